@@ -0,0 +1,511 @@
+/* skybench -- timings of libskycalc's hot entry points, as JSON.
+
+   usage: skybench [-s sizes] [-b name] [-t mintime] [-o file]
+
+   Each benchmark is run at each of the sizes (default 1,1000,1000000,
+   comma-separated) on inputs drawn from a fixed pseudo-random sequence,
+   so runs can be compared from one build to the next.  The "micro"
+   benchmarks make n calls of one routine; the "macro" ones do a whole
+   job over n catalogue objects -- reading a catalogue file the way
+   read_obj_list does (catalog_load_fp, which does its parsing), and
+   ranking a catalogue the way find_nearest does, by the keys and by
+   the catalogue index.  A batch is repeated until mintime seconds
+   (default 0.2) have gone by, and the result reported is
+
+	ns_per_call, calls_per_s   -- over all the repetitions
+	ns_per_run                 -- one repetition, the whole batch
+	allocs_per_call, alloc_bytes_per_call
+				   -- malloc, calloc and realloc calls
+				      made during the timed runs
+
+   where a "call" is one object for the macro benchmarks, except
+   find_nearest_ix, where it's one query (the 20 nearest) -- the
+   index makes its cost grow only slowly with n, so per object it
+   would be meaningless.  The rise
+   and set searches (jd_sun_alt, jd_moon_alt) take tens of microseconds
+   each, so they're held to 100000 calls a batch; "n" is the size
+   actually run.  -b runs only the benchmark named.  The allocation
+   counts need the link to wrap malloc (see the Makefile); built
+   without BENCH_WRAP_MALLOC they're reported as -1.
+
+   calcSafty and calcBaEofNight (libdk154sc.c) aren't in the library
+   built here, so they aren't covered.
+
+   Copyright (C) 2000  J.D.Pritchard -- GNU General Public License,
+   version 2 or later; see COPYING. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "libskycalc.h"
+
+#define MAXSIZES 16
+#define BENCH_JD0 2451545.   /* inputs span ten years from J2000 */
+
+/* allocation counting -- with BENCH_WRAP_MALLOC the link has
+   -Wl,--wrap=malloc (and calloc, realloc), so every allocation in
+   the library and here comes through these. */
+
+static long nalloc = 0;
+static double nalloc_bytes = 0.;
+
+#ifdef BENCH_WRAP_MALLOC
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size)
+	size_t size;
+{
+	nalloc++;
+	nalloc_bytes += size;
+	return(__real_malloc(size));
+}
+
+void *__wrap_calloc(nmemb, size)
+	size_t nmemb, size;
+{
+	nalloc++;
+	nalloc_bytes += (double) nmemb * size;
+	return(__real_calloc(nmemb,size));
+}
+
+void *__wrap_realloc(ptr, size)
+	void *ptr;
+	size_t size;
+{
+	nalloc++;
+	nalloc_bytes += size;
+	return(__real_realloc(ptr,size));
+}
+#endif
+
+/* the inputs, n of each, set up by bench_inputs */
+
+static double *in_jd, *in_ra, *in_dec, *in_ha, *in_lat, *in_longit, *in_sid;
+static volatile double sink;     /* keeps the calls from being optimized out */
+
+static struct catalog bcat;
+static struct catindex bix;
+static int *b_ind, *b_iwork;
+static double *b_keys, *b_dwork;
+static char bfile[] = "skybench.cat";
+
+static unsigned long bseed;
+
+double brand()
+
+/* uniform on [0,1), from a fixed linear congruential sequence --
+   the same on every system, unlike rand(). */
+
+{
+	bseed = (bseed * 1103515245UL + 12345UL) & 0x7fffffffUL;
+	return(bseed / 2147483648.);
+}
+
+int bench_inputs(n)
+
+	int n;
+
+/* fills the input arrays with n values each.  Returns 0, or -1 if
+   memory runs out. */
+
+{
+	int i;
+
+	free(in_jd); free(in_ra); free(in_dec); free(in_ha);
+	free(in_lat); free(in_longit); free(in_sid);
+	in_jd = (double *) malloc(n * sizeof(double));
+	in_ra = (double *) malloc(n * sizeof(double));
+	in_dec = (double *) malloc(n * sizeof(double));
+	in_ha = (double *) malloc(n * sizeof(double));
+	in_lat = (double *) malloc(n * sizeof(double));
+	in_longit = (double *) malloc(n * sizeof(double));
+	in_sid = (double *) malloc(n * sizeof(double));
+	if(in_jd == NULL || in_ra == NULL || in_dec == NULL || in_ha == NULL ||
+	   in_lat == NULL || in_longit == NULL || in_sid == NULL) return(-1);
+	bseed = 20000101UL;
+	for(i = 0; i < n; i++) {
+		in_jd[i] = BENCH_JD0 + 3652.5 * brand();
+		in_ra[i] = 24. * brand();
+		in_dec[i] = asin(2. * brand() - 1.) * DEG_IN_RADIAN;
+		in_ha[i] = 24. * brand() - 12.;
+		in_lat[i] = 120. * brand() - 60.;
+		in_longit[i] = 24. * brand() - 12.;
+		in_sid[i] = lst(in_jd[i],in_longit[i]);
+	}
+	return(0);
+}
+
+/* the micro benchmarks -- n calls each */
+
+void run_accumoon(n)
+	int n;
+{
+	double gra, gdec, gdist, tra, tdec, tdist;
+	int i;
+
+	for(i = 0; i < n; i++) {
+		accumoon(in_jd[i],in_lat[i],in_sid[i],2000.,&gra,&gdec,&gdist,
+			&tra,&tdec,&tdist);
+		sink += tra;
+	}
+}
+
+void run_accusun(n)
+	int n;
+{
+	double ra, dec, dist, tra, tdec, x, y, z;
+	int i;
+
+	for(i = 0; i < n; i++) {
+		accusun(in_jd[i],in_sid[i],in_lat[i],&ra,&dec,&dist,&tra,&tdec,
+			&x,&y,&z);
+		sink += tra;
+	}
+}
+
+void run_lpmoon(n)
+	int n;
+{
+	double ra, dec, dist;
+	int i;
+
+	for(i = 0; i < n; i++) {
+		lpmoon(in_jd[i],in_lat[i],in_sid[i],&ra,&dec,&dist);
+		sink += ra;
+	}
+}
+
+void run_lpsun(n)
+	int n;
+{
+	double ra, dec;
+	int i;
+
+	for(i = 0; i < n; i++) {
+		lpsun(in_jd[i],&ra,&dec);
+		sink += ra;
+	}
+}
+
+void run_precrot(n)
+	int n;
+{
+	double rf, df;
+	int i;
+
+	for(i = 0; i < n; i++) {
+		precrot(in_ra[i],in_dec[i],1950.,2025.,&rf,&df);
+		sink += rf;
+	}
+}
+
+void run_altit(n)
+	int n;
+{
+	double az;
+	int i;
+
+	for(i = 0; i < n; i++)
+		sink += altit(in_dec[i],in_ha[i],in_lat[i],&az);
+}
+
+void run_lst(n)
+	int n;
+{
+	int i;
+
+	for(i = 0; i < n; i++)
+		sink += lst(in_jd[i],in_longit[i]);
+}
+
+void run_helcor(n)
+	int n;
+{
+	double tcor, vcor;
+	int i;
+
+	for(i = 0; i < n; i++) {
+		helcor(in_jd[i],in_ra[i],in_dec[i],in_ha[i],in_lat[i],2000.,
+			&tcor,&vcor);
+		sink += vcor;
+	}
+}
+
+void run_barycor(n)
+	int n;
+{
+	double x, y, z, xdot, ydot, zdot;
+	int i;
+
+	for(i = 0; i < n; i++) {
+		barycor(in_jd[i],&x,&y,&z,&xdot,&ydot,&zdot);
+		sink += xdot;
+	}
+}
+
+void run_jd_sun_alt(n)
+	int n;
+{
+	int i;
+
+	for(i = 0; i < n; i++)
+		sink += jd_sun_alt(-18.,in_jd[i],in_lat[i],in_longit[i]);
+}
+
+void run_jd_moon_alt(n)
+	int n;
+{
+	int i;
+
+	for(i = 0; i < n; i++)
+		sink += jd_moon_alt(-0.83,in_jd[i],in_lat[i],in_longit[i],2000.);
+}
+
+/* the macro benchmarks -- jobs over a catalogue of n objects */
+
+int setup_catalog(n)
+
+	int n;
+
+/* writes n objects, in read_obj_list's format, to bfile, and reads
+   them into bcat.  Returns 0, or -1 on failure. */
+
+{
+	FILE *fp;
+	int i, nbad;
+	double ra, dec;
+
+	if((fp = fopen(bfile,"w")) == NULL) return(-1);
+	for(i = 0; i < n; i++) {
+		ra = in_ra[i];
+		dec = in_dec[i];
+		fprintf(fp,"obj%07d %02d %02d %05.2f %c%02d %02d %04.1f 2000.0 %.2f\n",
+			i,(int) ra,(int) (60. * ra) % 60,fmod(3600. * ra,60.),
+			dec < 0. ? '-' : '+',(int) fabs(dec),
+			(int) (60. * fabs(dec)) % 60,fmod(3600. * fabs(dec),60.),
+			in_ha[i]);
+	}
+	if(fclose(fp) != 0) return(-1);
+	/* setup_rank lends bcat and bix to the default context; take
+	   them back before they're freed */
+	catalog_init(&skycalc_default_ctx.cat);
+	skycalc_default_ctx.catindex = NULL;
+	catalog_free(&bcat);
+	if((fp = fopen(bfile,"r")) == NULL) return(-1);
+	i = catalog_load_fp(&bcat,fp,0,&nbad);
+	fclose(fp);
+	return((i == n) ? 0 : -1);
+}
+
+void run_read_obj_list(n)
+	int n;
+{
+	FILE *fp;
+	struct catalog cat;
+	int nbad;
+
+	(void) n;   /* the file was written n objects long by setup_catalog */
+	memset(&cat,0,sizeof(cat));
+	if((fp = fopen(bfile,"r")) == NULL) return;
+	sink += catalog_load_fp(&cat,fp,0,&nbad);
+	fclose(fp);
+	catalog_free(&cat);
+}
+
+int setup_rank(n)
+
+	int n;
+
+/* the catalogue, the find_nearest work arrays, and the index. */
+
+{
+	if(setup_catalog(n) != 0) return(-1);
+	free(b_ind); free(b_iwork); free(b_keys); free(b_dwork);
+	b_ind = (int *) malloc((n + 1) * sizeof(int));
+	b_iwork = (int *) malloc((n + 1) * sizeof(int));
+	b_keys = (double *) malloc((n + 1) * sizeof(double));
+	b_dwork = (double *) malloc((n + 1) * sizeof(double));
+	if(b_ind == NULL || b_iwork == NULL || b_keys == NULL || b_dwork == NULL)
+		return(-1);
+	catindex_free(&bix);
+	if(catindex_build(&bcat,2000.,&bix) != 0) return(-1);
+	skycalc_default_ctx.cat = bcat;
+	skycalc_default_ctx.catindex = &bix;
+	return(0);
+}
+
+void run_find_nearest(n)
+	int n;
+{
+	struct rank_spec rs;
+
+	(void) n;   /* bcat holds n objects, from setup_rank */
+	/* as find_nearest does it, without an index, for the first 20
+	   by arc distance */
+	rs.key = RANK_ARC;
+	rs.ra = 12.;
+	rs.dec = -30.;
+	rs.epoch = 2000.;
+	rs.jd = BENCH_JD0;
+	rs.lat = -29.25;
+	rs.longit = 4.7153;
+	rs.aircrit = 0.;
+	catalog_keys_r(&skycalc_default_ctx,&bcat,&rs,b_keys + 1);
+	sink += find_nearest_rank_r(&skycalc_default_ctx,0,rs.ra,rs.dec,
+		rs.epoch,20,b_ind,b_keys,b_iwork,b_dwork);
+}
+
+void run_find_nearest_ix(n)
+	int n;
+{
+	(void) n;   /* bix indexes n objects, from setup_rank */
+	sink += find_nearest_rank_r(&skycalc_default_ctx,1,12.,-30.,2000.,20,
+		b_ind,b_keys,b_iwork,b_dwork);
+}
+
+struct bench {
+	char *name;
+	char *kind;                /* "micro" or "macro" */
+	int maxn;                  /* largest batch run */
+	int ncall;                 /* calls a run -- 0 if n */
+	int (*setup)(int n);       /* NULL if the inputs are enough */
+	void (*run)(int n);
+};
+
+static struct bench benches[] = {
+	{"accumoon",        "micro", 1000000000, 0, NULL, run_accumoon},
+	{"accusun",         "micro", 1000000000, 0, NULL, run_accusun},
+	{"lpmoon",          "micro", 1000000000, 0, NULL, run_lpmoon},
+	{"lpsun",           "micro", 1000000000, 0, NULL, run_lpsun},
+	{"precrot",         "micro", 1000000000, 0, NULL, run_precrot},
+	{"altit",           "micro", 1000000000, 0, NULL, run_altit},
+	{"lst",             "micro", 1000000000, 0, NULL, run_lst},
+	{"helcor",          "micro", 1000000000, 0, NULL, run_helcor},
+	{"barycor",         "micro", 1000000000, 0, NULL, run_barycor},
+	{"jd_sun_alt",      "micro", 100000, 0, NULL, run_jd_sun_alt},
+	{"jd_moon_alt",     "micro", 100000, 0, NULL, run_jd_moon_alt},
+	{"read_obj_list",   "macro", 1000000000, 0, setup_catalog, run_read_obj_list},
+	{"find_nearest",    "macro", 1000000000, 0, setup_rank, run_find_nearest},
+	{"find_nearest_ix", "macro", 1000000000, 1, setup_rank, run_find_nearest_ix}
+};
+
+double bench_now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return(ts.tv_sec + 1.0e-9 * ts.tv_nsec);
+}
+
+int parse_sizes(s, size)
+
+	char *s;
+	int *size;
+
+/* a comma-separated list of sizes; returns how many, or -1. */
+
+{
+	int n = 0;
+	char *p;
+
+	for(p = s; *p != '\0'; p++) {
+		if(n == MAXSIZES || (size[n] = atoi(p)) < 1) return(-1);
+		n++;
+		p = p + strspn(p,"0123456789");
+		if(*p != ',') break;
+	}
+	return((*p == '\0' && n > 0) ? n : -1);
+}
+
+int main(argc, argv)
+
+	int argc;
+	char **argv;
+
+{
+	int size[MAXSIZES], nsize, i, j, k, n, nb, first;
+	long reps;
+	double mintime, t0, t, calls, allocs, bytes;
+	char *only, *outname;
+	FILE *out;
+
+	nsize = parse_sizes("1,1000,1000000",size);
+	mintime = 0.2;
+	only = NULL;
+	outname = NULL;
+	for(i = 1; i < argc - 1 && argv[i][0] == '-'; i += 2) {
+		if(strcmp(argv[i],"-s") == 0) {
+			if((nsize = parse_sizes(argv[i+1],size)) < 0) break;
+		}
+		else if(strcmp(argv[i],"-t") == 0) mintime = atof(argv[i+1]);
+		else if(strcmp(argv[i],"-b") == 0) only = argv[i+1];
+		else if(strcmp(argv[i],"-o") == 0) outname = argv[i+1];
+		else break;
+	}
+	if(i != argc || mintime <= 0.) {
+		fprintf(stderr,"usage: %s [-s sizes] [-b name] [-t mintime] [-o file]\n",
+			argv[0]);
+		return(1);
+	}
+	if(outname == NULL) out = stdout;
+	else if((out = fopen(outname,"w")) == NULL) {
+		fprintf(stderr,"%s: can't write %s.\n",argv[0],outname);
+		return(1);
+	}
+
+	fprintf(out,"{\n  \"library\": \"libskycalc\",\n");
+	fprintf(out,"  \"min_time_s\": %g,\n",mintime);
+	fprintf(out,"  \"results\": [");
+	first = 1;
+	nb = sizeof(benches) / sizeof(struct bench);
+	for(k = 0; k < nsize; k++) {
+		if(bench_inputs(size[k]) != 0) {
+			fprintf(stderr,"%s: out of memory at size %d.\n",argv[0],size[k]);
+			return(1);
+		}
+		for(j = 0; j < nb; j++) {
+			if(only != NULL && strcmp(only,benches[j].name) != 0) continue;
+			n = (size[k] < benches[j].maxn) ? size[k] : benches[j].maxn;
+			if(benches[j].setup != NULL && (*benches[j].setup)(n) != 0) {
+				fprintf(stderr,"%s: %s: setup failed at size %d.\n",argv[0],
+					benches[j].name,n);
+				return(1);
+			}
+			(*benches[j].run)(n);    /* warm up */
+			reps = 0;
+			nalloc = 0;
+			nalloc_bytes = 0.;
+			t0 = bench_now();
+			do {
+				(*benches[j].run)(n);
+				reps++;
+				t = bench_now() - t0;
+			} while(t < mintime);
+			calls = (double) reps *
+				(benches[j].ncall > 0 ? benches[j].ncall : n);
+#ifdef BENCH_WRAP_MALLOC
+			allocs = nalloc / calls;
+			bytes = nalloc_bytes / calls;
+#else
+			allocs = bytes = -1.;
+#endif
+			fprintf(out,"%s\n    {\"name\": \"%s\", \"kind\": \"%s\", \"n\": %d, \"reps\": %ld, ",
+				first ? "" : ",",benches[j].name,benches[j].kind,n,reps);
+			fprintf(out,"\"ns_per_call\": %.4g, \"calls_per_s\": %.4g, ",
+				1.0e9 * t / calls,calls / t);
+			fprintf(out,"\"ns_per_run\": %.4g, ",1.0e9 * t / reps);
+			fprintf(out,"\"allocs_per_call\": %.4g, \"alloc_bytes_per_call\": %.4g}",
+				allocs,bytes);
+			first = 0;
+			fflush(out);
+		}
+	}
+	fprintf(out,"\n  ],\n  \"sink\": %g\n}\n",(double) sink);
+	if(out != stdout) fclose(out);
+	remove(bfile);
+	return(0);
+}
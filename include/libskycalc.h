@@ -338,6 +338,7 @@ LEGALITIES:
 #include <ctype.h>
 #include <stdarg.h>
 #include <string.h>
+#include <stdlib.h>
 
 /* a couple of the system-dependent magic numbers are defined here */
 
@@ -348,12 +349,75 @@ LEGALITIES:
 #define LOG_FILES_OK 1  /* 1 means that log files are enabled.
 			Any other value means they're not.  */
 
-#define MAX_OBJECTS 500
+#define THREADS_OK 1    /* 1 means POSIX threads are available (link
+   with -lpthread).  Anything else and the "parallel" routines
+   just run in the calling thread. */
+
+#if THREADS_OK == 1
+#include <pthread.h>
+#endif
+
 #define MINSHORT -32767   /* min, max short integers and double precision */
 #define MAXSHORT 32767
 #define MAXDOUBLE 1.0e38
 #define MINDOUBLE -1.0e38
 #define BUFSIZE 150
+#define PREC_CACHE_SIZE 8  /* recent precession matrices kept per context */
+#define DST_CACHE_SIZE  8  /* recent daylight time bounds kept per context */
+#define DST_LASTSUN     0  /* dst_rule days -- the last Sunday of the month */
+#define MOON_CHEB_SEG   4.  /* days per segment of a moon_cheb table */
+#define MOON_CHEB_NCOEF 13  /* Chebyshev coefficients per coordinate */
+#define SKYEPH_MAGIC     0x53434550  /* "SCEP" -- ephemeris file */
+#define SKYEPH_VERSION   1
+#define SKYEPH_BYTEORDER 0x01020304  /* as written; reads wrong if swapped */
+#define SKYEPH_NBODY     11
+#define SKYEPH_SUN       0   /* body numbers -- 1 - 9 are planets as in el[] */
+#define SKYEPH_MOON      10
+#define SKYEPH_NCOEF     13  /* Chebyshev coefficients per coordinate */
+#define EVENT_SUN     0      /* bodies for rise / set / twilight searches */
+#define EVENT_MOON    1
+#define EVENT_STEP    (1./48.)  /* days between altitude samples */
+#define EVENT_MAXSAMP 1024   /* longest alt_crossings window, in samples */
+#define EVENT_WINDOW  0.25   /* days either side of a guess to search */
+#define EVENT_TOL     2.0e-5 /* days (about 2 sec) -- default tolerance */
+#define NIGHT_MAXCUSTOM 4    /* extra sun altitudes night_events can find */
+#define NIGHT_MAXCROSS  8    /* crossings of one altitude kept per night */
+#define ALMANAC_MAGIC   0x53434141  /* "SCAA" -- almanac cache file */
+#define ALMANAC_VERSION 1
+#define OSINK_STDOUT   0    /* output sinks -- see osink_write */
+#define OSINK_FILE     1
+#define OSINK_BUFFER   2
+#define OSINK_CALLBACK 3
+#define OSINK_NULL     4
+#define OSINK_LINE     512  /* oprntf formats into this much stack first */
+#define AIRMASS_MAXHRS 24    /* most hourly_airmass rows each side of center */
+#define CATALOG_CHUNK  1024  /* a catalog starts with room for this many */
+#define CATALOG_READBUF 65536 /* catalog_load_fp's buffer, if it can't mmap */
+#define RANK_ARC      1   /* rank keys -- as find_nearest's sort options */
+#define RANK_HA       2
+#define RANK_AIRMASS  3
+#define RANK_SETTING  4
+#define RANK_XTRA     5
+#define BATCH_BLOCK 256  /* working block for the batched (array)
+			routines -- sized to keep scratch arrays in L1 */
+#define MAX_THREADS 64   /* most threads skycalc_parallel will start */
+#define SEASON_CHUNK 16  /* objects per piece of obs_season_cat work */
+#define CALENDAR_CHUNK 8  /* nights per piece of calendar_gen work */
+#define CAL_TEXT 0       /* calendar_print formats -- plain text, */
+#define CAL_TEX1 1       /* TeX with one month a page, */
+#define CAL_TEX2 2       /* TeX with two months a page, */
+#define CAL_DATA 3       /* or one tab-separated line per night */
+#define HELSER_STEP 1.    /* days between helcor_series' interpolation nodes */
+#define HELSER_CHUNK 4096 /* epochs per piece of helcor_series work */
+#define ECL_LUNAR 0      /* kinds of event, for eclipse_search and */
+#define ECL_SOLAR 1      /*   occult_search */
+#define ECL_OCCULT 2
+#define ECL_STEP (1./144.)  /* days between eclipse_search's samples */
+#define ECL_WINDOW 0.3   /* days either side of a syzygy searched */
+#define ECL_TOL 1.0e-5   /* days -- how closely contacts are found */
+#define OCC_STEP (1./24.)   /* days between occult_search's moon positions */
+#define OCC_MARGIN 1.    /* degrees beyond the limb to look closer */
+#define OCC_CHUNK 64     /* moon positions per piece of occult_search work */
 
 /* some (not all) physical, mathematical, and astronomical constants
    used are defined here. */
@@ -375,6 +439,7 @@ LEGALITIES:
 						to a major planet ... */
 #define  KZEN              0.172       /* zenith extinction, mag, for use
 				     in lunar sky brightness calculations. */
+#define  LN_10             2.30258509299404568  /* for 10^x = exp(LN_10 x) */
 #define FIRSTJD            2415387.  /* 1901 Jan 1 -- calendrical limit */
 #define LASTJD             2488070.  /* 2099 Dec 31 */
 
@@ -416,7 +481,7 @@ struct date_time
 	short d;
 	short h;
 	short mn;
-	float s;
+	double s;
    };
 
 struct elements
@@ -432,6 +497,18 @@ struct elements
 	double mass;
    };
 
+/* the parts of the planet-position formulae that stay the same for
+   one set of elements -- filled in by comp_el_r alongside el[]. */
+
+struct elrot {
+	double ecc;
+	double c1, c2, c3;   /* coefficients of sin M, sin 2M, sin 3M in nu */
+	double p;            /* semi-latus rectum, a (1 - e^2), AU */
+	double M0, n;        /* mean anomaly at jd_el, and daily motion, rad */
+	double cw, sw;       /* cos and sin of omega - Omega */
+	double P[3], Q[3];   /* axes of the orbit plane, ecliptic xyz */
+};
+
 struct objct {
 	char name[20];
 	double ra;
@@ -440,6 +517,524 @@ struct objct {
 	float xtra;  /* mag, whatever */
 };
 
+/* a growable object catalog.  The objects are objs[1] through
+   objs[n] -- 1-indexed, as the list routines have always used them. */
+
+struct catalog {
+	struct objct *objs;
+	int n;
+	int cap;        /* room for objs[1] through objs[cap] */
+	unsigned long gen;  /* new with every change -- see catalog_touch */
+};
+
+/* a spatial index over a catalog, from catindex_build -- a k-d tree
+   of unit vectors at one epoch, stored implicitly: the node for a
+   range of entries is the middle one, split on axis depth % 3. */
+
+struct catindex {
+	double epoch;
+	int n;          /* objects indexed (the catalog's n when built) */
+	unsigned long gen;  /* the catalog's gen when built */
+	double *xyz;    /* unit vectors, 3 per object, in tree order */
+	int *id;        /* catalog index of each */
+};
+
+/* a catalog object near a solar-system body, from planet_screen --
+   body is SKYEPH_SUN, SKYEPH_MOON or a planet number. */
+
+struct prox_hit {
+	int obj;        /* catalog index */
+	short body;
+	double jd;      /* UT of the time step */
+	double sep;     /* degrees */
+};
+
+struct prox_list {
+	int n, cap;
+	struct prox_hit *hit;
+};
+
+/* what to rank a catalog by, for catalog_keys and catalog_rank. */
+
+struct rank_spec {
+	int key;         /* RANK_ARC etc. */
+	double ra, dec;  /* reference position (RANK_ARC, RANK_AIRMASS) */
+	double epoch;    /* of ra and dec */
+	double jd;       /* UT, for the keys that depend on time */
+	double lat, longit;
+	double aircrit;  /* critical airmass in the west (RANK_SETTING) */
+};
+
+#if THREADS_OK == 1
+
+/* work shared out by skycalc_parallel -- items are handed out
+   chunk at a time from next. */
+
+struct par_job {
+	void (*func)(void *arg, int i0, int i1);
+	void *arg;
+	int n, chunk;
+	int next;            /* first item not yet handed out */
+	pthread_mutex_t lock;
+};
+
+#endif
+
+/* the parts of the Krisciunas-Schaefer moonlit sky brightness
+   (lunskybright) that depend only on the moon, from
+   skybright_moon_set. */
+
+struct skybright_moon {
+	double alpha, kzen, altmoon, moondist;   /* as for lunskybright */
+	double u[3];       /* toward the moon, in alt-az (see cel_unit) */
+	double istar;      /* moon's illuminance, times its extinction */
+};
+
+/* a fixed grid of points on the sky in alt-az, from sky_grid_init,
+   for sky_grid_bright. */
+
+struct sky_grid {
+	int n;
+	double kzen;       /* extinction airfac is for */
+	double *u;         /* unit vectors, 3 per point */
+	double *alt;       /* degrees */
+	double *airfac;    /* sky_airfac of each point */
+};
+
+/* one night of an observing season, from season_nights -- the
+   night nearest a new or full moon.  Twilight times are -1. if
+   the sun doesn't get down to the twilight altitude. */
+
+struct season_night {
+	short nph;           /* 0 = new moon, 2 = full (as flmoon) */
+	double jdphase;      /* of the new or full moon */
+	double jdcent;       /* sun's lower culmination */
+	double jdeve, jdmorn;     /* evening and morning twilight */
+	double jdevedate;    /* for the local evening date */
+	double steve, stcent, stmorn;  /* local sidereal times (hours) */
+};
+
+/* one object on one season_night, from season_obs_calc.  HA in
+   hours; secz as from secant_z; hrs_ are dark hours spent at sec z
+   less than 3, 2 and 1.5. */
+
+struct season_obs {
+	double haeve, seczeve;
+	double hacent, seczcent;
+	double hamorn, seczmorn;
+	double hrs_3, hrs_2, hrs_15;
+};
+
+/* a whole catalog through a season, from obs_season_cat.
+   obs[i * nnight + k] is object i+1 (of the catalog) on night k. */
+
+struct season_table {
+	int nnight, nobj;
+	double sun_twi, lat, longit;
+	double curep;        /* objects were precessed to this */
+	struct season_night *night;
+	struct season_obs *obs;
+	double *ra, *dec;    /* scratch, while it's being filled */
+};
+
+/* Greenwich mean sidereal time at 0h UT of one day, kept by
+   lst_cached so that later times on the same UT day need only the
+   linear term.  A zeroed one is empty. */
+
+struct sid_cache {
+	int valid;
+	double jdmid;      /* JD of 0h UT */
+	double gmst0;      /* GMST there, fraction of a day */
+};
+
+/* one rule of a daylight time convention (use_dst; see
+   find_dst_bounds), for the years from through to, after a tzdata
+   Rule line.  The clocks change at 2 AM local time.  In the north,
+   daylight time begins in month mo1 and ends in mo2; in the south
+   (use_dst < 0) standard time begins in mo1 and ends in mo2.  A day
+   is the first Sunday on or after that day of the month if it's
+   positive, exactly day -day if it's negative, and the last Sunday
+   of the month if it's DST_LASTSUN. */
+
+struct dst_rule {
+	short use_dst;
+	short from, to;
+	short mo1, day1;
+	short mo2, day2;
+};
+
+/* daylight time rules read by dst_rules_load. */
+
+struct dst_rules {
+	int n, cap;
+	struct dst_rule *rule;
+};
+
+/* the daylight time bounds of one year, as find_dst_bounds gives
+   them, kept by find_dst_bounds_r. */
+
+struct dst_bounds {
+	short yr, use_dst;
+	double stdz;
+	double jdb, jde;
+};
+
+/* a precession matrix, as built by prec_matrix, for carrying from
+   orig_epoch to final_epoch. */
+
+struct precmat {
+	double orig_epoch;
+	double final_epoch;
+	double p[3][3];
+};
+
+/* a rotation from one frame to another, built up from the xform_
+   calls.  It acts on column unit vectors, so following rotation A
+   with rotation B gives the single matrix B A. */
+
+struct xform {
+	double m[3][3];
+};
+
+/* piecewise Chebyshev fits to the geocentric lunar position (x, y, z
+   in earth radii, equinox of date) from accumoon, made by
+   moon_cheb_build.  jdstart and jdend are ephemeris time. */
+
+struct moon_cheb {
+	double jdstart;
+	double jdend;
+	int nseg;
+	double *coef;  /* nseg * 3 * MOON_CHEB_NCOEF */
+};
+
+/* layout of an ephemeris file from skyeph_write: this header, then
+   the coefficients.  Body b, segment s, coordinate j (x, y, z),
+   coefficient k is coef[offset + (3 s + j) ncoef + k]. */
+
+struct skyeph_body {
+	double jdstart;  /* start of the first segment */
+	double seglen;   /* days */
+	int nseg;
+	int ncoef;
+	int offset;      /* in doubles, from the start of the coefficients */
+	int spare;
+};
+
+struct skyeph_header {
+	int magic;
+	int version;
+	int byteorder;
+	int nbody;
+	double jdstart;  /* span requested of skyeph_write */
+	double jdend;
+	struct skyeph_body body[SKYEPH_NBODY];
+};
+
+/* an ephemeris file mapped by skyeph_open. */
+
+struct skyeph {
+	void *map;
+	size_t maplen;
+	struct skyeph_header *hdr;
+	double *coef;
+};
+
+/* a crossing of a given altitude, found by alt_crossings. */
+
+struct alt_crossing {
+	double jd;
+	short rising;   /* 1 if rising through the altitude, 0 if setting */
+};
+
+/* one event found by night_events. */
+
+struct night_event {
+	double jd;      /* UT; -1. if it doesn't happen that night */
+	double illum;   /* moon's illuminated fraction at jd */
+};
+
+/* all the almanac events of one night, from night_events. */
+
+struct night_events {
+	double jdmid;   /* local midnight (UT) the night is centered on */
+	struct night_event sunset, sunrise;  /* at -(0.83 + horiz) */
+	struct night_event eve6, morn6;      /* civil */
+	struct night_event eve12, morn12;    /* nautical */
+	struct night_event eve13, morn13;
+	struct night_event eve18, morn18;    /* astronomical */
+	int ncustom;
+	double custom_alt[NIGHT_MAXCUSTOM];
+	struct night_event custom_eve[NIGHT_MAXCUSTOM];
+	struct night_event custom_morn[NIGHT_MAXCUSTOM];
+	struct night_event moonrise, moonset;  /* first of each */
+};
+
+/* almanac cache (almanac_get etc.) -- per-night records from
+   night_events, keyed by site, night, and altitudes, in an
+   open-addressed hash table. */
+
+struct almanac_key {
+	double jdmid;
+	double lat;
+	double longit;
+	double elevsea;
+	double horiz;
+	double custom[NIGHT_MAXCUSTOM];
+	int ncustom;
+	int spare;   /* keeps the key free of padding */
+};
+
+struct almanac_entry {
+	struct almanac_key key;
+	struct night_events ne;
+	int used;
+	int spare;
+};
+
+struct almanac_cache {
+	struct almanac_entry *entries;
+	int cap;        /* slots -- a power of 2 */
+	int n;          /* nights held */
+	long hits;      /* lookups answered from the cache */
+	long misses;    /* lookups that had to compute */
+};
+
+/* where a context's printed output goes; set with osink_stdout,
+   osink_file, osink_buffer, osink_callback, or osink_null. */
+
+struct osink {
+	int kind;                /* OSINK_STDOUT etc. */
+	FILE *fp;                /* OSINK_FILE */
+	char *buf;               /* OSINK_BUFFER -- NUL-terminated */
+	size_t len;
+	size_t size;
+	void (*func)(void *arg, char *text, size_t len);  /* OSINK_CALLBACK */
+	void *arg;
+};
+
+/* one body's place, as pposns tabulates it. */
+
+struct body_posn {
+	double ra, dec;   /* topocentric for sun and moon */
+	double ha, alt, az, secz;
+};
+
+/* everything pposns prints, from calc_pposns. */
+
+struct planet_posns {
+	struct body_posn sun, moon;
+	struct body_posn planet[10];  /* 1-9 in the usual order; 3 unused */
+};
+
+/* the circumstances of an observation, from calc_circumstances --
+   what print_circumstances prints.  Quantities print_circumstances
+   only reports under some conditions are set only under the same
+   conditions; the flags say which. */
+
+struct circumstances {
+	short pm;               /* 1 if there is a proper motion */
+	double objra_adj, objdec_adj;  /* adjusted for it, at curep */
+	double mura_arcs;       /* RA proper motion, arcsec/yr */
+	double curra, curdec;   /* at curep */
+	double ha, alt, az, secz, par;
+	double georamoon, geodecmoon, geodistmoon;
+	double ramoon, decmoon, distmoon;         /* topocentric */
+	double rasun, decsun, distsun, toporasun, topodecsun;
+	double sun_alt, sun_az;
+	double sun_moon;        /* degrees */
+	float ill_frac;
+	short sol_ecl;          /* from solecl_calc, if sun_alt >= -18 */
+	float sol_ecl_mag;
+	double moon_alt, moon_az;
+	double obj_moon;        /* degrees; if moon_alt > -2. */
+	double obj_lunlimb;     /* if obj_moon < 10. */
+	short lun_ecl;          /* from lunecl_calc, if moon_alt > -2. */
+	float lun_ecl_mag;
+	short have_vmoon;       /* 1 if a lunar sky brightness applies */
+	double Vmoon;
+	double eclong, eclat;
+	double planet_sep[10];  /* degrees, from planet_seps */
+	double tcor, vcor;      /* barycentric corrections, sec and km/s */
+	double bjd;
+};
+
+/* one line of the hourly airmass table. */
+
+struct airmass_row {
+	double jd;              /* UT */
+	double jdlocal;
+	double sid, ha, alt, secz, par;
+	double sunalt, moonalt;
+};
+
+/* the hourly airmass table, from calc_hourly_airmass. */
+
+struct airmass_table {
+	double jdmid;           /* UT of local midnight */
+	double jdb, jde;        /* daylight time bounds for the year */
+	short timechange;       /* 1 if std/daylight time changes tonight */
+	double curep, curra, curdec;
+	double ill_frac;        /* moon at midnight */
+	double sepn;            /* moon to object, degrees */
+	double planet_sep[10];
+	int nrows;
+	struct airmass_row row[2 * AIRMASS_MAXHRS + 1];
+};
+
+/* one night's almanac as print_tonight reckons it, from calc_tonight.
+   The state flags are 0 if the events were computed, 1 if the sun
+   (or moon) stays above the altitude all night, -1 if it stays below,
+   and 2 if the question didn't arise. */
+
+struct tonight {
+	double jd;              /* local date at 18h, as date_to_jd gives it */
+	double jdb, jde;        /* daylight time bounds (UT) for the year */
+	double locjdb, locjde;  /* the same, local */
+	short timechange;       /* 1 if std/daylight time changes tonight */
+	double jdmid;           /* UT of local midnight */
+	double stmid;           /* local mean sidereal time then */
+	double rasun, decsun;
+	double ramoon, decmoon, distmoon;  /* topocentric, at jdmid */
+	short sunstate;
+	double jdsunset, jdsunrise;
+	double jdcent;          /* -1. if not computed */
+	float set_to_rise, twi_to_twi;  /* hours */
+	short twi18state;
+	double jdetw, jdmtw;    /* 18-degree twilight */
+	double sidetw, sidmtw;  /* LMST at each */
+	short twi12state;
+	double jdetw12, jdmtw12;
+	short moonstate;
+	double jdmoonrise, jdmoonset;
+	double tmoonrise, tmoonset;   /* hours from midnight */
+	float moon_print;       /* moon events further out aren't printed */
+	double ill_frac;
+};
+
+/* an observatory, as load_site describes one -- see there for the
+   meaning of each quantity. */
+
+struct cal_site {
+	char name[40];
+	char zone_name[25];
+	char zabr;
+	double longit, lat, stdz;
+	double elevsea, elev, horiz;
+	short use_dst;
+};
+
+/* nights at several sites, from calendar_gen.  night[s * nnight + k]
+   is the night beginning on local date jdstart + k at site[s]. */
+
+struct calendar {
+	struct cal_site *site;
+	int nsite;
+	short year, nyears;  /* years covered, from 1 Jan of year */
+	int nnight;          /* nights at each site */
+	double jdstart;      /* local 18h of the first, as date_to_jd gives */
+	struct tonight *night;
+	struct skycalc_ctx *ctx;  /* ephemerides to use, while filling */
+};
+
+/* helcor_series' work, shared between threads -- the earth's
+   barycentric state at nnode nodes HELSER_STEP apart from jd0, six
+   to a node (x, y, z in AU and xdot, ydot, zdot in km/s, as
+   helcor_earth_r gives them), and the target and site. */
+
+struct helser {
+	double *jd;
+	int n;
+	double jd0;
+	int nnode;
+	double *node;
+	double xobj, yobj, zobj;   /* unit vector to the target */
+	double ra, longit;         /* hours */
+	double rot;                /* diurnal velocity amplitude, km/s */
+	double *tcor, *vcor;
+	struct skycalc_ctx *ctx;   /* ephemerides to use, while filling */
+};
+
+/* an eclipse or occultation, from eclipse_search or occult_search.
+   contact[] holds the times (UT) of the contacts in order -- for a
+   lunar eclipse P1 U1 U2 U3 U4 P4, for a solar eclipse C1 C2 C3 C4,
+   for an occultation disappearance and reappearance -- with -1 for
+   any that don't happen. */
+
+struct ecl_event {
+	short kind;        /* ECL_LUNAR, ECL_SOLAR or ECL_OCCULT */
+	short type;        /* as lunecl_calc or solecl_calc; 1 for occultations */
+	int obj;           /* catalog index, for occultations */
+	double jdmax;      /* greatest eclipse, or closest approach */
+	double sepmax;     /* separation then, degrees, as ecl_geom */
+	float magnitude;   /* solar: fraction of the sun covered, as
+			      solecl_calc.  lunar: umbral magnitude (types
+			      3 and 4, > 1 for total) or penumbral (types
+			      1 and 2), in moon diameters.  0 for
+			      occultations. */
+	double alt;        /* altitude of the moon (the sun, for a solar
+			      eclipse) at jdmax, from the site */
+	double contact[6];
+};
+
+struct ecl_list {
+	int n, cap;
+	struct ecl_event *ev;
+};
+
+/* what ecl_geom and the event searches need to know. */
+
+struct ecl_arg {
+	struct skycalc_ctx *ctx;
+	int kind;
+	int level;              /* contact whose separation ecl_func is
+				   relative to; -1 for none */
+	double lat, longit, elevsea;
+	double xyz[3];          /* the object, for occultations (J2000) */
+};
+
+/* occult_search's work, shared between threads. */
+
+struct occ_job {
+	struct skycalc_ctx *ctx;   /* ephemerides to use */
+	double lat, longit, elevsea;
+	double jd0;
+	int nnode;
+	double *node;      /* 4 per node OCC_STEP apart from jd0: the
+			      topocentric moon's J2000 unit vector, and the
+			      cosine of its semidiameter plus OCC_MARGIN */
+	int nobj;
+	double *xyz;       /* 3 per object, J2000 unit vectors */
+	int *obj;          /* catalog index of each */
+	struct ecl_list *found;   /* events for each; n = -1 if memory ran out */
+};
+
+/* Everything the library used to keep in file-scope globals -- the
+   planetary elements loaded by comp_el, the object list, the log file
+   and the getch/ungetch pushback buffer -- lives in one of these.
+   The _r entry points take one explicitly, so separate threads can
+   work in separate contexts; the traditional entry points all use
+   skycalc_default_ctx. */
+
+struct skycalc_ctx {
+	double jd_el;              /* epoch of elements in el[] */
+	struct elements el[10];
+	struct elrot elr[10];      /* from el[], by elrot_load */
+	struct catalog cat;        /* the object list */
+	struct catindex *catindex; /* if set, used by find_nearest_r */
+	FILE *sclogfl;
+	struct osink sink;   /* where oprntf_r output goes */
+	char buf[BUFSIZE];
+	int bufp;
+	struct precmat prec_cache[PREC_CACHE_SIZE]; /* most recent first */
+	int prec_cache_n;
+	struct moon_cheb *moon_cheb;  /* if set, used by accumoon_r */
+	struct skyeph *eph;  /* if set, used by the _r positions */
+	struct sid_cache sid;  /* used by lst_r */
+	struct dst_bounds dst_cache[DST_CACHE_SIZE]; /* most recent first */
+	int dst_cache_n;
+	struct dst_rules *dst;  /* if set, used by find_dst_bounds_r */
+};
+
 
 /* from Line 1553 */
 #define IGREG 2299161
@@ -452,41 +1047,74 @@ struct objct {
 #ifdef __cplusplus
 extern "C" {
 #endif
+extern struct skycalc_ctx skycalc_default_ctx;
+void skycalc_ctx_init(struct skycalc_ctx *ctx);
 void oprntf(char *fmt, ...);
+void voprntf_r(struct skycalc_ctx *ctx,char *fmt,va_list ap);
+void oprntf_r(struct skycalc_ctx *ctx,char *fmt, ...);
+void osink_write(struct skycalc_ctx *ctx,char *text,size_t len);
+void osink_stdout(struct skycalc_ctx *ctx);
+void osink_file(struct skycalc_ctx *ctx,FILE *fp);
+void osink_buffer(struct skycalc_ctx *ctx);
+void osink_callback(struct skycalc_ctx *ctx,void (*func)(void *arg, char *text, size_t len),void *arg);
+void osink_null(struct skycalc_ctx *ctx);
+char *osink_text(struct skycalc_ctx *ctx,size_t *len);
+void osink_clear(struct skycalc_ctx *ctx);
+void osink_free(struct skycalc_ctx *ctx);
 char getch();
+char getch_r(struct skycalc_ctx *ctx);
 void ungetch(int c);
+void ungetch_r(struct skycalc_ctx *ctx,int c);
 int legal_num_part(char c);
 int legal_int_part(char c);
 int legal_command_char(char c);
 int parsedouble(char *s,double *d);
+int parsedouble_r(struct skycalc_ctx *ctx,char *s,double *d);
 int getdouble(double *d,double least,double most,char *errprompt);
+int getdouble_r(struct skycalc_ctx *ctx,double *d,double least,double most,char *errprompt);
 int parseshort(char *s,short *d);
+int parseshort_r(struct skycalc_ctx *ctx,char *s,short *d);
 int getshort(short *d,short least,short most,char *errprompt);
+int getshort_r(struct skycalc_ctx *ctx,short *d,short least,short most,char *errprompt);
 double bab_to_dec(struct coord bab);
 void dec_to_bab (double deci,struct coord *bab);
 short get_line(char *s);
 double get_coord();
 void put_coords(double deci,short precision);
+void put_coords_r(struct skycalc_ctx *ctx,double deci,short precision);
 void load_site(double *longit,double *lat,double *stdz,short *use_dst,char *zone_name,char *zabr,double *elevsea,double *elev,double *horiz,char *site_name);
 double atan_circ(double x,double y);
 void min_max_alt(double lat,double dec,double *min,double *max);
 double altit(double dec,double ha,double lat,double *az);
 double secant_z(double alt);
+void altaz_batch(double *ra,double *dec,size_t n,double jd,double lat,double longit,double *alt,double *az,double *secz);
 double ha_alt(double dec,double lat,double alt);
 double subtend(double ra1,double dec1,double ra2,double dec2);
 int get_pm(double dec,double *mura,double *mudec);
 int get_date(struct date_time date);
 int get_time(struct date_time date);
+long jdn_from_civil(long y,int mo,int d);
+void civil_from_jdn(long jdn,short *y,short *mo,short *d);
+void jd_split(double jd,long *jdn,double *sod);
 double date_to_jd(struct date_time date);
 short day_of_week(double jd);
 void caldat(double jdin,struct date_time *date,short *dow);
+void caldat_batch(double *jd,size_t n,struct date_time *date,short *dow);
+void date_to_jd_batch(struct date_time *date,size_t n,double *jd);
 void print_day(short d);
+void print_day_r(struct skycalc_ctx *ctx,short d);
 void print_all(double jdin);
+void print_all_r(struct skycalc_ctx *ctx,double jdin);
 void print_current(struct date_time date,short night_date,short enter_ut);
+void print_current_r(struct skycalc_ctx *ctx,struct date_time date,short night_date,short enter_ut);
 void print_calendar(double jdin,short *dow);
 void print_time(double jdin,short prec);
+void print_time_r(struct skycalc_ctx *ctx,double jdin,short prec);
 double frac_part(double x);
 double lst(double jd,double longit);
+double lst_cached(struct sid_cache *sc,double jd,double longit);
+double lst_r(struct skycalc_ctx *ctx,double jd,double longit);
+void lst_series(double jd0,double dt,int n,double longit,double *out);
 double adj_time(double x);
 void lpmoon(double jd,double lat,double sid,double *ra,double *dec,double *dist);
 void lpsun(double jd,double *ra,double *dec);
@@ -495,43 +1123,164 @@ double circulo(double x);
 void geocent(double geolong,double geolat,double height,double *x_geo,double *y_geo,double *z_geo);
 double etcorr(double jd);
 void accumoon(double jd,double geolat,double lst,double elevsea,double *geora,double *geodec,double *geodist,double *topora,double *topodec,double *topodist);
+void accumoon_geo(double jd,double *l,double *m,double *n,double *dist);
+void cheb_fit(double *samp,int n,double *c);
+double cheb_eval(double *c,int n,double t,double *deriv);
+void moon_cheb_xyz(double jd,double *xyz);
+int moon_cheb_build(struct moon_cheb *mc,double jdstart,double jdend);
+void moon_cheb_free(struct moon_cheb *mc);
+int skyeph_open(struct skyeph *eph,char *fname);
+void skyeph_close(struct skyeph *eph);
+int skyeph_eval(struct skyeph *eph,int body,double jd,double *pos,double *vel);
+void accumoon_topo(double *xyz,double geolat,double lst,double elevsea,double *geora,double *geodec,double *geodist,double *topora,double *topodec,double *topodist);
+void accumoon_cheb(struct moon_cheb *mc,double jd,double geolat,double lst,double elevsea,double *geora,double *geodec,double *geodist,double *topora,double *topodec,double *topodist);
+void accumoon_r(struct skycalc_ctx *ctx,double jd,double geolat,double lst,double elevsea,double *geora,double *geodec,double *geodist,double *topora,double *topodec,double *topodist);
 void flmoon(int n,int nph,double *jdout);
 float lun_age(double jd,int *nlun);
 void print_phase(double jd);
+void skybright_moon_set(double alpha,double kzen,double altmoon,double azmoon,double moondist,
+	struct skybright_moon *m);
+double sky_airfac(double kzen,double alt);
+double lunsky_nl(struct skybright_moon *m,double rho,double cosrho,double airfac);
+double sky_vmag(double B);
 double lunskybright(double alpha,double rho,double kzen,double altmoon,double alt,double moondist);
+void accusun_geo(double jd,double *x,double *y,double *z,double *dist);
 void accusun(double jd,double lst,double geolat,double *ra,double *dec,double *dist,double *topora,double *topodec,double *x,double *y,double *z);
+void accusun_r(struct skycalc_ctx *ctx,double jd,double lst,double geolat,double *ra,double *dec,double *dist,double *topora,double *topodec,double *x,double *y,double *z);
+double body_alt_r(struct skycalc_ctx *ctx,int body,double jd,double lat,double longit,double elevsea);
+double alt_event_root_r(struct skycalc_ctx *ctx,int body,double alt,double jda,double jdb,double fa,double fb,double lat,double longit,double elevsea,double tol);
+int alt_sample_r(struct skycalc_ctx *ctx,int body,double jd1,double jd2,double lat,double longit,double elevsea,double *jd,double *altv,int maxsamp);
+int alt_crossings_sampled_r(struct skycalc_ctx *ctx,int body,double alt,double *jd,double *altv,int nsamp,double lat,double longit,double elevsea,double tol,struct alt_crossing *events,int maxevents);
+int alt_crossings_r(struct skycalc_ctx *ctx,int body,double alt,double jd1,double jd2,double lat,double longit,double elevsea,double tol,struct alt_crossing *events,int maxevents);
+int alt_crossings(int body,double alt,double jd1,double jd2,double lat,double longit,double elevsea,double tol,struct alt_crossing *events,int maxevents);
+double jd_body_alt_r(struct skycalc_ctx *ctx,int body,double alt,double jdguess,double lat,double longit,double elevsea,double tol);
 double jd_moon_alt(double alt,double jdguess,double lat,double longit,double elevsea);
+double jd_moon_alt_r(struct skycalc_ctx *ctx,double alt,double jdguess,double lat,double longit,double elevsea);
 double jd_sun_alt(double alt,double jdguess,double lat,double longit);
+double moon_illum_r(struct skycalc_ctx *ctx,double jd,double lat,double longit,double elevsea);
+void night_pair_r(struct skycalc_ctx *ctx,double alt,double *jd,double *altv,int nsamp,double lat,double longit,double elevsea,struct night_event *eve,struct night_event *morn);
+void night_events_r(struct skycalc_ctx *ctx,double jdmid,double lat,double longit,double elevsea,double horiz,double *custom,int ncustom,struct night_events *ne);
+void night_events(double jdmid,double lat,double longit,double elevsea,double horiz,double *custom,int ncustom,struct night_events *ne);
+void almanac_key_set(struct almanac_key *key,double jdmid,double lat,double longit,double elevsea,double horiz,double *custom,int ncustom);
+unsigned long almanac_hash(struct almanac_key *key);
+int almanac_cache_init(struct almanac_cache *ac,int nslots);
+void almanac_cache_free(struct almanac_cache *ac);
+struct almanac_entry *almanac_slot(struct almanac_cache *ac,struct almanac_key *key);
+int almanac_insert(struct almanac_cache *ac,struct almanac_key *key,struct night_events *ne);
+int almanac_get_r(struct skycalc_ctx *ctx,struct almanac_cache *ac,double jdmid,double lat,double longit,double elevsea,double horiz,double *custom,int ncustom,struct night_events *ne);
+int almanac_get(struct almanac_cache *ac,double jdmid,double lat,double longit,double elevsea,double horiz,double *custom,int ncustom,struct night_events *ne);
+int almanac_prefill_r(struct skycalc_ctx *ctx,struct almanac_cache *ac,double jdmid,int nnights,double lat,double longit,double elevsea,double horiz,double *custom,int ncustom);
+int almanac_prefill(struct almanac_cache *ac,double jdmid,int nnights,double lat,double longit,double elevsea,double horiz,double *custom,int ncustom);
+int almanac_save(struct almanac_cache *ac,char *fname);
+int almanac_load(struct almanac_cache *ac,char *fname);
 float ztwilight(double alt);
+void lunskybright_batch(struct skybright_moon *m,double *rho,double *alt,size_t n,double *V);
+void sky_grid_free(struct sky_grid *g);
+int sky_grid_init(struct sky_grid *g,double *alt,double *az,int n,double kzen);
+void sky_grid_bright(struct sky_grid *g,struct skybright_moon *m,double sun_alt,double vdark,double *vmoon,
+	double *vsky);
+double dst_rule_jd(short yr,short mo,short day);
+struct dst_rule *dst_rule_find(struct dst_rules *dr,short use_dst,short yr);
+void dst_rule_bounds(struct dst_rule *r,short yr,double stdz,double *jdb,double *jde);
 void find_dst_bounds(short yr,double stdz,short use_dst,double *jdb,double *jde);
+void find_dst_bounds_r(struct skycalc_ctx *ctx,short yr,double stdz,short use_dst,double *jdb,double *jde);
+void dst_rules_use(struct skycalc_ctx *ctx,struct dst_rules *dr);
+void dst_rules_free(struct dst_rules *dr);
+short dst_month(char *s);
+int dst_day(char *s,short *day);
+int dst_rules_load(struct dst_rules *dr,char *fname);
 double zone(short use_dst,double stdz,double jd,double jdb,double jde);
 double true_jd(struct date_time date,short use_dst,short enter_ut,short night_date,double stdz);
+double true_jd_r(struct skycalc_ctx *ctx,struct date_time date,short use_dst,short enter_ut,short night_date,
+	double stdz);
 void print_tz(double jd,short use,double jdb,double jde,char zabr);
+void cel_unit(double ra,double dec,double *u);
 void xyz_cel(double x,double y,double z,double *r,double *d);
+void prec_matrix(double orig_epoch,double final_epoch,struct precmat *pm);
+void precrot_mat(struct precmat *pm,double rorig,double dorig,double *rf,double *df);
 void precrot(double rorig, double dorig, double orig_epoch, double final_epoch, double *rf, double *df);
+struct precmat *prec_cache_r(struct skycalc_ctx *ctx,double orig_epoch,double final_epoch);
+void precrot_r(struct skycalc_ctx *ctx,double rorig,double dorig,double orig_epoch,double final_epoch,double *rf,double *df);
+void precrot_batch(struct precmat *pm,double *ra,double *dec,double *mura,double *mudec,size_t n,double *rf,double *df);
 void mass_precess();
 void galact(double ra,double dec,double epoch,double *glong,double *glat);
 void eclipt(double ra,double dec,double epoch,double jd,double *curep,double *eclong,double *eclat);
+void xform_ident(struct xform *xf);
+void xform_then(struct xform *xf,double p[3][3]);
+void xform_invert(struct xform *xf);
+void xform_precess_r(struct skycalc_ctx *ctx,struct xform *xf,double orig_epoch,double final_epoch);
+void xform_precess(struct xform *xf,double orig_epoch,double final_epoch);
+void xform_galactic(struct xform *xf);
+void xform_ecliptic(struct xform *xf,double jd);
+void xform_apply(struct xform *xf,double *x,double *y,double *z,size_t n,double *xf_x,double *xf_y,double *xf_z);
+void sph_xyz_batch(double *lon,double *lat,double lonunit,size_t n,double *x,double *y,double *z);
+void xyz_sph_batch(double *x,double *y,double *z,size_t n,double lonunit,double *lon,double *lat);
+void xform_coords(struct xform *xf,double *lon,double *lat,double inunit,size_t n,double outunit,
+	double *xf_lon,double *xf_lat);
+void galact_batch_r(struct skycalc_ctx *ctx,double *ra,double *dec,double epoch,size_t n,double *glong,double *glat);
+void galact_batch(double *ra,double *dec,double epoch,size_t n,double *glong,double *glat);
+void eclipt_batch_r(struct skycalc_ctx *ctx,double *ra,double *dec,double epoch,double jd,size_t n,
+	double *eclong,double *eclat);
+void eclipt_batch(double *ra,double *dec,double epoch,double jd,size_t n,double *eclong,double *eclat);
 double parang(double ha,double dec,double lat);
+void elrot_load(struct skycalc_ctx *ctx);
 void comp_el(double jd);
+void comp_el_r(struct skycalc_ctx *ctx,double jd);
+void planet_state_r(struct skycalc_ctx *ctx,int p,double jd,double *xyz,double *vel);
+void planet_state(int p,double jd,double *xyz,double *vel);
+void planet_state_batch_r(struct skycalc_ctx *ctx,int np,int *p,int nt,double *jd,double *xyz,double *vel);
+void planet_state_batch(int np,int *p,int nt,double *jd,double *xyz,double *vel);
 void planetxyz(int p,double jd,double  *x,double  *y,double  *z);
+void planetxyz_r(struct skycalc_ctx *ctx,int p,double jd,double *x,double *y,double *z);
 void planetvel(int p,double jd,double *vx,double *vy,double *vz);
+void planetvel_r(struct skycalc_ctx *ctx,int p,double jd,double *vx,double *vy,double *vz);
+void skyeph_sample(struct skycalc_ctx *ctx,int body,double jd,double *xyz);
+int skyeph_write(char *fname,double jdstart,double jdend);
 void xyz2000(double jd,double x,double y,double z);
 void earthview(double *x,double *y,double *z,int i,double *ra,double *dec);
+void body_posn_set(struct body_posn *bp,double ra,double dec,double lat,double sid);
+void calc_pposns(double jd,double lat,double sid,struct planet_posns *pp);
+void calc_pposns_r(struct skycalc_ctx *ctx,double jd,double lat,double sid,struct planet_posns *pp);
+void print_posn_r(struct skycalc_ctx *ctx,struct body_posn *bp);
 void pposns(double jd,double lat,double sid,short print_option,double *planra,double *plandec);
+void pposns_r(struct skycalc_ctx *ctx,double jd,double lat,double sid,short print_option,double *planra,double *plandec);
 void barycor(double jd,double *x,double *y,double *z,double *xdot,double *ydot,double *zdot);
+void barycor_r(struct skycalc_ctx *ctx,double jd,double *x,double *y,double *z,double *xdot,double *ydot,double *zdot);
 void helcor(double jd,double ra,double dec,double ha,double lat,double elevsea,double *tcor,double *vcor);
+void helcor_earth_r(struct skycalc_ctx *ctx,double jd,double *s);
+void helcor_r(struct skycalc_ctx *ctx,double jd,double ra,double dec,double ha,double lat,double elevsea,double *tcor,double *vcor);
 float overlap(double r1,double r2,double sepn);
+short solecl_calc(double sun_moon,double distmoon,double distsun,float *magnitude);
+void print_solecl(short code,float magnitude);
 void solecl(double sun_moon,double distmoon,double distsun);
+short lunecl_calc(double georamoon,double geodecmoon,double geodistmoon,double rasun,double decsun,double distsun,
+	float *magnitude);
+void print_lunecl(short code,float magnitude);
 short lunecl(double georamoon,double geodecmoon,double geodistmoon,double rasun,double decsun,double distsun);
+void planet_seps_r(struct skycalc_ctx *ctx,double jd,double ra,double dec,double *sep);
+void print_planet_alert_r(struct skycalc_ctx *ctx,double *sep,double tolerance);
 void planet_alert(double jd,double ra,double dec,double tolerance);
+void planet_alert_r(struct skycalc_ctx *ctx,double jd,double ra,double dec,double tolerance);
 short setup_time_place(struct date_time date,double longit,double lat,double stdz,short use_dst,char *zone_name,
         char zabr,char *site_name,short enter_ut,short night_date,double *jdut,double *jdlocal,double *jdb,double *jde,double *sid,
 	double *curepoch);
+void calc_tonight(struct date_time date,double lat,double longit,double elevsea,double horiz,double stdz,short use_dst,
+	struct tonight *tn);
+void calc_tonight_r(struct skycalc_ctx *ctx,struct date_time date,double lat,double longit,double elevsea,double horiz,
+	double stdz,short use_dst,struct tonight *tn);
+void print_tonight_time(double jd,short use_dst,double stdz,double jdb,double jde,char zabr);
 void print_tonight(struct date_time date,double lat,double longit,double elevsea,double elev,double horiz,char *site_name,double stdz,
 	char *zone_name,char zabr,short use_dst,double *jdb,double *jde,short short_long);
+void calc_circumstances(double objra,double objdec,double objepoch,double jd,double curep,double mura_sec,
+	double mudec,double sid,double lat,double elevsea,struct circumstances *c);
+void calc_circumstances_r(struct skycalc_ctx *ctx,double objra,double objdec,double objepoch,double jd,double curep,
+	double mura_sec,double mudec,double sid,double lat,double elevsea,struct circumstances *c);
 void print_circumstances(double objra,double objdec,double objepoch,double jd,double curep,double 
 	mura_arcs,double mura_sec,double mudec,double sid,double lat,double elevsea,double horiz);
+int calc_hourly_airmass(struct date_time date,double stdz,double lat,double longit,short use_dst,double objra,
+	double objdec,double objepoch,struct airmass_table *am);
+int calc_hourly_airmass_r(struct skycalc_ctx *ctx,struct date_time date,double stdz,double lat,double longit,
+	short use_dst,double objra,double objdec,double objepoch,struct airmass_table *am);
 void hourly_airmass(struct date_time date,double stdz,double lat,double longit,double horiz,short use_dst,double objra,double objdec,
   double objepoch,double  mura_sec,double mura_arcs,double mudec);
 void print_params(struct date_time date,short enter_ut,short night_date,double stdz,double lat,double longit,char *site_name,
@@ -544,14 +1293,107 @@ void print_legalities();
 void ephemgen(double ra,double dec,double ep,double lat,double longit);
 double hrs_up(double jdup,double jddown,double jdeve,double jdmorn);
 void print_air(double secz,short prec);
+void print_air_r(struct skycalc_ctx *ctx,double secz,short prec);
 void print_ha_air(double ha,double secz,short prec1,short prec2);
+void print_ha_air_r(struct skycalc_ctx *ctx,double ha,double secz,short prec1,short prec2);
+int skycalc_nthreads(int nthreads);
+int skycalc_parallel(int nthreads,int n,int chunk,void (*func)(void *arg, int i0, int i1),void *arg);
+int season_nights(double jdstart,double jdend,double sun_twi,double lat,double longit,struct season_night **night);
+int season_nights_r(struct skycalc_ctx *ctx,double jdstart,double jdend,double sun_twi,double lat,double longit,
+	struct season_night **night);
+void season_obs_calc(double ra,double dec,double lat,struct season_night *night,int nnight,struct season_obs *obs);
+void season_table_free(struct season_table *tab);
+int obs_season_cat(struct catalog *cat,double jdstart,double jdend,double sun_twi,double lat,double longit,
+	int nthreads,struct season_table *tab);
+int obs_season_cat_r(struct skycalc_ctx *ctx,struct catalog *cat,double jdstart,double jdend,double sun_twi,
+	double lat,double longit,int nthreads,struct season_table *tab);
 void obs_season(double ra,double dec,double epoch,double lat,double longit);
+void calendar_free(struct calendar *cal);
+int helcor_series_r(struct skycalc_ctx *ctx,double *jd,int n,double ra,double dec,double longit,double lat,
+	double elevsea,int nthreads,double *tcor,double *vcor);
+int helcor_series(double *jd,int n,double ra,double dec,double longit,double lat,double elevsea,int nthreads,
+	double *tcor,double *vcor);
+double lun_node_sin(int n,int nph);
+double ecl_geom(struct ecl_arg *ea,double jd,double *thr,double *dist);
+double ecl_func(struct ecl_arg *ea,double jd);
+double ecl_min(struct ecl_arg *ea,double jda,double jdb,double tol);
+double ecl_root(struct ecl_arg *ea,double jda,double jdb,double fa,double fb,double tol);
+void ecl_list_free(struct ecl_list *el);
+int ecl_list_add(struct ecl_list *el,struct ecl_event *ev);
+int ecl_event_find(struct ecl_arg *ea,double jda,double jdb,double jdmax,struct ecl_event *ev);
+int eclipse_search_r(struct skycalc_ctx *ctx,double jdstart,double jdend,double lat,double longit,double elevsea,
+	struct ecl_list *el);
+int eclipse_search(double jdstart,double jdend,double lat,double longit,double elevsea,struct ecl_list *el);
+int occult_search_r(struct skycalc_ctx *ctx,struct catalog *cat,double jdstart,double jdend,double lat,double longit,
+	double elevsea,int nthreads,struct ecl_list *el);
+int occult_search(struct catalog *cat,double jdstart,double jdend,double lat,double longit,double elevsea,
+	int nthreads,struct ecl_list *el);
+int calendar_gen(struct cal_site *site,int nsite,short year,short nyears,int nthreads,struct calendar *cal);
+int calendar_gen_r(struct skycalc_ctx *ctx,struct cal_site *site,int nsite,short year,short nyears,int nthreads,
+	struct calendar *cal);
+void calendar_setup_tex_r(struct skycalc_ctx *ctx,short option);
+void calendar_new_page_r(struct skycalc_ctx *ctx,short format);
+void calendar_page_top_r(struct skycalc_ctx *ctx,struct cal_site *st);
+void calendar_date_r(struct skycalc_ctx *ctx,double jd);
+void calendar_phases_r(struct skycalc_ctx *ctx,struct cal_site *st,short year);
+void calendar_time_r(struct skycalc_ctx *ctx,struct cal_site *st,struct tonight *tn,double jd);
+void calendar_line_r(struct skycalc_ctx *ctx,struct cal_site *st,struct tonight *tn,long jdroot);
+void calendar_data_jd_r(struct skycalc_ctx *ctx,double jd);
+void calendar_data_r(struct skycalc_ctx *ctx,struct calendar *cal,int s);
+void calendar_print(struct calendar *cal,int s,short format);
+void calendar_print_r(struct skycalc_ctx *ctx,struct calendar *cal,int s,short format);
 int get_sys_date(struct date_time date,short use_dst,short enter_ut,short night_date,double stdz,double toffset);
 void indexx(int n,float arrin[],int indx[]);
+void catalog_touch(struct catalog *cat);
+void catalog_init(struct catalog *cat);
+void catalog_free(struct catalog *cat);
+int catalog_reserve(struct catalog *cat,int n);
+int catalog_add(struct catalog *cat,char *name,double ra,double dec,double ep,double xtra);
+int catalog_blank(int c);
+char *catalog_num(char *p,char *end,double *x);
+char *catalog_line(char *p,char *end,struct objct *ob);
+int catalog_parse(struct catalog *cat,char *text,size_t len,int verbose,int *nbad);
+int catalog_load_fp(struct catalog *cat,FILE *fp,int verbose,int *nbad);
+int catalog_load(struct catalog *cat,char *fname,int verbose,int *nbad);
+void catindex_swap(struct catindex *ix,int i,int j);
+void catindex_select(struct catindex *ix,int lo,int hi,int k,int axis);
+void catindex_split(struct catindex *ix,int lo,int hi,int depth);
+void catindex_free(struct catindex *ix);
+int catindex_build(struct catalog *cat,double epoch,struct catindex *ix);
+int catindex_current(struct catindex *ix,struct catalog *cat);
+int catindex_build_r(struct skycalc_ctx *ctx,struct catalog *cat,double epoch,struct catindex *ix);
+void catindex_query_r(struct skycalc_ctx *ctx,struct catindex *ix,double ra,double dec,double epoch,double *q);
+void catindex_knn(struct catindex *ix,int lo,int hi,int depth,double *q,int k,double *hd,int *hid,int *nh);
+int catindex_nearest(struct catindex *ix,double ra,double dec,double epoch,int k,int *id,double *dist);
+int catindex_nearest_r(struct skycalc_ctx *ctx,struct catindex *ix,double ra,double dec,double epoch,int k,int *id,
+	double *dist);
+void catindex_walk(struct catindex *ix,int lo,int hi,int depth,double *q,double c2,int maxn,int *id,double *dist,
+	int *nfound);
+int catindex_cone(struct catindex *ix,double ra,double dec,double epoch,double radius,int maxn,int *id,double *dist);
+int catindex_cone_r(struct skycalc_ctx *ctx,struct catindex *ix,double ra,double dec,double epoch,double radius,
+	int maxn,int *id,double *dist);
+void prox_list_free(struct prox_list *pl);
+int prox_list_add(struct prox_list *pl,int obj,int body,double jd,double sep);
+int planet_screen_r(struct skycalc_ctx *ctx,struct catalog *cat,struct catindex *ix,double jdstart,double jdend,
+	double step,double tolerance,double lat,double longit,struct prox_list *pl);
+int planet_screen(struct catalog *cat,struct catindex *ix,double jdstart,double jdend,double step,double tolerance,
+	double lat,double longit,struct prox_list *pl);
 int read_obj_list();
-int find_by_name(double ra,double dec,double epoch,struct date_time date,short use_dst,short enter_ut,short night_date,double stdz,double lat,double longit);
+int read_obj_list_r(struct skycalc_ctx *ctx);
+int find_by_name(double *ra,double *dec,double epoch,struct date_time date,short use_dst,short enter_ut,short night_date,double stdz,double lat,double longit);
+int find_by_name_r(struct skycalc_ctx *ctx,double *ra,double *dec,double epoch,struct date_time date,short use_dst,short enter_ut,short night_date,double stdz,double lat,double longit);
 void type_list(struct date_time date,short use_dst,short enter_ut,short night_date,double stdz,double lat,double longit);
+void type_list_r(struct skycalc_ctx *ctx,struct date_time date,short use_dst,short enter_ut,short night_date,double stdz,double lat,double longit);
+int catalog_keys(struct catalog *cat,struct rank_spec *rs,double *keys);
+int catalog_keys_r(struct skycalc_ctx *ctx,struct catalog *cat,struct rank_spec *rs,double *keys);
+int rank_less(double *keys,int a,int b);
+int rank_topk(double *keys,int n,int k,int *idx,int *work);
+int catalog_rank(struct catalog *cat,struct rank_spec *rs,int k,int *idx,double *keys);
+int catalog_rank_r(struct skycalc_ctx *ctx,struct catalog *cat,struct rank_spec *rs,int k,int *idx,double *keys);
+int find_nearest_rank_r(struct skycalc_ctx *ctx,int useix,double ra,double dec,double epoch,int want,int *ind,
+	double *keys,int *iwork,double *dwork);
 int find_nearest(double *ra,double *dec,double epoch,struct date_time date,short use_dst,short enter_ut,short night_date,double stdz,double lat,double longit);
+int find_nearest_r(struct skycalc_ctx *ctx,double *ra,double *dec,double epoch,struct date_time date,short use_dst,short enter_ut,short night_date,double stdz,double lat,double longit);
 void set_zenith(struct date_time date,short use_dst,short enter_ut,short night_date,double stdz,double lat,double longit,double epoch,double *ra,double *dec);
 void printephase(struct date_time date,short use_dst,short enter_ut,short night_date,double stdz,double lat,double longit,double epoch,double ra,double dec);
 int set_to_jd(struct date_time *date,short use_dst,short enter_ut,short night_date,double stdz,double jd);
@@ -338,6 +338,12 @@ LEGALITIES:
 #include <ctype.h>
 #include <stdarg.h>
 #include <string.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 /* a couple of the system-dependent magic numbers are defined here */
 
@@ -348,12 +354,75 @@ LEGALITIES:
 #define LOG_FILES_OK 1  /* 1 means that log files are enabled.
 			Any other value means they're not.  */
 
-#define MAX_OBJECTS 500
+#define THREADS_OK 1    /* 1 means POSIX threads are available (link
+   with -lpthread).  Anything else and the "parallel" routines
+   just run in the calling thread. */
+
+#if THREADS_OK == 1
+#include <pthread.h>
+#endif
+
 #define MINSHORT -32767   /* min, max short integers and double precision */
 #define MAXSHORT 32767
 #define MAXDOUBLE 1.0e38
 #define MINDOUBLE -1.0e38
 #define BUFSIZE 150
+#define PREC_CACHE_SIZE 8  /* recent precession matrices kept per context */
+#define DST_CACHE_SIZE  8  /* recent daylight time bounds kept per context */
+#define DST_LASTSUN     0  /* dst_rule days -- the last Sunday of the month */
+#define MOON_CHEB_SEG   4.  /* days per segment of a moon_cheb table */
+#define MOON_CHEB_NCOEF 13  /* Chebyshev coefficients per coordinate */
+#define SKYEPH_MAGIC     0x53434550  /* "SCEP" -- ephemeris file */
+#define SKYEPH_VERSION   1
+#define SKYEPH_BYTEORDER 0x01020304  /* as written; reads wrong if swapped */
+#define SKYEPH_NBODY     11
+#define SKYEPH_SUN       0   /* body numbers -- 1 - 9 are planets as in el[] */
+#define SKYEPH_MOON      10
+#define SKYEPH_NCOEF     13  /* Chebyshev coefficients per coordinate */
+#define EVENT_SUN     0      /* bodies for rise / set / twilight searches */
+#define EVENT_MOON    1
+#define EVENT_STEP    (1./48.)  /* days between altitude samples */
+#define EVENT_MAXSAMP 1024   /* longest alt_crossings window, in samples */
+#define EVENT_WINDOW  0.25   /* days either side of a guess to search */
+#define EVENT_TOL     2.0e-5 /* days (about 2 sec) -- default tolerance */
+#define NIGHT_MAXCUSTOM 4    /* extra sun altitudes night_events can find */
+#define NIGHT_MAXCROSS  8    /* crossings of one altitude kept per night */
+#define ALMANAC_MAGIC   0x53434141  /* "SCAA" -- almanac cache file */
+#define ALMANAC_VERSION 1
+#define OSINK_STDOUT   0    /* output sinks -- see osink_write */
+#define OSINK_FILE     1
+#define OSINK_BUFFER   2
+#define OSINK_CALLBACK 3
+#define OSINK_NULL     4
+#define OSINK_LINE     512  /* oprntf formats into this much stack first */
+#define AIRMASS_MAXHRS 24    /* most hourly_airmass rows each side of center */
+#define CATALOG_CHUNK  1024  /* a catalog starts with room for this many */
+#define CATALOG_READBUF 65536 /* catalog_load_fp's buffer, if it can't mmap */
+#define RANK_ARC      1   /* rank keys -- as find_nearest's sort options */
+#define RANK_HA       2
+#define RANK_AIRMASS  3
+#define RANK_SETTING  4
+#define RANK_XTRA     5
+#define BATCH_BLOCK 256  /* working block for the batched (array)
+			routines -- sized to keep scratch arrays in L1 */
+#define MAX_THREADS 64   /* most threads skycalc_parallel will start */
+#define SEASON_CHUNK 16  /* objects per piece of obs_season_cat work */
+#define CALENDAR_CHUNK 8  /* nights per piece of calendar_gen work */
+#define CAL_TEXT 0       /* calendar_print formats -- plain text, */
+#define CAL_TEX1 1       /* TeX with one month a page, */
+#define CAL_TEX2 2       /* TeX with two months a page, */
+#define CAL_DATA 3       /* or one tab-separated line per night */
+#define HELSER_STEP 1.    /* days between helcor_series' interpolation nodes */
+#define HELSER_CHUNK 4096 /* epochs per piece of helcor_series work */
+#define ECL_LUNAR 0      /* kinds of event, for eclipse_search and */
+#define ECL_SOLAR 1      /*   occult_search */
+#define ECL_OCCULT 2
+#define ECL_STEP (1./144.)  /* days between eclipse_search's samples */
+#define ECL_WINDOW 0.3   /* days either side of a syzygy searched */
+#define ECL_TOL 1.0e-5   /* days -- how closely contacts are found */
+#define OCC_STEP (1./24.)   /* days between occult_search's moon positions */
+#define OCC_MARGIN 1.    /* degrees beyond the limb to look closer */
+#define OCC_CHUNK 64     /* moon positions per piece of occult_search work */
 
 /* some (not all) physical, mathematical, and astronomical constants
    used are defined here. */
@@ -375,6 +444,7 @@ LEGALITIES:
 						to a major planet ... */
 #define  KZEN              0.172       /* zenith extinction, mag, for use
 				     in lunar sky brightness calculations. */
+#define  LN_10             2.30258509299404568  /* for 10^x = exp(LN_10 x) */
 #define FIRSTJD            2415387.  /* 1901 Jan 1 -- calendrical limit */
 #define LASTJD             2488070.  /* 2099 Dec 31 */
 
@@ -416,132 +486,769 @@ struct date_time
 	short d;
 	short h;
 	short mn;
-	float s;
+	double s;
    };
 
-FILE *sclogfl = NULL;
+/* elements of planetary orbits */
+struct elements
+   {
+	char name[9];
+	double incl;
+	double Omega;
+	double omega;
+	double a;
+	double daily;
+	double ecc;
+	double L_0;
+	double mass;
+   };
 
-void oprntf(char *fmt, ...)
+/* the parts of the planet-position formulae that stay the same for
+   one set of elements -- filled in by comp_el_r alongside el[]. */
 
-/* This routine should look almost exactly like printf in terms of its
-   arguments (format list, then a variable number of arguments
-   to be formatted and printed).  It is designed to behave just
-   like printf (though perhaps not all format types are supported yet)
-   EXCEPT that IF the globally-defined file pointer "sclogfl" is
-   defined, IT ALSO WRITES TO THAT FILE using fprintf.  The skeleton
-   for this came from Kernighan and Ritchie, 2nd edition, page 156 --
-   their "minprintf" example.  I modified it to include the
-   entire format string (e.g., %8.2f, %7d) and to write to the
-   file as well as standard output.  */
+struct elrot {
+	double ecc;
+	double c1, c2, c3;   /* coefficients of sin M, sin 2M, sin 3M in nu */
+	double p;            /* semi-latus rectum, a (1 - e^2), AU */
+	double M0, n;        /* mean anomaly at jd_el, and daily motion, rad */
+	double cw, sw;       /* cos and sin of omega - Omega */
+	double P[3], Q[3];   /* axes of the orbit plane, ecliptic xyz */
+};
 
-{
-	va_list ap;        /* see K&R for explanation of these macros */
-	char *p, *sval;
-	char outform[10];  /* an item's output format, e.g. %8.2f */
-	char strout[150];
-	int ival, i;
-	short shval;
-	char cval;
-	double dval;
+struct objct {
+	char name[20];
+	double ra;
+	double dec;
+	float ep;
+	float xtra;  /* mag, whatever */
+};
+
+/* a growable object catalog.  The objects are objs[1] through
+   objs[n] -- 1-indexed, as the list routines have always used them. */
+
+struct catalog {
+	struct objct *objs;
+	int n;
+	int cap;        /* room for objs[1] through objs[cap] */
+	unsigned long gen;  /* new with every change -- see catalog_touch */
+};
+
+/* a spatial index over a catalog, from catindex_build -- a k-d tree
+   of unit vectors at one epoch, stored implicitly: the node for a
+   range of entries is the middle one, split on axis depth % 3. */
+
+struct catindex {
+	double epoch;
+	int n;          /* objects indexed (the catalog's n when built) */
+	unsigned long gen;  /* the catalog's gen when built */
+	double *xyz;    /* unit vectors, 3 per object, in tree order */
+	int *id;        /* catalog index of each */
+};
+
+/* a catalog object near a solar-system body, from planet_screen --
+   body is SKYEPH_SUN, SKYEPH_MOON or a planet number. */
+
+struct prox_hit {
+	int obj;        /* catalog index */
+	short body;
+	double jd;      /* UT of the time step */
+	double sep;     /* degrees */
+};
+
+struct prox_list {
+	int n, cap;
+	struct prox_hit *hit;
+};
+
+/* what to rank a catalog by, for catalog_keys and catalog_rank. */
+
+struct rank_spec {
+	int key;         /* RANK_ARC etc. */
+	double ra, dec;  /* reference position (RANK_ARC, RANK_AIRMASS) */
+	double epoch;    /* of ra and dec */
+	double jd;       /* UT, for the keys that depend on time */
+	double lat, longit;
+	double aircrit;  /* critical airmass in the west (RANK_SETTING) */
+};
+
+#if THREADS_OK == 1
+
+/* work shared out by skycalc_parallel -- items are handed out
+   chunk at a time from next. */
+
+struct par_job {
+	void (*func)(void *arg, int i0, int i1);
+	void *arg;
+	int n, chunk;
+	int next;            /* first item not yet handed out */
+	pthread_mutex_t lock;
+};
 
-	va_start(ap,fmt);
-	for (p = fmt; *p; p++) {
-		if (*p != '%') {
-			putchar(*p);
-/* overkill to put in these preprocessor flags, perhaps. */
-#if LOG_FILES_OK == 1
-			if(sclogfl != NULL) fputc(*p,sclogfl);
 #endif
-			continue;
+
+/* the parts of the Krisciunas-Schaefer moonlit sky brightness
+   (lunskybright) that depend only on the moon, from
+   skybright_moon_set. */
+
+struct skybright_moon {
+	double alpha, kzen, altmoon, moondist;   /* as for lunskybright */
+	double u[3];       /* toward the moon, in alt-az (see cel_unit) */
+	double istar;      /* moon's illuminance, times its extinction */
+};
+
+/* a fixed grid of points on the sky in alt-az, from sky_grid_init,
+   for sky_grid_bright. */
+
+struct sky_grid {
+	int n;
+	double kzen;       /* extinction airfac is for */
+	double *u;         /* unit vectors, 3 per point */
+	double *alt;       /* degrees */
+	double *airfac;    /* sky_airfac of each point */
+};
+
+/* one night of an observing season, from season_nights -- the
+   night nearest a new or full moon.  Twilight times are -1. if
+   the sun doesn't get down to the twilight altitude. */
+
+struct season_night {
+	short nph;           /* 0 = new moon, 2 = full (as flmoon) */
+	double jdphase;      /* of the new or full moon */
+	double jdcent;       /* sun's lower culmination */
+	double jdeve, jdmorn;     /* evening and morning twilight */
+	double jdevedate;    /* for the local evening date */
+	double steve, stcent, stmorn;  /* local sidereal times (hours) */
+};
+
+/* one object on one season_night, from season_obs_calc.  HA in
+   hours; secz as from secant_z; hrs_ are dark hours spent at sec z
+   less than 3, 2 and 1.5. */
+
+struct season_obs {
+	double haeve, seczeve;
+	double hacent, seczcent;
+	double hamorn, seczmorn;
+	double hrs_3, hrs_2, hrs_15;
+};
+
+/* a whole catalog through a season, from obs_season_cat.
+   obs[i * nnight + k] is object i+1 (of the catalog) on night k. */
+
+struct season_table {
+	int nnight, nobj;
+	double sun_twi, lat, longit;
+	double curep;        /* objects were precessed to this */
+	struct season_night *night;
+	struct season_obs *obs;
+	double *ra, *dec;    /* scratch, while it's being filled */
+};
+
+/* Greenwich mean sidereal time at 0h UT of one day, kept by
+   lst_cached so that later times on the same UT day need only the
+   linear term.  A zeroed one is empty. */
+
+struct sid_cache {
+	int valid;
+	double jdmid;      /* JD of 0h UT */
+	double gmst0;      /* GMST there, fraction of a day */
+};
+
+/* one rule of a daylight time convention (use_dst; see
+   find_dst_bounds), for the years from through to, after a tzdata
+   Rule line.  The clocks change at 2 AM local time.  In the north,
+   daylight time begins in month mo1 and ends in mo2; in the south
+   (use_dst < 0) standard time begins in mo1 and ends in mo2.  A day
+   is the first Sunday on or after that day of the month if it's
+   positive, exactly day -day if it's negative, and the last Sunday
+   of the month if it's DST_LASTSUN. */
+
+struct dst_rule {
+	short use_dst;
+	short from, to;
+	short mo1, day1;
+	short mo2, day2;
+};
+
+/* daylight time rules read by dst_rules_load. */
+
+struct dst_rules {
+	int n, cap;
+	struct dst_rule *rule;
+};
+
+/* the daylight time bounds of one year, as find_dst_bounds gives
+   them, kept by find_dst_bounds_r. */
+
+struct dst_bounds {
+	short yr, use_dst;
+	double stdz;
+	double jdb, jde;
+};
+
+/* a precession matrix, as built by prec_matrix, for carrying from
+   orig_epoch to final_epoch. */
+
+struct precmat {
+	double orig_epoch;
+	double final_epoch;
+	double p[3][3];
+};
+
+/* a rotation from one frame to another, built up from the xform_
+   calls.  It acts on column unit vectors, so following rotation A
+   with rotation B gives the single matrix B A. */
+
+struct xform {
+	double m[3][3];
+};
+
+/* piecewise Chebyshev fits to the geocentric lunar position (x, y, z
+   in earth radii, equinox of date) from accumoon, made by
+   moon_cheb_build.  jdstart and jdend are ephemeris time. */
+
+struct moon_cheb {
+	double jdstart;
+	double jdend;
+	int nseg;
+	double *coef;  /* nseg * 3 * MOON_CHEB_NCOEF */
+};
+
+/* layout of an ephemeris file from skyeph_write: this header, then
+   the coefficients.  Body b, segment s, coordinate j (x, y, z),
+   coefficient k is coef[offset + (3 s + j) ncoef + k]. */
+
+struct skyeph_body {
+	double jdstart;  /* start of the first segment */
+	double seglen;   /* days */
+	int nseg;
+	int ncoef;
+	int offset;      /* in doubles, from the start of the coefficients */
+	int spare;
+};
+
+struct skyeph_header {
+	int magic;
+	int version;
+	int byteorder;
+	int nbody;
+	double jdstart;  /* span requested of skyeph_write */
+	double jdend;
+	struct skyeph_body body[SKYEPH_NBODY];
+};
+
+/* an ephemeris file mapped by skyeph_open. */
+
+struct skyeph {
+	void *map;
+	size_t maplen;
+	struct skyeph_header *hdr;
+	double *coef;
+};
+
+/* a crossing of a given altitude, found by alt_crossings. */
+
+struct alt_crossing {
+	double jd;
+	short rising;   /* 1 if rising through the altitude, 0 if setting */
+};
+
+/* one event found by night_events. */
+
+struct night_event {
+	double jd;      /* UT; -1. if it doesn't happen that night */
+	double illum;   /* moon's illuminated fraction at jd */
+};
+
+/* all the almanac events of one night, from night_events. */
+
+struct night_events {
+	double jdmid;   /* local midnight (UT) the night is centered on */
+	struct night_event sunset, sunrise;  /* at -(0.83 + horiz) */
+	struct night_event eve6, morn6;      /* civil */
+	struct night_event eve12, morn12;    /* nautical */
+	struct night_event eve13, morn13;
+	struct night_event eve18, morn18;    /* astronomical */
+	int ncustom;
+	double custom_alt[NIGHT_MAXCUSTOM];
+	struct night_event custom_eve[NIGHT_MAXCUSTOM];
+	struct night_event custom_morn[NIGHT_MAXCUSTOM];
+	struct night_event moonrise, moonset;  /* first of each */
+};
+
+/* almanac cache (almanac_get etc.) -- per-night records from
+   night_events, keyed by site, night, and altitudes, in an
+   open-addressed hash table. */
+
+struct almanac_key {
+	double jdmid;
+	double lat;
+	double longit;
+	double elevsea;
+	double horiz;
+	double custom[NIGHT_MAXCUSTOM];
+	int ncustom;
+	int spare;   /* keeps the key free of padding */
+};
+
+struct almanac_entry {
+	struct almanac_key key;
+	struct night_events ne;
+	int used;
+	int spare;
+};
+
+struct almanac_cache {
+	struct almanac_entry *entries;
+	int cap;        /* slots -- a power of 2 */
+	int n;          /* nights held */
+	long hits;      /* lookups answered from the cache */
+	long misses;    /* lookups that had to compute */
+};
+
+/* where a context's printed output goes; set with osink_stdout,
+   osink_file, osink_buffer, osink_callback, or osink_null. */
+
+struct osink {
+	int kind;                /* OSINK_STDOUT etc. */
+	FILE *fp;                /* OSINK_FILE */
+	char *buf;               /* OSINK_BUFFER -- NUL-terminated */
+	size_t len;
+	size_t size;
+	void (*func)(void *arg, char *text, size_t len);  /* OSINK_CALLBACK */
+	void *arg;
+};
+
+/* one body's place, as pposns tabulates it. */
+
+struct body_posn {
+	double ra, dec;   /* topocentric for sun and moon */
+	double ha, alt, az, secz;
+};
+
+/* everything pposns prints, from calc_pposns. */
+
+struct planet_posns {
+	struct body_posn sun, moon;
+	struct body_posn planet[10];  /* 1-9 in the usual order; 3 unused */
+};
+
+/* the circumstances of an observation, from calc_circumstances --
+   what print_circumstances prints.  Quantities print_circumstances
+   only reports under some conditions are set only under the same
+   conditions; the flags say which. */
+
+struct circumstances {
+	short pm;               /* 1 if there is a proper motion */
+	double objra_adj, objdec_adj;  /* adjusted for it, at curep */
+	double mura_arcs;       /* RA proper motion, arcsec/yr */
+	double curra, curdec;   /* at curep */
+	double ha, alt, az, secz, par;
+	double georamoon, geodecmoon, geodistmoon;
+	double ramoon, decmoon, distmoon;         /* topocentric */
+	double rasun, decsun, distsun, toporasun, topodecsun;
+	double sun_alt, sun_az;
+	double sun_moon;        /* degrees */
+	float ill_frac;
+	short sol_ecl;          /* from solecl_calc, if sun_alt >= -18 */
+	float sol_ecl_mag;
+	double moon_alt, moon_az;
+	double obj_moon;        /* degrees; if moon_alt > -2. */
+	double obj_lunlimb;     /* if obj_moon < 10. */
+	short lun_ecl;          /* from lunecl_calc, if moon_alt > -2. */
+	float lun_ecl_mag;
+	short have_vmoon;       /* 1 if a lunar sky brightness applies */
+	double Vmoon;
+	double eclong, eclat;
+	double planet_sep[10];  /* degrees, from planet_seps */
+	double tcor, vcor;      /* barycentric corrections, sec and km/s */
+	double bjd;
+};
+
+/* one line of the hourly airmass table. */
+
+struct airmass_row {
+	double jd;              /* UT */
+	double jdlocal;
+	double sid, ha, alt, secz, par;
+	double sunalt, moonalt;
+};
+
+/* the hourly airmass table, from calc_hourly_airmass. */
+
+struct airmass_table {
+	double jdmid;           /* UT of local midnight */
+	double jdb, jde;        /* daylight time bounds for the year */
+	short timechange;       /* 1 if std/daylight time changes tonight */
+	double curep, curra, curdec;
+	double ill_frac;        /* moon at midnight */
+	double sepn;            /* moon to object, degrees */
+	double planet_sep[10];
+	int nrows;
+	struct airmass_row row[2 * AIRMASS_MAXHRS + 1];
+};
+
+/* one night's almanac as print_tonight reckons it, from calc_tonight.
+   The state flags are 0 if the events were computed, 1 if the sun
+   (or moon) stays above the altitude all night, -1 if it stays below,
+   and 2 if the question didn't arise. */
+
+struct tonight {
+	double jd;              /* local date at 18h, as date_to_jd gives it */
+	double jdb, jde;        /* daylight time bounds (UT) for the year */
+	double locjdb, locjde;  /* the same, local */
+	short timechange;       /* 1 if std/daylight time changes tonight */
+	double jdmid;           /* UT of local midnight */
+	double stmid;           /* local mean sidereal time then */
+	double rasun, decsun;
+	double ramoon, decmoon, distmoon;  /* topocentric, at jdmid */
+	short sunstate;
+	double jdsunset, jdsunrise;
+	double jdcent;          /* -1. if not computed */
+	float set_to_rise, twi_to_twi;  /* hours */
+	short twi18state;
+	double jdetw, jdmtw;    /* 18-degree twilight */
+	double sidetw, sidmtw;  /* LMST at each */
+	short twi12state;
+	double jdetw12, jdmtw12;
+	short moonstate;
+	double jdmoonrise, jdmoonset;
+	double tmoonrise, tmoonset;   /* hours from midnight */
+	float moon_print;       /* moon events further out aren't printed */
+	double ill_frac;
+};
+
+/* an observatory, as load_site describes one -- see there for the
+   meaning of each quantity. */
+
+struct cal_site {
+	char name[40];
+	char zone_name[25];
+	char zabr;
+	double longit, lat, stdz;
+	double elevsea, elev, horiz;
+	short use_dst;
+};
+
+/* nights at several sites, from calendar_gen.  night[s * nnight + k]
+   is the night beginning on local date jdstart + k at site[s]. */
+
+struct calendar {
+	struct cal_site *site;
+	int nsite;
+	short year, nyears;  /* years covered, from 1 Jan of year */
+	int nnight;          /* nights at each site */
+	double jdstart;      /* local 18h of the first, as date_to_jd gives */
+	struct tonight *night;
+	struct skycalc_ctx *ctx;  /* ephemerides to use, while filling */
+};
+
+/* helcor_series' work, shared between threads -- the earth's
+   barycentric state at nnode nodes HELSER_STEP apart from jd0, six
+   to a node (x, y, z in AU and xdot, ydot, zdot in km/s, as
+   helcor_earth_r gives them), and the target and site. */
+
+struct helser {
+	double *jd;
+	int n;
+	double jd0;
+	int nnode;
+	double *node;
+	double xobj, yobj, zobj;   /* unit vector to the target */
+	double ra, longit;         /* hours */
+	double rot;                /* diurnal velocity amplitude, km/s */
+	double *tcor, *vcor;
+	struct skycalc_ctx *ctx;   /* ephemerides to use, while filling */
+};
+
+/* an eclipse or occultation, from eclipse_search or occult_search.
+   contact[] holds the times (UT) of the contacts in order -- for a
+   lunar eclipse P1 U1 U2 U3 U4 P4, for a solar eclipse C1 C2 C3 C4,
+   for an occultation disappearance and reappearance -- with -1 for
+   any that don't happen. */
+
+struct ecl_event {
+	short kind;        /* ECL_LUNAR, ECL_SOLAR or ECL_OCCULT */
+	short type;        /* as lunecl_calc or solecl_calc; 1 for occultations */
+	int obj;           /* catalog index, for occultations */
+	double jdmax;      /* greatest eclipse, or closest approach */
+	double sepmax;     /* separation then, degrees, as ecl_geom */
+	float magnitude;   /* solar: fraction of the sun covered, as
+			      solecl_calc.  lunar: umbral magnitude (types
+			      3 and 4, > 1 for total) or penumbral (types
+			      1 and 2), in moon diameters.  0 for
+			      occultations. */
+	double alt;        /* altitude of the moon (the sun, for a solar
+			      eclipse) at jdmax, from the site */
+	double contact[6];
+};
+
+struct ecl_list {
+	int n, cap;
+	struct ecl_event *ev;
+};
+
+/* what ecl_geom and the event searches need to know. */
+
+struct ecl_arg {
+	struct skycalc_ctx *ctx;
+	int kind;
+	int level;              /* contact whose separation ecl_func is
+				   relative to; -1 for none */
+	double lat, longit, elevsea;
+	double xyz[3];          /* the object, for occultations (J2000) */
+};
+
+/* occult_search's work, shared between threads. */
+
+struct occ_job {
+	struct skycalc_ctx *ctx;   /* ephemerides to use */
+	double lat, longit, elevsea;
+	double jd0;
+	int nnode;
+	double *node;      /* 4 per node OCC_STEP apart from jd0: the
+			      topocentric moon's J2000 unit vector, and the
+			      cosine of its semidiameter plus OCC_MARGIN */
+	int nobj;
+	double *xyz;       /* 3 per object, J2000 unit vectors */
+	int *obj;          /* catalog index of each */
+	struct ecl_list *found;   /* events for each; n = -1 if memory ran out */
+};
+
+/* Everything the library used to keep in file-scope globals -- the
+   planetary elements loaded by comp_el, the object list, the log file
+   and the getch/ungetch pushback buffer -- lives in one of these.
+   The _r entry points take one explicitly, so separate threads can
+   work in separate contexts; the traditional entry points all use
+   skycalc_default_ctx. */
+
+struct skycalc_ctx {
+	double jd_el;              /* epoch of elements in el[] */
+	struct elements el[10];
+	struct elrot elr[10];      /* from el[], by elrot_load */
+	struct catalog cat;        /* the object list */
+	struct catindex *catindex; /* if set, used by find_nearest_r */
+	FILE *sclogfl;
+	struct osink sink;   /* where oprntf_r output goes */
+	char buf[BUFSIZE];
+	int bufp;
+	struct precmat prec_cache[PREC_CACHE_SIZE]; /* most recent first */
+	int prec_cache_n;
+	struct moon_cheb *moon_cheb;  /* if set, used by accumoon_r */
+	struct skyeph *eph;  /* if set, used by the _r positions */
+	struct sid_cache sid;  /* used by lst_r */
+	struct dst_bounds dst_cache[DST_CACHE_SIZE]; /* most recent first */
+	int dst_cache_n;
+	struct dst_rules *dst;  /* if set, used by find_dst_bounds_r */
+};
+
+struct skycalc_ctx skycalc_default_ctx;
+
+void skycalc_ctx_init(ctx)
+
+	struct skycalc_ctx *ctx;
+
+/* puts a context into its start-up state -- no elements loaded,
+   no objects, no log file.  Contexts with static storage are already
+   in this state. */
+
+{
+	memset(ctx,0,sizeof(struct skycalc_ctx));
+	ctx->sclogfl = NULL;
+}
+
+void osink_write(ctx,text,len)
+
+	struct skycalc_ctx *ctx;
+	char *text;
+	size_t len;
+
+/* sends len characters of text to the context's output sink, and to
+   its log file (sclogfl) if there is one -- unless the sink is the
+   null sink, which swallows everything. */
+
+{
+	char *nbuf;
+	size_t nsize;
+
+	switch(ctx->sink.kind) {
+	case OSINK_NULL:
+		return;
+	case OSINK_FILE:
+		fwrite(text,1,len,ctx->sink.fp);
+		break;
+	case OSINK_BUFFER:
+		if(ctx->sink.len + len + 1 > ctx->sink.size) {
+			nsize = (ctx->sink.size > 0) ? ctx->sink.size : OSINK_LINE;
+			while(ctx->sink.len + len + 1 > nsize) nsize = 2 * nsize;
+			nbuf = (char *) realloc(ctx->sink.buf,nsize);
+			if(nbuf == NULL) return;   /* drop it rather than crash */
+			ctx->sink.buf = nbuf;
+			ctx->sink.size = nsize;
 		}
-		i = 0;
-		outform[i] = '%';
-		p++;
-		while(*p != 'd' && *p != 'f' && *p != 's' && *p != 'c' && 
-		    *p != 'h') {
-			outform[++i] = *p++;
-		}
-		switch (*p) {
-		case 'd':
-			ival = va_arg(ap, int);
-			outform[++i] = *p;
-			outform[++i] = '\0';
-			printf(outform, ival);
-#if LOG_FILES_OK == 1
-			if(sclogfl != NULL)
-				fprintf(sclogfl,outform,ival);
-#endif
-			break;
-		case 'h':    /* signals short argument ... */
-			shval = (short) va_arg(ap, int);
-			outform[++i] = 'd';
-			outform[++i] = '\0';
-			++p;  /* skip the 'd' in '%hd' */
-			printf(outform, shval);
-#if LOG_FILES_OK == 1
-			if(sclogfl != NULL)
-				fprintf(sclogfl,outform,shval);
-#endif
-			break;
-		case 'c':
-			/* cval = va_arg(ap, char); */
-			cval = va_arg(ap, int);
-			outform[++i] = *p;
-			outform[++i] = '\0';
-			printf(outform, cval);
-#if LOG_FILES_OK == 1
-			if(sclogfl != NULL)
-				fprintf(sclogfl,outform,cval);
-#endif
-			break;
-		case 'f':
-			dval = va_arg(ap, double);
-			outform[++i] = *p;
-			outform[++i] = '\0';
-			printf(outform, dval);
-#if LOG_FILES_OK == 1
-			if(sclogfl != NULL)
-				fprintf(sclogfl,outform,dval);
-#endif
-			break;
-		case 's':
-			outform[++i] = *p;
-			outform[++i] = '\0';
-			i = 0;
-			for (sval = va_arg(ap, char *); *sval; sval++) {
-				strout[i++] = *sval;
-			}
-			strout[i] = '\0';
-			printf(outform,strout);
+		memcpy(ctx->sink.buf + ctx->sink.len,text,len);
+		ctx->sink.len = ctx->sink.len + len;
+		ctx->sink.buf[ctx->sink.len] = '\0';
+		break;
+	case OSINK_CALLBACK:
+		(*ctx->sink.func)(ctx->sink.arg,text,len);
+		break;
+	default:   /* OSINK_STDOUT */
+		fwrite(text,1,len,stdout);
+	}
 #if LOG_FILES_OK == 1
-			if(sclogfl != NULL) fprintf(sclogfl,outform,strout);
+	if(ctx->sclogfl != NULL) fwrite(text,1,len,ctx->sclogfl);
 #endif
-			break;
-		default:
-	                ;
-		}
+}
+
+/* The output sinks.  Everything the library prints through oprntf
+   and oprntf_r goes to the context's sink -- standard output unless
+   one of these says otherwise.  Switching away from the buffer sink
+   keeps its text until osink_clear or osink_free. */
+
+void osink_stdout(ctx)
+	struct skycalc_ctx *ctx;
+{
+	ctx->sink.kind = OSINK_STDOUT;
+}
+
+void osink_file(ctx,fp)
+	struct skycalc_ctx *ctx;
+	FILE *fp;
+{
+	ctx->sink.kind = OSINK_FILE;
+	ctx->sink.fp = fp;
+}
+
+void osink_buffer(ctx)   /* collect output in memory; see osink_text */
+	struct skycalc_ctx *ctx;
+{
+	ctx->sink.kind = OSINK_BUFFER;
+}
+
+void osink_callback(ctx,func,arg)  /* hand each piece to func(arg,text,len) */
+	struct skycalc_ctx *ctx;
+	void (*func)(void *arg, char *text, size_t len);
+	void *arg;
+{
+	ctx->sink.kind = OSINK_CALLBACK;
+	ctx->sink.func = func;
+	ctx->sink.arg = arg;
+}
+
+void osink_null(ctx)   /* throw output away, log file included */
+	struct skycalc_ctx *ctx;
+{
+	ctx->sink.kind = OSINK_NULL;
+}
+
+char *osink_text(ctx,len)
+
+	struct skycalc_ctx *ctx;
+	size_t *len;
+
+/* the text collected by the buffer sink so far (NUL-terminated);
+   its length goes in *len unless len is NULL. */
+
+{
+	if(len != NULL) *len = ctx->sink.len;
+	return((ctx->sink.buf != NULL) ? ctx->sink.buf : "");
+}
+
+void osink_clear(ctx)
+	struct skycalc_ctx *ctx;
+{
+	ctx->sink.len = 0;
+	if(ctx->sink.buf != NULL) ctx->sink.buf[0] = '\0';
+}
+
+void osink_free(ctx)   /* release the buffer and go back to stdout */
+	struct skycalc_ctx *ctx;
+{
+	if(ctx->sink.buf != NULL) free(ctx->sink.buf);
+	ctx->sink.buf = NULL;
+	ctx->sink.len = ctx->sink.size = 0;
+	ctx->sink.kind = OSINK_STDOUT;
+}
+
+void voprntf_r(struct skycalc_ctx *ctx, char *fmt, va_list ap)
+
+/* This routine should look almost exactly like printf in terms of its
+   arguments (format list, then a variable number of arguments
+   to be formatted and printed).  The output goes to the context's
+   sink (see osink_write), which is standard output unless set
+   otherwise, AND IF the context's file pointer "sclogfl" is
+   defined, IT ALSO GOES TO THAT FILE.  This once followed K&R's
+   "minprintf", writing a character at a time; now the whole thing
+   is formatted with one vsnprintf, into a line buffer when it fits.
+   The argument list is picked up by the callers (oprntf_r, oprntf)
+   with va_start. */
+
+{
+	char line[OSINK_LINE];
+	char *text = line;
+	int n;
+	va_list aq;
+
+	if(ctx->sink.kind == OSINK_NULL) return;  /* don't even format it */
+
+	va_copy(aq,ap);
+	n = vsnprintf(line,sizeof(line),fmt,ap);
+	if(n >= (int) sizeof(line)) {   /* too long -- format it again */
+		text = (char *) malloc((size_t) n + 1);
+		if(text != NULL) vsnprintf(text,(size_t) n + 1,fmt,aq);
 	}
+	va_end(aq);
+	if(n < 0 || text == NULL) return;
+
+	osink_write(ctx,text,(size_t) n);
+	if(text != line) free(text);
+}
+
+void oprntf_r(struct skycalc_ctx *ctx, char *fmt, ...)
+{
+	va_list ap;        /* see K&R for explanation of these macros */
+
+	va_start(ap,fmt);
+	voprntf_r(ctx,fmt,ap);
 	va_end(ap);
 }
 
-/* elements of K&R hp calculator, basis of commands */
+void oprntf(char *fmt, ...)
+{
+	va_list ap;
 
-char buf[BUFSIZE];
-int bufp=0;
+	va_start(ap,fmt);
+	voprntf_r(&skycalc_default_ctx,fmt,ap);
+	va_end(ap);
+}
 
+/* elements of K&R hp calculator, basis of commands */
 
-char getch() /* get a (possibly pushed back) character */
+char getch_r(ctx) /* get a (possibly pushed back) character */
+	struct skycalc_ctx *ctx;
 {
-	return((bufp > 0) ? buf[--bufp] : getchar());
+	return((ctx->bufp > 0) ? ctx->buf[--ctx->bufp] : getchar());
 }
 
-void ungetch(c) /* push character back on input */
+void ungetch_r(ctx,c) /* push character back on input */
+	struct skycalc_ctx *ctx;
 	int c;
 {
-	if(bufp > BUFSIZE)
+	if(ctx->bufp > BUFSIZE)
 		printf("Ungetch -- too many characters.\n");
 	else
-		buf[bufp++] = c;
+		ctx->buf[ctx->bufp++] = c;
+}
+
+char getch()
+{
+	return(getch_r(&skycalc_default_ctx));
+}
+
+void ungetch(c)
+	int c;
+{
+	ungetch_r(&skycalc_default_ctx,c);
 }
 
 /* some functions for getting well-tested input. */
@@ -620,8 +1327,9 @@ int legal_command_char(c)
 	}
 }
 
-int parsedouble(s,d)
+int parsedouble_r(ctx,s,d)
 
+	struct skycalc_ctx *ctx;
 	char *s;
 	double *d;
 
@@ -635,7 +1343,7 @@ int parsedouble(s,d)
 	if(legal_num_part(*(s+i)) == 0) i++;
 	else if(legal_command_char(*(s+i)) == 1) {
 		/* to allow command to follow argument without blanks */
-		ungetch(s[i]);
+		ungetch_r(ctx,s[i]);
 		*(s+i) = '\0';  /* will terminate on next pass. */
 	}
 	else legal = -1;
@@ -659,8 +1367,9 @@ int parsedouble(s,d)
 }
 
 
-int getdouble(d,least,most,errprompt)
+int getdouble_r(ctx,d,least,most,errprompt)
 
+	struct skycalc_ctx *ctx;
 	double *d,least,most;
 	char *errprompt;
 
@@ -671,7 +1380,7 @@ int getdouble(d,least,most,errprompt)
 
     scanf("%s",s);
     while(success < 0) {
-	success = parsedouble(s,d);
+	success = parsedouble_r(ctx,s,d);
 	if((success == 0) && ((*d < least) || (*d > most))) {
 	   printf("%g is out of range; allowed %g to %g -- \n",
 			*d,least,most);
@@ -696,8 +1405,9 @@ int getdouble(d,least,most,errprompt)
     return((int) success);
 }
 
-int parseshort(s,d)
+int parseshort_r(ctx,s,d)
 
+	struct skycalc_ctx *ctx;
 	char *s;
 	short *d;
 
@@ -708,7 +1418,7 @@ int parseshort(s,d)
 	if(legal_int_part(*(s+i)) == 0) i++;
 	else if(legal_command_char(*(s+i)) == 1) {
 		/* to allow command to follow argument without blanks */
-		ungetch(s[i]);
+		ungetch_r(ctx,s[i]);
 		*(s+i) = '\0';  /* will terminate on next pass. */
 	}
 	else legal = -1;
@@ -731,8 +1441,9 @@ int parseshort(s,d)
    return(-1);
 }
 
-int getshort(d,least,most,errprompt)
+int getshort_r(ctx,d,least,most,errprompt)
 
+	struct skycalc_ctx *ctx;
 	short *d,least,most;
 	char *errprompt;
 
@@ -743,7 +1454,7 @@ int getshort(d,least,most,errprompt)
 
     scanf("%s",s);
     while(success < 0) {
-	success = parseshort(s,d);
+	success = parseshort_r(ctx,s,d);
 	if((success == 0) && ((*d < least) || (*d > most))) {
 	   printf("%d is out of range; allowed %d to %d -- try again.\n",
 			*d,least,most);
@@ -768,8 +1479,35 @@ int getshort(d,least,most,errprompt)
     return( (int) success);
 }
 
+int parsedouble(s,d)
+	char *s;
+	double *d;
+{
+	return(parsedouble_r(&skycalc_default_ctx,s,d));
+}
 
-double bab_to_dec(bab)
+int getdouble(d,least,most,errprompt)
+	double *d,least,most;
+	char *errprompt;
+{
+	return(getdouble_r(&skycalc_default_ctx,d,least,most,errprompt));
+}
+
+int parseshort(s,d)
+	char *s;
+	short *d;
+{
+	return(parseshort_r(&skycalc_default_ctx,s,d));
+}
+
+int getshort(d,least,most,errprompt)
+	short *d,least,most;
+	char *errprompt;
+{
+	return(getshort_r(&skycalc_default_ctx,d,least,most,errprompt));
+}
+
+double bab_to_dec(bab)
 
 	struct coord bab;
 
@@ -878,8 +1616,9 @@ double get_coord()
 }
 
 
-void put_coords(deci, precision)
+void put_coords_r(ctx, deci, precision)
 
+	struct skycalc_ctx *ctx;
 	double deci;
 	short precision;
 
@@ -911,12 +1650,12 @@ void put_coords(deci, precision)
 	 out_coord.mm = 0.;
 	 out_coord.hh = out_coord.hh + 1.;
       }
-      if(out_coord.hh < 100.) oprntf(" ");  /* put in leading blanks explicitly
+      if(out_coord.hh < 100.) oprntf_r(ctx," ");  /* put in leading blanks explicitly
 	  for 'h' option below. */
-      if(out_coord.hh < 10.) oprntf(" ");
-      if(coords.sign == -1) oprntf("-");
-	else oprntf(" ");   /* preserves alignment */
-      oprntf("%.0f %02.0f",out_coord.hh,out_coord.mm);
+      if(out_coord.hh < 10.) oprntf_r(ctx," ");
+      if(coords.sign == -1) oprntf_r(ctx,"-");
+	else oprntf_r(ctx," ");   /* preserves alignment */
+      oprntf_r(ctx,"%.0f %02.0f",out_coord.hh,out_coord.mm);
    }
 
    else if(precision == 1) {    /* keep nearest tenth of a minute */
@@ -928,10 +1667,10 @@ void put_coords(deci, precision)
 	 out_coord.mm = 0.;
 	 out_coord.hh = out_coord.hh + 1.;
       }
-      if(out_coord.hh < 10.) oprntf(" ");
-      if(coords.sign == -1) oprntf("-");
-	else oprntf(" ");   /* preserves alignment */
-      oprntf("%.0f %04.1f", out_coord.hh, out_coord.mm);
+      if(out_coord.hh < 10.) oprntf_r(ctx," ");
+      if(coords.sign == -1) oprntf_r(ctx,"-");
+	else oprntf_r(ctx," ");   /* preserves alignment */
+      oprntf_r(ctx,"%.0f %04.1f", out_coord.hh, out_coord.mm);
    }
    else if(precision == 2) {
 	  /* check to be sure seconds are not 60 */
@@ -946,10 +1685,10 @@ void put_coords(deci, precision)
 	      out_coord.mm = 0.;
 	  }
       }
-      if(out_coord.hh < 10.) oprntf(" ");
-      if(coords.sign == -1) oprntf("-");
-	 else oprntf(" ");   /* preserves alignment */
-      oprntf("%.0f %02.0f %02.0f",out_coord.hh,out_coord.mm,out_coord.ss);
+      if(out_coord.hh < 10.) oprntf_r(ctx," ");
+      if(coords.sign == -1) oprntf_r(ctx,"-");
+	 else oprntf_r(ctx," ");   /* preserves alignment */
+      oprntf_r(ctx,"%.0f %02.0f %02.0f",out_coord.hh,out_coord.mm,out_coord.ss);
    }
    else if(precision == 3) {
 	  /* the usual shuffle to check for 60's */
@@ -964,10 +1703,10 @@ void put_coords(deci, precision)
 	     out_coord.mm = 0.;
 	  }
       }
-      if(out_coord.hh < 10.) oprntf(" ");
-      if(coords.sign == -1) oprntf("-");
-	 else oprntf(" ");   /* preserves alignment */
-      oprntf("%.0f %02.0f %04.1f",out_coord.hh,out_coord.mm,out_coord.ss);
+      if(out_coord.hh < 10.) oprntf_r(ctx," ");
+      if(coords.sign == -1) oprntf_r(ctx,"-");
+	 else oprntf_r(ctx," ");   /* preserves alignment */
+      oprntf_r(ctx,"%.0f %02.0f %04.1f",out_coord.hh,out_coord.mm,out_coord.ss);
    }
    else {
       sprintf(out_string,"%.0f %02.0f %05.2f",coords.hh,coords.mm,coords.ss);
@@ -981,13 +1720,20 @@ void put_coords(deci, precision)
 	    out_coord.mm = 0.;
 	 }
       }
-      if(out_coord.hh < 10.) oprntf(" ");
-      if(coords.sign == -1) oprntf("-");
-	 else oprntf(" ");   /* preserves alignment */
-      oprntf("%.0f %02.0f %05.2f",out_coord.hh, out_coord.mm, out_coord.ss);
+      if(out_coord.hh < 10.) oprntf_r(ctx," ");
+      if(coords.sign == -1) oprntf_r(ctx,"-");
+	 else oprntf_r(ctx," ");   /* preserves alignment */
+      oprntf_r(ctx,"%.0f %02.0f %05.2f",out_coord.hh, out_coord.mm, out_coord.ss);
    }
 }
 
+void put_coords(deci, precision)
+	double deci;
+	short precision;
+{
+	put_coords_r(&skycalc_default_ctx,deci,precision);
+}
+
 void load_site(longit,lat,stdz,use_dst,
 	zone_name,zabr,elevsea,elev,horiz,site_name)
 
@@ -1349,6 +2095,20 @@ double ha_alt(dec,lat,alt)
 	}
 }
 
+void cel_unit(ra, dec, u)
+
+	double ra, dec, *u;
+
+/* the unit vector toward ra (hours) and dec (degrees), in u[0..2]. */
+
+{
+	ra = ra / HRS_IN_RADIAN;
+	dec = dec / DEG_IN_RADIAN;
+	u[0] = cos(ra) * cos(dec);
+	u[1] = sin(ra) * cos(dec);
+	u[2] = sin(dec);
+}
+
 double subtend(ra1,dec1,ra2,dec2)
 
 	double ra1,dec1,ra2,dec2;
@@ -1493,41 +2253,96 @@ int get_time(date)
 	return(0);
 }
 
-double date_to_jd(date)
+long jdn_from_civil(y,mo,d)
 
-	struct date_time date;
+	long y;
+	int mo, d;
+
+/* the julian day number (the julian date at noon) of a date in the
+   Gregorian calendar, in integers only -- H. Hinnant's
+   days_from_civil, counted from the start of a 400-year cycle.
+   Good for any year; d needn't be within the month (day 0 is the
+   last of the month before), and months outside 1 - 12 carry into
+   the year. */
+
+{
+	long era, yoe, doy, doe, k;
+
+	k = (mo >= 1) ? (mo - 1) / 12 : (mo - 12) / 12;   /* floor */
+	y = y + k;
+	mo = mo - 12 * k;
+	if(mo <= 2) y--;     /* years start in March */
+	era = (y >= 0 ? y : y - 399) / 400;
+	yoe = y - era * 400;                          /* 0 - 399 */
+	doy = (153 * (mo > 2 ? mo - 3 : mo + 9) + 2) / 5 + d - 1;  /* 0 - 365 */
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;  /* 0 - 146096 */
+	return(era * 146097 + doe + 1721120);  /* 0000 Mar 1 is JDN 1721120 */
+}
+
+void civil_from_jdn(jdn,y,mo,d)
+
+	long jdn;
+	short *y, *mo, *d;
+
+/* the Gregorian calendar date of julian day number jdn -- the
+   inverse of jdn_from_civil (Hinnant's civil_from_days). */
+
+{
+	long z, era;
+	int doe, yoe, doy, mp;
+
+	z = jdn - 1721120;
+	era = (z >= 0 ? z : z - 146096) / 146097;
+	doe = (int) (z - era * 146097);                          /* 0 - 146096 */
+	yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;   /* 0 - 399 */
+	doy = doe - (365*yoe + yoe/4 - yoe/100);                 /* 0 - 365 */
+	mp = (5*doy + 2)/153;                                    /* 0 - 11, from March */
+	*d = doy - (153*mp + 2)/5 + 1;
+	*mo = mp < 10 ? mp + 3 : mp - 9;
+	*y = yoe + era * 400 + (*mo <= 2);
+}
+
+void jd_split(jd,jdn,sod)
+
+	double jd;
+	long *jdn;
+	double *sod;
 
-/* Converts a date (structure) into a julian date.
-   Only good for 1900 -- 2100. */
+/* splits a julian date into the day number of the civil (midnight
+   to midnight) day it falls in and the seconds since that day's
+   midnight, 0 <= sod < 86400. */
 
 {
-	short yr1=0, mo1=1;
-	long jdzpt = 1720982, jdint, inter;
-	double jd,jdfrac;
+	double x;
+
+	x = jd + 0.5;
+	*jdn = (long) x;        /* truncates ... */
+	if(x < 0. && *jdn != x) (*jdn)--;   /* ... so round down */
+	*sod = (x - *jdn) * SEC_IN_DAY;
+	if(*sod < 0.) *sod = 0.;
+	else if(*sod >= SEC_IN_DAY) {
+		(*jdn)++;
+		*sod = *sod - SEC_IN_DAY;
+	}
+}
+
+double date_to_jd(date)
+
+	struct date_time date;
 
+/* Converts a date (structure) into a julian date.  The day number
+   is worked out exactly, by jdn_from_civil; only the time of day is
+   floating point.  Still refuses dates outside 1900 -- 2100, as the
+   rest of the program isn't good beyond them. */
 
+{
 	if((date.y <= 1900) | (date.y >= 2100)) {
 		printf("Date out of range.  1900 - 2100 only.\n");
 		return(0.);
 	}
 
-	if(date.mo <= 2) {
-		yr1 = -1;
-		mo1 = 13;
-	}
-
-	jdint = 365.25*(date.y+yr1);  /* truncates */
-	inter = 30.6001*(date.mo+mo1);
-	jdint = jdint+inter+date.d+jdzpt;
-	jd = jdint;
-	jdfrac=date.h/24.+date.mn/1440.+date.s/SEC_IN_DAY;
-	if(jdfrac < 0.5) {
-		jdint--;
-		jdfrac=jdfrac+0.5;
-	}
-	else jdfrac=jdfrac-0.5;
-	jd=jdint+jdfrac;
-	return(jd);
+	return((double) jdn_from_civil((long) date.y,date.mo,date.d) - 0.5 +
+		(date.h * 3600. + date.mn * 60. + date.s) / SEC_IN_DAY);
 }
 
 short day_of_week(jd)
@@ -1535,15 +2350,12 @@ short day_of_week(jd)
 {
 	/* returns day of week for a jd, 0 = Mon, 6 = Sun. */
 
-	double x,y;
 	long i;
-	short d;
 
-	jd = jd+0.5;
-	i = jd; /* truncate */
-	x = i/7.+0.01;
-	d = 7.*(x - (long) x);   /* truncate */
-	return(d);
+	i = floor(jd + 0.5);
+	i = i % 7;
+	if(i < 0) i = i + 7;
+	return((short) i);
 }
 
 
@@ -1558,31 +2370,37 @@ void caldat(jdin,date,dow)
 {
 	/* Returns date and time for a given julian date;
 	   also returns day-of-week coded 0 (Mon) through 6 (Sun).
-	   Adapted from Press, Flannery, Teukolsky, &
-	   Vetterling, Numerical Recipes in C, (Cambridge
-	   University Press), 1st edn, p. 12. */
+	   Since the Gregorian reform (IGREG) the date comes from
+	   integer arithmetic (civil_from_jdn), and the time of day
+	   from the seconds since midnight, in double precision.
+	   Earlier dates are in the Julian calendar, after Press,
+	   Flannery, Teukolsky, & Vetterling, Numerical Recipes in C,
+	   (Cambridge University Press), 1st edn, p. 12. */
 
 	int mm, id, iyyy;  /* their notation */
-	long ja, jdint, jalpha, jb, jc, jd, je;
-	float jdfrac;
-	double x;
-
-	jdin = jdin + 0.5;  /* adjust for 1/2 day */
-	jdint = jdin;
-	x = jdint/7.+0.01;
-	*dow = 7.*(x - (long) x);   /* truncate for day of week */
-	jdfrac = jdin - jdint;
-	date->h = jdfrac * 24; /* truncate */
-	date->mn = (jdfrac - ((float) date->h)/24.) * 1440.;
-	date->s = (jdfrac - ((float) date->h)/24. -
-			((float) date->mn)/1440.) * SEC_IN_DAY;
+	long ja, jdint, jb, jc, jd, je;
+	double sod;
+
+	jd_split(jdin,&jdint,&sod);
+	*dow = jdint % 7;
+	if(*dow < 0) *dow = *dow + 7;
+	date->h = (short) (sod * (1. / 3600.));  /* truncate */
+	date->mn = (short) ((sod - 3600. * date->h) * (1. / 60.));
+	date->s = sod - 3600. * date->h - 60. * date->mn;
+	if(date->s < 0.) {   /* multiplying by 1/60 may round up */
+		date->mn--;
+		date->s = date->s + 60.;
+	}
+	if(date->mn < 0) {
+		date->h--;
+		date->mn = date->mn + 60;
+	}
 
 	if(jdint > IGREG) {
-		jalpha=((float) (jdint-1867216)-0.25)/36524.25;
-		ja=jdint+1+jalpha-(long)(0.25*jalpha);
+		civil_from_jdn(jdint,&date->y,&date->mo,&date->d);
+		return;
 	}
-	else
-		ja=jdint;
+	ja=jdint;
 	jb=ja+1524;
 	jc=6680.0+((float) (jb-2439870)-122.1)/365.25;
 	jd=365*jc+(0.25*jc);
@@ -1598,8 +2416,45 @@ void caldat(jdin,date,dow)
 	date->d = id;
 }
 
+void caldat_batch(jd,n,date,dow)
 
-void print_day(d)
+	double *jd;
+	size_t n;
+	struct date_time *date;
+	short *dow;
+
+/* caldat for n julian dates at once; dow may be NULL. */
+
+{
+	size_t i;
+	short d;
+
+	for(i = 0; i < n; i++) {
+		caldat(jd[i],date + i,&d);
+		if(dow != NULL) dow[i] = d;
+	}
+}
+
+void date_to_jd_batch(date,n,jd)
+
+	struct date_time *date;
+	size_t n;
+	double *jd;
+
+/* date_to_jd for n dates at once -- without its range check or
+   message; the caller has to keep the years sensible. */
+
+{
+	size_t i;
+
+	for(i = 0; i < n; i++)
+		jd[i] = (double) jdn_from_civil((long) date[i].y,date[i].mo,
+			date[i].d) - 0.5 + (date[i].h * 3600. + date[i].mn * 60. +
+			date[i].s) / SEC_IN_DAY;
+}
+
+void print_day_r(ctx,d)
+	struct skycalc_ctx *ctx;
 	short d;
 
 {
@@ -1612,12 +2467,19 @@ void print_day(d)
 	day_out[2] = *(days+3*d+2);
 	day_out[3] = '\0';  /* terminate with null char */
 
-	oprntf("%s",day_out);
+	oprntf_r(ctx,"%s",day_out);
+}
+
+void print_day(d)
+	short d;
+{
+	print_day_r(&skycalc_default_ctx,d);
 }
 
 
-void print_all(jdin)
+void print_all_r(ctx,jdin)
 
+	struct skycalc_ctx *ctx;
 	double jdin;
 {
 	/* given a julian date,
@@ -1633,8 +2495,8 @@ void print_all(jdin)
 
 	caldat(jdin,&date,&dow);
 
-	print_day(dow);
-	oprntf(", ");
+	print_day_r(ctx,dow);
+	oprntf_r(ctx,", ");
 
 	mo_out[0] = *(months + 3*(date.mo - 1));
 	mo_out[1] = *(months + 3*(date.mo - 1) + 1);
@@ -1647,12 +2509,19 @@ void print_all(jdin)
 
 	ytemp = (int) date.y;
 	dtemp = (int) date.d;
-	oprntf("%d %s %2d, time ",
+	oprntf_r(ctx,"%d %s %2d, time ",
 		ytemp,mo_out,dtemp);
-	put_coords(out_time,3);
+	put_coords_r(ctx,out_time,3);
 }
 
-void print_current(date,night_date,enter_ut)
+void print_all(jdin)
+	double jdin;
+{
+	print_all_r(&skycalc_default_ctx,jdin);
+}
+
+void print_current_r(ctx,date,night_date,enter_ut)
+	struct skycalc_ctx *ctx;
         struct date_time date;
 	short night_date, enter_ut;
 {
@@ -1664,9 +2533,16 @@ void print_current(date,night_date,enter_ut)
 
 	jd = date_to_jd(date);
         if((night_date == 1) && (date.h < 12)) jd = jd + 1.0;
-	print_all(jd);
-	if(enter_ut == 0) oprntf(" local time.");
-	else oprntf(" Universal time.");
+	print_all_r(ctx,jd);
+	if(enter_ut == 0) oprntf_r(ctx," local time.");
+	else oprntf_r(ctx," Universal time.");
+}
+
+void print_current(date,night_date,enter_ut)
+	struct date_time date;
+	short night_date, enter_ut;
+{
+	print_current_r(&skycalc_default_ctx,date,night_date,enter_ut);
 }
 
 void print_calendar(jdin,dow)
@@ -1696,8 +2572,9 @@ void print_calendar(jdin,dow)
 	oprntf("%d %s %d",ytemp,mo_out,dtemp);
 }
 
-void print_time(jdin,prec)
+void print_time_r(ctx,jdin,prec)
 
+	struct skycalc_ctx *ctx;
 	double jdin;
 	short prec;
 
@@ -1712,9 +2589,16 @@ void print_time(jdin,prec)
 
 	temptime = date.h + date.mn/60. + date.s/3600.;
 
-	if(prec >= 0) put_coords(temptime,prec);
-	else if(date.mn < 30) oprntf("%2.0hd hr",date.h);
-	else oprntf("%2.0hd hr",(date.h+1)); /* round it up */
+	if(prec >= 0) put_coords_r(ctx,temptime,prec);
+	else if(date.mn < 30) oprntf_r(ctx,"%2.0hd hr",date.h);
+	else oprntf_r(ctx,"%2.0hd hr",(date.h+1)); /* round it up */
+}
+
+void print_time(jdin,prec)
+	double jdin;
+	short prec;
+{
+	print_time_r(&skycalc_default_ctx,jdin,prec);
 }
 
 double frac_part(x)
@@ -1728,19 +2612,18 @@ double frac_part(x)
 }
 
 
-double lst(jd,longit)
+double lst_cached(sc,jd,longit)
 
+	struct sid_cache *sc;
 	double jd,longit;
 
-{
-	/* returns the local MEAN sidereal time (dec hrs) at julian date jd
-	   at west longitude long (decimal hours).  Follows
-	   definitions in 1992 Astronomical Almanac, pp. B7 and L2.
-	   Expression for GMST at 0h ut referenced to Aoki et al, A&A 105,
-	   p.359, 1982.  On workstations, accuracy (numerical only!)
-	   is about a millisecond in the 1990s. */
+/* lst (below), keeping the GMST at 0h UT in sc.  When jd falls on
+   the UT day sc already holds, only the linear term is computed;
+   otherwise the Aoki polynomial is evaluated and sc is refilled.  The arithmetic
+   is the same as lst's, so the results are identical. */
 
-	double t, ut, jdmid, jdint, jdfrac, sid_g, sid;
+{
+	double t, ut, jdmid, jdint, jdfrac, sid_g;
 	long jdin, sid_int;
 
 	jdin = jd;         /* fossil code from earlier package which
@@ -1755,17 +2638,71 @@ double lst(jd,longit)
 		jdmid = jdint + 0.5;
 		ut = jdfrac - 0.5;
 	}
-	t = (jdmid - J2000)/36525;
-	sid_g = (24110.54841+8640184.812866*t+0.093104*t*t-6.2e-6*t*t*t)/SEC_IN_DAY;
-	sid_int = sid_g;
-	sid_g = sid_g - (double) sid_int;
-	sid_g = sid_g + 1.0027379093 * ut - longit/24.;
+	if(!sc->valid || sc->jdmid != jdmid) {
+		t = (jdmid - J2000)/36525;
+		sid_g = (24110.54841+8640184.812866*t+0.093104*t*t-6.2e-6*t*t*t)/SEC_IN_DAY;
+		sid_int = sid_g;
+		sc->gmst0 = sid_g - (double) sid_int;
+		sc->jdmid = jdmid;
+		sc->valid = 1;
+	}
+	sid_g = sc->gmst0 + 1.0027379093 * ut - longit/24.;
 	sid_int = sid_g;
 	sid_g = (sid_g - (double) sid_int) * 24.;
 	if(sid_g < 0.) sid_g = sid_g + 24.;
 	return(sid_g);
 }
 
+double lst(jd,longit)
+
+	double jd,longit;
+
+{
+	/* returns the local MEAN sidereal time (dec hrs) at julian date jd
+	   at west longitude long (decimal hours).  Follows
+	   definitions in 1992 Astronomical Almanac, pp. B7 and L2.
+	   Expression for GMST at 0h ut referenced to Aoki et al, A&A 105,
+	   p.359, 1982.  On workstations, accuracy (numerical only!)
+	   is about a millisecond in the 1990s.  The work is done by
+	   lst_cached, with a cache that's used once. */
+
+	struct sid_cache sc;
+
+	sc.valid = 0;
+	return(lst_cached(&sc,jd,longit));
+}
+
+double lst_r(ctx,jd,longit)
+
+	struct skycalc_ctx *ctx;
+	double jd,longit;
+
+/* lst, with the context's sidereal time cache. */
+
+{
+	return(lst_cached(&ctx->sid,jd,longit));
+}
+
+void lst_series(jd0,dt,n,longit,out)
+
+	double jd0,dt;
+	int n;
+	double longit,*out;
+
+/* local mean sidereal times (dec hrs) at jd0, jd0 + dt, ...
+   jd0 + (n-1) dt, into out[0..n-1] -- as lst, but the 0h UT GMST is
+   found once per UT day and each time is only the linear term
+   on top of it. */
+
+{
+	struct sid_cache sc;
+	int i;
+
+	sc.valid = 0;
+	for(i = 0; i < n; i++)
+		out[i] = lst_cached(&sc,jd0 + i * dt,longit);
+}
+
 double adj_time(x)
 	double x;
 
@@ -1785,6 +2722,71 @@ double adj_time(x)
 	return(x);
 }
 
+void altaz_batch(ra,dec,n,jd,lat,longit,alt,az,secz)
+
+	double *ra, *dec;
+	size_t n;
+	double jd, lat, longit;
+	double *alt, *az, *secz;
+
+/* altitude, azimuth and secant z for n objects at one instant --
+   the batched counterpart of altit/secant_z, for long queues.
+   ra (decimal hours) and dec (degrees) are taken to be at the
+   epoch of date.  The sidereal time and latitude terms are worked
+   out once for the whole batch; outputs are written to contiguous
+   arrays.  secz is clipped at +- 100 exactly as in secant_z.
+
+   The work is done BATCH_BLOCK objects at a time in separate short
+   loops, each calling only one libm function per argument (a sin and
+   a cos of the same angle in one loop would be merged into a sincos
+   call, which has no vector version).  Compiled with a vector libm
+   available -- e.g. gcc and glibc with -O3 -ffast-math -mavx2 or
+   -mavx512f -- every loop is vectorised; an ordinary -O2 build runs
+   the same code as plain scalar calls.  Results agree with
+   altit/secant_z to ~1.e-11 degree either way. */
+
+{
+	size_t i, j, m;
+	double sid, coslat, sinlat, x, y, z, theta;
+	double h[BATCH_BLOCK], cosd[BATCH_BLOCK], sind[BATCH_BLOCK],
+		cosha[BATCH_BLOCK], sinha[BATCH_BLOCK];
+
+	sid = lst(jd,longit);
+	coslat = cos(lat / DEG_IN_RADIAN);
+	sinlat = sin(lat / DEG_IN_RADIAN);
+
+	for(i = 0; i < n; i += m) {
+		m = (n - i < BATCH_BLOCK) ? n - i : BATCH_BLOCK;
+		for(j = 0; j < m; j++) {
+			/* same as adj_time(sid - ra), given 0 <= ra < 24 */
+			x = sid - ra[i+j];
+			x = (x > 12.) ? x - 24. : ((x < -12.) ? x + 24. : x);
+			h[j] = x / HRS_IN_RADIAN;
+		}
+		for(j = 0; j < m; j++) {
+			cosd[j] = cos(dec[i+j] / DEG_IN_RADIAN);
+			cosha[j] = cos(h[j]);
+		}
+		for(j = 0; j < m; j++) {
+			sind[j] = sin(dec[i+j] / DEG_IN_RADIAN);
+			sinha[j] = sin(h[j]);
+		}
+		for(j = 0; j < m; j++) {
+			x = cosd[j] * cosha[j] * coslat + sind[j] * sinlat;
+			y = sind[j] * coslat - cosd[j] * cosha[j] * sinlat; /* N */
+			z = -1. * cosd[j] * sinha[j];  /* due east comp. */
+			alt[i+j] = DEG_IN_RADIAN * asin(x);
+			theta = atan2(z,y);
+			az[i+j] = DEG_IN_RADIAN *
+				((theta < 0.) ? theta + 2. * PI : theta);
+			/* sin(alt) is just x; clip as secant_z does */
+			x = (x != 0.) ? 1. / x : 100.;
+			secz[i+j] = (x > 100.) ? 100. :
+				((x < -100.) ? -100. : x);
+		}
+	}
+}
+
 void lpmoon(jd,lat,sid,ra,dec,dist)
 
 	double jd,lat,sid,*ra,*dec,*dist;
@@ -2004,27 +3006,20 @@ double jd;
 }
 
 
-void accumoon(jd,geolat,lst,elevsea,geora,geodec,geodist,
-     topora,topodec,topodist)
+void accumoon_geo(jd,l,m,n,dist)
 
-	double jd,geolat,lst,elevsea;
-     	double *geora,*geodec,*geodist,*topora,*topodec,*topodist;
+	double jd, *l, *m, *n, *dist;
 
-  /* jd, dec. degr., dec. hrs., meters */
-/* More accurate (but more elaborate and slower) lunar
-   ephemeris, from Jean Meeus' *Astronomical Formulae For Calculators*,
-   pub. Willman-Bell.  Includes all the terms given there. */
+/* The series part of accumoon -- direction cosines of the geocentric
+   moon (equinox of date) and its distance in earth radii, for jd in
+   *ephemeris* time. */
 
 {
-/*      double *eclatit,*eclongit, *pie,*ra,*dec,*dist; geocent quantities,
-		formerly handed out but not in this version */
-	double pie, dist;  /* horiz parallax */
+	double pie;  /* horiz parallax */
 	double Lpr,M,Mpr,D,F,Om,T,Tsq,Tcb;
 	double e,lambda,B,beta,om1,om2;
-	double sinx, x, y, z, l, m, n;
-	double x_geo, y_geo, z_geo;  /* geocentric position of *observer* */
+	double sinx;
 
-	jd = jd + etcorr(jd)/SEC_IN_DAY;   /* approximate correction to ephemeris time */
 	T = (jd - 2415020.) / 36525.;   /* this based around 1900 ... */
 	Tsq = T * T;
 	Tcb = Tsq * T;
@@ -2220,12 +3215,35 @@ void accumoon(jd,geolat,lst,elevsea,geora,geodec,geodist,
 
 	beta = beta/DEG_IN_RADIAN;
 	lambda = lambda/DEG_IN_RADIAN;
-	l = cos(lambda) * cos(beta);
-	m = sin(lambda) * cos(beta);
-	n = sin(beta);
-	eclrot(jd,&l,&m,&n);
+	*l = cos(lambda) * cos(beta);
+	*m = sin(lambda) * cos(beta);
+	*n = sin(beta);
+	eclrot(jd,l,m,n);
+
+	*dist = 1/sin((pie)/DEG_IN_RADIAN);
+}
+
+void accumoon(jd,geolat,lst,elevsea,geora,geodec,geodist,
+     topora,topodec,topodist)
+
+	double jd,geolat,lst,elevsea;
+     	double *geora,*geodec,*geodist,*topora,*topodec,*topodist;
+
+  /* jd, dec. degr., dec. hrs., meters */
+/* More accurate (but more elaborate and slower) lunar
+   ephemeris, from Jean Meeus' *Astronomical Formulae For Calculators*,
+   pub. Willman-Bell.  Includes all the terms given there. */
+
+{
+/*      double *eclatit,*eclongit, *pie,*ra,*dec,*dist; geocent quantities,
+		formerly handed out but not in this version */
+	double dist;
+	double x, y, z, l, m, n;
+	double x_geo, y_geo, z_geo;  /* geocentric position of *observer* */
+
+	jd = jd + etcorr(jd)/SEC_IN_DAY;   /* approximate correction to ephemeris time */
+	accumoon_geo(jd,&l,&m,&n,&dist);
 
-	dist = 1/sin((pie)/DEG_IN_RADIAN);
 	x = l * dist;
 	y = m * dist;
 	z = n * dist;
@@ -2251,60 +3269,427 @@ void accumoon(jd,geolat,lst,elevsea,geora,geodec,geodist,
 
 }
 
-void flmoon(n,nph,jdout)
-
-	int n,nph;
-	double *jdout;
+void cheb_fit(samp,n,c)
 
-/* Gives jd (+- 2 min) of phase nph on lunation n; replaces
-less accurate Numerical Recipes routine.  This routine
-implements formulae found in Jean Meeus' *Astronomical Formulae
-for Calculators*, 2nd edition, Willman-Bell.  A very useful
-book!! */
+	double *samp, *c;
+	int n;
 
-/* n, nph lunation and phase; nph = 0 new, 1 1st, 2 full, 3 last
- *jdout   jd of requested phase */
+/* Chebyshev coefficients c[0..n-1] of a function sampled at the n
+   nodes t_i = cos(pi (i + 1/2) / n) on -1 <= t <= 1; a discrete
+   cosine transform.  c[0] is halved so that cheb_eval is a plain sum. */
 
 {
-	double jd, cor;
-	double M, Mpr, F;
-	double T;
-	double lun;
+	int i, k;
+	double sum;
+
+	for(k = 0; k < n; k++) {
+		sum = 0.;
+		for(i = 0; i < n; i++)
+			sum = sum + samp[i] * cos(PI * k * (i + 0.5) / n);
+		c[k] = 2. * sum / n;
+	}
+	c[0] = c[0] / 2.;
+}
 
-	lun = (double) n + (double) nph / 4.;
-	T = lun / 1236.85;
-	jd = 2415020.75933 + 29.53058868 * lun
-		+ 0.0001178 * T * T
-		- 0.000000155 * T * T * T
-		+ 0.00033 * sin((166.56 + 132.87 * T - 0.009173 * T * T)/DEG_IN_RADIAN);
-	M = 359.2242 + 29.10535608 * lun - 0.0000333 * T * T - 0.00000347 * T * T * T;
-	M = M / DEG_IN_RADIAN;
-	Mpr = 306.0253 + 385.81691806 * lun + 0.0107306 * T * T + 0.00001236 * T * T * T;
-	Mpr = Mpr / DEG_IN_RADIAN;
-	F = 21.2964 + 390.67050646 * lun - 0.0016528 * T * T - 0.00000239 * T * T * T;
-	F = F / DEG_IN_RADIAN;
-	if((nph == 0) || (nph == 2)) {/* new or full */
-		cor =   (0.1734 - 0.000393*T) * sin(M)
-			+ 0.0021 * sin(2*M)
-			- 0.4068 * sin(Mpr)
-			+ 0.0161 * sin(2*Mpr)
-			- 0.0004 * sin(3*Mpr)
-			+ 0.0104 * sin(2*F)
-			- 0.0051 * sin(M + Mpr)
-			- 0.0074 * sin(M - Mpr)
-			+ 0.0004 * sin(2*F+M)
-			- 0.0004 * sin(2*F-M)
-			- 0.0006 * sin(2*F+Mpr)
-			+ 0.0010 * sin(2*F-Mpr)
-			+ 0.0005 * sin(M+2*Mpr);
-		jd = jd + cor;
+double cheb_eval(c,n,t,deriv)
+
+	double *c, t, *deriv;
+	int n;
+
+/* sums the Chebyshev series c[0..n-1] at t (-1 to 1) by Clenshaw's
+   recurrence.  If deriv is non-NULL the derivative with respect to
+   t is put there as well. */
+
+{
+	int k;
+	double b0 = 0., b1 = 0., b2;
+	double T0, T1, T2, dT0, dT1, dT2, d;
+
+	for(k = n - 1; k >= 1; k--) {
+		b2 = b1;
+		b1 = b0;
+		b0 = 2. * t * b1 - b2 + c[k];
 	}
-	else {
-		cor = (0.1721 - 0.0004*T) * sin(M)
-			+ 0.0021 * sin(2 * M)
-			- 0.6280 * sin(Mpr)
-			+ 0.0089 * sin(2 * Mpr)
-			- 0.0004 * sin(3 * Mpr)
+	if(deriv != NULL) {   /* T_k' = 2 T_k-1 + 2 t T_k-1' - T_k-2' */
+		T0 = 1.;
+		T1 = t;
+		dT0 = 0.;
+		dT1 = 1.;
+		d = (n > 1) ? c[1] : 0.;
+		for(k = 2; k < n; k++) {
+			T2 = 2. * t * T1 - T0;
+			dT2 = 2. * T1 + 2. * t * dT1 - dT0;
+			d = d + c[k] * dT2;
+			T0 = T1;
+			T1 = T2;
+			dT0 = dT1;
+			dT1 = dT2;
+		}
+		*deriv = d;
+	}
+	return(t * b0 - b1 + c[0]);
+}
+
+void moon_cheb_xyz(jd,xyz)
+
+	double jd, *xyz;
+
+/* geocentric moon from accumoon_geo as x, y, z in earth radii;
+   jd is ephemeris time. */
+
+{
+	double l, m, n, dist;
+
+	accumoon_geo(jd,&l,&m,&n,&dist);
+	xyz[0] = l * dist;
+	xyz[1] = m * dist;
+	xyz[2] = n * dist;
+}
+
+int moon_cheb_build(mc,jdstart,jdend)
+
+	struct moon_cheb *mc;
+	double jdstart, jdend;
+
+/* fits accumoon's geocentric position over jdstart to jdend (at
+   least; the span is rounded up to whole MOON_CHEB_SEG-day segments)
+   for use by accumoon_cheb.  Costs about 13 accumoon calls per 4 days.
+   Returns 0, or -1 if no memory could be had.  Release the table with
+   moon_cheb_free.
+
+   Fitting the cartesian position rather than RA and dec avoids the
+   wrap at 0h and the pole, and fitting in ephemeris time keeps the
+   kinks in etcorr out of the fit.  Over 1900 - 2100 the fitted position
+   departs from accumoon's by no more than 1.e-4 arcsec (measured
+   2.e-5) and the distance by no more than 1.e-8 earth radius -- far
+   below the accuracy of the series itself.  A lookup costs about an
+   eighth of an accumoon call. */
+
+{
+	int i, j, seg;
+	double t, xyz[3], *c;
+	double tnode[MOON_CHEB_NCOEF];
+	double samp[3][MOON_CHEB_NCOEF];
+
+	/* the fit is in ephemeris time, which is smooth -- etcorr
+	   is not, so it is applied afresh on every lookup, as accumoon
+	   does.  Pad a little for its small jumps. */
+	jdstart = jdstart + etcorr(jdstart)/SEC_IN_DAY - 0.01;
+	jdend = jdend + etcorr(jdend)/SEC_IN_DAY + 0.01;
+	mc->jdstart = jdstart;
+	mc->nseg = (int) ceil((jdend - jdstart) / MOON_CHEB_SEG);
+	if(mc->nseg < 1) mc->nseg = 1;
+	mc->jdend = jdstart + mc->nseg * MOON_CHEB_SEG;
+	mc->coef = (double *) malloc(mc->nseg * 3 * MOON_CHEB_NCOEF * sizeof(double));
+	if(mc->coef == NULL) {
+		mc->nseg = 0;
+		return(-1);
+	}
+
+	for(i = 0; i < MOON_CHEB_NCOEF; i++)
+		tnode[i] = cos(PI * (i + 0.5) / MOON_CHEB_NCOEF);
+
+	for(seg = 0; seg < mc->nseg; seg++) {
+		/* sample at the Chebyshev nodes of the segment ... */
+		for(i = 0; i < MOON_CHEB_NCOEF; i++) {
+			t = jdstart + MOON_CHEB_SEG * (seg + 0.5 * (tnode[i] + 1.));
+			moon_cheb_xyz(t,xyz);
+			for(j = 0; j < 3; j++) samp[j][i] = xyz[j];
+		}
+		/* ... and take the discrete cosine transform. */
+		c = mc->coef + seg * 3 * MOON_CHEB_NCOEF;
+		for(j = 0; j < 3; j++)
+			cheb_fit(samp[j],MOON_CHEB_NCOEF,c + j * MOON_CHEB_NCOEF);
+	}
+	return(0);
+}
+
+void moon_cheb_free(mc)
+
+	struct moon_cheb *mc;
+
+{
+	if(mc->coef != NULL) free(mc->coef);
+	mc->coef = NULL;
+	mc->nseg = 0;
+	mc->jdend = mc->jdstart;
+}
+
+int skyeph_open(eph,fname)
+
+	struct skyeph *eph;
+	char *fname;
+
+/* maps an ephemeris file written by skyeph_write.  Nothing is read
+   or parsed beyond a check of the header; pages come in as they are
+   touched and are shared with any other process using the same file.
+   Returns 0, or -1 if the file can't be had or isn't one of ours
+   (wrong magic number, version, or byte order, a body table that
+   doesn't make sense, or truncated). */
+
+{
+	int fd;
+	struct stat st;
+	struct skyeph_header *hdr;
+	struct skyeph_body *bd;
+	void *map;
+	long i, end, need, have;
+
+	eph->map = NULL;
+	eph->maplen = 0;
+	eph->hdr = NULL;
+	eph->coef = NULL;
+
+	if((fd = open(fname, O_RDONLY)) < 0) return(-1);
+	if(fstat(fd, &st) != 0 ||
+	   st.st_size < (off_t) sizeof(struct skyeph_header)) {
+		close(fd);
+		return(-1);
+	}
+	map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);   /* the mapping stays good */
+	if(map == MAP_FAILED) return(-1);
+
+	hdr = (struct skyeph_header *) map;
+	/* room for this many coefficients after the header */
+	have = (long) ((st.st_size - sizeof(struct skyeph_header)) /
+		sizeof(double));
+	need = 0;
+	if(hdr->magic == SKYEPH_MAGIC && hdr->version == SKYEPH_VERSION &&
+	   hdr->byteorder == SKYEPH_BYTEORDER && hdr->nbody == SKYEPH_NBODY) {
+		for(i = 0; i < SKYEPH_NBODY; i++) {
+			bd = hdr->body + i;
+			/* each body's table has to be usable by skyeph_eval
+			   as it stands -- the comparisons are written so
+			   that a NaN fails them. */
+			if(!(bd->offset >= 0 && bd->nseg >= 1 &&
+			     bd->ncoef >= 1 && bd->ncoef <= SKYEPH_NCOEF &&
+			     bd->seglen > 0. && bd->seglen < 1.e6 &&
+			     fabs(bd->jdstart) < 1.e8)) {
+				need = 0;
+				break;
+			}
+			end = bd->offset + 3L * bd->nseg * bd->ncoef;
+			if(end > have) {
+				need = 0;
+				break;
+			}
+			if(end > need) need = end;
+		}
+	}
+	if(need == 0) {
+		munmap(map, (size_t) st.st_size);
+		return(-1);
+	}
+
+	eph->map = map;
+	eph->maplen = (size_t) st.st_size;
+	eph->hdr = hdr;
+	eph->coef = (double *) ((char *) map + sizeof(struct skyeph_header));
+	return(0);
+}
+
+void skyeph_close(eph)
+
+	struct skyeph *eph;
+
+{
+	if(eph->map != NULL) munmap(eph->map, eph->maplen);
+	eph->map = NULL;
+	eph->maplen = 0;
+	eph->hdr = NULL;
+	eph->coef = NULL;
+}
+
+int skyeph_eval(eph,body,jd,pos,vel)
+
+	struct skyeph *eph;
+	int body;
+	double jd, *pos, *vel;
+
+/* position (and, if vel is non-NULL, velocity per day) of body
+   SKYEPH_SUN, SKYEPH_MOON, or planet 1 - 9 at jd, from a mapped file.
+   jd is ephemeris time for the sun and moon, and plain jd for the
+   planets, as for the routines the file was made from; see
+   skyeph_write for the quantities.  Returns 0, or -1 if jd is
+   outside the file. */
+
+{
+	struct skyeph_body *bd;
+	int seg, j;
+	double t, *c;
+
+	if(eph->hdr == NULL || body < 0 || body >= SKYEPH_NBODY) return(-1);
+	bd = eph->hdr->body + body;
+	if(jd < bd->jdstart || jd >= bd->jdstart + bd->nseg * bd->seglen)
+		return(-1);
+
+	seg = (int) ((jd - bd->jdstart) / bd->seglen);
+	if(seg >= bd->nseg) seg = bd->nseg - 1;
+	t = 2. * (jd - bd->jdstart - seg * bd->seglen) / bd->seglen - 1.;
+	c = eph->coef + bd->offset + 3L * seg * bd->ncoef;
+
+	for(j = 0; j < 3; j++) {
+		pos[j] = cheb_eval(c + j * bd->ncoef, bd->ncoef, t,
+			(vel == NULL) ? (double *) NULL : vel + j);
+		if(vel != NULL) vel[j] = vel[j] * 2. / bd->seglen;
+	}
+	return(0);
+}
+
+void accumoon_topo(xyz,geolat,lst,elevsea,geora,geodec,geodist,
+     topora,topodec,topodist)
+
+	double *xyz,geolat,lst,elevsea;
+     	double *geora,*geodec,*geodist,*topora,*topodec,*topodist;
+
+/* accumoon's answers from the geocentric moon xyz (earth radii,
+   equinox of date), as found by one of the tabulated ephemerides. */
+
+{
+	double x, y, z, dist, l, m, n;
+	double x_geo, y_geo, z_geo;  /* geocentric position of *observer* */
+
+	x = xyz[0];
+	y = xyz[1];
+	z = xyz[2];
+
+	dist = sqrt(x*x + y*y + z*z);
+	*geora = atan_circ(x,y) * HRS_IN_RADIAN;
+	*geodec = asin(z / dist) * DEG_IN_RADIAN;
+	*geodist = dist;
+
+	geocent(lst,geolat,elevsea,&x_geo,&y_geo,&z_geo);
+
+	x = x - x_geo;  /* topocentric correction using elliptical earth fig. */
+	y = y - y_geo;
+	z = z - z_geo;
+
+	*topodist = sqrt(x*x + y*y + z*z);
+
+	l = x / (*topodist);
+	m = y / (*topodist);
+	n = z / (*topodist);
+
+	*topora = atan_circ(l,m) * HRS_IN_RADIAN;
+	*topodec = asin(n) * DEG_IN_RADIAN;
+}
+
+void accumoon_cheb(mc,jd,geolat,lst,elevsea,geora,geodec,geodist,
+     topora,topodec,topodist)
+
+	struct moon_cheb *mc;
+	double jd,geolat,lst,elevsea;
+     	double *geora,*geodec,*geodist,*topora,*topodec,*topodist;
+
+/* accumoon, but from a table made by moon_cheb_build -- same
+   arguments and answers (see moon_cheb_build for how close).
+   Falls back on accumoon outside the table's span. */
+
+{
+	int seg, j;
+	double jdet, t, *c;
+	double xyz[3];
+
+	jdet = jd + etcorr(jd)/SEC_IN_DAY;
+	if(mc->coef == NULL || jdet < mc->jdstart || jdet >= mc->jdend) {
+		accumoon(jd,geolat,lst,elevsea,geora,geodec,geodist,
+			topora,topodec,topodist);
+		return;
+	}
+
+	seg = (int) ((jdet - mc->jdstart) / MOON_CHEB_SEG);
+	if(seg >= mc->nseg) seg = mc->nseg - 1;
+	t = 2. * (jdet - mc->jdstart - seg * MOON_CHEB_SEG) / MOON_CHEB_SEG - 1.;
+	c = mc->coef + seg * 3 * MOON_CHEB_NCOEF;
+
+	for(j = 0; j < 3; j++)
+		xyz[j] = cheb_eval(c + j * MOON_CHEB_NCOEF,MOON_CHEB_NCOEF,t,
+			(double *) NULL);
+
+	accumoon_topo(xyz,geolat,lst,elevsea,geora,geodec,geodist,
+		topora,topodec,topodist);
+}
+
+void accumoon_r(ctx,jd,geolat,lst,elevsea,geora,geodec,geodist,
+     topora,topodec,topodist)
+
+	struct skycalc_ctx *ctx;
+	double jd,geolat,lst,elevsea;
+     	double *geora,*geodec,*geodist,*topora,*topodec,*topodist;
+
+/* accumoon, from the context's ephemeris file or moon_cheb table
+   if it has one that covers jd. */
+
+{
+	double xyz[3];
+
+	if(ctx->eph != NULL &&
+	   skyeph_eval(ctx->eph,SKYEPH_MOON,jd + etcorr(jd)/SEC_IN_DAY,
+		xyz,(double *) NULL) == 0)
+		accumoon_topo(xyz,geolat,lst,elevsea,geora,geodec,geodist,
+			topora,topodec,topodist);
+	else if(ctx->moon_cheb != NULL)
+		accumoon_cheb(ctx->moon_cheb,jd,geolat,lst,elevsea,
+			geora,geodec,geodist,topora,topodec,topodist);
+	else accumoon(jd,geolat,lst,elevsea,geora,geodec,geodist,
+			topora,topodec,topodist);
+}
+
+void flmoon(n,nph,jdout)
+
+	int n,nph;
+	double *jdout;
+
+/* Gives jd (+- 2 min) of phase nph on lunation n; replaces
+less accurate Numerical Recipes routine.  This routine
+implements formulae found in Jean Meeus' *Astronomical Formulae
+for Calculators*, 2nd edition, Willman-Bell.  A very useful
+book!! */
+
+/* n, nph lunation and phase; nph = 0 new, 1 1st, 2 full, 3 last
+ *jdout   jd of requested phase */
+
+{
+	double jd, cor;
+	double M, Mpr, F;
+	double T;
+	double lun;
+
+	lun = (double) n + (double) nph / 4.;
+	T = lun / 1236.85;
+	jd = 2415020.75933 + 29.53058868 * lun
+		+ 0.0001178 * T * T
+		- 0.000000155 * T * T * T
+		+ 0.00033 * sin((166.56 + 132.87 * T - 0.009173 * T * T)/DEG_IN_RADIAN);
+	M = 359.2242 + 29.10535608 * lun - 0.0000333 * T * T - 0.00000347 * T * T * T;
+	M = M / DEG_IN_RADIAN;
+	Mpr = 306.0253 + 385.81691806 * lun + 0.0107306 * T * T + 0.00001236 * T * T * T;
+	Mpr = Mpr / DEG_IN_RADIAN;
+	F = 21.2964 + 390.67050646 * lun - 0.0016528 * T * T - 0.00000239 * T * T * T;
+	F = F / DEG_IN_RADIAN;
+	if((nph == 0) || (nph == 2)) {/* new or full */
+		cor =   (0.1734 - 0.000393*T) * sin(M)
+			+ 0.0021 * sin(2*M)
+			- 0.4068 * sin(Mpr)
+			+ 0.0161 * sin(2*Mpr)
+			- 0.0004 * sin(3*Mpr)
+			+ 0.0104 * sin(2*F)
+			- 0.0051 * sin(M + Mpr)
+			- 0.0074 * sin(M - Mpr)
+			+ 0.0004 * sin(2*F+M)
+			- 0.0004 * sin(2*F-M)
+			- 0.0006 * sin(2*F+Mpr)
+			+ 0.0010 * sin(2*F-Mpr)
+			+ 0.0005 * sin(M+2*Mpr);
+		jd = jd + cor;
+	}
+	else {
+		cor = (0.1721 - 0.0004*T) * sin(M)
+			+ 0.0021 * sin(2 * M)
+			- 0.6280 * sin(Mpr)
+			+ 0.0089 * sin(2 * Mpr)
+			- 0.0004 * sin(3 * Mpr)
 			+ 0.0079 * sin(2*F)
 			- 0.0119 * sin(M + Mpr)
 			- 0.0047 * sin(M - Mpr)
@@ -2424,6 +3809,93 @@ void print_phase(jd)
 	}
 }
 
+void skybright_moon_set(alpha,kzen,altmoon,azmoon,moondist,m)
+
+	double alpha,kzen,altmoon,azmoon,moondist;
+	struct skybright_moon *m;
+
+/* works out the terms of lunskybright that depend only on the moon
+   (and the extinction), so they can be kept and used for many
+   points on the sky -- see lunsky_nl, lunskybright_batch and
+   sky_grid_bright.  Arguments are as for lunskybright, plus
+   the moon's azimuth (degrees), which only sky_grid_bright uses. */
+
+{
+	double Zmoon, Xzm, istar;
+
+	m->alpha = alpha;
+	m->kzen = kzen;
+	m->altmoon = altmoon;
+	m->moondist = moondist;
+	cel_unit(azmoon / 15.,altmoon,m->u);  /* az as if it were RA */
+
+	alpha = (180. - alpha);
+	Zmoon = (90. - altmoon)/DEG_IN_RADIAN;
+	moondist = moondist/(60.27);  /* divide by mean distance */
+
+	istar = -0.4*(3.84 + 0.026*fabs(alpha) + 4.0e-9*pow(alpha,4.)); /*eqn 20*/
+	istar =  pow(10.,istar)/(moondist * moondist);
+	if(fabs(alpha) < 7.)   /* crude accounting for opposition effect */
+		istar = istar * (1.35 - 0.05 * fabs(istar));
+	/* 35 per cent brighter at full, effect tapering linearly to
+	   zero at 7 degrees away from full. mentioned peripherally in
+	   Krisciunas and Scheafer, p. 1035. */
+	Xzm = sqrt(1.0 - 0.96*sin(Zmoon)*sin(Zmoon));
+	if(Xzm != 0.) Xzm = 1./Xzm;
+	  else Xzm = 10000.;
+	/* moonlight, extincted on the way down */
+	m->istar = istar * pow(10.,(-0.4*kzen*Xzm));
+}
+
+double sky_airfac(kzen,alt)
+
+	double kzen,alt;
+
+/* the fraction of moonlight the air scatters toward an object at
+   altitude alt -- the (1 - 10^(-0.4 k X)) factor of lunskybright. */
+
+{
+	double Z, Xo;
+
+	Z = (90. - alt)/DEG_IN_RADIAN;
+	Xo = sqrt(1.0 - 0.96*sin(Z)*sin(Z));
+	if(Xo != 0.) Xo = 1./Xo;
+	  else Xo = 10000.;
+	return(1. - pow(10.,(-0.4*kzen*Xo)));
+}
+
+double lunsky_nl(m,rho,cosrho,airfac)
+
+	struct skybright_moon *m;
+	double rho,cosrho,airfac;
+
+/* lunar sky brightness, in nanoLamberts, at rho degrees from the
+   moon (cosrho = its cosine) where sky_airfac is airfac. */
+
+{
+	double fofrho;
+
+	fofrho = 229087. * (1.06 + cosrho*cosrho);
+	if(fabs(rho) > 10.)
+	   fofrho=fofrho+exp(LN_10 * (6.15 - rho/40.));       /* eqn 21 */
+	else if (fabs(rho) > 0.25)
+	   fofrho= fofrho+ 6.2e7 / (rho*rho);   /* eqn 19 */
+	else fofrho = fofrho+9.9e8;  /*for 1/4 degree -- radius of moon! */
+	return(fofrho * m->istar * airfac);
+}
+
+double sky_vmag(B)
+
+	double B;
+
+/* nanoLamberts to V mag per square arcsec (Krisciunas and Schaefer
+   eqn 1), or 99. for a negligible brightness. */
+
+{
+	if(B > 0.001) return(22.50 - 1.08574 * log(B/34.08));
+	else return(99.);
+}
+
 double lunskybright(alpha,rho,kzen,altmoon,alt, moondist)
 
 	double alpha,rho,kzen,altmoon,alt,moondist;
@@ -2440,72 +3912,34 @@ double lunskybright(alpha,rho,kzen,altmoon,alt, moondist)
    alt = altitude of object above horizon
    moondist = distance to moon, in earth radii
 
-   all are in decimal degrees. */
+   all are in decimal degrees.  The moon's part of the work is
+   done by skybright_moon_set; for many objects, keep that and use
+   lunskybright_batch or sky_grid_bright. */
 
 {
+    struct skybright_moon m;
+    double Bmoon;
 
-    double istar,Xzm,Xo,Z,Zmoon,Bmoon,fofrho,rho_rad,test;
-
-    rho_rad = rho/DEG_IN_RADIAN;
-    alpha = (180. - alpha);
-    Zmoon = (90. - altmoon)/DEG_IN_RADIAN;
-    Z = (90. - alt)/DEG_IN_RADIAN;
-    moondist = moondist/(60.27);  /* divide by mean distance */
-
-    istar = -0.4*(3.84 + 0.026*fabs(alpha) + 4.0e-9*pow(alpha,4.)); /*eqn 20*/
-    istar =  pow(10.,istar)/(moondist * moondist);
-    if(fabs(alpha) < 7.)   /* crude accounting for opposition effect */
-	istar = istar * (1.35 - 0.05 * fabs(istar));
-	/* 35 per cent brighter at full, effect tapering linearly to
-	   zero at 7 degrees away from full. mentioned peripherally in
-	   Krisciunas and Scheafer, p. 1035. */
-    fofrho = 229087. * (1.06 + cos(rho_rad)*cos(rho_rad));
-    if(fabs(rho) > 10.)
-       fofrho=fofrho+pow(10.,(6.15 - rho/40.));            /* eqn 21 */
-    else if (fabs(rho) > 0.25)
-       fofrho= fofrho+ 6.2e7 / (rho*rho);   /* eqn 19 */
-    else fofrho = fofrho+9.9e8;  /*for 1/4 degree -- radius of moon! */
-    Xzm = sqrt(1.0 - 0.96*sin(Zmoon)*sin(Zmoon));
-    if(Xzm != 0.) Xzm = 1./Xzm;
-	  else Xzm = 10000.;
-    Xo = sqrt(1.0 - 0.96*sin(Z)*sin(Z));
-    if(Xo != 0.) Xo = 1./Xo;
-	  else Xo = 10000.;
-    Bmoon = fofrho * istar * pow(10.,(-0.4*kzen*Xzm))
-	  * (1. - pow(10.,(-0.4*kzen*Xo)));   /* nanoLamberts */
-    if(Bmoon > 0.001)
-      return(22.50 - 1.08574 * log(Bmoon/34.08)); /* V mag per sq arcs-eqn 1 */
-    else return(99.);
+    skybright_moon_set(alpha,kzen,altmoon,0.,moondist,&m);
+    Bmoon = lunsky_nl(&m,rho,cos(rho/DEG_IN_RADIAN),sky_airfac(kzen,alt));
+				/* nanoLamberts */
+    return(sky_vmag(Bmoon));  /* V mag per sq arcs-eqn 1 */
 }
 
-void accusun(jd,lst,geolat,ra,dec,dist,topora,topodec,x,y,z)
+void accusun_geo(jd,x,y,z,dist)
 
-	double jd,lst,geolat,*ra,*dec,*dist,*topora,*topodec;
- 	double *x, *y, *z;
-{
-      /*  implemenataion of Jean Meeus' more accurate solar
-	  ephemeris.  For ultimate use in helio correction! From
-	  Astronomical Formulae for Calculators, pp. 79 ff.  This
-	  gives sun's position wrt *mean* equinox of date, not
-	  *apparent*.  Accuracy is << 1 arcmin.  Positions given are
-	  geocentric ... parallax due to observer's position on earth is
-	  ignored. This is up to 8 arcsec; routine is usually a little
-	  better than that.
-          // -- topocentric correction *is* included now. -- //
-	  Light travel time is apparently taken into
-	  account for the ra and dec, but I don't know if aberration is
-	  and I don't know if distance is simlarly antedated.
+	double jd, *x, *y, *z, *dist;
 
-	  x, y, and z are heliocentric equatorial coordinates of the
-	  EARTH, referred to mean equator and equinox of date. */
+/* The series part of accusun -- unit vector toward the sun from the
+   earth's center (mean equator and equinox of date), and the
+   earth-sun distance in AU, for jd in *ephemeris* time. */
 
+{
 	double L, T, Tsq, Tcb;
 	double M, e, Cent, nu, sunlong;
 	double Lrad, Mrad, nurad, R;
 	double A, B, C, D, E, H;
-	double xtop, ytop, ztop, topodist, l, m, n, xgeo, ygeo, zgeo;
 
-	jd = jd + etcorr(jd)/SEC_IN_DAY;  /* might as well do it right .... */
 	T = (jd - 2415020.) / 36525.;  /* 1900 --- this is an oldish theory*/
 	Tsq = T*T;
 	Tcb = T*Tsq;
@@ -2567,6 +4001,35 @@ void accusun(jd,lst,geolat,ra,dec,dist,topora,topodec,x,y,z)
 	*y = sin(sunlong);
 	*z = 0.;
 	eclrot(jd, x, y, z);
+}
+
+void accusun(jd,lst,geolat,ra,dec,dist,topora,topodec,x,y,z)
+
+	double jd,lst,geolat,*ra,*dec,*dist,*topora,*topodec;
+ 	double *x, *y, *z;
+{
+      /*  implemenataion of Jean Meeus' more accurate solar
+	  ephemeris.  For ultimate use in helio correction! From
+	  Astronomical Formulae for Calculators, pp. 79 ff.  This
+	  gives sun's position wrt *mean* equinox of date, not
+	  *apparent*.  Accuracy is << 1 arcmin.  Positions given are
+	  geocentric ... parallax due to observer's position on earth is
+	  ignored. This is up to 8 arcsec; routine is usually a little
+	  better than that.
+          // -- topocentric correction *is* included now. -- //
+	  Light travel time is apparently taken into
+	  account for the ra and dec, but I don't know if aberration is
+	  and I don't know if distance is simlarly antedated.
+
+	  x, y, and z are heliocentric equatorial coordinates of the
+	  EARTH, referred to mean equator and equinox of date. */
+
+	double R;
+	double xtop, ytop, ztop, topodist, l, m, n, xgeo, ygeo, zgeo;
+
+	jd = jd + etcorr(jd)/SEC_IN_DAY;  /* might as well do it right .... */
+	accusun_geo(jd, x, y, z, dist);
+	R = *dist;
 
 /*      --- code to include topocentric correction for sun .... */
 
@@ -2594,2974 +4057,7257 @@ void accusun(jd,lst,geolat,ra,dec,dist,topora,topodec,x,y,z)
 
 }
 
-double jd_moon_alt(alt,jdguess,lat,longit,elevsea)
-
-	double alt,jdguess,lat,longit,elevsea;
+void accusun_r(ctx,jd,lst,geolat,ra,dec,dist,topora,topodec,x,y,z)
 
-{
-	/* returns jd at which moon is at a given
-	altitude, given jdguess as a starting point. In current version
-	uses high-precision moon -- execution time does not seem to be
-	excessive on modern hardware.  If it's a problem on your machine,
-	you can replace calls to 'accumoon' with 'lpmoon' and remove
-	the 'elevsea' argument. */
+	struct skycalc_ctx *ctx;
+	double jd,lst,geolat,*ra,*dec,*dist,*topora,*topodec;
+ 	double *x, *y, *z;
 
-	double jdout;
-	double deriv, err, del = 0.002;
-	double ra,dec,dist,geora,geodec,geodist,sid,ha,alt2,alt3,az;
-	short i = 0;
+/* accusun, from the context's ephemeris file if it has one that
+   covers jd. */
 
-	/* first guess */
+{
+	double v[3], R;
+	double xtop, ytop, ztop, topodist, l, m, n, xgeo, ygeo, zgeo;
 
-	sid=lst(jdguess,longit);
-	accumoon(jdguess,lat,sid,elevsea,&geora,&geodec,&geodist,
-				&ra,&dec,&dist);
-	ha = lst(jdguess,longit) - ra;
-	alt2 = altit(dec,ha,lat,&az);
-	jdguess = jdguess + del;
-	sid = lst(jdguess,longit);
-	accumoon(jdguess,lat,sid,elevsea,&geora,&geodec,&geodist,
-				&ra,&dec,&dist);
-	alt3 = altit(dec,(sid - ra),lat,&az);
-	err = alt3 - alt;
-	deriv = (alt3 - alt2) / del;
-	while((fabs(err) > 0.1) && (i < 10)) {
-		jdguess = jdguess - err/deriv;
-		sid=lst(jdguess,longit);
-		accumoon(jdguess,lat,sid,elevsea,&geora,&geodec,&geodist,
-				&ra,&dec,&dist);
-		alt3 = altit(dec,(sid - ra),lat,&az);
-		err = alt3 - alt;
-		i++;
-		if(i == 9) oprntf("Moonrise or -set calculation not converging!!...\n");
+	if(ctx->eph == NULL ||
+	   skyeph_eval(ctx->eph,SKYEPH_SUN,jd + etcorr(jd)/SEC_IN_DAY,
+		v,(double *) NULL) != 0) {
+		accusun(jd,lst,geolat,ra,dec,dist,topora,topodec,x,y,z);
+		return;
 	}
-	if(i >= 9) jdguess = -1000.;
-	jdout = jdguess;
-	return(jdout);
-}
 
-double jd_sun_alt(alt,jdguess,lat,longit)
+	R = sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+	*dist = R;
+	*x = v[0] / R;  /* geocentric */
+	*y = v[1] / R;
+	*z = v[2] / R;
 
-	double alt,jdguess,lat,longit;
+	geocent(lst,geolat,0.,&xgeo,&ygeo,&zgeo);
 
-{
-	/* returns jd at which sun is at a given
-	altitude, given jdguess as a starting point. Uses
-	low-precision sun, which is plenty good enough. */
+	xtop = *x - xgeo*EQUAT_RAD/ASTRO_UNIT;
+	ytop = *y - ygeo*EQUAT_RAD/ASTRO_UNIT;
+	ztop = *z - zgeo*EQUAT_RAD/ASTRO_UNIT;
 
-	double jdout;
-	double deriv, err, del = 0.002;
-	double ra,dec,ha,alt2,alt3,az;
-	short i = 0;
+	topodist = sqrt(xtop*xtop + ytop*ytop + ztop*ztop);
 
-	/* first guess */
-
-	lpsun(jdguess,&ra,&dec);
-	ha = lst(jdguess,longit) - ra;
-	alt2 = altit(dec,ha,lat,&az);
-	jdguess = jdguess + del;
-	lpsun(jdguess,&ra,&dec);
-	alt3 = altit(dec,(lst(jdguess,longit) - ra),lat,&az);
-	err = alt3 - alt;
-	deriv = (alt3 - alt2) / del;
-	while((fabs(err) > 0.1) && (i < 10)) {
-		jdguess = jdguess - err/deriv;
-		lpsun(jdguess,&ra,&dec);
-		alt3 = altit(dec,(lst(jdguess,longit) - ra),lat,&az);
-		err = alt3 - alt;
-		i++;
-		if(i == 9) oprntf("Sunrise, set, or twilight calculation not converging!\n");
-	}
-	if(i >= 9) jdguess = -1000.;
-	jdout = jdguess;
-	return(jdout);
+	l = xtop / (topodist);
+	m = ytop / (topodist);
+	n = ztop / (topodist);
+
+	*topora = atan_circ(l,m) * HRS_IN_RADIAN;
+	*topodec = asin(n) * DEG_IN_RADIAN;
+
+	*ra = atan_circ(*x,*y) * HRS_IN_RADIAN;
+	*dec = asin(*z) * DEG_IN_RADIAN;
+
+	*x = *x * R * -1;  /* heliocentric */
+	*y = *y * R * -1;
+	*z = *z * R * -1;
 }
 
-float ztwilight(alt)
-	double alt;
-{
+double body_alt_r(ctx,body,jd,lat,longit,elevsea)
 
-/* evaluates a polynomial expansion for the approximate brightening
-   in magnitudes of the zenith in twilight compared to its
-   value at full night, as function of altitude of the sun (in degrees).
-   To get this expression I looked in Meinel, A.,
-   & Meinel, M., "Sunsets, Twilight, & Evening Skies", Cambridge U.
-   Press, 1983; there's a graph on p. 38 showing the decline of
-   zenith twilight.  I read points off this graph and fit them with a
-   polynomial; I don't even know what band there data are for! */
-/* Comparison with Ashburn, E. V. 1952, JGR, v.57, p.85 shows that this
-   is a good fit to his B-band measurements.  */
+	struct skycalc_ctx *ctx;
+	int body;
+	double jd,lat,longit,elevsea;
 
-	float y, val;
+/* altitude (degrees) of the sun (body EVENT_SUN; low-precision, which
+   is plenty good enough for rise, set and twilight) or of the moon
+   (EVENT_MOON; topocentric, high-precision, through accumoon_r). */
 
-	y = (-1.* alt - 9.0) / 9.0;  /* my polynomial's argument...*/
-	val = ((2.0635175 * y + 1.246602) * y - 9.4084495)*y + 6.132725;
-	return(val);
+{
+	double ra,dec,dist,geora,geodec,geodist,sid,az;
+
+	sid = lst_r(ctx,jd,longit);
+	if(body == EVENT_SUN) lpsun(jd,&ra,&dec);
+	else accumoon_r(ctx,jd,lat,sid,elevsea,&geora,&geodec,&geodist,
+				&ra,&dec,&dist);
+	return(altit(dec,(sid - ra),lat,&az));
 }
 
+double alt_event_root_r(ctx,body,alt,jda,jdb,fa,fb,lat,longit,elevsea,tol)
 
-void find_dst_bounds(yr,stdz,use_dst,jdb,jde)
+	struct skycalc_ctx *ctx;
+	int body;
+	double alt,jda,jdb,fa,fb,lat,longit,elevsea,tol;
 
-	short yr;
-	double stdz;
-	short use_dst;
-  	double *jdb,*jde;
+/* refines a crossing of altitude alt bracketed by jda and jdb, at
+   which the body's altitude less alt is fa and fb (of opposite sign),
+   to within tol days.  Brent's method -- inverse quadratic
+   interpolation where it behaves, bisection where it doesn't -- so it
+   can't fail to converge, and it usually takes 4 or 5 evaluations. */
 
 {
-	/* finds jd's at which daylight savings time begins
-	    and ends.  The parameter use_dst allows for a number
-	    of conventions, namely:
-		0 = don't use it at all (standard time all the time)
-		1 = use USA convention (1st Sun in April to
-		     last Sun in Oct after 1986; last Sun in April before)
-		2 = use Spanish convention (for Canary Islands)
-		-1 = use Chilean convention (CTIO).
-		-2 = Australian convention (for AAT).
-	    Negative numbers denote sites in the southern hemisphere,
-	    where jdb and jde are beginning and end of STANDARD time for
-	    the year.
-	    It's assumed that the time changes at 2AM local time; so
-	    when clock is set ahead, time jumps suddenly from 2 to 3,
-	    and when time is set back, the hour from 1 to 2 AM local
-	    time is repeated.  This could be changed in code if need be. */
-
-	struct date_time trial;
-
-	if((use_dst == 1) || (use_dst == 0)) {
-	    /* USA Convention, and including no DST to be defensive */
-	    /* Note that this ignores various wrinkles such as the
-		brief Nixon administration flirtation with year-round DST,
-		the extended DST of WW II, and so on. */
-		trial.y = yr;
-		trial.mo = 4;
-		if(yr >= 1986) trial.d = 1;
-		else trial.d = 30;
-		trial.h = 2;
-		trial.mn = 0;
-		trial.s = 0;
-
-		/* Find first Sunday in April for 1986 on ... */
-		if(yr >= 1986)
-			while(day_of_week(date_to_jd(trial)) != 6)
-				trial.d++;
-
-		/* Find last Sunday in April for pre-1986 .... */
-		else while(day_of_week(date_to_jd(trial)) != 6)
-				trial.d--;
-
-		*jdb = date_to_jd(trial) + stdz/24.;
-
-		/* Find last Sunday in October ... */
-		trial.mo = 10;
-		trial.d = 31;
-		while(day_of_week(date_to_jd(trial)) != 6) {
-			trial.d--;
-		}
-		*jde = date_to_jd(trial) + (stdz - 1.)/24.;
-	}
-	else if (use_dst == 2) {  /* Spanish, for Canaries */
-		trial.y = yr;
-		trial.mo = 3;
-		trial.d = 31;
-		trial.h = 2;
-		trial.mn = 0;
-		trial.s = 0;
-
-		while(day_of_week(date_to_jd(trial)) != 6) {
-			trial.d--;
-		}
-		*jdb = date_to_jd(trial) + stdz/24.;
-		trial.mo = 9;
-		trial.d = 30;
-		while(day_of_week(date_to_jd(trial)) != 6) {
-			trial.d--;
-		}
-		*jde = date_to_jd(trial) + (stdz - 1.)/24.;
-	}
-	else if (use_dst == -1) {  /* Chilean, for CTIO, etc.  */
-	   /* off daylight 2nd Sun in March, onto daylight 2nd Sun in October */
-		trial.y = yr;
-		trial.mo = 3;
-		trial.d = 8;  /* earliest possible 2nd Sunday */
-		trial.h = 2;
-		trial.mn = 0;
-		trial.s = 0;
-
-		while(day_of_week(date_to_jd(trial)) != 6) {
-			trial.d++;
-		}
-		*jdb = date_to_jd(trial) + (stdz - 1.)/24.;
-			/* note jdb is beginning of STANDARD time in south,
-				hence use stdz - 1. */
-		trial.mo = 10;
-		trial.d = 8;
-		while(day_of_week(date_to_jd(trial)) != 6) {
-			trial.d++;
-		}
-		*jde = date_to_jd(trial) + stdz /24.;
-	}
-	else if (use_dst == -2) {  /* For Anglo-Australian Telescope  */
-	   /* off daylight 1st Sun in March, onto daylight last Sun in October */
-		trial.y = yr;
-		trial.mo = 3;
-		trial.d = 1;  /* earliest possible 1st Sunday */
-		trial.h = 2;
-		trial.mn = 0;
-		trial.s = 0;
-
-		while(day_of_week(date_to_jd(trial)) != 6) {
-			trial.d++;
-		}
-		*jdb = date_to_jd(trial) + (stdz - 1.)/24.;
-			/* note jdb is beginning of STANDARD time in south,
-				hence use stdz - 1. */
-		trial.mo = 10;
-		trial.d = 31;
-		while(day_of_week(date_to_jd(trial)) != 6) {
-			trial.d--;
+	double a = jda, b = jdb, c, fc, d, e, tol1, xm;
+	double p, q, r, s2, min1, min2;
+	short i;
+
+	c = b;
+	fc = fb;
+	d = e = b - a;
+	for(i = 0; i < 60; i++) {
+		if((fb > 0. && fc > 0.) || (fb < 0. && fc < 0.)) {
+			c = a;   /* keep the root between b and c */
+			fc = fa;
+			d = e = b - a;
+		}
+		if(fabs(fc) < fabs(fb)) {  /* b the best guess so far */
+			a = b;
+			b = c;
+			c = a;
+			fa = fb;
+			fb = fc;
+			fc = fa;
+		}
+		tol1 = 2.0e-16 * fabs(b) + 0.5 * tol;
+		xm = 0.5 * (c - b);
+		if(fabs(xm) <= tol1 || fb == 0.) return(b);
+		if(fabs(e) >= tol1 && fabs(fa) > fabs(fb)) {
+			s2 = fb / fa;
+			if(a == c) {   /* secant */
+				p = 2. * xm * s2;
+				q = 1. - s2;
+			}
+			else {   /* inverse quadratic */
+				q = fa / fc;
+				r = fb / fc;
+				p = s2 * (2. * xm * q * (q - r) - (b - a) * (r - 1.));
+				q = (q - 1.) * (r - 1.) * (s2 - 1.);
+			}
+			if(p > 0.) q = -q;
+			p = fabs(p);
+			min1 = 3. * xm * q - fabs(tol1 * q);
+			min2 = fabs(e * q);
+			if(2. * p < (min1 < min2 ? min1 : min2)) {
+				e = d;
+				d = p / q;
+			}
+			else {  /* interpolation no good -- bisect */
+				d = xm;
+				e = d;
+			}
+		}
+		else {
+			d = xm;
+			e = d;
 		}
-		*jde = date_to_jd(trial) + stdz /24.;
+		a = b;
+		fa = fb;
+		if(fabs(d) > tol1) b = b + d;
+		else b = b + (xm > 0. ? tol1 : -tol1);
+		fb = body_alt_r(ctx,body,b,lat,longit,elevsea) - alt;
 	}
+	return(b);
 }
 
+int alt_sample_r(ctx,body,jd1,jd2,lat,longit,elevsea,jd,altv,maxsamp)
 
-double zone(use_dst,stdz,jd,jdb,jde)
+	struct skycalc_ctx *ctx;
+	int body;
+	double jd1,jd2,lat,longit,elevsea,*jd,*altv;
+	int maxsamp;
 
-	short use_dst;
-	double stdz,jd,jdb,jde;
+/* tabulates the body's altitude every EVENT_STEP from jd1 through
+   jd2 (or maxsamp points, if fewer) for alt_crossings_sampled_r;
+   returns the number of points. */
 
 {
-	/* Returns zone time offset when standard time zone is stdz,
-	   when daylight time begins (for the year) on jdb, and ends
-	   (for the year) on jde.  This is parochial to the northern
-	   hemisphere.  */
-	/* Extension -- specifying a negative value of use_dst reverses
-	   the logic for the Southern hemisphere; then DST is assumed for
-	   the Southern hemisphere summer (which is the end and beginning
-	   of the year. */
-
-	if(use_dst == 0) return(stdz);
-	else if((jd > jdb) && (jd < jde) && (use_dst > 0)) return(stdz-1.);
-	   /* next line .. use_dst < 0 .. for Southern Hemisphere sites. */
-	else if(((jd < jdb) || (jd > jde)) && (use_dst < 0)) return(stdz-1.);
-	else return(stdz);
+	int i, n;
+
+	n = (int) ceil((jd2 - jd1) / EVENT_STEP) + 1;
+	if(n < 2) n = 2;
+	if(n > maxsamp) n = maxsamp;
+	for(i = 0; i < n; i++) {
+		jd[i] = (i == n - 1) ? jd2 : jd1 + i * EVENT_STEP;
+		altv[i] = body_alt_r(ctx,body,jd[i],lat,longit,elevsea);
+	}
+	return(n);
 }
 
-double true_jd(date, use_dst, enter_ut, night_date, stdz)
-
-/* takes the values in the date-time structure, the standard time
-   zone (in hours west), the prevailing conventions for date and
-   time entry, and returns the value of the true julian date. */
+int alt_crossings_sampled_r(ctx,body,alt,jd,altv,nsamp,lat,longit,elevsea,
+	tol,events,maxevents)
+
+	struct skycalc_ctx *ctx;
+	int body;
+	double alt,*jd,*altv;
+	int nsamp;
+	double lat,longit,elevsea,tol;
+	struct alt_crossing *events;
+	int maxevents;
+
+/* finds every crossing of altitude alt within a table from
+   alt_sample_r, refining each to tol days, and puts them in events
+   in time order.  Besides the plain changes of sign, each turning
+   point of the table is checked with a parabola through its three
+   points, so that a rise and set closer together than the sampling
+   (the sun grazing the horizon at high latitude) aren't missed.
+   The same table serves any number of altitudes.  Returns the
+   number of crossings found, of which at most maxevents are stored. */
 
-	struct date_time date;
-	short use_dst, enter_ut, night_date;
-	double stdz;
 {
-	double jd, jdb, jde, test;
-
-	if(enter_ut == 0) {
-           find_dst_bounds(date.y,stdz,use_dst,&jdb,&jde);
-	   jd = date_to_jd(date);
-	   if((night_date == 1)  && (date.h < 12)) jd = jd + 1.;
-	   if(use_dst != 0)  {  /* check at time changes */
-		test = jd + stdz/24. - jdb;
-		if((test > 0.) && (test < 0.041666666))   {
-			/* 0.0416 = 1 hr; nonexistent time */
-			oprntf("Error in true_jd -- nonexistent input time during std->dst change.\n");
-			oprntf("Specify as 1 hour later!\n");
-			return(-1.); /* signal of nonexistent time */
+	int i, n = 0;
+	double f0, f1, f2, den, tv, fv;
+
+	for(i = 0; i < nsamp - 1; i++) {
+		f0 = altv[i] - alt;
+		f1 = altv[i+1] - alt;
+		if(f0 == 0.) {
+			if(i == 0 || (altv[i-1] - alt) * f1 < 0.) { /* touches */
+				if(n < maxevents) {
+					events[n].jd = jd[i];
+					events[n].rising = (f1 > 0.);
+				}
+				n++;
+			}
+			continue;
 		}
-		test = jd + stdz/24. - jde;
-		if((test > 0.) && (test < 0.041666666))   {
-			oprntf("WARNING ... ambiguous input time during dst->std change!\n");
+		if(f0 * f1 < 0.) {
+			if(n < maxevents) {
+				events[n].jd = alt_event_root_r(ctx,body,alt,
+				   jd[i],jd[i+1],f0,f1,lat,longit,elevsea,tol);
+				events[n].rising = (f1 > f0);
+			}
+			n++;
+			continue;
 		}
-	   }
-	   jd = jd + zone(use_dst,stdz,(jd+stdz/24.),jdb,jde)/24.;
-			/* effect should be to default to standard time. */
-        }
-	else jd = date_to_jd(date);
-
-	return(jd);
+		/* no change of sign here -- see if a turning point at
+		   i+1 pokes through between i and i+2. */
+		if(i + 2 >= nsamp) continue;
+		f2 = altv[i+2] - alt;
+		if(f1 * f2 <= 0.) continue;  /* counted on the next step */
+		if((f1 - f0) * (f2 - f1) >= 0.) continue;  /* monotonic */
+		den = f0 - 2. * f1 + f2;
+		if(den == 0.) continue;
+		tv = jd[i+1] + 0.5 * (jd[i+2] - jd[i+1]) * (f0 - f2) / den;
+		if(tv <= jd[i] || tv >= jd[i+2]) continue;
+		fv = body_alt_r(ctx,body,tv,lat,longit,elevsea) - alt;
+		if(fv * f1 >= 0.) continue;
+		if(n < maxevents) {
+			events[n].jd = alt_event_root_r(ctx,body,alt,
+			   jd[i],tv,f0,fv,lat,longit,elevsea,tol);
+			events[n].rising = (fv > f0);
+		}
+		n++;
+		if(n < maxevents) {
+			events[n].jd = alt_event_root_r(ctx,body,alt,
+			   tv,jd[i+2],fv,f2,lat,longit,elevsea,tol);
+			events[n].rising = (f2 > fv);
+		}
+		n++;
+		i++;   /* both crossings lie before jd[i+2] */
+	}
+	if(nsamp > 1 && altv[nsamp-1] == alt &&
+	   (altv[nsamp-2] - alt) != 0.) {   /* lands on the last point */
+		if(n < maxevents) {
+			events[n].jd = jd[nsamp-1];
+			events[n].rising = (altv[nsamp-1] > altv[nsamp-2]);
+		}
+		n++;
+	}
+	return(n);
 }
 
+int alt_crossings_r(ctx,body,alt,jd1,jd2,lat,longit,elevsea,tol,
+	events,maxevents)
 
-void print_tz(jd,use,jdb,jde,zabr)
+	struct skycalc_ctx *ctx;
+	int body;
+	double alt,jd1,jd2,lat,longit,elevsea,tol;
+	struct alt_crossing *events;
+	int maxevents;
 
-	double jd;
-	short use;
-	double jdb,jde;
-	char zabr;
+/* every time between jd1 and jd2 at which the sun (EVENT_SUN) or
+   moon (EVENT_MOON) crosses altitude alt, each good to tol days, in
+   time order in events.  Returns the number found (of which at most
+   maxevents are stored) -- zero if it stays above or below -- or -1
+   if the window is too long (more than EVENT_MAXSAMP samples). */
 
 {
-	/* prints correct time abbreviation, given zabr as the
-	   single character abbreviation for the time zone,
-	   "D" or "S" depending on daylight or standard (dst
-	    begins at jdb, ends at jde) and current jd. */
+	double jd[EVENT_MAXSAMP], altv[EVENT_MAXSAMP];
+	int nsamp;
+
+	if((jd2 - jd1) / EVENT_STEP > EVENT_MAXSAMP - 1) return(-1);
+	nsamp = alt_sample_r(ctx,body,jd1,jd2,lat,longit,elevsea,jd,altv,
+		EVENT_MAXSAMP);
+	return(alt_crossings_sampled_r(ctx,body,alt,jd,altv,nsamp,
+		lat,longit,elevsea,tol,events,maxevents));
+}
 
-	oprntf(" %c", zabr);
-	if((jd > jdb) && (jd < jde) && (use > 0)) oprntf("D");
-	  else if(((jd < jdb) || (jd > jde)) && (use < 0)) oprntf("D");
-	  else oprntf("S");
-	oprntf("T");
+int alt_crossings(body,alt,jd1,jd2,lat,longit,elevsea,tol,events,maxevents)
+
+	int body;
+	double alt,jd1,jd2,lat,longit,elevsea,tol;
+	struct alt_crossing *events;
+	int maxevents;
+{
+	return(alt_crossings_r(&skycalc_default_ctx,body,alt,jd1,jd2,lat,
+		longit,elevsea,tol,events,maxevents));
 }
 
-void xyz_cel(x, y, z, r, d)
+double jd_body_alt_r(ctx,body,alt,jdguess,lat,longit,elevsea,tol)
 
-	double x, y, z, *r, *d;
+	struct skycalc_ctx *ctx;
+	int body;
+	double alt,jdguess,lat,longit,elevsea,tol;
 
-     /* Cartesian coordinate triplet */
+/* the crossing of altitude alt nearest jdguess, to within tol days.
+   Steps out from jdguess in both directions by EVENT_STEP / 4 until
+   the altitude brackets alt, then refines with alt_event_root_r.
+   Returns -1000. if there's no crossing within EVENT_WINDOW days. */
 
 {
-   /* converts a coordinate triplet back to a standard ra and dec */
-
-   double mod;    /* modulus */
-   double xy;     /* component in xy plane */
-   short sign;    /* for determining quadrant */
-   double radian_ra, radian_dec;
+	double h, f0, fl, fr, fl1, fr1, jdl, jdr;
+	short k, kmax;
+
+	h = EVENT_STEP / 4.;
+	kmax = (short) (EVENT_WINDOW / h);
+	f0 = body_alt_r(ctx,body,jdguess,lat,longit,elevsea) - alt;
+	if(f0 == 0.) return(jdguess);
+	fl = fr = f0;
+	for(k = 1; k <= kmax; k++) {
+		jdr = jdguess + k * h;
+		fr1 = body_alt_r(ctx,body,jdr,lat,longit,elevsea) - alt;
+		if(fr * fr1 <= 0.)
+			return(alt_event_root_r(ctx,body,alt,jdr - h,jdr,fr,fr1,
+				lat,longit,elevsea,tol));
+		fr = fr1;
+		jdl = jdguess - k * h;
+		fl1 = body_alt_r(ctx,body,jdl,lat,longit,elevsea) - alt;
+		if(fl * fl1 <= 0.)
+			return(alt_event_root_r(ctx,body,alt,jdl,jdl + h,fl1,fl,
+				lat,longit,elevsea,tol));
+		fl = fl1;
+	}
+	return(-1000.);
+}
 
-   /* this taken directly from pl1 routine - no acos or asin available there,
-       as it is in c. Easier just to copy, though */
+double jd_moon_alt_r(ctx,alt,jdguess,lat,longit,elevsea)
 
-   mod = sqrt(x*x + y*y + z*z);
-   x = x / mod;
-   y = y / mod;
-   z = z / mod;   /* normalize 'em explicitly first. */
+	struct skycalc_ctx *ctx;
+	double alt,jdguess,lat,longit,elevsea;
 
-   xy = sqrt(x*x + y*y);
+{
+	/* returns jd at which moon is at a given
+	altitude, given jdguess as a starting point. In current version
+	uses high-precision moon -- execution time does not seem to be
+	excessive on modern hardware.  The context's moon_cheb table or
+	ephemeris file, if any, is used in place of accumoon (see
+	accumoon_r).  The crossing is bracketed and refined (see
+	jd_body_alt_r), so it can't fail to converge; -1000. means the
+	moon doesn't reach alt within EVENT_WINDOW of jdguess. */
+
+	return(jd_body_alt_r(ctx,EVENT_MOON,alt,jdguess,lat,longit,elevsea,
+		EVENT_TOL));
+}
 
-   if(xy < 1.0e-10) {
-      radian_ra = 0.;  /* too close to pole */
-      radian_dec = PI / 2.;
-      if(z < 0.) radian_dec = radian_dec * -1.;
-   }
-   else {
-      if(fabs(z/xy) < 3.) radian_dec = atan(z / xy);
-	 else if (z >= 0.) radian_dec = PI / 2. - atan(xy / z);
-	 else radian_dec = -1. * PI / 2. - atan(xy / z);
-      if(fabs(x) > 1.0e-10) {
-	 if(fabs(y / x) < 3.) radian_ra = atan(y / x);
-	 else if ((x * y ) >= 0.) radian_ra = PI / 2. - atan(x/y);
-	 else radian_ra = -1. *  PI / 2. - atan(x / y);
-      }
-      else {
-	 radian_ra = PI / 2.;
-	 if((x * y)<= 0.) radian_ra = radian_ra * -1.;
-      }
-      if(x <0.) radian_ra = radian_ra + PI ;
-      if(radian_ra < 0.) radian_ra = radian_ra + 2. * PI ;
-   }
+double jd_moon_alt(alt,jdguess,lat,longit,elevsea)
 
-   *r = radian_ra * HRS_IN_RADIAN;
-   *d = radian_dec * DEG_IN_RADIAN;
+	double alt,jdguess,lat,longit,elevsea;
 
+{
+	return(jd_moon_alt_r(&skycalc_default_ctx,alt,jdguess,lat,longit,elevsea));
 }
 
-void precrot(rorig, dorig, orig_epoch, final_epoch, rf, df)
+double jd_sun_alt(alt,jdguess,lat,longit)
 
-	double rorig, dorig, orig_epoch, final_epoch, *rf, *df;
+	double alt,jdguess,lat,longit;
 
-/*  orig_epoch, rorig, dorig  years, decimal hours, decimal degr.
-    final_epoch;
-    *rf, *df final ra and dec */
+{
+	/* returns jd at which sun is at a given
+	altitude, given jdguess as a starting point. Uses
+	low-precision sun, which is plenty good enough.  Bracketed
+	and refined as for the moon; -1000. if the sun doesn't reach
+	alt within EVENT_WINDOW of jdguess. */
 
-   /* Takes a coordinate pair and precesses it using matrix procedures
-      as outlined in Taff's Computational Spherical Astronomy book.
-      This is the so-called 'rigorous' method which should give very
-      accurate answers all over the sky over an interval of several
-      centuries.  Naked eye accuracy holds to ancient times, too.
-      Precession constants used are the new IAU1976 -- the 'J2000'
-      system. */
+	return(jd_body_alt_r(&skycalc_default_ctx,EVENT_SUN,alt,jdguess,
+		lat,longit,0.,EVENT_TOL));
+}
 
-{
-   double ti, tf, zeta, z, theta;  /* all as per  Taff */
-   double cosz, coszeta, costheta, sinz, sinzeta, sintheta;  /* ftns */
-   double p11, p12, p13, p21, p22, p23, p31, p32, p33;
-      /* elements of the rotation matrix */
-   double radian_ra, radian_dec;
-   double orig_x, orig_y, orig_z;
-   double fin_x, fin_y, fin_z;   /* original and final unit ectors */
+double moon_illum_r(ctx,jd,lat,longit,elevsea)
 
-   ti = (orig_epoch - 2000.) / 100.;
-   tf = (final_epoch - 2000. - 100. * ti) / 100.;
+	struct skycalc_ctx *ctx;
+	double jd,lat,longit,elevsea;
 
-   zeta = (2306.2181 + 1.39656 * ti + 0.000139 * ti * ti) * tf +
-    (0.30188 - 0.000344 * ti) * tf * tf + 0.017998 * tf * tf * tf;
-   z = zeta + (0.79280 + 0.000410 * ti) * tf * tf + 0.000205 * tf * tf * tf;
-   theta = (2004.3109 - 0.8533 * ti - 0.000217 * ti * ti) * tf
-     - (0.42665 + 0.000217 * ti) * tf * tf - 0.041833 * tf * tf * tf;
+/* illuminated fraction of the moon at jd, reckoned as print_tonight
+   does from the topocentric moon and low-precision sun. */
 
-   /* convert to radians */
+{
+	double ra,dec,dist,geora,geodec,geodist,rasun,decsun;
 
-   zeta = zeta / ARCSEC_IN_RADIAN;
-   z = z / ARCSEC_IN_RADIAN;
-   theta = theta / ARCSEC_IN_RADIAN;
+	accumoon_r(ctx,jd,lat,lst_r(ctx,jd,longit),elevsea,&geora,&geodec,&geodist,
+		&ra,&dec,&dist);
+	lpsun(jd,&rasun,&decsun);
+	return(0.5*(1.-cos(subtend(ra,dec,rasun,decsun))));
+}
 
-   /* compute the necessary trig functions for speed and simplicity */
+void night_pair_r(ctx,alt,jd,altv,nsamp,lat,longit,elevsea,eve,morn)
 
-   cosz = cos(z);
-   coszeta = cos(zeta);
-   costheta = cos(theta);
-   sinz = sin(z);
-   sinzeta = sin(zeta);
-   sintheta = sin(theta);
-
-   /* compute the elements of the precession matrix */
-
-   p11 = coszeta * cosz * costheta - sinzeta * sinz;
-   p12 = -1. * sinzeta * cosz * costheta - coszeta * sinz;
-   p13 = -1. * cosz * sintheta;
+	struct skycalc_ctx *ctx;
+	double alt,*jd,*altv;
+	int nsamp;
+	double lat,longit,elevsea;
+	struct night_event *eve, *morn;
 
-   p21 = coszeta * sinz * costheta + sinzeta * cosz;
-   p22 = -1. * sinzeta * sinz * costheta + coszeta * cosz;
-   p23 = -1. * sinz * sintheta;
+/* the evening (first setting) and morning (last rising) crossings of
+   alt by the sun in a table from alt_sample_r, for night_events_r.
+   A crossing that doesn't happen is given jd = -1. */
 
-   p31 = coszeta * sintheta;
-   p32 = -1. * sinzeta * sintheta;
-   p33 = costheta;
+{
+	struct alt_crossing ev[NIGHT_MAXCROSS];
+	int i, n;
+
+	eve->jd = morn->jd = -1.;
+	eve->illum = morn->illum = 0.;
+	n = alt_crossings_sampled_r(ctx,EVENT_SUN,alt,jd,altv,nsamp,
+		lat,longit,0.,EVENT_TOL,ev,NIGHT_MAXCROSS);
+	if(n > NIGHT_MAXCROSS) n = NIGHT_MAXCROSS;
+	for(i = 0; i < n; i++) {
+		if(!ev[i].rising) {
+			eve->jd = ev[i].jd;
+			break;
+		}
+	}
+	for(i = n - 1; i >= 0; i--) {
+		if(ev[i].rising && ev[i].jd > eve->jd) {
+			morn->jd = ev[i].jd;
+			break;
+		}
+	}
+	if(eve->jd > 0.) eve->illum = moon_illum_r(ctx,eve->jd,lat,longit,elevsea);
+	if(morn->jd > 0.) morn->illum = moon_illum_r(ctx,morn->jd,lat,longit,elevsea);
+}
 
-   /* transform original coordinates */
+void night_events_r(ctx,jdmid,lat,longit,elevsea,horiz,custom,ncustom,ne)
 
-   radian_ra = rorig / HRS_IN_RADIAN;
-   radian_dec = dorig / DEG_IN_RADIAN;
+	struct skycalc_ctx *ctx;
+	double jdmid,lat,longit,elevsea,horiz,*custom;
+	int ncustom;
+	struct night_events *ne;
 
-   orig_x = cos(radian_dec) * cos(radian_ra);
-   orig_y = cos(radian_dec) *sin(radian_ra);
-   orig_z = sin(radian_dec);
-      /* (hard coded matrix multiplication ...) */
-   fin_x = p11 * orig_x + p12 * orig_y + p13 * orig_z;
-   fin_y = p21 * orig_x + p22 * orig_y + p23 * orig_z;
-   fin_z = p31 * orig_x + p32 * orig_y + p33 * orig_z;
+/* Every almanac event of the night centered on jdmid (the UT of local
+   midnight, as in print_tonight) -- sunset and sunrise (sun at
+   -(0.83 + horiz)), 6, 12, 13 and 18 degree twilights, the sun at
+   each of ncustom (up to NIGHT_MAXCUSTOM) further altitudes custom[],
+   and moonrise and moonset (also at -(0.83 + horiz)) -- with the
+   moon's illuminated fraction at each, in *ne.  Events are searched
+   for from noon to noon.
 
-   /* convert back to spherical polar coords */
+   The sun's and moon's altitudes are tabulated once over the night
+   and all the thresholds are found in the same tables (see
+   alt_crossings_sampled_r), so the whole almanac costs one sweep of
+   each plus a few evaluations per event.  Events that don't occur
+   have jd = -1. */
 
-   xyz_cel(fin_x, fin_y, fin_z, rf, df);
+{
+	double jd[EVENT_MAXSAMP], sunalt[EVENT_MAXSAMP], moonalt[EVENT_MAXSAMP];
+	struct alt_crossing ev[NIGHT_MAXCROSS];
+	int i, n, nsamp;
+
+	ne->jdmid = jdmid;
+	nsamp = alt_sample_r(ctx,EVENT_SUN,jdmid - 0.5,jdmid + 0.5,
+		lat,longit,0.,jd,sunalt,EVENT_MAXSAMP);
+
+	night_pair_r(ctx,-(0.83+horiz),jd,sunalt,nsamp,lat,longit,elevsea,
+		&ne->sunset,&ne->sunrise);
+	night_pair_r(ctx,-6.,jd,sunalt,nsamp,lat,longit,elevsea,
+		&ne->eve6,&ne->morn6);
+	night_pair_r(ctx,-12.,jd,sunalt,nsamp,lat,longit,elevsea,
+		&ne->eve12,&ne->morn12);
+	night_pair_r(ctx,-13.,jd,sunalt,nsamp,lat,longit,elevsea,
+		&ne->eve13,&ne->morn13);
+	night_pair_r(ctx,-18.,jd,sunalt,nsamp,lat,longit,elevsea,
+		&ne->eve18,&ne->morn18);
+
+	if(ncustom > NIGHT_MAXCUSTOM) ncustom = NIGHT_MAXCUSTOM;
+	if(ncustom < 0) ncustom = 0;
+	ne->ncustom = ncustom;
+	for(i = 0; i < ncustom; i++) {
+		ne->custom_alt[i] = custom[i];
+		night_pair_r(ctx,custom[i],jd,sunalt,nsamp,lat,longit,elevsea,
+			ne->custom_eve + i,ne->custom_morn + i);
+	}
 
+	/* the moon -- first rise and first set in the window */
+
+	alt_sample_r(ctx,EVENT_MOON,jdmid - 0.5,jdmid + 0.5,
+		lat,longit,elevsea,jd,moonalt,EVENT_MAXSAMP);
+	n = alt_crossings_sampled_r(ctx,EVENT_MOON,-(0.83+horiz),jd,moonalt,
+		nsamp,lat,longit,elevsea,EVENT_TOL,ev,NIGHT_MAXCROSS);
+	if(n > NIGHT_MAXCROSS) n = NIGHT_MAXCROSS;
+	ne->moonrise.jd = ne->moonset.jd = -1.;
+	ne->moonrise.illum = ne->moonset.illum = 0.;
+	for(i = 0; i < n; i++) {
+		if(ev[i].rising && ne->moonrise.jd < 0.)
+			ne->moonrise.jd = ev[i].jd;
+		if(!ev[i].rising && ne->moonset.jd < 0.)
+			ne->moonset.jd = ev[i].jd;
+	}
+	if(ne->moonrise.jd > 0.) ne->moonrise.illum =
+		moon_illum_r(ctx,ne->moonrise.jd,lat,longit,elevsea);
+	if(ne->moonset.jd > 0.) ne->moonset.illum =
+		moon_illum_r(ctx,ne->moonset.jd,lat,longit,elevsea);
 }
 
-void mass_precess() {
-
-    double rorig = 1., dorig, orig_epoch, final_epoch, rf, df,
-            mura = 0., mudec = 0., dt;
-    short do_proper = 0;
+void night_events(jdmid,lat,longit,elevsea,horiz,custom,ncustom,ne)
 
-    printf("Mass precession.  The '=' command does precessions in a pinch, but\n");
-    printf("the present command is convenient for doing several (all with same\n");
-    printf("starting and ending epochs).  This routine does not affect parameters\n");
-    printf("in the rest of the program.\n\n");
-    printf("Type 1 if you need proper motions (They're a pain!), or 0:");
-    scanf("%hd",&do_proper);
-    if(do_proper == 1) {
-	printf("\nA proper motion correction will be included -- it's a simple\n");
-	printf("linear correction (adds mu * dt to coordinate).  Proper motion\n");
-	printf("itself is NOT rigorously transformed (as in B1950->J2000, which\n");
-	printf("involves a small change of inertial reference frame!)\n\n");
-    }
-    printf("Give epoch to precess from:");
-    scanf("%lf",&orig_epoch);
-    printf("Give epoch to precess to:");
-    scanf("%lf",&final_epoch);
-    dt = final_epoch - orig_epoch;
-    while(rorig >= 0.) {
-	printf("\nGive RA for %7.2f (h m s, -1 0 0 to exit):",orig_epoch);
-        rorig = get_coord();
-        if(rorig < 0.) {
-		printf("Exiting precession routine.  Type '?' if you want a menu.\n");
-		return;
-        }
-        printf("Give dec (d m s):");
-        dorig = get_coord();
-	if(do_proper == 1) get_pm(dorig,&mura,&mudec);
-        precrot(rorig,dorig,orig_epoch,final_epoch,&rf,&df);
-	rf = rf + mura * dt / 3600.;
-        df = df + mudec * dt / 3600.;
-        oprntf("\n\n %7.2f : RA = ",orig_epoch);
-        put_coords(rorig,4);
-        oprntf(", dec = ");
-        put_coords(dorig,3);
-        oprntf("\n %7.2f : RA = ",final_epoch);
-        put_coords(rf,4);
-        oprntf(", dec = ");
-        put_coords(df,3);
-        if(do_proper == 1) oprntf("\n RA p.m. = %8.4f sec/yr, dec = %8.3f arcsec/yr",mura,mudec);
-	oprntf("\n");
-    }
+	double jdmid,lat,longit,elevsea,horiz,*custom;
+	int ncustom;
+	struct night_events *ne;
+{
+	night_events_r(&skycalc_default_ctx,jdmid,lat,longit,elevsea,horiz,
+		custom,ncustom,ne);
 }
 
-void galact(ra,dec,epoch,glong,glat)
+void almanac_key_set(key,jdmid,lat,longit,elevsea,horiz,custom,ncustom)
 
-	double ra,dec,epoch,*glong,*glat;
+	struct almanac_key *key;
+	double jdmid,lat,longit,elevsea,horiz,*custom;
+	int ncustom;
+
+/* fills in a cache key, zeroing every unused byte so that keys can be
+   hashed and compared as plain memory. */
 
 {
-	/* Homebrew algorithm for 3-d Euler rotation into galactic.
-	   Perfectly rigorous, and with reasonably accurate input
-	   numbers derived from original IAU definition of galactic
-	   pole (12 49, +27.4, 1950) and zero of long (at PA 123 deg
-	   from pole.) */
-
-	double  p11= -0.066988739415,
-		p12= -0.872755765853,
-		p13= -0.483538914631,
-		p21=  0.492728466047,
-		p22= -0.450346958025,
-		p23=  0.744584633299,
-		p31= -0.867600811168,
-		p32= -0.188374601707,
-		p33=  0.460199784759;  /* derived from Euler angles of
-		theta   265.610844031 deg (rotates x axis to RA of galact center),
-		phi     28.9167903483 deg (rotates x axis to point at galact cent),
-		omega   58.2813466094 deg (rotates z axis to point at galact pole) */
+	int i;
 
-	double r1950,d1950,
-		x0,y0,z0,x1,y1,z1,
-		check;
+	memset(key,0,sizeof(struct almanac_key));
+	if(ncustom > NIGHT_MAXCUSTOM) ncustom = NIGHT_MAXCUSTOM;
+	if(ncustom < 0) ncustom = 0;
+	key->jdmid = jdmid;
+	key->lat = lat;
+	key->longit = longit;
+	key->elevsea = elevsea;
+	key->horiz = horiz;
+	key->ncustom = ncustom;
+	for(i = 0; i < ncustom; i++) key->custom[i] = custom[i];
+}
 
-/*   EXCISED CODE .... creates matrix from Euler angles. Resurrect if
-     necessary to create new Euler angles for better precision.
-     Program evolved by running and calculating angles,then initializing
-     them to the values they will always have, thus saving space and time.
+unsigned long almanac_hash(key)
 
-	cosphi = cos(phi); and so on
-	p11 = cosphi * costhet;
-	p12 = cosphi * sinthet;
-	p13 = -1. * sinphi;
-	p21 = sinom*sinphi*costhet - sinthet*cosom;
-	p22 = cosom*costhet + sinthet*sinphi*sinom;
-	p23 = sinom*cosphi;
-	p31 = sinom*sinthet + cosom*sinphi*costhet;
-	p32 = cosom*sinphi*sinthet - costhet*sinom;
-	p33 = cosom * cosphi;
+	struct almanac_key *key;
 
-	printf("%15.10f %15.10f %15.10f\n",p11,p12,p13);
-	printf("%15.10f %15.10f %15.10f\n",p21,p22,p23);
-	printf("%15.10f %15.10f %15.10f\n",p31,p32,p33);
+/* FNV-1a over the bytes of the key. */
 
-	check = p11*(p22*p33-p32*p23) - p12*(p21*p33-p31*p23) +
-		p13*(p21*p32-p22*p31);
-	printf("Check: %lf\n",check);  check determinant .. ok
+{
+	unsigned char *c = (unsigned char *) key;
+	unsigned long h = 2166136261UL;
+	size_t i;
 
-    END OF EXCISED CODE..... */
+	for(i = 0; i < sizeof(struct almanac_key); i++) {
+		h = h ^ c[i];
+		h = (h * 16777619UL) & 0xffffffffUL;
+	}
+	return(h);
+}
 
-	/* precess to 1950 */
-	precrot(ra,dec,epoch,1950.,&r1950,&d1950);
-	r1950 = r1950 / HRS_IN_RADIAN;
-	d1950 = d1950 / DEG_IN_RADIAN;
+int almanac_cache_init(ac,nslots)
 
-	/* form direction cosines */
-	x0 = cos(r1950) * cos(d1950);
-	y0 = sin(r1950) * cos(d1950);
-	z0 = sin(d1950);
+	struct almanac_cache *ac;
+	int nslots;
 
-	/* rotate 'em */
-	x1 = p11*x0 + p12*y0 + p13*z0;
-	y1 = p21*x0 + p22*y0 + p23*z0;
-	z1 = p31*x0 + p32*y0 + p33*z0;
+/* sets up an empty almanac cache with room for about nslots nights
+   before it has to grow (it grows by itself).  Returns 0, or -1 if no
+   memory.  (A zeroed struct almanac_cache also works, starting at 16
+   slots.)  A cache is not to be shared between threads without a lock
+   of the caller's. */
 
-	/* translate to spherical polars for Galactic coords. */
-	*glong = atan_circ(x1,y1)*DEG_IN_RADIAN;
-	*glat = asin(z1)*DEG_IN_RADIAN;
+{
+	int cap = 16;
+
+	while(cap < nslots + nslots / 3) cap = cap * 2;
+	ac->entries = (struct almanac_entry *)
+		calloc((size_t) cap, sizeof(struct almanac_entry));
+	ac->cap = (ac->entries == NULL) ? 0 : cap;
+	ac->n = 0;
+	ac->hits = ac->misses = 0;
+	return((ac->entries == NULL) ? -1 : 0);
 }
 
-void eclipt(ra,dec,epoch,jd,curep,eclong,eclat)
+void almanac_cache_free(ac)
 
-           double ra,dec,epoch,jd,*curep,*eclong,*eclat;
+	struct almanac_cache *ac;
 
- /* ra in decimal hrs, other coords in dec. deg. */
+{
+	if(ac->entries != NULL) free(ac->entries);
+	ac->entries = NULL;
+	ac->cap = ac->n = 0;
+}
 
-/* converts ra and dec to ecliptic coords -- precesses to current
-   epoch first (and hands current epoch back for printing.)  */
+struct almanac_entry *almanac_slot(ac,key)
+
+	struct almanac_cache *ac;
+	struct almanac_key *key;
+
+/* the slot holding key, or the empty one where it belongs (linear
+   probing; the table is never more than 3/4 full). */
 
 {
-	double incl, T;
-	double racur, decur;
-	double x0,y0,z0,x1,y1,z1;
+	unsigned long i;
 
-	T = (jd - J2000)/36525.;  /* centuries since J2000 */
-	*curep = 2000. + (jd - J2000) / 365.25;
+	i = almanac_hash(key) & (unsigned long) (ac->cap - 1);
+	while(ac->entries[i].used &&
+	      memcmp(&ac->entries[i].key,key,sizeof(struct almanac_key)) != 0)
+		i = (i + 1) & (unsigned long) (ac->cap - 1);
+	return(ac->entries + i);
+}
 
-	incl = (23.439291 + T * (-0.0130042 - 0.00000016 * T))/DEG_IN_RADIAN;
-		/* 1992 Astron Almanac, p. B18, dropping the
-		   cubic term, which is 2 milli-arcsec! */
+int almanac_insert(ac,key,ne)
 
-	precrot(ra,dec,epoch,*curep,&racur,&decur);
-	racur = racur / HRS_IN_RADIAN;
-	decur = decur / DEG_IN_RADIAN;
+	struct almanac_cache *ac;
+	struct almanac_key *key;
+	struct night_events *ne;
 
-	x0=cos(decur)*cos(racur);
-	y0=cos(decur)*sin(racur);
-	z0=sin(decur);
+/* puts a record in the cache (replacing any with the same key),
+   doubling the table first if it is getting full.  Returns 0, or -1
+   if it needed to grow and couldn't. */
 
-	x1=x0;  /* doesn't change */
-	y1 = cos(incl)*y0 + sin(incl)*z0;
-	z1 = -1 * sin(incl)*y0 + cos(incl)*z0;
-	*eclong = atan_circ(x1,y1) * DEG_IN_RADIAN;
-	*eclat = asin(z1) * DEG_IN_RADIAN;
+{
+	struct almanac_entry *old, *slot;
+	int i, oldcap, oldn;
+	long hits, misses;
+
+	if(4 * (ac->n + 1) > 3 * ac->cap) {
+		old = ac->entries;
+		oldcap = ac->cap;
+		oldn = ac->n;
+		hits = ac->hits;
+		misses = ac->misses;
+		if(almanac_cache_init(ac,oldcap) != 0) {   /* doubles it */
+			ac->entries = old;   /* leave it as it was */
+			ac->cap = oldcap;
+			ac->n = oldn;
+			ac->hits = hits;
+			ac->misses = misses;
+			return(-1);
+		}
+		ac->hits = hits;
+		ac->misses = misses;
+		for(i = 0; i < oldcap; i++) {
+			if(!old[i].used) continue;
+			slot = almanac_slot(ac,&old[i].key);
+			*slot = old[i];
+			ac->n++;
+		}
+		free(old);
+	}
+	slot = almanac_slot(ac,key);
+	if(!slot->used) ac->n++;
+	slot->used = 1;
+	slot->key = *key;
+	slot->ne = *ne;
+	return(0);
 }
 
-double parang(ha,dec,lat)
+int almanac_get_r(ctx,ac,jdmid,lat,longit,elevsea,horiz,custom,ncustom,ne)
 
-	double ha,dec,lat;
+	struct skycalc_ctx *ctx;
+	struct almanac_cache *ac;
+	double jdmid,lat,longit,elevsea,horiz,*custom;
+	int ncustom;
+	struct night_events *ne;
 
- /* decimal hours, degrees, and degrees. */
+/* night_events_r for the night, from the cache if it's there (a hit)
+   and otherwise computed and remembered (a miss).  Nights are keyed
+   on all the arguments exactly, so jdmid should be reckoned the same
+   way each time.  Returns 1 on a hit, 0 on a miss. */
 
 {
-	/* finds the parallactic angle.  This is a little
-	   complicated (see Filippenko PASP 94, 715 (1982) */
-
-	double colat,codec,hacrit,sineta,denom;
+	struct almanac_key key;
+	struct almanac_entry *slot;
+
+	almanac_key_set(&key,jdmid,lat,longit,elevsea,horiz,custom,ncustom);
+	if(ac->cap > 0) {
+		slot = almanac_slot(ac,&key);
+		if(slot->used) {
+			*ne = slot->ne;
+			ac->hits++;
+			return(1);
+		}
+	}
+	night_events_r(ctx,jdmid,lat,longit,elevsea,horiz,custom,ncustom,ne);
+	almanac_insert(ac,&key,ne);
+	ac->misses++;
+	return(0);
+}
 
-	ha = ha / HRS_IN_RADIAN;
-	dec = dec / DEG_IN_RADIAN;
-	lat = lat / DEG_IN_RADIAN;
+int almanac_get(ac,jdmid,lat,longit,elevsea,horiz,custom,ncustom,ne)
 
-	/* Filippenko eqn 10 follows -- guarded against division by zero
-             at the exact zenith .... */
-	denom =
-	   sqrt(1.-pow((sin(lat)*sin(dec)+cos(lat)*cos(dec)*cos(ha)),2.));
-	if(denom != 0.)
-	    sineta = sin(ha)*cos(lat)/denom;
-	else sineta = 0.;
+	struct almanac_cache *ac;
+	double jdmid,lat,longit,elevsea,horiz,*custom;
+	int ncustom;
+	struct night_events *ne;
+{
+	return(almanac_get_r(&skycalc_default_ctx,ac,jdmid,lat,longit,elevsea,
+		horiz,custom,ncustom,ne));
+}
 
-	if(lat >= 0.) {
-		/* northern hemisphere case */
+int almanac_prefill_r(ctx,ac,jdmid,nnights,lat,longit,elevsea,horiz,
+	custom,ncustom)
 
-		/* If you're south of zenith, no problem. */
+	struct skycalc_ctx *ctx;
+	struct almanac_cache *ac;
+	double jdmid;
+	int nnights;
+	double lat,longit,elevsea,horiz,*custom;
+	int ncustom;
 
-		if(dec<lat) return (asin(sineta)*DEG_IN_RADIAN);
+/* computes and caches nnights nights starting with the one centered
+   on jdmid, at one-day steps.  (Where daylight saving time shifts
+   local midnight, key later lookups on the same jdmid + i.)
+   Nights already present aren't redone, and don't count as hits or
+   misses.  Returns the number of nights newly computed. */
 
-		else {
-			/* find critical hour angle -- where parallactic
-				angle becomes 90 deg.  After that,
-				take another root of expression. */
-			colat = PI /2. - lat;
-			codec = PI /2. - dec;
-			hacrit = 1.-pow(cos(colat),2.)/pow(cos(codec),2.);
-			hacrit = sqrt(hacrit)/sin(colat);
-			if(fabs(hacrit) <= 1.00) hacrit = asin(hacrit);
-			else oprntf("Error in parang..asin(>1)\n");
-			if(fabs(ha) > fabs(hacrit))
-				return(asin(sineta)*DEG_IN_RADIAN);
-				/* comes out ok at large hour angle */
-			else if (ha > 0)
-				return((PI - asin(sineta))*DEG_IN_RADIAN);
-			else return((-1.* PI - asin(sineta))*DEG_IN_RADIAN);
-		}
-	}
-	else {  /* Southern hemisphere case follows */
-		/* If you're north of zenith, no problem. */
-		if(dec>lat) {
-			if(ha >= 0)
-				return ((PI - asin(sineta))*DEG_IN_RADIAN);
-			else return(-1*(PI + asin(sineta)) * DEG_IN_RADIAN);
-		}
-		else {
-			/* find critical hour angle -- where parallactic
-				angle becomes 90 deg.  After that,
-				take another root of expression. */
-			colat = -1*PI/2. - lat;
-			codec = PI/2. - dec;
-			hacrit = 1.-pow(cos(colat),2.)/pow(cos(codec),2.);
-			hacrit = sqrt(hacrit)/sin(colat);
-			if(fabs(hacrit) <= 1.00) hacrit = asin(hacrit);
-			else oprntf("Error in parang..asin(>1)\n");
-			if(fabs(ha) > fabs(hacrit)) {
-				if(ha >= 0)
-				    return((PI - asin(sineta))*DEG_IN_RADIAN);
-				else return(-1. * (PI + asin(sineta))*DEG_IN_RADIAN);
-			}
-			else return(asin(sineta)*DEG_IN_RADIAN);
-		}
+{
+	struct almanac_key key;
+	struct night_events ne;
+	int i, nnew = 0;
+
+	for(i = 0; i < nnights; i++) {
+		almanac_key_set(&key,jdmid + i,lat,longit,elevsea,horiz,
+			custom,ncustom);
+		if(ac->cap > 0 && almanac_slot(ac,&key)->used) continue;
+		night_events_r(ctx,jdmid + i,lat,longit,elevsea,horiz,
+			custom,ncustom,&ne);
+		if(almanac_insert(ac,&key,&ne) == 0) nnew++;
 	}
+	return(nnew);
 }
 
-/* Planetary part, added 1992 August.  The intention of this is
-   to compute low-precision planetary positions for general info
-   and to inform user if observation might be interfered with by
-   a planet -- a rarity, but it happens.  Also designed to make
-   handy low-precision planet positions available for casual
-   planning purposes.  Do not try to point blindly right at the
-   middle of a planetary disk with these routines!  */
+int almanac_prefill(ac,jdmid,nnights,lat,longit,elevsea,horiz,custom,ncustom)
 
-double jd_el;     /* ************** */
+	struct almanac_cache *ac;
+	double jdmid;
+	int nnights;
+	double lat,longit,elevsea,horiz,*custom;
+	int ncustom;
+{
+	return(almanac_prefill_r(&skycalc_default_ctx,ac,jdmid,nnights,lat,
+		longit,elevsea,horiz,custom,ncustom));
+}
 
-/* elements of planetary orbits */
-struct elements {
-	char name[9];
-	double incl;
-	double Omega;
-	double omega;
-	double a;
-	double daily;
-	double ecc;
-	double L_0;
-	double mass;
-};
+int almanac_save(ac,fname)
 
-struct elements el[10];
+	struct almanac_cache *ac;
+	char *fname;
 
-void comp_el(jd)
+/* writes the cached nights to a file for almanac_load -- a header
+   (magic number, version, byte order, record size, count) and then
+   the key and record of each, in native byte order.  Returns 0, or
+   -1 on failure. */
 
-	double jd;
 {
+	FILE *fp;
+	int hdr[5], i, ret = 0;
+
+	if((fp = fopen(fname,"wb")) == NULL) return(-1);
+	hdr[0] = ALMANAC_MAGIC;
+	hdr[1] = ALMANAC_VERSION;
+	hdr[2] = SKYEPH_BYTEORDER;
+	hdr[3] = (int) sizeof(struct almanac_entry);
+	hdr[4] = ac->n;
+	if(fwrite(hdr,sizeof(int),5,fp) != 5) ret = -1;
+	for(i = 0; i < ac->cap && ret == 0; i++) {
+		if(!ac->entries[i].used) continue;
+		if(fwrite(&ac->entries[i].key,sizeof(struct almanac_key),1,fp) != 1 ||
+		   fwrite(&ac->entries[i].ne,sizeof(struct night_events),1,fp) != 1)
+			ret = -1;
+	}
+	if(fclose(fp) != 0) ret = -1;
+	return(ret);
+}
 
-   double T, Tsq, Tcb, d;
-   double ups, P, Q, S, V, W, G, H, zeta, psi; /* Meeus p. 110 ff. */
-   double sinQ,sinZeta,cosQ,cosZeta,sinV,cosV,
-	sin2Zeta,cos2Zeta;
+int almanac_load(ac,fname)
 
-   jd_el = jd;   /* true, but not necessarily; set explicitly */
-   d = jd - 2415020.;
-   T = d / 36525.;
-   Tsq = T * T;
-   Tcb = Tsq * T;
+	struct almanac_cache *ac;
+	char *fname;
 
-/* computes and loads mean elements for planets.  */
+/* adds the nights in a file from almanac_save to the cache (which
+   must have been set up with almanac_cache_init).  Returns the number
+   loaded, or -1 if the file can't be read or was written by an
+   incompatible version or machine. */
 
-/* Mercury, Venus, and Mars from Explanatory Suppl., p. 113 */
-
-   strcpy(el[1].name,"Mercury");
-   el[1].incl = 7.002880 + 1.8608e-3 * T - 1.83e-5 * Tsq;
-   el[1].Omega = 47.14594 + 1.185208 * T + 1.74e-4 * Tsq;
-   el[1].omega = 75.899697 + 1.55549 * T + 2.95e-4 * Tsq;
-   el[1].a = .3870986;
-   el[1].daily = 4.0923388;
-   el[1].ecc = 0.20561421 + 0.00002046 * T;
-   el[1].L_0 = 178.179078 + 4.0923770233 * d  +
-	 0.0000226 * pow((3.6525 * T),2.);
+{
+	FILE *fp;
+	int hdr[5], i, n = 0;
+	struct almanac_key key;
+	struct night_events ne;
+
+	if((fp = fopen(fname,"rb")) == NULL) return(-1);
+	if(fread(hdr,sizeof(int),5,fp) != 5 || hdr[0] != ALMANAC_MAGIC ||
+	   hdr[1] != ALMANAC_VERSION || hdr[2] != SKYEPH_BYTEORDER ||
+	   hdr[3] != (int) sizeof(struct almanac_entry)) {
+		fclose(fp);
+		return(-1);
+	}
+	for(i = 0; i < hdr[4]; i++) {
+		if(fread(&key,sizeof(struct almanac_key),1,fp) != 1 ||
+		   fread(&ne,sizeof(struct night_events),1,fp) != 1) break;
+		if(almanac_insert(ac,&key,&ne) != 0) break;
+		n++;
+	}
+	fclose(fp);
+	return(n);
+}
 
-   strcpy(el[2].name,"Venus  ");
-   el[2].incl = 3.39363 + 1.00583e-03 * T - 9.722e-7 * Tsq;
-   el[2].Omega = 75.7796472 + 0.89985 * T + 4.1e-4 * Tsq;
-   el[2].omega = 130.16383 + 1.4080 * T + 9.764e-4 * Tsq;
-   el[2].a = .723325;
-   el[2].daily = 1.60213049;
-   el[2].ecc = 0.00682069 - 0.00004774 * T;
-   el[2].L_0 = 342.767053 + 1.6021687039 * 36525 * T +
-	 0.000023212 * pow((3.6525 * T),2.);
+float ztwilight(alt)
+	double alt;
+{
 
-/* Earth from old Nautical Almanac .... */
+/* evaluates a polynomial expansion for the approximate brightening
+   in magnitudes of the zenith in twilight compared to its
+   value at full night, as function of altitude of the sun (in degrees).
+   To get this expression I looked in Meinel, A.,
+   & Meinel, M., "Sunsets, Twilight, & Evening Skies", Cambridge U.
+   Press, 1983; there's a graph on p. 38 showing the decline of
+   zenith twilight.  I read points off this graph and fit them with a
+   polynomial; I don't even know what band there data are for! */
+/* Comparison with Ashburn, E. V. 1952, JGR, v.57, p.85 shows that this
+   is a good fit to his B-band measurements.  */
 
-   strcpy(el[5].name,"Earth  ");
-   el[3].ecc = 0.01675104 - 0.00004180*T + 0.000000126*Tsq;
-   el[3].incl = 0.0;
-   el[3].Omega = 0.0;
-   el[3].omega = 101.22083 + 0.0000470684*d + 0.000453*Tsq + 0.000003*Tcb;
-   el[3].a = 1.0000007;;
-   el[3].daily = 0.985599;
-   el[3].L_0 = 358.47583 + 0.9856002670*d - 0.000150*Tsq - 0.000003*Tcb +
-	    el[3].omega;
-
-   strcpy(el[4].name,"Mars   ");
-   el[4].incl = 1.85033 - 6.75e-04 * T - 1.833e-5 * Tsq;
-   el[4].Omega = 48.786442 + .770992 * T + 1.39e-6 * Tsq;
-   el[4].omega = 334.218203 + 1.840758 * T + 1.299e-4 * Tsq;
-   el[4].a = 1.5236915;
-   el[4].daily = 0.5240329502 + 1.285e-9 * T;
-   el[4].ecc = 0.09331290 - 0.000092064 * T - 0.000000077 * Tsq;
-   el[4].L_0 = 293.747628 + 0.5240711638 * d  +
-	 0.000023287 * pow((3.6525 * T),2.);
+	float y, val;
 
-/* Outer planets from Jean Meeus, Astronomical Formulae for
-   Calculators, 3rd edition, Willman-Bell; p. 100. */
+	y = (-1.* alt - 9.0) / 9.0;  /* my polynomial's argument...*/
+	val = ((2.0635175 * y + 1.246602) * y - 9.4084495)*y + 6.132725;
+	return(val);
+}
 
-   strcpy(el[5].name,"Jupiter");
-   el[5].incl = 1.308736 - 0.0056961 * T + 0.0000039 * Tsq;
-   el[5].Omega = 99.443414 + 1.0105300 * T + 0.0003522 * Tsq
-		- 0.00000851 * Tcb;
-   el[5].omega = 12.720972 + 1.6099617 * T + 1.05627e-3 * Tsq
-	- 3.43e-6 * Tcb;
-   el[5].a = 5.202561;
-   el[5].daily = 0.08312941782;
-   el[5].ecc = .04833475  + 1.64180e-4 * T - 4.676e-7*Tsq -
-	1.7e-9 * Tcb;
-   el[5].L_0 = 238.049257 + 3036.301986 * T + 0.0003347 * Tsq -
-	1.65e-6 * Tcb;
+void lunskybright_batch(m,rho,alt,n,V)
 
-   /* The outer planets have such large mutual interactions that
-      even fair accuracy requires lots of perturbations --- here
-      are some of the larger ones, from Meeus' book. */
+	struct skybright_moon *m;
+	double *rho, *alt;
+	size_t n;
+	double *V;
 
-   ups = 0.2*T + 0.1;
-   P = (237.47555 + 3034.9061 * T) / DEG_IN_RADIAN;
-   Q = (265.91650 + 1222.1139 * T) / DEG_IN_RADIAN;
-   S = (243.51721 + 428.4677 * T) / DEG_IN_RADIAN;
-   V = 5*Q - 2*P;
-   W = 2*P - 6*Q + 3*S;
-   zeta = Q - P;
-   psi = S - Q;
-   sinQ = sin(Q);
-   cosQ = cos(Q);
-   sinV = sin(V);
-   cosV = cos(V);
-   sinZeta = sin(zeta);
-   cosZeta = cos(zeta);
-   sin2Zeta = sin(2*zeta);
-   cos2Zeta = cos(2*zeta);
+/* lunskybright for n objects at once, with the moon's terms from
+   skybright_moon_set.  rho[i] and alt[i] are the i-th object's
+   distance from the moon and altitude (degrees); V[i] gets its
+   lunar sky brightness in V mag per square arcsec. */
 
-   el[5].L_0 = el[5].L_0
-	+ (0.331364 - 0.010281*ups - 0.004692*ups*ups)*sinV
-	+ (0.003228 - 0.064436*ups + 0.002075*ups*ups)*cosV
-	- (0.003083 + 0.000275*ups - 0.000489*ups*ups)*sin(2*V)
-	+ 0.002472 * sin(W) + 0.013619 * sinZeta + 0.018472 * sin2Zeta
-	+ 0.006717 * sin(3*zeta)
-	+ (0.007275  - 0.001253*ups) * sinZeta * sinQ
-	+ 0.006417 * sin2Zeta * sinQ
-	- (0.033839 + 0.001253 * ups) * cosZeta * sinQ
-	- (0.035681 + 0.001208 * ups) * sinZeta * sinQ;
-	/* only part of the terms, the ones first on the list and
-	   selected larger-amplitude terms from farther down. */
+{
+	size_t i;
 
-   el[5].ecc = el[5].ecc + 1e-7 * (
-	  (3606 + 130 * ups - 43 * ups*ups) * sinV
-	+ (1289 - 580 * ups) * cosV - 6764 * sinZeta * sinQ
-	- 1110 * sin2Zeta * sin(Q)
-	+ (1284 + 116 * ups) * cosZeta * sinQ
-	+ (1460 + 130 * ups) * sinZeta * cosQ
-	+ 6074 * cosZeta * cosQ);
+	for(i = 0; i < n; i++)
+		V[i] = sky_vmag(lunsky_nl(m,rho[i],cos(rho[i]/DEG_IN_RADIAN),
+			sky_airfac(m->kzen,alt[i])));
+}
 
-   el[5].omega = el[5].omega
-	+ (0.007192 - 0.003147 * ups) * sinV
-	+ ( 0.000197*ups*ups - 0.00675*ups - 0.020428) * cosV
-	+ 0.034036 * cosZeta * sinQ + 0.037761 * sinZeta * cosQ;
+void sky_grid_free(g)
 
-   el[5].a = el[5].a + 1.0e-6 * (
-	205 * cosZeta - 263 * cosV + 693 * cos2Zeta + 312 * sin(3*zeta)
-	+ 147 * cos(4*zeta) + 299 * sinZeta * sinQ
-	+ 181 * cos2Zeta * sinQ + 181 * cos2Zeta * sinQ
-	+ 204 * sin2Zeta * cosQ + 111 * sin(3*zeta) * cosQ
-	- 337 * cosZeta * cosQ - 111 * cos2Zeta * cosQ
-	);
+	struct sky_grid *g;
+{
+	free(g->u);
+	free(g->alt);
+	free(g->airfac);
+	g->u = g->alt = g->airfac = NULL;
+	g->n = 0;
+}
 
-   strcpy(el[6].name,"Saturn ");
-   el[6].incl = 2.492519 - 0.00034550*T - 7.28e-7*Tsq;
-   el[6].Omega = 112.790414 + 0.8731951*T - 0.00015218*Tsq - 5.31e-6*Tcb ;
-   el[6].omega = 91.098214 + 1.9584158*T + 8.2636e-4*Tsq;
-   el[6].a = 9.554747;
-   el[6].daily = 0.0334978749897;
-   el[6].ecc = 0.05589232 - 3.4550e-4 * T - 7.28e-7*Tsq;
-   el[6].L_0 = 266.564377 + 1223.509884*T + 0.0003245*Tsq - 5.8e-6*Tcb
-	+ (0.018150*ups - 0.814181 + 0.016714 * ups*ups) * sinV
-	+ (0.160906*ups - 0.010497 - 0.004100 * ups*ups) * cosV
-	+ 0.007581 * sin(2*V) - 0.007986 * sin(W)
-	- 0.148811 * sinZeta - 0.040786*sin2Zeta
-	- 0.015208 * sin(3*zeta) - 0.006339 * sin(4*zeta)
-	- 0.006244 * sinQ
-	+ (0.008931 + 0.002728 * ups) * sinZeta * sinQ
-	- 0.016500 * sin2Zeta * sinQ
-	- 0.005775 * sin(3*zeta) * sinQ
-	+ (0.081344 + 0.003206 * ups) * cosZeta * sinQ
-	+ 0.015019 * cos2Zeta * sinQ
-	+ (0.085581 + 0.002494 * ups) * sinZeta * cosQ
-	+ (0.025328 - 0.003117 * ups) * cosZeta * cosQ
-	+ 0.014394 * cos2Zeta * cosQ;   /* truncated here -- no
-		      terms larger than 0.01 degrees, but errors may
-		      accumulate beyond this.... */
-   el[6].ecc = el[6].ecc + 1.0e-7 * (
-	  (2458 * ups - 7927.) * sinV + (13381. + 1226. * ups) * cosV
-	+ 12415. * sinQ + 26599. * cosZeta * sinQ
-	- 4687. * cos2Zeta * sinQ - 12696. * sinZeta * cosQ
-	- 4200. * sin2Zeta * cosQ +(2211. - 286*ups) * sinZeta*sin(2*Q)
-	- 2208. * sin2Zeta * sin(2*Q)
-	- 2780. * cosZeta * sin(2*Q) + 2022. * cos2Zeta*sin(2*Q)
-	- 2842. * sinZeta * cos(2*Q) - 1594. * cosZeta * cos(2*Q)
-	+ 2162. * cos2Zeta*cos(2*Q) );  /* terms with amplitudes
-	    > 2000e-7;  some secular variation ignored. */
-   el[6].omega = el[6].omega
-	+ (0.077108 + 0.007186 * ups - 0.001533 * ups*ups) * sinV
-	+ (0.045803 - 0.014766 * ups - 0.000536 * ups*ups) * cosV
-	- 0.075825 * sinZeta * sinQ - 0.024839 * sin2Zeta*sinQ
-	- 0.072582 * cosQ - 0.150383 * cosZeta * cosQ +
-	0.026897 * cos2Zeta * cosQ;  /* all terms with amplitudes
-	    greater than 0.02 degrees -- lots of others! */
-   el[6].a = el[6].a + 1.0e-6 * (
-	2933. * cosV + 33629. * cosZeta - 3081. * cos2Zeta
-	- 1423. * cos(3*zeta) + 1098. * sinQ - 2812. * sinZeta * sinQ
-	+ 2138. * cosZeta * sinQ  + 2206. * sinZeta * cosQ
-	- 1590. * sin2Zeta*cosQ + 2885. * cosZeta * cosQ
-	+ 2172. * cos2Zeta * cosQ);  /* terms with amplitudes greater
-	   than 1000 x 1e-6 */
+int sky_grid_init(g,alt,az,n,kzen)
 
-   strcpy(el[7].name,"Uranus ");
-   el[7].incl = 0.772464 + 0.0006253*T + 0.0000395*Tsq;
-   el[7].Omega = 73.477111 + 0.4986678*T + 0.0013117*Tsq;
-   el[7].omega = 171.548692 + 1.4844328*T + 2.37e-4*Tsq - 6.1e-7*Tcb;
-   el[7].a = 19.21814;
-   el[7].daily = 1.1769022484e-2;
-   el[7].ecc = 0.0463444 - 2.658e-5 * T;
-   el[7].L_0 = 244.197470 + 429.863546*T + 0.000316*Tsq - 6e-7*Tcb;
-   /* stick in a little bit of perturbation -- this one really gets
-      yanked around.... after Meeus p. 116*/
-   G = (83.76922 + 218.4901 * T)/DEG_IN_RADIAN;
-   H = 2*G - S;
-   el[7].L_0 = el[7].L_0 + (0.864319 - 0.001583 * ups) * sin(H)
-	+ (0.082222 - 0.006833 * ups) * cos(H)
-	+ 0.036017 * sin(2*H);
-   el[7].omega = el[7].omega + 0.120303 * sin(H)
-	+ (0.019472 - 0.000947 * ups) * cos(H)
-	+ 0.006197 * sin(2*H);
-   el[7].ecc = el[7].ecc + 1.0e-7 * (
-	20981. * cos(H) - 3349. * sin(H) + 1311. * cos(2*H));
-   el[7].a = el[7].a - 0.003825 * cos(H);
+	struct sky_grid *g;
+	double *alt, *az;
+	int n;
+	double kzen;
 
-   /* other corrections to "true longitude" are ignored. */
+/* sets up a fixed grid of n points on the sky (in alt and az,
+   degrees -- a HEALPix map, say) for sky_grid_bright, with zenith
+   extinction kzen.  Everything that depends only on where a point
+   is -- its unit vector and the air it's seen through -- is worked
+   out here, once.  Returns 0, or -1 if out of memory. */
 
-   strcpy(el[8].name,"Neptune");
-   el[8].incl = 1.779242 - 9.5436e-3 * T - 9.1e-6*Tsq;
-   el[8].Omega = 130.681389 + 1.0989350 * T + 2.4987e-4*Tsq - 4.718e-6*Tcb;
-   el[8].omega = 46.727364 + 1.4245744*T + 3.9082e-3*Tsq - 6.05e-7*Tcb;
-   el[8].a = 30.10957;
-   el[8].daily = 6.020148227e-3;
-   el[8].ecc = 0.00899704 + 6.33e-6 * T;
-   el[8].L_0 = 84.457994 + 219.885914*T + 0.0003205*Tsq - 6e-7*Tcb;
-   el[8].L_0 = el[8].L_0
-	- (0.589833 - 0.001089 * ups) * sin(H)
-	- (0.056094 - 0.004658 * ups) * cos(H)
-	- 0.024286 * sin(2*H);
-   el[8].omega = el[8].omega + 0.024039 * sin(H)
-	- 0.025303 * cos(H);
-   el[8].ecc = el[8].ecc + 1.0e-7 * (
-	4389. * sin(H) + 1129. * sin(2.*H)
-	+ 4262. * cos(H) + 1089. * cos(2.*H));
-   el[8].a = el[8].a + 8.189e-3 * cos(H);
+{
+	int i;
 
-/* crummy -- osculating elements a la Sept 15 1992 */
+	g->n = n;
+	g->kzen = kzen;
+	g->u = (double *) malloc(3 * (size_t) n * sizeof(double) + 1);
+	g->alt = (double *) malloc((size_t) n * sizeof(double) + 1);
+	g->airfac = (double *) malloc((size_t) n * sizeof(double) + 1);
+	if(g->u == NULL || g->alt == NULL || g->airfac == NULL) {
+		sky_grid_free(g);
+		return(-1);
+	}
+	for(i = 0; i < n; i++) {
+		cel_unit(az[i] / 15.,alt[i],g->u + 3 * i);
+		g->alt[i] = alt[i];
+		g->airfac[i] = sky_airfac(kzen,alt[i]);
+	}
+	return(0);
+}
 
-   d = jd - 2448880.5;  /* 1992 Sep 15 */
-   T = d / 36525.;
-   strcpy(el[9].name,"Pluto  ");
-   el[9].incl = 17.1426;
-   el[9].Omega = 110.180;
-   el[9].omega = 223.782;
-   el[9].a = 39.7465;
-   el[9].daily = 0.00393329;
-   el[9].ecc = 0.253834;
-   el[9].L_0 = 228.1027 + 0.00393329 * d;
-/*   printf("inc Om om : %f %f %f\n",el[9].incl,el[9].Omega,el[9].omega);
-   printf("a  dail ecc: %f %f %f\n",el[9].a,el[9].daily,el[9].ecc);
-   printf("L_0 %f\n",el[9].L_0);
-*/
-   el[1].mass = 1.660137e-7;  /* in units of sun's mass, IAU 1976 */
-   el[2].mass = 2.447840e-6;  /* from 1992 *Astron Almanac*, p. K7 */
-   el[3].mass = 3.040433e-6;  /* earth + moon */
-   el[4].mass = 3.227149e-7;
-   el[5].mass = 9.547907e-4;
-   el[6].mass = 2.858776e-4;
-   el[7].mass = 4.355401e-5;
-   el[8].mass = 5.177591e-5;
-   el[9].mass = 7.69e-9;  /* Pluto+Charon -- ? */
+void sky_grid_bright(g,m,sun_alt,vdark,vmoon,vsky)
+
+	struct sky_grid *g;
+	struct skybright_moon *m;
+	double sun_alt, vdark;
+	double *vmoon, *vsky;
+
+/* sky brightness over the points of g (see sky_grid_init), in V mag
+   per square arcsec, with the moon's terms from skybright_moon_set
+   (which must be for g's kzen).  vmoon gets the moon's part, as
+   lunskybright; vsky the whole sky -- a dark-sky brightness of vdark,
+   brightened by ztwilight for a sun at sun_alt (applied to the whole
+   sky, which is crude away from the zenith; the sun isn't taken
+   above the horizon), plus the moon.  Either may be NULL.  Points
+   below the horizon get 99.  Distances from the moon come from dot
+   products with the grid's unit vectors, so there's no spherical
+   trig per point.
+
+   Blocked like altaz_batch: BATCH_BLOCK points at a time, in short
+   loops that each call at most one libm function and choose between
+   lunsky_nl's cases with conditional expressions rather than
+   branches, so that each loop can be vectorised.  Agrees with
+   lunsky_nl and sky_vmag point by point to ~1.e-12 mag. */
 
+{
+	int i, j, k;
+	double Bsky, r, x;
+	double c[BATCH_BLOCK], rho[BATCH_BLOCK], e[BATCH_BLOCK],
+		B[BATCH_BLOCK], v[BATCH_BLOCK];
+	double *u;
+
+	if(sun_alt > 0.) sun_alt = 0.;
+	Bsky = 34.08 * exp((22.50 - vdark) / 1.08574);  /* eqn 1 reversed */
+	if(sun_alt > -18.)
+		Bsky = Bsky * exp(0.4 * LN_10 * ztwilight(sun_alt));
+
+	for(i = 0; i < g->n; i += k) {
+		k = (g->n - i < BATCH_BLOCK) ? g->n - i : BATCH_BLOCK;
+		if(m->altmoon > 0.) {
+			u = g->u + 3 * i;
+			for(j = 0; j < k; j++) {
+				x = u[3*j] * m->u[0] + u[3*j+1] * m->u[1] +
+					u[3*j+2] * m->u[2];
+				c[j] = (x > 1.) ? 1. : ((x < -1.) ? -1. : x);
+			}
+			for(j = 0; j < k; j++) rho[j] = DEG_IN_RADIAN * acos(c[j]);
+			for(j = 0; j < k; j++)   /* eqn 21, taken where rho > 10 */
+				e[j] = exp(LN_10 * (6.15 - rho[j] / 40.));
+			for(j = 0; j < k; j++) {
+				r = (rho[j] > 0.25) ? rho[j] : 0.25;
+				x = (rho[j] > 10.) ? e[j] :         /* eqn 21 */
+				    (rho[j] > 0.25) ? 6.2e7 / (r * r) :  /* eqn 19 */
+				    9.9e8;     /* within the moon's radius */
+				x = (229087. * (1.06 + c[j] * c[j]) + x) * m->istar *
+					g->airfac[i+j];
+				B[j] = (g->alt[i+j] > 0.) ? x : 0.;
+			}
+		}
+		else for(j = 0; j < k; j++) B[j] = 0.;
+
+		/* as sky_vmag */
+		if(vmoon != NULL) {
+			for(j = 0; j < k; j++)
+				v[j] = log(((B[j] > 0.001) ? B[j] : 0.001) / 34.08);
+			for(j = 0; j < k; j++)
+				vmoon[i+j] = (g->alt[i+j] <= 0. || B[j] <= 0.001) ?
+					99. : 22.50 - 1.08574 * v[j];
+		}
+		if(vsky != NULL) {
+			for(j = 0; j < k; j++) {
+				x = Bsky + B[j];
+				v[j] = log(((x > 0.001) ? x : 0.001) / 34.08);
+			}
+			for(j = 0; j < k; j++)
+				vsky[i+j] = (g->alt[i+j] <= 0. || Bsky + B[j] <= 0.001) ?
+					99. : 22.50 - 1.08574 * v[j];
+		}
+	}
 }
 
-void planetxyz(p, jd, x, y, z)
 
-	int p;
-	double jd, *x, *y, *z;
+static struct dst_rule dst_builtin[] = {
+	/* use_dst, from, to,  mo1, day1,  mo2, day2 */
+	{ 1, 1986, 9999,  4, 1,            10, DST_LASTSUN },  /* USA */
+	{ 1,    0, 1985,  4, DST_LASTSUN,  10, DST_LASTSUN },
+	{ 0, 1986, 9999,  4, 1,            10, DST_LASTSUN },  /* as USA, */
+	{ 0,    0, 1985,  4, DST_LASTSUN,  10, DST_LASTSUN },  /* defensively */
+	{ 2,    0, 9999,  3, DST_LASTSUN,   9, DST_LASTSUN },  /* Spanish */
+	{-1,    0, 9999,  3, 8,            10, 8 },            /* Chilean */
+	{-2,    0, 9999,  3, 1,            10, DST_LASTSUN }   /* Australian */
+};
 
-/* produces ecliptic x,y,z coordinates for planet number 'p'
-   at date jd. */
+double dst_rule_jd(yr,mo,day)
+
+	short yr, mo, day;
+
+/* the local-time "julian date", as date_to_jd gives it, of 2 AM on
+   the day in month mo of year yr that a dst_rule day picks out. */
 
 {
-	double M, omnotil, nu, r;
-	double e, LL, Om, om, nuu, ii;
+	long jdn;
+	int dow;
 
-/* see 1992 Astronomical Almanac, p. E 4 for these formulae. */
+	if(day == DST_LASTSUN) {
+		jdn = jdn_from_civil((long) yr,mo + 1,0);  /* last of month */
+		dow = (int) (jdn % 7);   /* 0 = Mon, 6 = Sun */
+		jdn = jdn - (dow + 1) % 7;
+	}
+	else if(day < 0) jdn = jdn_from_civil((long) yr,mo,-day);
+	else {
+		jdn = jdn_from_civil((long) yr,mo,day);
+		dow = (int) (jdn % 7);
+		jdn = jdn + (6 - dow);
+	}
+	return((double) jdn - 0.5 + 2. / 24.);
+}
 
-	ii = el[p].incl/DEG_IN_RADIAN;
-	e = el[p].ecc;
+struct dst_rule *dst_rule_find(dr,use_dst,yr)
 
-	LL = (el[p].daily * (jd - jd_el) + el[p].L_0) / DEG_IN_RADIAN;
-	Om = el[p].Omega / DEG_IN_RADIAN;
-	om = el[p].omega / DEG_IN_RADIAN;
+	struct dst_rules *dr;
+	short use_dst, yr;
 
-	M = LL - om;
-	omnotil = om - Om;
-	nu = M + (2.*e - 0.25 * pow(e,3.)) * sin(M) +
-	     1.25 * e * e * sin(2 * M) +
-	     1.08333333 * pow(e,3.) * sin(3 * M);
-	r = el[p].a * (1. - e*e) / (1 + e * cos(nu));
+/* the rule for convention use_dst in year yr -- the last one in dr
+   (if it isn't NULL) that covers it, or else the built-in one.
+   NULL if there's none. */
 
-	*x = r *
-	     (cos(nu + omnotil) * cos(Om) - sin(nu +  omnotil) *
-		cos(ii) * sin(Om));
-	*y = r *
-	     (cos(nu +  omnotil) * sin(Om) + sin(nu +  omnotil) *
-		cos(ii) * cos(Om));
-	*z = r * sin(nu +  omnotil) * sin(ii);
+{
+	int i;
+
+	if(dr != NULL)
+		for(i = dr->n - 1; i >= 0; i--)
+			if(dr->rule[i].use_dst == use_dst &&
+			   dr->rule[i].from <= yr && dr->rule[i].to >= yr)
+				return(dr->rule + i);
+	for(i = 0; i < (int) (sizeof(dst_builtin) / sizeof(struct dst_rule)); i++)
+		if(dst_builtin[i].use_dst == use_dst &&
+		   dst_builtin[i].from <= yr && dst_builtin[i].to >= yr)
+			return(dst_builtin + i);
+	return(NULL);
 }
 
+void dst_rule_bounds(r,yr,stdz,jdb,jde)
 
-void planetvel(p, jd, vx, vy, vz)
-	int p;
-	double jd, *vx, *vy, *vz;
-{
-/* numerically evaluates planet velocity by brute-force
-numerical differentiation. Very unsophisticated algorithm. */
+	struct dst_rule *r;
+	short yr;
+	double stdz, *jdb, *jde;
 
-	double dt; /* timestep */
-	double x1,y1,z1,x2,y2,z2,r1,d1,r2,d2,ep1;
+/* jdb and jde (UT) for year yr under rule r.  In the north jdb is
+   reckoned in standard time and jde in daylight time; in the south,
+   the other way around. */
 
-	dt = 0.1 / el[p].daily; /* time for mean motion of 0.1 degree */
-	planetxyz(p, (jd - dt), &x1, &y1, &z1);
-	planetxyz(p, (jd + dt), &x2, &y2, &z2);
-	*vx = 0.5 * (x2 - x1) / dt;
-	*vy = 0.5 * (y2 - y1) / dt;
-	*vz = 0.5 * (z2 - z1) / dt;
-	/* answer should be in ecliptic coordinates, in AU per day.*/
+{
+	if(r->use_dst >= 0) {
+		*jdb = dst_rule_jd(yr,r->mo1,r->day1) + stdz/24.;
+		*jde = dst_rule_jd(yr,r->mo2,r->day2) + (stdz - 1.)/24.;
+	}
+	else {
+		*jdb = dst_rule_jd(yr,r->mo1,r->day1) + (stdz - 1.)/24.;
+			/* note jdb is beginning of STANDARD time in south,
+				hence use stdz - 1. */
+		*jde = dst_rule_jd(yr,r->mo2,r->day2) + stdz/24.;
+	}
 }
 
-void xyz2000(jd,x,y,z)
-	double jd, x, y, z;
+void find_dst_bounds(yr,stdz,use_dst,jdb,jde)
+
+	short yr;
+	double stdz;
+	short use_dst;
+  	double *jdb,*jde;
 
-/* simply transforms a vector x, y, and z to 2000 coordinates
-   and prints -- for use in diagnostics. */
 {
-	double r1, d1, ep1, r2, d2, mod;
+	/* finds jd's at which daylight savings time begins
+	    and ends.  The parameter use_dst allows for a number
+	    of conventions, namely:
+		0 = don't use it at all (standard time all the time)
+		1 = use USA convention (1st Sun in April to
+		     last Sun in Oct after 1986; last Sun in April before)
+		2 = use Spanish convention (for Canary Islands)
+		-1 = use Chilean convention (CTIO).
+		-2 = Australian convention (for AAT).
+	    Negative numbers denote sites in the southern hemisphere,
+	    where jdb and jde are beginning and end of STANDARD time for
+	    the year.
+	    It's assumed that the time changes at 2AM local time; so
+	    when clock is set ahead, time jumps suddenly from 2 to 3,
+	    and when time is set back, the hour from 1 to 2 AM local
+	    time is repeated.  This could be changed in code if need be.
+	    The conventions are the rules in dst_builtin; jdb and jde
+	    are left alone for any other value of use_dst.  See
+	    find_dst_bounds_r for a cached version, which can also use
+	    rules read from a file. */
 
-	mod = sqrt(x*x + y*y + z*z);
-	xyz_cel(x,y,z,&r1,&d1);
-	ep1 = 2000. + (jd - J2000)/365.25;
-	precrot(r1,d1,ep1,2000.,&r2,&d2);
-	x = mod * cos(r2/HRS_IN_RADIAN) * cos(d2/DEG_IN_RADIAN);
-	y = mod * sin(r2/HRS_IN_RADIAN) * cos(d2/DEG_IN_RADIAN);
-	z = mod * sin(d2/DEG_IN_RADIAN);
-	printf("%f to 2000 -->  %f %f %f \n",ep1,x,y,z);
+	struct dst_rule *r;
 
+	if((r = dst_rule_find((struct dst_rules *) NULL,use_dst,yr)) != NULL)
+		dst_rule_bounds(r,yr,stdz,jdb,jde);
 }
 
-void earthview(x, y, z, i, ra, dec)
+void find_dst_bounds_r(ctx,yr,stdz,use_dst,jdb,jde)
 
-	double *x, *y, *z;
-	int i;
-	double *ra, *dec;
+	struct skycalc_ctx *ctx;
+	short yr;
+	double stdz;
+	short use_dst;
+	double *jdb,*jde;
 
-/* given computed planet positions for planets 1-10, computes
-   ra and dec of i-th planet as viewed from earth (3rd) */
+/* find_dst_bounds, from the context's small most-recently-used list
+   of years if it can be, and with the rules read into ctx->dst (see
+   dst_rules_use) ahead of the built-in ones. */
 
 {
-	double dx, dy, dz;
+	struct dst_bounds found;
+	struct dst_rule *r;
+	int i, k;
+
+	for(k = 0; k < ctx->dst_cache_n; k++)
+		if(ctx->dst_cache[k].yr == yr && ctx->dst_cache[k].use_dst == use_dst &&
+		   ctx->dst_cache[k].stdz == stdz) break;
+	if(k < ctx->dst_cache_n) found = ctx->dst_cache[k];
+	else {
+		if((r = dst_rule_find(ctx->dst,use_dst,yr)) == NULL) return;
+		found.yr = yr;
+		found.use_dst = use_dst;
+		found.stdz = stdz;
+		dst_rule_bounds(r,yr,stdz,&found.jdb,&found.jde);
+		if(ctx->dst_cache_n < DST_CACHE_SIZE) ctx->dst_cache_n++;
+		k = ctx->dst_cache_n - 1;
+	}
+	for(i = k; i > 0; i--) ctx->dst_cache[i] = ctx->dst_cache[i-1];
+	ctx->dst_cache[0] = found;
+	*jdb = found.jdb;
+	*jde = found.jde;
+}
 
-	dx = x[i] - x[3];
-	dy = y[i] - y[3];
-	dz = z[i] - z[3];
+void dst_rules_use(ctx,dr)
 
+	struct skycalc_ctx *ctx;
+	struct dst_rules *dr;
 
-	xyz_cel(dx,dy,dz,ra,dec);
+/* has find_dst_bounds_r use the rules in dr (NULL for only the
+   built-in ones) from now on. */
 
+{
+	ctx->dst = dr;
+	ctx->dst_cache_n = 0;
 }
 
-void pposns(jd,lat,sid,print_option,planra,plandec)
+void dst_rules_free(dr)
 
-	double jd,lat,sid;
-	short print_option;
-	double *planra, *plandec;
+	struct dst_rules *dr;
+{
+	free(dr->rule);
+	dr->rule = NULL;
+	dr->n = dr->cap = 0;
+}
 
-/* computes and optionally prints positions for all the planets. */
-/*  print_option 1 = print positions, 0 = silent */
+short dst_month(s)
+
+	char *s;
+
+/* a month as a number or a name ("Mar", "March"); 0 if neither. */
 
 {
-	int i;
-	double x[10], y[10], z[10], ha, alt, az, secz;
-	double rasun, decsun, distsun, topora,topodec;
-	double georamoon,geodecmoon,geodistmoon,toporamoon,topodecmoon,
-	      topodistmoon;
+	char *months = "janfebmaraprmayjunjulaugsepoctnovdec";
+	int i, m;
 
-	accusun(jd,0.,0.,&rasun,&decsun,&distsun,&topora,&topodec,x+3,y+3,z+3);
-/*      planetxyz(3,jd,x+3,y+3,z+3);   get the earth first (EarthFirst!?)
-	eclrot(jd,x+3,y+3,z+3);  */
+	if(isdigit((int) s[0])) {
+		m = atoi(s);
+		return((m >= 1 && m <= 12) ? m : 0);
+	}
+	for(i = 0; i < 12; i++)
+		if(strlen(s) >= 3 && tolower((int) s[0]) == months[3*i] &&
+		   tolower((int) s[1]) == months[3*i+1] &&
+		   tolower((int) s[2]) == months[3*i+2]) return(i + 1);
+	return(0);
+}
 
-	accumoon(jd,lat,sid,0.,&georamoon,&geodecmoon,&geodistmoon,
-			 &toporamoon,&topodecmoon,&topodistmoon);
+int dst_day(s,day)
 
-	if(print_option == 1) {  /* set up table header */
-		oprntf("\n\nPlanetary positions (epoch of date), accuracy about 0.1 deg:\n");
-		oprntf("\n             RA       dec       HA");
-		oprntf("       sec.z     alt   az\n\n");
+	char *s;
+	short *day;
 
-	/* Throw in the sun and moon here ... */
-		oprntf("Sun    : ");
-		put_coords(topora,1);
-		oprntf("  ");
-		put_coords(topodec,0);
-		ha = adj_time(sid - topora);
-		oprntf("  ");
-		put_coords(ha,0);
-		alt = altit(topodec,ha,lat,&az);
-		secz = secant_z(alt);
- 		if(fabs(secz) < 100.) oprntf("   %8.2f  ",secz);
-		else oprntf("  (near horiz)");
-		oprntf(" %5.1f  %5.1f\n",alt,az);
-		oprntf("Moon   : ",el[i].name);
-		put_coords(toporamoon,1);
-		oprntf("  ");
-		put_coords(topodecmoon,0);
-		ha = adj_time(sid - toporamoon);
-		oprntf("  ");
-		put_coords(ha,0);
-		alt=altit(topodecmoon,ha,lat,&az);
-		secz = secant_z(alt);
- 		if(fabs(secz) < 100.) oprntf("   %8.2f  ",secz);
-		else oprntf("  (near horiz)");
-		oprntf(" %5.1f  %5.1f\n\n",alt,az);
-        }
-	for(i = 1; i <= 9; i++) {
-		if(i == 3) goto SKIP;  /* skip the earth */
-		planetxyz(i,jd,x+i,y+i,z+i);
-		eclrot(jd,x+i,y+i,z+i);
-		earthview(x,y,z,i,planra+i,plandec+i);
-		if(print_option == 1) {
-			oprntf("%s: ",el[i].name);
-			put_coords(planra[i],1);
-			oprntf("  ");
-			put_coords(plandec[i],0);
-			ha = adj_time(sid - planra[i]);
-			oprntf("  ");
-			put_coords(ha,0);
-			alt=altit(plandec[i],ha,lat,&az);
-			secz = secant_z(alt);
- 			if(fabs(secz) < 100.) oprntf("   %8.2f  ",secz);
-			else oprntf("  (near horiz)");
-			oprntf(" %5.1f  %5.1f",alt,az);
-			if(i == 9) oprntf(" <-(least accurate)\n");
-			else oprntf("\n");
-		}
-		SKIP: ;
-	}
-	if(print_option == 1) printf("Type command, or ? for menu:");
+/* a tzdata day -- "lastSun", "Sun>=8" or "15" -- as a dst_rule day.
+   Returns 0, or -1 if it isn't one of those. */
+
+{
+	int d;
+
+	if(strcmp(s,"lastSun") == 0) *day = DST_LASTSUN;
+	else if(strncmp(s,"Sun>=",5) == 0 && (d = atoi(s + 5)) >= 1 && d <= 31)
+		*day = d;
+	else if(isdigit((int) s[0]) && (d = atoi(s)) >= 1 && d <= 31)
+		*day = -d;
+	else return(-1);
+	return(0);
 }
 
-void barycor(jd,x,y,z,xdot,ydot,zdot)
+int dst_rules_load(dr,fname)
 
-	double jd,*x,*y,*z;
-	double *xdot,*ydot,*zdot;
+	struct dst_rules *dr;
+	char *fname;
 
-/* This routine takes the position
-   x,y,z and velocity xdot,ydot,zdot, assumed heliocentric,
-   and corrects them to the solar system barycenter taking into
-   account the nine major planets.  Routine evolved by inserting
-   planetary data (given above) into an earlier, very crude
-   barycentric correction.  */
+/* adds the rules in file fname to dr (start from a zeroed one), so
+   new conventions can be had without new code.  Each line is
+
+	Rule use_dst from to in1 on1 in2 on2
+
+   after tzdata's Rule lines: to can be "max" or "only", the months
+   in1 and in2 are names or numbers, and the days on1 and on2 are
+   "lastSun", "Sun>=n" or a day of the month.  In the north daylight
+   time runs from on1 in1 to on2 in2; in the south (use_dst < 0)
+   standard time does.  Later rules take precedence over earlier
+   ones and over the built-in conventions.  Blank lines and anything
+   after a '#' are skipped.  Returns the number of rules added, or -1
+   if the file can't be read, a line is bad (dr is then unchanged) or
+   memory runs out. */
 
 {
+	FILE *fp;
+	char line[256], word[8][32], *p;
+	struct dst_rule r, *nrule;
+	int n0, nw, ncap;
+
+	if((fp = fopen(fname,"r")) == NULL) return(-1);
+	n0 = dr->n;
+	while(fgets(line,sizeof(line),fp) != NULL) {
+		if((p = strchr(line,'#')) != NULL) *p = '\0';
+		nw = sscanf(line,"%31s %31s %31s %31s %31s %31s %31s %31s",
+			word[0],word[1],word[2],word[3],word[4],word[5],word[6],
+			word[7]);
+		if(nw <= 0) continue;
+		if(nw != 8 || strcmp(word[0],"Rule") != 0) goto BAD;
+		r.use_dst = atoi(word[1]);
+		r.from = atoi(word[2]);
+		if(strcmp(word[3],"max") == 0) r.to = 9999;
+		else if(strcmp(word[3],"only") == 0) r.to = r.from;
+		else r.to = atoi(word[3]);
+		if((r.mo1 = dst_month(word[4])) == 0 || dst_day(word[5],&r.day1) != 0 ||
+		   (r.mo2 = dst_month(word[6])) == 0 || dst_day(word[7],&r.day2) != 0)
+			goto BAD;
+		if(dr->n == dr->cap) {
+			ncap = (dr->cap > 0) ? 2 * dr->cap : 16;
+			nrule = (struct dst_rule *) realloc(dr->rule,
+				ncap * sizeof(struct dst_rule));
+			if(nrule == NULL) goto BAD;
+			dr->rule = nrule;
+			dr->cap = ncap;
+		}
+		dr->rule[dr->n++] = r;
+	}
+	fclose(fp);
+	return(dr->n - n0);
 
-	int p;
-	double xp, yp, zp, xvp, yvp, zvp;
-	double xo, yo, zo;  /* for diagn */
+   BAD:
+	dr->n = n0;
+	fclose(fp);
+	return(-1);
+}
+double zone(use_dst,stdz,jd,jdb,jde)
 
-	double xc=0.,yc=0.,zc=0.,xvc=0.,yvc=0.,zvc=0.;
+	short use_dst;
+	double stdz,jd,jdb,jde;
 
-	comp_el(jd);
+{
+	/* Returns zone time offset when standard time zone is stdz,
+	   when daylight time begins (for the year) on jdb, and ends
+	   (for the year) on jde.  This is parochial to the northern
+	   hemisphere.  */
+	/* Extension -- specifying a negative value of use_dst reverses
+	   the logic for the Southern hemisphere; then DST is assumed for
+	   the Southern hemisphere summer (which is the end and beginning
+	   of the year. */
 
-	for(p=1;p<=9;p++) { /* sum contributions of the planets */
-		planetxyz(p,jd,&xp,&yp,&zp);
-		xc = xc + el[p].mass * xp;  /* mass is fraction of solar mass */
-		yc = yc + el[p].mass * yp;
-		zc = zc + el[p].mass * zc;
-		planetvel(p,jd,&xvp,&yvp,&zvp);
-		xvc = xvc + el[p].mass * xvp;
-		yvc = yvc + el[p].mass * yvp;
-		zvc = zvc + el[p].mass * zvc;
-	/* diagnostic commented out ..... nice place to check planets if needed
-		printf("%d :",p);
-		xo = xp;
-		yo = yp;
-		zo = zp;
-		eclrot(jd,&xo,&yo,&zo);
-		xyz2000(jd,xo,yo,zo);
-		printf("    ");
-		xo = xvp;
-		yo = yvp;
-		zo = zvp;
-		eclrot(jd,&xo,&yo,&zo);
-		xyz2000(jd,xo,yo,zo);    */
-	}
-	/* normalize properly and rotate corrections to equatorial coords */
-	xc = xc / SS_MASS;
-	yc = yc / SS_MASS;
-	zc = zc / SS_MASS;     /* might as well do it right ... */
+	if(use_dst == 0) return(stdz);
+	else if((jd > jdb) && (jd < jde) && (use_dst > 0)) return(stdz-1.);
+	   /* next line .. use_dst < 0 .. for Southern Hemisphere sites. */
+	else if(((jd < jdb) || (jd > jde)) && (use_dst < 0)) return(stdz-1.);
+	else return(stdz);
+}
 
-	eclrot(jd, &xc, &yc, &zc);
+double true_jd_r(ctx, date, use_dst, enter_ut, night_date, stdz)
 
-/*      printf("posn corrn:");   diagnostic commented out
-	xyz2000(jd,xc,yc,zc);
-	printf(" vel corrn:");
-	xyz2000(jd,(1.0e9 * xvc),(1.0e9 * yvc),(1.0e9 * zvc));  */
+/* takes the values in the date-time structure, the standard time
+   zone (in hours west), the prevailing conventions for date and
+   time entry, and returns the value of the true julian date. */
 
-	xvc = xvc * KMS_AUDAY / SS_MASS;
-	yvc = yvc * KMS_AUDAY / SS_MASS;
-	zvc = zvc * KMS_AUDAY / SS_MASS;
-	eclrot(jd, &xvc, &yvc, &zvc);
+	struct skycalc_ctx *ctx;
+	struct date_time date;
+	short use_dst, enter_ut, night_date;
+	double stdz;
+{
+	double jd, jdb, jde, test;
 
-	/* add them in */
-	*x = *x - xc;  /* these are in AU -- */
-	*y = *y - yc;
-	*z = *z - zc;
-/*      xyz2000(jd,*x,*y,*z);   */
-	*xdot = *xdot - xvc;
-	*ydot = *ydot - yvc;
-	*zdot = *zdot - zvc;
+	if(enter_ut == 0) {
+           find_dst_bounds_r(ctx,date.y,stdz,use_dst,&jdb,&jde);
+	   jd = date_to_jd(date);
+	   if((night_date == 1)  && (date.h < 12)) jd = jd + 1.;
+	   if(use_dst != 0)  {  /* check at time changes */
+		test = jd + stdz/24. - jdb;
+		if((test > 0.) && (test < 0.041666666))   {
+			/* 0.0416 = 1 hr; nonexistent time */
+			oprntf_r(ctx,"Error in true_jd -- nonexistent input time during std->dst change.\n");
+			oprntf_r(ctx,"Specify as 1 hour later!\n");
+			return(-1.); /* signal of nonexistent time */
+		}
+		test = jd + stdz/24. - jde;
+		if((test > 0.) && (test < 0.041666666))   {
+			oprntf_r(ctx,"WARNING ... ambiguous input time during dst->std change!\n");
+		}
+	   }
+	   jd = jd + zone(use_dst,stdz,(jd+stdz/24.),jdb,jde)/24.;
+			/* effect should be to default to standard time. */
+        }
+	else jd = date_to_jd(date);
 
-/* diagnostic -- trash variables
-	-- scale for direct comparison with almanac
-	xp = 1.0e9 * *xdot / KMS_AUDAY;
-	yp = 1.0e9 * *ydot / KMS_AUDAY;
-	zp = 1.0e9 * *zdot / KMS_AUDAY;
-	xyz2000(jd,xp,yp,zp);
-					*/
+	return(jd);
 }
 
-void helcor(jd,ra,dec,ha,lat,elevsea,tcor,vcor)
+double true_jd(date, use_dst, enter_ut, night_date, stdz)
 
-	double jd,ra,dec,ha;
-  	double lat,elevsea,*tcor,*vcor;
+	struct date_time date;
+	short use_dst, enter_ut, night_date;
+	double stdz;
+{
+	return(true_jd_r(&skycalc_default_ctx,date,use_dst,enter_ut,
+		night_date,stdz));
+}
 
-/* finds heliocentric correction for given jd, ra, dec, ha, and lat.
-   tcor is time correction in seconds, vcor velocity in km/s, to
-   be added to the observed values.
-   Input ra and dec assumed to be at current epoch */
+
+void print_tz(jd,use,jdb,jde,zabr)
+
+	double jd;
+	short use;
+	double jdb,jde;
+	char zabr;
 
 {
-	double M, ec, E, obliq, omeg, x, y, z, xdot, ydot, zdot;
-	double xobj,yobj,zobj;
-	double ras, decs, dists, jd1, jd2, x1, x2, y1, y2, z1, z2;
-	double topora, topodec;
-	double x_geo, y_geo, z_geo;  /* geocentric coords of observatory */
-	double diff;
-	double a=499.0047837;  /* light travel time for 1 AU, sec  */
+	/* prints correct time abbreviation, given zabr as the
+	   single character abbreviation for the time zone,
+	   "D" or "S" depending on daylight or standard (dst
+	    begins at jdb, ends at jde) and current jd. */
 
-	dec=dec/DEG_IN_RADIAN; /* pass by value! */
-	ra = ra/HRS_IN_RADIAN;
-	ha = ha/HRS_IN_RADIAN;
+	oprntf(" %c", zabr);
+	if((jd > jdb) && (jd < jde) && (use > 0)) oprntf("D");
+	  else if(((jd < jdb) || (jd > jde)) && (use < 0)) oprntf("D");
+	  else oprntf("S");
+	oprntf("T");
+}
 
-	xobj = cos(ra) * cos(dec);
-	yobj = sin(ra) * cos(dec);
-	zobj = sin(dec);
+void xyz_cel(x, y, z, r, d)
 
-/* diagnostic -- temporarily trash jd1
-	jd1 = jd1 + etcorr(jd1) / SEC_IN_DAY;
-	printf("TDT: %20f\n",jd1);  */
+	double x, y, z, *r, *d;
 
-	jd1 = jd - EARTH_DIFF;
-	jd2 = jd + EARTH_DIFF;
+     /* Cartesian coordinate triplet */
 
-	accusun(jd1,0.,0.,&ras,&decs,&dists,&topora,&topodec,&x1,&y1,&z1);
-	accusun(jd2,0.,0.,&ras,&decs,&dists,&topora,&topodec,&x2,&y2,&z2);
-	accusun(jd,0.,0.,&ras,&decs,&dists,&topora,&topodec,&x,&y,&z);
+{
+   /* converts a coordinate triplet back to a standard ra and dec */
 
-/*      printf("ra dec distance:");  diagnostic -- commented out
-	put_coords(ras,3);
-	printf(" ");
-	put_coords(decs,2);
-	printf(" %f\n",dists);   */
+   double mod;    /* modulus */
+   double xy;     /* component in xy plane */
+   short sign;    /* for determining quadrant */
+   double radian_ra, radian_dec;
 
-	xdot = KMS_AUDAY*(x2 - x1)/(2.*EARTH_DIFF);  /* numerical differentiation */
-	ydot = KMS_AUDAY*(y2 - y1)/(2.*EARTH_DIFF);  /* crude but accurate */
-	zdot = KMS_AUDAY*(z2 - z1)/(2.*EARTH_DIFF);
+   /* this taken directly from pl1 routine - no acos or asin available there,
+       as it is in c. Easier just to copy, though */
 
-/*      printf("Helio earth:");  diagnostic -- commmented out
-	xyz2000(jd,x,y,z);
-	xyz2000(jd,xdot,ydot,zdot);   */
+   mod = sqrt(x*x + y*y + z*z);
+   x = x / mod;
+   y = y / mod;
+   z = z / mod;   /* normalize 'em explicitly first. */
+
+   xy = sqrt(x*x + y*y);
+
+   if(xy < 1.0e-10) {
+      radian_ra = 0.;  /* too close to pole */
+      radian_dec = PI / 2.;
+      if(z < 0.) radian_dec = radian_dec * -1.;
+   }
+   else {
+      if(fabs(z/xy) < 3.) radian_dec = atan(z / xy);
+	 else if (z >= 0.) radian_dec = PI / 2. - atan(xy / z);
+	 else radian_dec = -1. * PI / 2. - atan(xy / z);
+      if(fabs(x) > 1.0e-10) {
+	 if(fabs(y / x) < 3.) radian_ra = atan(y / x);
+	 else if ((x * y ) >= 0.) radian_ra = PI / 2. - atan(x/y);
+	 else radian_ra = -1. *  PI / 2. - atan(x / y);
+      }
+      else {
+	 radian_ra = PI / 2.;
+	 if((x * y)<= 0.) radian_ra = radian_ra * -1.;
+      }
+      if(x <0.) radian_ra = radian_ra + PI ;
+      if(radian_ra < 0.) radian_ra = radian_ra + 2. * PI ;
+   }
+
+   *r = radian_ra * HRS_IN_RADIAN;
+   *d = radian_dec * DEG_IN_RADIAN;
 
-	barycor(jd,&x,&y,&z,&xdot,&ydot,&zdot);
-	*tcor = a * (x*xobj + y*yobj + z*zobj);
-	*vcor = xdot * xobj + ydot * yobj + zdot * zobj;
-/* correct diurnal rotation for elliptical earth including obs. elevation */
-	geocent(0., lat, elevsea, &x_geo, &y_geo, &z_geo);
-/* longitude set to zero arbitrarily so that x_geo = perp. distance to axis */
-	*vcor = *vcor - 0.4651011 * x_geo * sin(ha) * cos(dec);
-/* 0.4651011 = 6378.137 km radius * 2 pi / (86164.1 sec per sidereal day) */
-/* could add time-of-flight across earth's radius here -- but rest of
-   theory is not good to 0.02 seconds anyway. */
 }
 
-/* A couple of eclipse predictors.... */
+void prec_matrix(orig_epoch, final_epoch, pm)
 
-float overlap(r1, r2, sepn)
+	double orig_epoch, final_epoch;
+	struct precmat *pm;
+
+   /* Fills in the IAU1976 precession matrix carrying coordinates
+      from orig_epoch to final_epoch (years), following Taff's
+      Computational Spherical Astronomy; see precrot.  Worth keeping
+      hold of when many positions share the same pair of epochs. */
 
-	double r1, r2, sepn;
 {
+   double ti, tf, zeta, z, theta;  /* all as per  Taff */
+   double cosz, coszeta, costheta, sinz, sinzeta, sintheta;  /* ftns */
 
+   ti = (orig_epoch - 2000.) / 100.;
+   tf = (final_epoch - 2000. - 100. * ti) / 100.;
 
-/* for two circles of radii r1 and r2,
-   computes the overlap area in terms of the area of r1
-   if their centers are separated by
-   sepn. */
+   zeta = (2306.2181 + 1.39656 * ti + 0.000139 * ti * ti) * tf +
+    (0.30188 - 0.000344 * ti) * tf * tf + 0.017998 * tf * tf * tf;
+   z = zeta + (0.79280 + 0.000410 * ti) * tf * tf + 0.000205 * tf * tf * tf;
+   theta = (2004.3109 - 0.8533 * ti - 0.000217 * ti * ti) * tf
+     - (0.42665 + 0.000217 * ti) * tf * tf - 0.041833 * tf * tf * tf;
 
-	float result, a, rlarge, rsmall;
+   /* convert to radians */
 
-	if(sepn > r1+r2) return(0.); /* They don't overlap */
-	if((r2 < 0.) || (r1 < 0.)) return(-1.);  /* oops -- r's > 0.*/
-	if(r2 > r1) {
-		rlarge = r2;
-		rsmall = r1;
-	}
-	else {
-		rlarge = r1;
-		rsmall = r2;
-	}
-	if(sepn < (rlarge - rsmall)) { /* small circle completely contained */
-		if(r2 > r1) return(1.);  /* r1 is completely covered */
-		else return((r2*r2) / (r1*r1)); /* ratio of areas */
-	}
-	a = (rlarge*rlarge + sepn*sepn - rsmall*rsmall) / (2.*sepn);
-	   /* a is the distance along axis of centers to where circles cross */
-	result = PI * rlarge * rlarge / 4.
-	     - a * sqrt(rlarge * rlarge - a*a) / 2.
-	     - rlarge * rlarge * asin(a/rlarge) / 2;
-	a = sepn - a;
-	result = result + PI * rsmall * rsmall / 4.
-	     - a * sqrt(rsmall * rsmall - a*a) / 2.
-	     - rsmall * rsmall * asin(a/rsmall) / 2.;
-	result = result * 2.;
-	return(result / (PI*r1*r1)); /* normalize to circle 1's area. */
-}
+   zeta = zeta / ARCSEC_IN_RADIAN;
+   z = z / ARCSEC_IN_RADIAN;
+   theta = theta / ARCSEC_IN_RADIAN;
 
-void solecl(sun_moon,distmoon,distsun)
+   /* compute the necessary trig functions for speed and simplicity */
 
-	double sun_moon,distmoon,distsun;
+   cosz = cos(z);
+   coszeta = cos(zeta);
+   costheta = cos(theta);
+   sinz = sin(z);
+   sinzeta = sin(zeta);
+   sintheta = sin(theta);
 
+   /* compute the elements of the precession matrix */
 
-{
-	double ang_sun, ang_moon; /* angular sizes */
-	float magnitude; /* fraction of sun covered */
+   pm->orig_epoch = orig_epoch;
+   pm->final_epoch = final_epoch;
 
-	ang_moon = DEG_IN_RADIAN * asin(RMOON / (distmoon * EQUAT_RAD));
-	ang_sun = DEG_IN_RADIAN * asin(RSUN / (distsun * ASTRO_UNIT));
+   pm->p[0][0] = coszeta * cosz * costheta - sinzeta * sinz;
+   pm->p[0][1] = -1. * sinzeta * cosz * costheta - coszeta * sinz;
+   pm->p[0][2] = -1. * cosz * sintheta;
 
-	if(sun_moon >= (ang_sun + ang_moon)) return ;
+   pm->p[1][0] = coszeta * sinz * costheta + sinzeta * cosz;
+   pm->p[1][1] = -1. * sinzeta * sinz * costheta + coszeta * cosz;
+   pm->p[1][2] = -1. * sinz * sintheta;
 
-	else if(ang_sun >= ang_moon) {                   /* annular */
-		magnitude = overlap(ang_sun,ang_moon,sun_moon);
-		if(sun_moon > (ang_sun - ang_moon))
-			oprntf("PARTIAL ECLIPSE OF THE SUN, %4.2f covered.\n",
-				magnitude);
-		else oprntf("ANNULAR ECLIPSE OF THE SUN, %4.2f covered.\n",
-				magnitude);
-	}
-	else {
-		magnitude = overlap(ang_sun,ang_moon,sun_moon);
-		if(sun_moon > (ang_moon - ang_sun))
-			oprntf("PARTIAL ECLIPSE OF THE SUN, %4.2f covered.\n",
-				magnitude);
-		else oprntf("TOTAL ECLIPSE OF THE SUN!\n");
-	}
+   pm->p[2][0] = coszeta * sintheta;
+   pm->p[2][1] = -1. * sinzeta * sintheta;
+   pm->p[2][2] = costheta;
 }
 
-short lunecl(georamoon,geodecmoon,geodistmoon,rasun,decsun,distsun)
+void precrot_mat(pm, rorig, dorig, rf, df)
 
-	double georamoon,geodecmoon,geodistmoon,rasun,decsun,distsun;
+	struct precmat *pm;
+	double rorig, dorig, *rf, *df;
 
+/* precesses one position (decimal hours, decimal degr.) with a
+   matrix from prec_matrix.  Same answer as precrot for the
+   matrix's pair of epochs. */
 
 {
-	/* quickie lunar eclipse predictor -- makes a number of
-	   minor assumptions, e. g. small angle approximations, plus
-	   projects phenomena onto a plane at distance = geocentric
-	   distance of moon . */
-
-	double ang_sun, ang_moon; /* angular sizes */
-	double radius_um, radius_penum;
-	double ra_shadow, dec_shadow;
-	double lun_to_shadow;  /* angular separation of centerline of shadow
-		  from center of moon ... */
-	float magnitude;  /* portion covered */
+   double radian_ra, radian_dec;
+   double orig_x, orig_y, orig_z;
+   double fin_x, fin_y, fin_z;   /* original and final unit ectors */
 
-	ang_sun = asin(RSUN / (distsun * ASTRO_UNIT));  /* radians */
+   radian_ra = rorig / HRS_IN_RADIAN;
+   radian_dec = dorig / DEG_IN_RADIAN;
 
-	ra_shadow = rasun + 12.;
-	if(ra_shadow > 24.) ra_shadow = ra_shadow - 24.; /* not strictly
-	   necessary, perhaps, but wise */
-	dec_shadow = -1. * decsun;
-	radius_um = (1./geodistmoon - ang_sun) * DEG_IN_RADIAN;
-	radius_penum = (1./geodistmoon + ang_sun) * DEG_IN_RADIAN;
+   orig_x = cos(radian_dec) * cos(radian_ra);
+   orig_y = cos(radian_dec) *sin(radian_ra);
+   orig_z = sin(radian_dec);
+      /* (hard coded matrix multiplication ...) */
+   fin_x = pm->p[0][0] * orig_x + pm->p[0][1] * orig_y + pm->p[0][2] * orig_z;
+   fin_y = pm->p[1][0] * orig_x + pm->p[1][1] * orig_y + pm->p[1][2] * orig_z;
+   fin_z = pm->p[2][0] * orig_x + pm->p[2][1] * orig_y + pm->p[2][2] * orig_z;
 
+   /* convert back to spherical polar coords */
 
-	ang_moon = DEG_IN_RADIAN * asin(RMOON / (geodistmoon * EQUAT_RAD));
-	lun_to_shadow = DEG_IN_RADIAN *
-		subtend(georamoon,geodecmoon,ra_shadow,dec_shadow);
-	if(lun_to_shadow > (radius_penum + ang_moon)) return (0);
-	else if(lun_to_shadow >= (radius_um + ang_moon))  {
-		if(lun_to_shadow >= (radius_penum - ang_moon)) {
-			oprntf("PARTIAL PENUMBRAL (BRIGHT) ECLIPSE OF THE MOON.\n");
-			return (1);
-		}
-		else  {
-			oprntf("PENUMBRAL (BRIGHT) ECLIPSE OF THE MOON.\n");
-			return (2);
-		}
-	}
-	else if (lun_to_shadow >= (radius_um - ang_moon)) {
-		magnitude = overlap(ang_moon,radius_um,lun_to_shadow);
-		oprntf("PARTIAL UMBRAL (DARK) ECLIPSE OF THE MOON, %4.2f covered.\n",
-		   magnitude);
-		return(3);
-	}
-	else {
-		oprntf("TOTAL ECLIPSE OF THE MOON!\n");
-		return(4);
-	}
+   xyz_cel(fin_x, fin_y, fin_z, rf, df);
 }
 
-void planet_alert(jd,ra,dec,tolerance)
+void precrot(rorig, dorig, orig_epoch, final_epoch, rf, df)
 
-	double jd,ra,dec,tolerance;
+	double rorig, dorig, orig_epoch, final_epoch, *rf, *df;
 
-/* given a jd, ra, and dec, this computes rough positions
-   for all the planets, and alerts the user if any of them
-   are within less than a settable tolerance of the ra and dec. */
+/*  orig_epoch, rorig, dorig  years, decimal hours, decimal degr.
+    final_epoch;
+    *rf, *df final ra and dec */
+
+   /* Takes a coordinate pair and precesses it using matrix procedures
+      as outlined in Taff's Computational Spherical Astronomy book.
+      This is the so-called 'rigorous' method which should give very
+      accurate answers all over the sky over an interval of several
+      centuries.  Naked eye accuracy holds to ancient times, too.
+      Precession constants used are the new IAU1976 -- the 'J2000'
+      system.  The matrix is rebuilt on every call; see precrot_r
+      and precrot_batch for ways of reusing it. */
 
 {
-	double pra[10],pdec[10], angle;
-	int i;
+   struct precmat pm;
 
-	comp_el(jd);
-	pposns(jd,0.,0.,0,pra,pdec);
-	for(i = 1; i<=9 ; i++) {
-		if(i == 3) goto SKIP;
-		angle = subtend(pra[i],pdec[i],ra,dec) * DEG_IN_RADIAN;
-		if(angle < tolerance) {
-			oprntf("-- CAUTION -- proximity to %s -- low-precision calculation shows\n ",
-				el[i].name);
-			oprntf("this direction as %5.2f deg away from %s ---\n",
-				angle,el[i].name);
-		}
-		SKIP: ;
-	}
+   prec_matrix(orig_epoch, final_epoch, &pm);
+   precrot_mat(&pm, rorig, dorig, rf, df);
 }
 
-short setup_time_place(date,longit,lat,stdz,use_dst,zone_name,
-        zabr,site_name,enter_ut,night_date,jdut,jdlocal,jdb,jde,sid,
-	curepoch)
+struct precmat *prec_cache_r(ctx, orig_epoch, final_epoch)
 
-struct date_time date;
-double lat, longit, stdz, *jdut, *jdlocal, *jdb, *jde, *sid, *curepoch;
-short use_dst, enter_ut, night_date;
-char zabr;
-char *site_name;
-char *zone_name;
+	struct skycalc_ctx *ctx;
+	double orig_epoch, final_epoch;
 
-/* This takes the date (which contains the time), and the site parameters,
-   and prints out a banner giving the various dates and times; also
-   computes and returns various jd's, the sidereal time, and the epoch.
-   Returns negative number to signal error if date is out of range of
-   validity of algorithms, or if you specify a bad time during daylight-time
-   change; returns zero if successful.  */
+/* returns the precession matrix for the pair of epochs, from the
+   context's small most-recently-used list if it is there, building
+   it (and dropping the least recently used) if not.  The pointer is
+   good until the next call on the same context. */
 
 {
+   struct precmat found;
+   int i, k;
 
-	double jd, jdloc, jdtest;
-	if((date.y <= 1900) | (date.y >= 2100)) {
-		oprntf("Date out of range - 1901 -> 2099\n");
-		return(-1);
-	}
-	find_dst_bounds(date.y,stdz,use_dst,jdb,jde);
-	oprntf("\nW Long (hms):");
-	put_coords(longit,3);
-	oprntf(", lat (dms):");
-	put_coords(lat,2);
-	oprntf(", std time zone %3.0f hr W\n",stdz);
-	oprntf("\n");
+   for(k = 0; k < ctx->prec_cache_n; k++) {
+	if(ctx->prec_cache[k].orig_epoch == orig_epoch &&
+	   ctx->prec_cache[k].final_epoch == final_epoch) break;
+   }
+   if(k == 0 && ctx->prec_cache_n > 0) return(ctx->prec_cache);
 
-        /* Establish the correct time from the input values ...
-             This is done more compactly in the true_jd function, but
-             the present code prints more warnings, etc, so leave it.*/
+   if(k < ctx->prec_cache_n) found = ctx->prec_cache[k];
+   else {
+	prec_matrix(orig_epoch, final_epoch, &found);
+	if(ctx->prec_cache_n < PREC_CACHE_SIZE) ctx->prec_cache_n++;
+	k = ctx->prec_cache_n - 1;
+   }
+   for(i = k; i > 0; i--) ctx->prec_cache[i] = ctx->prec_cache[i-1];
+   ctx->prec_cache[0] = found;
+   return(ctx->prec_cache);
+}
 
-	if(enter_ut==0) {
-		/* "night date" convention -- adjust date up by one if local
-		      time is in morning. */
-		if((night_date == 1) && (date.h < 12))
-		      date.d = date.d + 1;  /* pass-by-value, I hope */
-		jdloc = date_to_jd(date); /* local */
-		jdtest = jdloc + stdz/24.; /* almost */
-		if(use_dst != 0) {
-		   if((fabs(jdtest-*jdb)<0.5) | (fabs(jdtest-*jde)<0.5)) {
-		   oprntf("** be careful -- near standard and daylight change. ** \n");
-		   }
-		}
-		if(use_dst > 0) {  /* handle exceptions during dst -- std change */
-			if((jdtest - *jdb > 0.)
-				&& (jdtest - *jdb < 0.041666667)) {
-				/* this time doesn't really exist */
-			  oprntf("Nonexistent input time during change to DST!\n");
-			  oprntf("Please respecify time as 1 hour later.\n");
-			  return(-1);  /* return error flag. */
-			}
-			else if((jdtest - *jde >= 0.0) &&
-				(jdtest - *jde < 0.04166667)) {
-			  oprntf("\nCAUTION - DST --> STD -- ambiguous input time defaults to STD!\n");
-			  oprntf("Use 'g' option to specify UT unambiguously.\n");
-			  jd = jdloc + stdz / 24.;
-			}
-			else jd = jdloc +
-				zone(use_dst,stdz,jdtest,*jdb,*jde) / 24.;
-		}
-		else if(use_dst < 0) {  /* south -- reverse jdb & jde */
-			if((jdtest - *jde > 0.)
-				&& (jdtest - *jde < 0.041666667)) {
-				/* this time doesn't really exist */
-			  oprntf("Nonexistent input time during change to DST!\n");
-			  oprntf("Please respecify time as 1 hour later.\n");
-			  return(-1);  /* return error flag. */
-			}
-			else if((jdtest - *jdb >= 0.0) &&
-				(jdtest - *jdb < 0.04166667)) {
-			  oprntf("\nCAUTION - DST --> STD -- ambiguous input time defaults to STD!\n");
-			  oprntf("Use 'g' option to specify UT unambiguously.\n");
-			  jd = jdloc + stdz / 24.;
-			}
-			else jd = jdloc +
-				zone(use_dst,stdz,jdtest,*jdb,*jde) / 24.;
-		}
-		else jd = jdtest;  /* not using dst ... no problem. */
-		oprntf("Local Date and time: ");
-		print_all(jdloc);
-		oprntf(" ");
-		print_tz(jd,use_dst,*jdb,*jde,zabr);
-/*              if(fabs(frac_part(jdloc) - 0.5) < MIDN_TOL)
-		   oprntf("\n(Watch for possible day error near midnight.)");
- .... this really shouldn't happen now. */
-		if(use_dst != 0) {
-		}
+void precrot_r(ctx, rorig, dorig, orig_epoch, final_epoch, rf, df)
 
-		oprntf("\n   UT Date and time: ");
-		print_all(jd);
-		if(fabs(frac_part(jd) - 0.5) < 0.00001)
-		   oprntf("\n(Watch for possible day error near midnight.)");
-	}
-	else {  /* times entered are ut already */
+	struct skycalc_ctx *ctx;
+	double rorig, dorig, orig_epoch, final_epoch, *rf, *df;
 
-		jd = date_to_jd(date);
-		oprntf("   UT Date and time: ");
-		print_all(jd);
-		if(fabs(frac_part(jd) - 0.5) < 0.00001)
-		   oprntf("\n(Watch for possible day error near midnight.)");
-		jdloc = jd - zone(use_dst,stdz,jd,*jdb,*jde)/24.;
-		if(use_dst != 0) {
-		   if((fabs(jd-*jdb)<0.05) | (fabs(jd-*jde)<0.05))
-			oprntf("\nCAUTION..dst/std time changing!");
-		}
-		oprntf("\nlocal Date and time: ");
-		print_all(jdloc);
-		oprntf(" ");
-		print_tz(jd,use_dst,*jdb,*jde,zabr);
-		if(fabs(frac_part(jdloc) - 0.5) < 0.00001)
-		   oprntf("\n(Watch for possible day error near midnight.)");
+/* precrot, but taking the matrix from the context's cache. */
 
-	}
-	if(use_dst != 0) {
-		if(stdz==zone(use_dst,stdz,jd,*jdb,*jde))
-			oprntf("\nDST assumed not in effect\n");
-		else oprntf("\nDST assumed in effect.\n");
-	}
-	oprntf("\nJulian date: %lf",jd);
-	*sid=lst(jd,longit);
-	oprntf("   LMST: ");
-	put_coords(*sid,3);
-	*jdut = jd;
-	*jdlocal = jdloc;
-	*curepoch = 2000.+(jd-J2000)/365.25;
-	return(0);
+{
+   precrot_mat(prec_cache_r(ctx, orig_epoch, final_epoch),
+	rorig, dorig, rf, df);
 }
 
-void print_tonight(date,lat,longit,elevsea,elev,horiz,site_name,stdz,
-	zone_name,zabr,use_dst,jdb,jde,short_long)
+void precrot_batch(pm, ra, dec, mura, mudec, n, rf, df)
 
-struct date_time date;
-double lat, longit, elevsea, elev, horiz, stdz, *jdb, *jde;
-char *site_name, *zone_name, zabr;
-short use_dst, short_long;     /* short_long is a fossil argument which
-                    allows a slightly shorter version to be printed. */
+	struct precmat *pm;
+	double *ra, *dec, *mura, *mudec;
+	size_t n;
+	double *rf, *df;
 
-/* Given site and time information, prints a summary of
-   the important phenomena for a single night.
+/* precesses n positions (decimal hours, decimal degr.) with one
+   matrix.  If mura (sec of time / yr) and mudec (arcsec / yr) are
+   non-NULL, the proper motion over the matrix's interval is added
+   first, as print_circumstances does.  rf and df may be the same
+   arrays as ra and dec.
 
-   The coding in this routine is extremely tortuous ... I even use
-   the dreaded goto statement!  It's inelegant, but (a) the logic is
-   indeed somewhat complicated and (b) it works.  */
+   Blocked like altaz_batch so that each loop calls one libm function
+   and can be vectorised; the back-conversion uses atan2 in place of
+   xyz_cel's branches.  Agrees with precrot to ~1.e-12 degree. */
 
 {
+   size_t i, j, m;
+   double dt, x, y, z, xy, r;
+   double a[BATCH_BLOCK], d[BATCH_BLOCK], cosa[BATCH_BLOCK],
+	sina[BATCH_BLOCK], cosd[BATCH_BLOCK], sind[BATCH_BLOCK];
+
+   dt = pm->final_epoch - pm->orig_epoch;
+
+   for(i = 0; i < n; i += m) {
+	m = (n - i < BATCH_BLOCK) ? n - i : BATCH_BLOCK;
+	for(j = 0; j < m; j++) {
+	   a[j] = ra[i+j];
+	   d[j] = dec[i+j];
+	}
+	if(mura != NULL)
+	   for(j = 0; j < m; j++) a[j] = a[j] + dt * mura[i+j] / 3600.;
+	if(mudec != NULL)
+	   for(j = 0; j < m; j++) d[j] = d[j] + dt * mudec[i+j] / 3600.;
+	for(j = 0; j < m; j++) {
+	   cosa[j] = cos(a[j] / HRS_IN_RADIAN);
+	   cosd[j] = cos(d[j] / DEG_IN_RADIAN);
+	}
+	for(j = 0; j < m; j++) {
+	   sina[j] = sin(a[j] / HRS_IN_RADIAN);
+	   sind[j] = sin(d[j] / DEG_IN_RADIAN);
+	}
+	for(j = 0; j < m; j++) {
+	   x = cosd[j] * cosa[j];
+	   y = cosd[j] * sina[j];
+	   z = sind[j];
+	   a[j] = pm->p[0][0] * x + pm->p[0][1] * y + pm->p[0][2] * z;
+	   d[j] = pm->p[1][0] * x + pm->p[1][1] * y + pm->p[1][2] * z;
+	   sind[j] = pm->p[2][0] * x + pm->p[2][1] * y + pm->p[2][2] * z;
+	}
+	for(j = 0; j < m; j++) {  /* a, d, sind now hold x, y, z */
+	   xy = sqrt(a[j] * a[j] + d[j] * d[j]);
+	   r = atan2(d[j], a[j]);
+	   r = (r < 0.) ? r + 2. * PI : r;
+	   rf[i+j] = (xy < 1.0e-10) ? 0. : r * HRS_IN_RADIAN; /* at pole */
+	   df[i+j] = atan2(sind[j], xy) * DEG_IN_RADIAN;
+	}
+   }
+}
 
-	double jd, jdmid, jdcent, stmid, ramoon, decmoon, distmoon;
-	double geora, geodec, geodist;  /* geocent for moon, not used here.*/
-	double locjdb, locjde;
-	double rasun, decsun, min_alt, max_alt;
-	double hasunset, jdsunset, jdsunrise, sid;
-	double hamoonrise, hamoonset, tmoonrise, tmoonset,
-		jdmoonrise, jdmoonset;
-	double hatwilight, jdtwilight, jdetw, jdmtw;
-	double ill_frac;
-	short dow; /* day of week */
-	float set_to_rise, twi_to_twi, hrs,
-		   moonless_hrs, moony_hrs, moon_print;
-
-	find_dst_bounds(date.y,stdz,use_dst,jdb,jde);
-	locjdb = *jdb-stdz/24.;
-	locjde = *jde-(stdz-1)/24.;
-	date.h = 18;  /* local afternoon */
-	date.mn = 0;
-	date.s = 0;  /* afternoon */
+void mass_precess() {
 
-	oprntf("\nAlmanac for %s:\nlong. ",site_name);
+    double rorig = 1., dorig, orig_epoch, final_epoch, rf, df,
+            mura = 0., mudec = 0., dt;
+    short do_proper = 0;
+
+    printf("Mass precession.  The '=' command does precessions in a pinch, but\n");
+    printf("the present command is convenient for doing several (all with same\n");
+    printf("starting and ending epochs).  This routine does not affect parameters\n");
+    printf("in the rest of the program.\n\n");
+    printf("Type 1 if you need proper motions (They're a pain!), or 0:");
+    scanf("%hd",&do_proper);
+    if(do_proper == 1) {
+	printf("\nA proper motion correction will be included -- it's a simple\n");
+	printf("linear correction (adds mu * dt to coordinate).  Proper motion\n");
+	printf("itself is NOT rigorously transformed (as in B1950->J2000, which\n");
+	printf("involves a small change of inertial reference frame!)\n\n");
+    }
+    printf("Give epoch to precess from:");
+    scanf("%lf",&orig_epoch);
+    printf("Give epoch to precess to:");
+    scanf("%lf",&final_epoch);
+    dt = final_epoch - orig_epoch;
+    while(rorig >= 0.) {
+	printf("\nGive RA for %7.2f (h m s, -1 0 0 to exit):",orig_epoch);
+        rorig = get_coord();
+        if(rorig < 0.) {
+		printf("Exiting precession routine.  Type '?' if you want a menu.\n");
+		return;
+        }
+        printf("Give dec (d m s):");
+        dorig = get_coord();
+	if(do_proper == 1) get_pm(dorig,&mura,&mudec);
+        precrot(rorig,dorig,orig_epoch,final_epoch,&rf,&df);
+	rf = rf + mura * dt / 3600.;
+        df = df + mudec * dt / 3600.;
+        oprntf("\n\n %7.2f : RA = ",orig_epoch);
+        put_coords(rorig,4);
+        oprntf(", dec = ");
+        put_coords(dorig,3);
+        oprntf("\n %7.2f : RA = ",final_epoch);
+        put_coords(rf,4);
+        oprntf(", dec = ");
+        put_coords(df,3);
+        if(do_proper == 1) oprntf("\n RA p.m. = %8.4f sec/yr, dec = %8.3f arcsec/yr",mura,mudec);
+	oprntf("\n");
+    }
+}
+
+/* the rotation from 1950 equatorial to galactic coordinates, used by
+   galact and xform_galactic.  Homebrew algorithm for 3-d Euler
+   rotation into galactic.  Perfectly rigorous, and with reasonably
+   accurate input numbers derived from original IAU definition of
+   galactic pole (12 49, +27.4, 1950) and zero of long (at PA 123 deg
+   from pole.) */
+
+static double galmat[3][3] = {
+	{ -0.066988739415, -0.872755765853, -0.483538914631 },
+	{  0.492728466047, -0.450346958025,  0.744584633299 },
+	{ -0.867600811168, -0.188374601707,  0.460199784759 }
+};	/* derived from Euler angles of
+	theta   265.610844031 deg (rotates x axis to RA of galact center),
+	phi     28.9167903483 deg (rotates x axis to point at galact cent),
+	omega   58.2813466094 deg (rotates z axis to point at galact pole) */
+
+void galact(ra,dec,epoch,glong,glat)
+
+	double ra,dec,epoch,*glong,*glat;
+
+{
+	double r1950,d1950,
+		x0,y0,z0,x1,y1,z1;
+
+/*   EXCISED CODE .... creates matrix from Euler angles. Resurrect if
+     necessary to create new Euler angles for better precision.
+     Program evolved by running and calculating angles,then initializing
+     them to the values they will always have, thus saving space and time.
+
+	cosphi = cos(phi); and so on
+	p11 = cosphi * costhet;
+	p12 = cosphi * sinthet;
+	p13 = -1. * sinphi;
+	p21 = sinom*sinphi*costhet - sinthet*cosom;
+	p22 = cosom*costhet + sinthet*sinphi*sinom;
+	p23 = sinom*cosphi;
+	p31 = sinom*sinthet + cosom*sinphi*costhet;
+	p32 = cosom*sinphi*sinthet - costhet*sinom;
+	p33 = cosom * cosphi;
+
+	printf("%15.10f %15.10f %15.10f\n",p11,p12,p13);
+	printf("%15.10f %15.10f %15.10f\n",p21,p22,p23);
+	printf("%15.10f %15.10f %15.10f\n",p31,p32,p33);
+
+	check = p11*(p22*p33-p32*p23) - p12*(p21*p33-p31*p23) +
+		p13*(p21*p32-p22*p31);
+	printf("Check: %lf\n",check);  check determinant .. ok
+
+    END OF EXCISED CODE..... */
+
+	/* precess to 1950 */
+	precrot(ra,dec,epoch,1950.,&r1950,&d1950);
+	r1950 = r1950 / HRS_IN_RADIAN;
+	d1950 = d1950 / DEG_IN_RADIAN;
+
+	/* form direction cosines */
+	x0 = cos(r1950) * cos(d1950);
+	y0 = sin(r1950) * cos(d1950);
+	z0 = sin(d1950);
+
+	/* rotate 'em */
+	x1 = galmat[0][0]*x0 + galmat[0][1]*y0 + galmat[0][2]*z0;
+	y1 = galmat[1][0]*x0 + galmat[1][1]*y0 + galmat[1][2]*z0;
+	z1 = galmat[2][0]*x0 + galmat[2][1]*y0 + galmat[2][2]*z0;
+
+	/* translate to spherical polars for Galactic coords. */
+	*glong = atan_circ(x1,y1)*DEG_IN_RADIAN;
+	*glat = asin(z1)*DEG_IN_RADIAN;
+}
+
+void eclipt(ra,dec,epoch,jd,curep,eclong,eclat)
+
+           double ra,dec,epoch,jd,*curep,*eclong,*eclat;
+
+ /* ra in decimal hrs, other coords in dec. deg. */
+
+/* converts ra and dec to ecliptic coords -- precesses to current
+   epoch first (and hands current epoch back for printing.)  */
+
+{
+	double incl, T;
+	double racur, decur;
+	double x0,y0,z0,x1,y1,z1;
+
+	T = (jd - J2000)/36525.;  /* centuries since J2000 */
+	*curep = 2000. + (jd - J2000) / 365.25;
+
+	incl = (23.439291 + T * (-0.0130042 - 0.00000016 * T))/DEG_IN_RADIAN;
+		/* 1992 Astron Almanac, p. B18, dropping the
+		   cubic term, which is 2 milli-arcsec! */
+
+	precrot(ra,dec,epoch,*curep,&racur,&decur);
+	racur = racur / HRS_IN_RADIAN;
+	decur = decur / DEG_IN_RADIAN;
+
+	x0=cos(decur)*cos(racur);
+	y0=cos(decur)*sin(racur);
+	z0=sin(decur);
+
+	x1=x0;  /* doesn't change */
+	y1 = cos(incl)*y0 + sin(incl)*z0;
+	z1 = -1 * sin(incl)*y0 + cos(incl)*z0;
+	*eclong = atan_circ(x1,y1) * DEG_IN_RADIAN;
+	*eclat = asin(z1) * DEG_IN_RADIAN;
+}
+
+void xform_ident(xf)
+
+	struct xform *xf;
+
+/* sets xf to the identity -- the start of every chain of xform_
+   calls. */
+
+{
+	int i, j;
+
+	for(i = 0; i < 3; i++)
+		for(j = 0; j < 3; j++) xf->m[i][j] = (i == j) ? 1. : 0.;
+}
+
+void xform_then(xf, p)
+
+	struct xform *xf;
+	double p[3][3];
+
+/* follows the rotation in xf with the rotation p, fusing the two
+   into xf (xf = p xf), so that however long the chain, each vector
+   is rotated only once. */
+
+{
+	double t[3][3];
+	int i, j;
+
+	for(i = 0; i < 3; i++)
+		for(j = 0; j < 3; j++)
+			t[i][j] = p[i][0] * xf->m[0][j] + p[i][1] * xf->m[1][j]
+				+ p[i][2] * xf->m[2][j];
+	for(i = 0; i < 3; i++)
+		for(j = 0; j < 3; j++) xf->m[i][j] = t[i][j];
+}
+
+void xform_invert(xf)
+
+	struct xform *xf;
+
+/* turns xf around (galactic back to equatorial, say); the inverse
+   of a rotation is its transpose. */
+
+{
+	double t;
+	int i, j;
+
+	for(i = 0; i < 3; i++)
+		for(j = i + 1; j < 3; j++) {
+			t = xf->m[i][j];
+			xf->m[i][j] = xf->m[j][i];
+			xf->m[j][i] = t;
+		}
+}
+
+void xform_precess_r(ctx, xf, orig_epoch, final_epoch)
+
+	struct skycalc_ctx *ctx;
+	struct xform *xf;
+	double orig_epoch, final_epoch;
+
+/* follows xf with precession from orig_epoch to final_epoch
+   (years), the matrix coming from the context's cache as for
+   precrot_r. */
+
+{
+	xform_then(xf, prec_cache_r(ctx, orig_epoch, final_epoch)->p);
+}
+
+void xform_precess(xf, orig_epoch, final_epoch)
+
+	struct xform *xf;
+	double orig_epoch, final_epoch;
+
+{
+	xform_precess_r(&skycalc_default_ctx, xf, orig_epoch, final_epoch);
+}
+
+void xform_galactic(xf)
+
+	struct xform *xf;
+
+/* follows xf with the rotation from 1950 equatorial coordinates to
+   galactic, as galact -- so precess to 1950 first. */
+
+{
+	xform_then(xf, galmat);
+}
+
+void xform_ecliptic(xf, jd)
+
+	struct xform *xf;
+	double jd;
+
+/* follows xf with the rotation from the equator of date to the
+   ecliptic of date at jd, as eclipt -- so precess to the epoch of
+   jd, 2000. + (jd - J2000) / 365.25, first. */
+
+{
+	double T, incl, p[3][3];
+
+	T = (jd - J2000)/36525.;
+	incl = (23.439291 + T * (-0.0130042 - 0.00000016 * T))/DEG_IN_RADIAN;
+
+	p[0][0] = 1.;  p[0][1] = 0.;         p[0][2] = 0.;
+	p[1][0] = 0.;  p[1][1] = cos(incl);  p[1][2] = sin(incl);
+	p[2][0] = 0.;  p[2][1] = -sin(incl); p[2][2] = cos(incl);
+	xform_then(xf, p);
+}
+
+void xform_apply(xf, x, y, z, n, xf_x, xf_y, xf_z)
+
+	struct xform *xf;
+	double *x, *y, *z;
+	size_t n;
+	double *xf_x, *xf_y, *xf_z;
+
+/* rotates n vectors, held as separate x, y and z arrays, by xf.
+   The outputs may be the same arrays as the inputs.  The loop is
+   straight multiply-adds, and vectorises at -O3. */
+
+{
+	size_t i;
+	double a, b, c;
+	double m00 = xf->m[0][0], m01 = xf->m[0][1], m02 = xf->m[0][2],
+		m10 = xf->m[1][0], m11 = xf->m[1][1], m12 = xf->m[1][2],
+		m20 = xf->m[2][0], m21 = xf->m[2][1], m22 = xf->m[2][2];
+
+	for(i = 0; i < n; i++) {
+		a = x[i];
+		b = y[i];
+		c = z[i];
+		xf_x[i] = m00 * a + m01 * b + m02 * c;
+		xf_y[i] = m10 * a + m11 * b + m12 * c;
+		xf_z[i] = m20 * a + m21 * b + m22 * c;
+	}
+}
+
+void sph_xyz_batch(lon, lat, lonunit, n, x, y, z)
+
+	double *lon, *lat, lonunit;
+	size_t n;
+	double *x, *y, *z;
+
+/* unit vectors for n positions -- longitudes (ra) in lon and
+   latitudes (dec) in degrees in lat.  lonunit is the number of
+   longitude units in a radian, HRS_IN_RADIAN for ra in hours or
+   DEG_IN_RADIAN for degrees.  Blocked like altaz_batch so that each
+   loop calls one libm function and can be vectorised. */
+
+{
+	size_t i, j, m;
+	double cosa[BATCH_BLOCK], sina[BATCH_BLOCK], cosd[BATCH_BLOCK];
+
+	for(i = 0; i < n; i += m) {
+		m = (n - i < BATCH_BLOCK) ? n - i : BATCH_BLOCK;
+		for(j = 0; j < m; j++) {
+			cosa[j] = cos(lon[i+j] / lonunit);
+			cosd[j] = cos(lat[i+j] / DEG_IN_RADIAN);
+		}
+		for(j = 0; j < m; j++) {
+			sina[j] = sin(lon[i+j] / lonunit);
+			z[i+j] = sin(lat[i+j] / DEG_IN_RADIAN);
+		}
+		for(j = 0; j < m; j++) {
+			x[i+j] = cosd[j] * cosa[j];
+			y[i+j] = cosd[j] * sina[j];
+		}
+	}
+}
+
+void xyz_sph_batch(x, y, z, n, lonunit, lon, lat)
+
+	double *x, *y, *z;
+	size_t n;
+	double lonunit;
+	double *lon, *lat;
+
+/* the reverse of sph_xyz_batch: longitudes, 0 to 2 pi in lonunit's
+   units, and latitudes in degrees for n vectors, which need not be
+   normalized.  atan2 stands in for xyz_cel's branches, as in
+   precrot_batch; lon is 0 at the poles. */
+
+{
+	size_t i;
+	double xy, r;
+
+	for(i = 0; i < n; i++) {
+		xy = sqrt(x[i] * x[i] + y[i] * y[i]);
+		r = atan2(y[i], x[i]);
+		r = (r < 0.) ? r + 2. * PI : r;
+		lon[i] = (xy < 1.0e-10) ? 0. : r * lonunit;
+		lat[i] = atan2(z[i], xy) * DEG_IN_RADIAN;
+	}
+}
+
+void xform_coords(xf, lon, lat, inunit, n, outunit, xf_lon, xf_lat)
+
+	struct xform *xf;
+	double *lon, *lat, inunit;
+	size_t n;
+	double outunit, *xf_lon, *xf_lat;
+
+/* transforms n positions by xf -- sph_xyz_batch, xform_apply and
+   xyz_sph_batch in turn on BATCH_BLOCK positions at a time, so
+   nothing is allocated and the vectors stay in L1.  inunit and
+   outunit are the longitude units, as sph_xyz_batch's lonunit.  The
+   outputs may be the same arrays as the inputs.  For example,
+   galactic coordinates of ra, dec (hours, degrees) at epoch are
+
+	xform_ident(&xf);
+	xform_precess(&xf, epoch, 1950.);
+	xform_galactic(&xf);
+	xform_coords(&xf, ra, dec, HRS_IN_RADIAN, n, DEG_IN_RADIAN,
+		glong, glat);
+
+   which agrees with galact to ~1.e-8 degree. */
+
+{
+	size_t i, m;
+	double x[BATCH_BLOCK], y[BATCH_BLOCK], z[BATCH_BLOCK];
+
+	for(i = 0; i < n; i += m) {
+		m = (n - i < BATCH_BLOCK) ? n - i : BATCH_BLOCK;
+		sph_xyz_batch(lon + i, lat + i, inunit, m, x, y, z);
+		xform_apply(xf, x, y, z, m, x, y, z);
+		xyz_sph_batch(x, y, z, m, outunit, xf_lon + i, xf_lat + i);
+	}
+}
+
+void galact_batch_r(ctx, ra, dec, epoch, n, glong, glat)
+
+	struct skycalc_ctx *ctx;
+	double *ra, *dec, epoch;
+	size_t n;
+	double *glong, *glat;
+
+/* galact for n positions (decimal hours, decimal degr.) at one
+   epoch; glong and glat come back in degrees. */
+
+{
+	struct xform xf;
+
+	xform_ident(&xf);
+	xform_precess_r(ctx, &xf, epoch, 1950.);
+	xform_galactic(&xf);
+	xform_coords(&xf, ra, dec, HRS_IN_RADIAN, n, DEG_IN_RADIAN,
+		glong, glat);
+}
+
+void galact_batch(ra, dec, epoch, n, glong, glat)
+
+	double *ra, *dec, epoch;
+	size_t n;
+	double *glong, *glat;
+
+{
+	galact_batch_r(&skycalc_default_ctx, ra, dec, epoch, n, glong, glat);
+}
+
+void eclipt_batch_r(ctx, ra, dec, epoch, jd, n, eclong, eclat)
+
+	struct skycalc_ctx *ctx;
+	double *ra, *dec, epoch, jd;
+	size_t n;
+	double *eclong, *eclat;
+
+/* eclipt for n positions (decimal hours, decimal degr.) at one
+   epoch, referred to the ecliptic and equinox of jd; eclong and
+   eclat come back in degrees. */
+
+{
+	struct xform xf;
+
+	xform_ident(&xf);
+	xform_precess_r(ctx, &xf, epoch, 2000. + (jd - J2000) / 365.25);
+	xform_ecliptic(&xf, jd);
+	xform_coords(&xf, ra, dec, HRS_IN_RADIAN, n, DEG_IN_RADIAN,
+		eclong, eclat);
+}
+
+void eclipt_batch(ra, dec, epoch, jd, n, eclong, eclat)
+
+	double *ra, *dec, epoch, jd;
+	size_t n;
+	double *eclong, *eclat;
+
+{
+	eclipt_batch_r(&skycalc_default_ctx, ra, dec, epoch, jd, n,
+		eclong, eclat);
+}
+
+double parang(ha,dec,lat)
+
+	double ha,dec,lat;
+
+ /* decimal hours, degrees, and degrees. */
+
+{
+	/* finds the parallactic angle.  This is a little
+	   complicated (see Filippenko PASP 94, 715 (1982) */
+
+	double colat,codec,hacrit,sineta,denom;
+
+	ha = ha / HRS_IN_RADIAN;
+	dec = dec / DEG_IN_RADIAN;
+	lat = lat / DEG_IN_RADIAN;
+
+	/* Filippenko eqn 10 follows -- guarded against division by zero
+             at the exact zenith .... */
+	denom =
+	   sqrt(1.-pow((sin(lat)*sin(dec)+cos(lat)*cos(dec)*cos(ha)),2.));
+	if(denom != 0.)
+	    sineta = sin(ha)*cos(lat)/denom;
+	else sineta = 0.;
+
+	if(lat >= 0.) {
+		/* northern hemisphere case */
+
+		/* If you're south of zenith, no problem. */
+
+		if(dec<lat) return (asin(sineta)*DEG_IN_RADIAN);
+
+		else {
+			/* find critical hour angle -- where parallactic
+				angle becomes 90 deg.  After that,
+				take another root of expression. */
+			colat = PI /2. - lat;
+			codec = PI /2. - dec;
+			hacrit = 1.-pow(cos(colat),2.)/pow(cos(codec),2.);
+			hacrit = sqrt(hacrit)/sin(colat);
+			if(fabs(hacrit) <= 1.00) hacrit = asin(hacrit);
+			else oprntf("Error in parang..asin(>1)\n");
+			if(fabs(ha) > fabs(hacrit))
+				return(asin(sineta)*DEG_IN_RADIAN);
+				/* comes out ok at large hour angle */
+			else if (ha > 0)
+				return((PI - asin(sineta))*DEG_IN_RADIAN);
+			else return((-1.* PI - asin(sineta))*DEG_IN_RADIAN);
+		}
+	}
+	else {  /* Southern hemisphere case follows */
+		/* If you're north of zenith, no problem. */
+		if(dec>lat) {
+			if(ha >= 0)
+				return ((PI - asin(sineta))*DEG_IN_RADIAN);
+			else return(-1*(PI + asin(sineta)) * DEG_IN_RADIAN);
+		}
+		else {
+			/* find critical hour angle -- where parallactic
+				angle becomes 90 deg.  After that,
+				take another root of expression. */
+			colat = -1*PI/2. - lat;
+			codec = PI/2. - dec;
+			hacrit = 1.-pow(cos(colat),2.)/pow(cos(codec),2.);
+			hacrit = sqrt(hacrit)/sin(colat);
+			if(fabs(hacrit) <= 1.00) hacrit = asin(hacrit);
+			else oprntf("Error in parang..asin(>1)\n");
+			if(fabs(ha) > fabs(hacrit)) {
+				if(ha >= 0)
+				    return((PI - asin(sineta))*DEG_IN_RADIAN);
+				else return(-1. * (PI + asin(sineta))*DEG_IN_RADIAN);
+			}
+			else return(asin(sineta)*DEG_IN_RADIAN);
+		}
+	}
+}
+
+/* Planetary part, added 1992 August.  The intention of this is
+   to compute low-precision planetary positions for general info
+   and to inform user if observation might be interfered with by
+   a planet -- a rarity, but it happens.  Also designed to make
+   handy low-precision planet positions available for casual
+   planning purposes.  Do not try to point blindly right at the
+   middle of a planetary disk with these routines!  */
+
+void elrot_load(ctx)
+
+	struct skycalc_ctx *ctx;
+
+/* fills in ctx->elr[] from the elements in ctx->el[]. */
+
+{
+	struct elements *el;
+	struct elrot *er;
+	double e, ii, Om, om;
+	int p;
+
+	for(p = 1; p <= 9; p++) {
+		el = ctx->el + p;
+		er = ctx->elr + p;
+		ii = el->incl/DEG_IN_RADIAN;
+		Om = el->Omega / DEG_IN_RADIAN;
+		om = el->omega / DEG_IN_RADIAN;
+		e = el->ecc;
+		er->ecc = e;
+		er->c1 = 2.*e - 0.25 * e * e * e;
+		er->c2 = 1.25 * e * e;
+		er->c3 = 1.08333333 * e * e * e;
+		er->p = el->a * (1. - e*e);
+		er->M0 = el->L_0 / DEG_IN_RADIAN - om;
+		er->n = el->daily / DEG_IN_RADIAN;
+		er->cw = cos(om - Om);
+		er->sw = sin(om - Om);
+		er->P[0] = cos(Om);
+		er->P[1] = sin(Om);
+		er->P[2] = 0.;
+		er->Q[0] = -cos(ii) * sin(Om);
+		er->Q[1] = cos(ii) * cos(Om);
+		er->Q[2] = sin(ii);
+	}
+}
+
+void comp_el_r(ctx,jd)
+
+	struct skycalc_ctx *ctx;
+	double jd;
+{
+
+   double T, Tsq, Tcb, d;
+   double ups, P, Q, S, V, W, G, H, zeta, psi; /* Meeus p. 110 ff. */
+   double sinQ,sinZeta,cosQ,cosZeta,sinV,cosV,
+	sin2Zeta,cos2Zeta;
+
+   ctx->jd_el = jd;   /* true, but not necessarily; set explicitly */
+   d = jd - 2415020.;
+   T = d / 36525.;
+   Tsq = T * T;
+   Tcb = Tsq * T;
+
+/* computes and loads mean elements for planets.  */
+
+/* Mercury, Venus, and Mars from Explanatory Suppl., p. 113 */
+
+   strcpy(ctx->el[1].name,"Mercury");
+   ctx->el[1].incl = 7.002880 + 1.8608e-3 * T - 1.83e-5 * Tsq;
+   ctx->el[1].Omega = 47.14594 + 1.185208 * T + 1.74e-4 * Tsq;
+   ctx->el[1].omega = 75.899697 + 1.55549 * T + 2.95e-4 * Tsq;
+   ctx->el[1].a = .3870986;
+   ctx->el[1].daily = 4.0923388;
+   ctx->el[1].ecc = 0.20561421 + 0.00002046 * T;
+   ctx->el[1].L_0 = 178.179078 + 4.0923770233 * d  +
+	 0.0000226 * pow((3.6525 * T),2.);
+
+   strcpy(ctx->el[2].name,"Venus  ");
+   ctx->el[2].incl = 3.39363 + 1.00583e-03 * T - 9.722e-7 * Tsq;
+   ctx->el[2].Omega = 75.7796472 + 0.89985 * T + 4.1e-4 * Tsq;
+   ctx->el[2].omega = 130.16383 + 1.4080 * T + 9.764e-4 * Tsq;
+   ctx->el[2].a = .723325;
+   ctx->el[2].daily = 1.60213049;
+   ctx->el[2].ecc = 0.00682069 - 0.00004774 * T;
+   ctx->el[2].L_0 = 342.767053 + 1.6021687039 * 36525 * T +
+	 0.000023212 * pow((3.6525 * T),2.);
+
+/* Earth from old Nautical Almanac .... */
+
+   strcpy(ctx->el[5].name,"Earth  ");
+   ctx->el[3].ecc = 0.01675104 - 0.00004180*T + 0.000000126*Tsq;
+   ctx->el[3].incl = 0.0;
+   ctx->el[3].Omega = 0.0;
+   ctx->el[3].omega = 101.22083 + 0.0000470684*d + 0.000453*Tsq + 0.000003*Tcb;
+   ctx->el[3].a = 1.0000007;;
+   ctx->el[3].daily = 0.985599;
+   ctx->el[3].L_0 = 358.47583 + 0.9856002670*d - 0.000150*Tsq - 0.000003*Tcb +
+	    ctx->el[3].omega;
+
+   strcpy(ctx->el[4].name,"Mars   ");
+   ctx->el[4].incl = 1.85033 - 6.75e-04 * T - 1.833e-5 * Tsq;
+   ctx->el[4].Omega = 48.786442 + .770992 * T + 1.39e-6 * Tsq;
+   ctx->el[4].omega = 334.218203 + 1.840758 * T + 1.299e-4 * Tsq;
+   ctx->el[4].a = 1.5236915;
+   ctx->el[4].daily = 0.5240329502 + 1.285e-9 * T;
+   ctx->el[4].ecc = 0.09331290 - 0.000092064 * T - 0.000000077 * Tsq;
+   ctx->el[4].L_0 = 293.747628 + 0.5240711638 * d  +
+	 0.000023287 * pow((3.6525 * T),2.);
+
+/* Outer planets from Jean Meeus, Astronomical Formulae for
+   Calculators, 3rd edition, Willman-Bell; p. 100. */
+
+   strcpy(ctx->el[5].name,"Jupiter");
+   ctx->el[5].incl = 1.308736 - 0.0056961 * T + 0.0000039 * Tsq;
+   ctx->el[5].Omega = 99.443414 + 1.0105300 * T + 0.0003522 * Tsq
+		- 0.00000851 * Tcb;
+   ctx->el[5].omega = 12.720972 + 1.6099617 * T + 1.05627e-3 * Tsq
+	- 3.43e-6 * Tcb;
+   ctx->el[5].a = 5.202561;
+   ctx->el[5].daily = 0.08312941782;
+   ctx->el[5].ecc = .04833475  + 1.64180e-4 * T - 4.676e-7*Tsq -
+	1.7e-9 * Tcb;
+   ctx->el[5].L_0 = 238.049257 + 3036.301986 * T + 0.0003347 * Tsq -
+	1.65e-6 * Tcb;
+
+   /* The outer planets have such large mutual interactions that
+      even fair accuracy requires lots of perturbations --- here
+      are some of the larger ones, from Meeus' book. */
+
+   ups = 0.2*T + 0.1;
+   P = (237.47555 + 3034.9061 * T) / DEG_IN_RADIAN;
+   Q = (265.91650 + 1222.1139 * T) / DEG_IN_RADIAN;
+   S = (243.51721 + 428.4677 * T) / DEG_IN_RADIAN;
+   V = 5*Q - 2*P;
+   W = 2*P - 6*Q + 3*S;
+   zeta = Q - P;
+   psi = S - Q;
+   sinQ = sin(Q);
+   cosQ = cos(Q);
+   sinV = sin(V);
+   cosV = cos(V);
+   sinZeta = sin(zeta);
+   cosZeta = cos(zeta);
+   sin2Zeta = sin(2*zeta);
+   cos2Zeta = cos(2*zeta);
+
+   ctx->el[5].L_0 = ctx->el[5].L_0
+	+ (0.331364 - 0.010281*ups - 0.004692*ups*ups)*sinV
+	+ (0.003228 - 0.064436*ups + 0.002075*ups*ups)*cosV
+	- (0.003083 + 0.000275*ups - 0.000489*ups*ups)*sin(2*V)
+	+ 0.002472 * sin(W) + 0.013619 * sinZeta + 0.018472 * sin2Zeta
+	+ 0.006717 * sin(3*zeta)
+	+ (0.007275  - 0.001253*ups) * sinZeta * sinQ
+	+ 0.006417 * sin2Zeta * sinQ
+	- (0.033839 + 0.001253 * ups) * cosZeta * sinQ
+	- (0.035681 + 0.001208 * ups) * sinZeta * sinQ;
+	/* only part of the terms, the ones first on the list and
+	   selected larger-amplitude terms from farther down. */
+
+   ctx->el[5].ecc = ctx->el[5].ecc + 1e-7 * (
+	  (3606 + 130 * ups - 43 * ups*ups) * sinV
+	+ (1289 - 580 * ups) * cosV - 6764 * sinZeta * sinQ
+	- 1110 * sin2Zeta * sin(Q)
+	+ (1284 + 116 * ups) * cosZeta * sinQ
+	+ (1460 + 130 * ups) * sinZeta * cosQ
+	+ 6074 * cosZeta * cosQ);
+
+   ctx->el[5].omega = ctx->el[5].omega
+	+ (0.007192 - 0.003147 * ups) * sinV
+	+ ( 0.000197*ups*ups - 0.00675*ups - 0.020428) * cosV
+	+ 0.034036 * cosZeta * sinQ + 0.037761 * sinZeta * cosQ;
+
+   ctx->el[5].a = ctx->el[5].a + 1.0e-6 * (
+	205 * cosZeta - 263 * cosV + 693 * cos2Zeta + 312 * sin(3*zeta)
+	+ 147 * cos(4*zeta) + 299 * sinZeta * sinQ
+	+ 181 * cos2Zeta * sinQ + 181 * cos2Zeta * sinQ
+	+ 204 * sin2Zeta * cosQ + 111 * sin(3*zeta) * cosQ
+	- 337 * cosZeta * cosQ - 111 * cos2Zeta * cosQ
+	);
+
+   strcpy(ctx->el[6].name,"Saturn ");
+   ctx->el[6].incl = 2.492519 - 0.00034550*T - 7.28e-7*Tsq;
+   ctx->el[6].Omega = 112.790414 + 0.8731951*T - 0.00015218*Tsq - 5.31e-6*Tcb ;
+   ctx->el[6].omega = 91.098214 + 1.9584158*T + 8.2636e-4*Tsq;
+   ctx->el[6].a = 9.554747;
+   ctx->el[6].daily = 0.0334978749897;
+   ctx->el[6].ecc = 0.05589232 - 3.4550e-4 * T - 7.28e-7*Tsq;
+   ctx->el[6].L_0 = 266.564377 + 1223.509884*T + 0.0003245*Tsq - 5.8e-6*Tcb
+	+ (0.018150*ups - 0.814181 + 0.016714 * ups*ups) * sinV
+	+ (0.160906*ups - 0.010497 - 0.004100 * ups*ups) * cosV
+	+ 0.007581 * sin(2*V) - 0.007986 * sin(W)
+	- 0.148811 * sinZeta - 0.040786*sin2Zeta
+	- 0.015208 * sin(3*zeta) - 0.006339 * sin(4*zeta)
+	- 0.006244 * sinQ
+	+ (0.008931 + 0.002728 * ups) * sinZeta * sinQ
+	- 0.016500 * sin2Zeta * sinQ
+	- 0.005775 * sin(3*zeta) * sinQ
+	+ (0.081344 + 0.003206 * ups) * cosZeta * sinQ
+	+ 0.015019 * cos2Zeta * sinQ
+	+ (0.085581 + 0.002494 * ups) * sinZeta * cosQ
+	+ (0.025328 - 0.003117 * ups) * cosZeta * cosQ
+	+ 0.014394 * cos2Zeta * cosQ;   /* truncated here -- no
+		      terms larger than 0.01 degrees, but errors may
+		      accumulate beyond this.... */
+   ctx->el[6].ecc = ctx->el[6].ecc + 1.0e-7 * (
+	  (2458 * ups - 7927.) * sinV + (13381. + 1226. * ups) * cosV
+	+ 12415. * sinQ + 26599. * cosZeta * sinQ
+	- 4687. * cos2Zeta * sinQ - 12696. * sinZeta * cosQ
+	- 4200. * sin2Zeta * cosQ +(2211. - 286*ups) * sinZeta*sin(2*Q)
+	- 2208. * sin2Zeta * sin(2*Q)
+	- 2780. * cosZeta * sin(2*Q) + 2022. * cos2Zeta*sin(2*Q)
+	- 2842. * sinZeta * cos(2*Q) - 1594. * cosZeta * cos(2*Q)
+	+ 2162. * cos2Zeta*cos(2*Q) );  /* terms with amplitudes
+	    > 2000e-7;  some secular variation ignored. */
+   ctx->el[6].omega = ctx->el[6].omega
+	+ (0.077108 + 0.007186 * ups - 0.001533 * ups*ups) * sinV
+	+ (0.045803 - 0.014766 * ups - 0.000536 * ups*ups) * cosV
+	- 0.075825 * sinZeta * sinQ - 0.024839 * sin2Zeta*sinQ
+	- 0.072582 * cosQ - 0.150383 * cosZeta * cosQ +
+	0.026897 * cos2Zeta * cosQ;  /* all terms with amplitudes
+	    greater than 0.02 degrees -- lots of others! */
+   ctx->el[6].a = ctx->el[6].a + 1.0e-6 * (
+	2933. * cosV + 33629. * cosZeta - 3081. * cos2Zeta
+	- 1423. * cos(3*zeta) + 1098. * sinQ - 2812. * sinZeta * sinQ
+	+ 2138. * cosZeta * sinQ  + 2206. * sinZeta * cosQ
+	- 1590. * sin2Zeta*cosQ + 2885. * cosZeta * cosQ
+	+ 2172. * cos2Zeta * cosQ);  /* terms with amplitudes greater
+	   than 1000 x 1e-6 */
+
+   strcpy(ctx->el[7].name,"Uranus ");
+   ctx->el[7].incl = 0.772464 + 0.0006253*T + 0.0000395*Tsq;
+   ctx->el[7].Omega = 73.477111 + 0.4986678*T + 0.0013117*Tsq;
+   ctx->el[7].omega = 171.548692 + 1.4844328*T + 2.37e-4*Tsq - 6.1e-7*Tcb;
+   ctx->el[7].a = 19.21814;
+   ctx->el[7].daily = 1.1769022484e-2;
+   ctx->el[7].ecc = 0.0463444 - 2.658e-5 * T;
+   ctx->el[7].L_0 = 244.197470 + 429.863546*T + 0.000316*Tsq - 6e-7*Tcb;
+   /* stick in a little bit of perturbation -- this one really gets
+      yanked around.... after Meeus p. 116*/
+   G = (83.76922 + 218.4901 * T)/DEG_IN_RADIAN;
+   H = 2*G - S;
+   ctx->el[7].L_0 = ctx->el[7].L_0 + (0.864319 - 0.001583 * ups) * sin(H)
+	+ (0.082222 - 0.006833 * ups) * cos(H)
+	+ 0.036017 * sin(2*H);
+   ctx->el[7].omega = ctx->el[7].omega + 0.120303 * sin(H)
+	+ (0.019472 - 0.000947 * ups) * cos(H)
+	+ 0.006197 * sin(2*H);
+   ctx->el[7].ecc = ctx->el[7].ecc + 1.0e-7 * (
+	20981. * cos(H) - 3349. * sin(H) + 1311. * cos(2*H));
+   ctx->el[7].a = ctx->el[7].a - 0.003825 * cos(H);
+
+   /* other corrections to "true longitude" are ignored. */
+
+   strcpy(ctx->el[8].name,"Neptune");
+   ctx->el[8].incl = 1.779242 - 9.5436e-3 * T - 9.1e-6*Tsq;
+   ctx->el[8].Omega = 130.681389 + 1.0989350 * T + 2.4987e-4*Tsq - 4.718e-6*Tcb;
+   ctx->el[8].omega = 46.727364 + 1.4245744*T + 3.9082e-3*Tsq - 6.05e-7*Tcb;
+   ctx->el[8].a = 30.10957;
+   ctx->el[8].daily = 6.020148227e-3;
+   ctx->el[8].ecc = 0.00899704 + 6.33e-6 * T;
+   ctx->el[8].L_0 = 84.457994 + 219.885914*T + 0.0003205*Tsq - 6e-7*Tcb;
+   ctx->el[8].L_0 = ctx->el[8].L_0
+	- (0.589833 - 0.001089 * ups) * sin(H)
+	- (0.056094 - 0.004658 * ups) * cos(H)
+	- 0.024286 * sin(2*H);
+   ctx->el[8].omega = ctx->el[8].omega + 0.024039 * sin(H)
+	- 0.025303 * cos(H);
+   ctx->el[8].ecc = ctx->el[8].ecc + 1.0e-7 * (
+	4389. * sin(H) + 1129. * sin(2.*H)
+	+ 4262. * cos(H) + 1089. * cos(2.*H));
+   ctx->el[8].a = ctx->el[8].a + 8.189e-3 * cos(H);
+
+/* crummy -- osculating elements a la Sept 15 1992 */
+
+   d = jd - 2448880.5;  /* 1992 Sep 15 */
+   T = d / 36525.;
+   strcpy(ctx->el[9].name,"Pluto  ");
+   ctx->el[9].incl = 17.1426;
+   ctx->el[9].Omega = 110.180;
+   ctx->el[9].omega = 223.782;
+   ctx->el[9].a = 39.7465;
+   ctx->el[9].daily = 0.00393329;
+   ctx->el[9].ecc = 0.253834;
+   ctx->el[9].L_0 = 228.1027 + 0.00393329 * d;
+/*   printf("inc Om om : %f %f %f\n",ctx->el[9].incl,ctx->el[9].Omega,ctx->el[9].omega);
+   printf("a  dail ecc: %f %f %f\n",ctx->el[9].a,ctx->el[9].daily,ctx->el[9].ecc);
+   printf("L_0 %f\n",ctx->el[9].L_0);
+*/
+   ctx->el[1].mass = 1.660137e-7;  /* in units of sun's mass, IAU 1976 */
+   ctx->el[2].mass = 2.447840e-6;  /* from 1992 *Astron Almanac*, p. K7 */
+   ctx->el[3].mass = 3.040433e-6;  /* earth + moon */
+   ctx->el[4].mass = 3.227149e-7;
+   ctx->el[5].mass = 9.547907e-4;
+   ctx->el[6].mass = 2.858776e-4;
+   ctx->el[7].mass = 4.355401e-5;
+   ctx->el[8].mass = 5.177591e-5;
+   ctx->el[9].mass = 7.69e-9;  /* Pluto+Charon -- ? */
+
+   elrot_load(ctx);
+}
+
+void comp_el(jd)
+	double jd;
+{
+	comp_el_r(&skycalc_default_ctx,jd);
+}
+
+void planet_state_r(ctx, p, jd, xyz, vel)
+
+	struct skycalc_ctx *ctx;
+	int p;
+	double jd, *xyz, *vel;
+
+/* ecliptic position xyz[0..2] (AU) of planet number p at jd, and
+   if vel isn't NULL its velocity vel[0..2] (AU per day) with it,
+   from the elements loaded by comp_el_r -- or from the context's
+   ephemeris file, if it has one that covers jd.  The velocity is the
+   exact derivative of the position formula, so it needs no further
+   positions. */
+
+{
+	struct elrot *er;
+	double M, sM, cM, s2M, c2M, nu, snu, cnu, den, r, u, v;
+	double nudot, rdot;
+	int i;
+
+	if(ctx->eph != NULL &&   /* the file's fit is differentiated exactly */
+	   skyeph_eval(ctx->eph,p,jd,xyz,vel) == 0) return;
+
+/* see 1992 Astronomical Almanac, p. E 4 for these formulae. */
+
+	er = ctx->elr + p;
+	M = er->n * (jd - ctx->jd_el) + er->M0;
+	sM = sin(M);
+	cM = cos(M);
+	s2M = 2. * sM * cM;
+	c2M = cM * cM - sM * sM;
+	nu = M + er->c1 * sM + er->c2 * s2M +
+	     er->c3 * (s2M * cM + c2M * sM);    /* sin 3M */
+	snu = sin(nu);
+	cnu = cos(nu);
+	den = 1. + er->ecc * cnu;
+	r = er->p / den;
+	u = cnu * er->cw - snu * er->sw;   /* cos and sin of nu + omnotil */
+	v = snu * er->cw + cnu * er->sw;
+	for(i = 0; i < 3; i++) xyz[i] = r * (u * er->P[i] + v * er->Q[i]);
+	if(vel == NULL) return;
+
+	nudot = er->n * (1. + er->c1 * cM + 2. * er->c2 * c2M +
+		3. * er->c3 * (c2M * cM - s2M * sM));   /* cos 3M */
+	rdot = r * er->ecc * snu * nudot / den;
+	for(i = 0; i < 3; i++)
+		vel[i] = rdot * (u * er->P[i] + v * er->Q[i]) +
+			r * nudot * (u * er->Q[i] - v * er->P[i]);
+}
+
+void planet_state(p, jd, xyz, vel)
+	int p;
+	double jd, *xyz, *vel;
+{
+	planet_state_r(&skycalc_default_ctx,p,jd,xyz,vel);
+}
+
+void planet_state_batch_r(ctx, np, p, nt, jd, xyz, vel)
+
+	struct skycalc_ctx *ctx;
+	int np, *p, nt;
+	double *jd, *xyz, *vel;
+
+/* planet_state_r for each of the np planets p[] at each of the nt
+   times jd[], all from the elements now loaded: body j at time k is
+   xyz[3 * (k * np + j)] on, and likewise in vel, which can be NULL.
+   The elements change slowly, so one comp_el_r near the middle of a
+   span of days or weeks does for all of it. */
+
+{
+	int j, k;
+	double *vk;
+
+	for(k = 0; k < nt; k++)
+		for(j = 0; j < np; j++) {
+			vk = (vel == NULL) ? (double *) NULL :
+				vel + 3 * ((size_t) k * np + j);
+			planet_state_r(ctx,p[j],jd[k],xyz + 3 * ((size_t) k * np + j),
+				vk);
+		}
+}
+
+void planet_state_batch(np, p, nt, jd, xyz, vel)
+	int np, *p, nt;
+	double *jd, *xyz, *vel;
+{
+	planet_state_batch_r(&skycalc_default_ctx,np,p,nt,jd,xyz,vel);
+}
+
+void planetxyz_r(ctx, p, jd, x, y, z)
+
+	struct skycalc_ctx *ctx;
+	int p;
+	double jd, *x, *y, *z;
+
+/* produces ecliptic x,y,z coordinates for planet number 'p'
+   at date jd.  From the context's ephemeris file, if it has one
+   that covers jd -- in which case the elements are those of jd
+   itself, not of jd_el.  See planet_state_r. */
+
+{
+	double xyz[3];
+
+	planet_state_r(ctx,p,jd,xyz,(double *) NULL);
+	*x = xyz[0];
+	*y = xyz[1];
+	*z = xyz[2];
+}
+
+void planetxyz(p, jd, x, y, z)
+	int p;
+	double jd, *x, *y, *z;
+{
+	planetxyz_r(&skycalc_default_ctx,p,jd,x,y,z);
+}
+
+
+void planetvel_r(ctx, p, jd, vx, vy, vz)
+	struct skycalc_ctx *ctx;
+	int p;
+	double jd, *vx, *vy, *vz;
+{
+/* planet velocity, in ecliptic coordinates, in AU per day -- once
+by brute-force numerical differentiation, now exactly; see
+planet_state_r. */
+
+	double xyz[3], vel[3];
+
+	planet_state_r(ctx,p,jd,xyz,vel);
+	*vx = vel[0];
+	*vy = vel[1];
+	*vz = vel[2];
+}
+
+void planetvel(p, jd, vx, vy, vz)
+	int p;
+	double jd, *vx, *vy, *vz;
+{
+	planetvel_r(&skycalc_default_ctx,p,jd,vx,vy,vz);
+}
+
+/* days per segment of the ephemeris file, by body (SKYEPH_SUN, the
+   planets 1 - 9, SKYEPH_MOON).  With SKYEPH_NCOEF coefficients these
+   keep the fit within 0.001 arcsec. */
+
+static double skyeph_seglen[SKYEPH_NBODY] =
+	{32., 16., 32., 32., 64., 128., 128., 128., 128., 128., 4.};
+
+void skyeph_sample(ctx,body,jd,xyz)
+
+	struct skycalc_ctx *ctx;
+	int body;
+	double jd, *xyz;
+
+/* the quantity skyeph_write fits for the body at jd. */
+
+{
+	double dist;
+
+	if(body == SKYEPH_SUN) {
+		accusun_geo(jd,xyz,xyz+1,xyz+2,&dist);
+		xyz[0] = xyz[0] * dist;
+		xyz[1] = xyz[1] * dist;
+		xyz[2] = xyz[2] * dist;
+	}
+	else if(body == SKYEPH_MOON) moon_cheb_xyz(jd,xyz);
+	else {
+		comp_el_r(ctx,jd);
+		planetxyz_r(ctx,body,jd,xyz,xyz+1,xyz+2);
+	}
+}
+
+int skyeph_write(fname,jdstart,jdend)
+
+	char *fname;
+	double jdstart, jdend;
+
+/* writes an ephemeris file covering jdstart to jdend for skyeph_open.
+   For each body the file has piecewise Chebyshev fits to x, y, z:
+
+     SKYEPH_SUN    geocentric sun, AU, mean equator and equinox of
+		   date (accusun; ephemeris time)
+     1 - 9         heliocentric planet, AU, ecliptic of date, with
+		   the elements of the date (comp_el, planetxyz)
+     SKYEPH_MOON   geocentric moon, earth radii, equator and equinox
+		   of date (accumoon; ephemeris time)
+
+   Segment lengths are chosen so that the fit is within 0.001 arcsec
+   of the series (see skyeph_seglen).  The file holds a header and then
+   the coefficients, in native byte order; a century is about 5 Mb,
+   most of it the moon.  The file is written under a temporary name in
+   the same directory and renamed over fname, so a process that still
+   has the old file mapped keeps its (now unlinked) copy intact.
+   Returns 0, or -1 on failure to allocate or write. */
+
+{
+	FILE *fp;
+	char *tmpname;
+	int fd;
+	struct skycalc_ctx *ctx;
+	struct skyeph_header hdr;
+	struct skyeph_body *bd;
+	double *coef, *c, t, xyz[3];
+	double tnode[SKYEPH_NCOEF], samp[3][SKYEPH_NCOEF];
+	long ntot;
+	int b, i, j, seg, ret = 0;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = SKYEPH_MAGIC;
+	hdr.version = SKYEPH_VERSION;
+	hdr.byteorder = SKYEPH_BYTEORDER;
+	hdr.nbody = SKYEPH_NBODY;
+	hdr.jdstart = jdstart;
+	hdr.jdend = jdend;
+
+	ntot = 0;
+	for(b = 0; b < SKYEPH_NBODY; b++) {
+		bd = hdr.body + b;
+		bd->seglen = skyeph_seglen[b];
+		bd->ncoef = SKYEPH_NCOEF;
+		if(b == SKYEPH_SUN || b == SKYEPH_MOON) {  /* ET, padded */
+			bd->jdstart = jdstart + etcorr(jdstart)/SEC_IN_DAY - 0.01;
+			t = jdend + etcorr(jdend)/SEC_IN_DAY + 0.01;
+		}
+		else {
+			bd->jdstart = jdstart;
+			t = jdend;
+		}
+		bd->nseg = (int) ceil((t - bd->jdstart) / bd->seglen);
+		if(bd->nseg < 1) bd->nseg = 1;
+		bd->offset = ntot;
+		ntot = ntot + 3L * bd->nseg * bd->ncoef;
+	}
+
+	coef = (double *) malloc(ntot * sizeof(double));
+	ctx = (struct skycalc_ctx *) malloc(sizeof(struct skycalc_ctx));
+	if(coef == NULL || ctx == NULL) {
+		if(coef != NULL) free(coef);
+		if(ctx != NULL) free(ctx);
+		return(-1);
+	}
+	skycalc_ctx_init(ctx);   /* no ephemeris file, so the series */
+
+	for(i = 0; i < SKYEPH_NCOEF; i++)
+		tnode[i] = cos(PI * (i + 0.5) / SKYEPH_NCOEF);
+
+	for(b = 0; b < SKYEPH_NBODY; b++) {
+		bd = hdr.body + b;
+		for(seg = 0; seg < bd->nseg; seg++) {
+			for(i = 0; i < bd->ncoef; i++) {
+				t = bd->jdstart + bd->seglen * (seg + 0.5 * (tnode[i] + 1.));
+				skyeph_sample(ctx,b,t,xyz);
+				for(j = 0; j < 3; j++) samp[j][i] = xyz[j];
+			}
+			c = coef + bd->offset + 3L * seg * bd->ncoef;
+			for(j = 0; j < 3; j++)
+				cheb_fit(samp[j],bd->ncoef,c + j * bd->ncoef);
+		}
+	}
+	free(ctx);
+
+	if((tmpname = (char *) malloc(strlen(fname) + 32)) == NULL) {
+		free(coef);
+		return(-1);
+	}
+	sprintf(tmpname,"%s.%ld.tmp",fname,(long) getpid());
+	fd = open(tmpname, O_WRONLY | O_CREAT | O_EXCL, 0666);
+	if(fd < 0) ret = -1;
+	else if((fp = fdopen(fd,"wb")) == NULL) {
+		close(fd);
+		ret = -1;
+	}
+	else {
+		if(fwrite(&hdr,sizeof(hdr),1,fp) != 1 ||
+		   fwrite(coef,sizeof(double),(size_t) ntot,fp) != (size_t) ntot)
+			ret = -1;
+		if(fclose(fp) != 0) ret = -1;
+		if(ret == 0 && rename(tmpname,fname) != 0) ret = -1;
+		if(ret != 0) unlink(tmpname);
+	}
+	free(tmpname);
+	free(coef);
+	return(ret);
+}
+
+void xyz2000(jd,x,y,z)
+	double jd, x, y, z;
+
+/* simply transforms a vector x, y, and z to 2000 coordinates
+   and prints -- for use in diagnostics. */
+{
+	double r1, d1, ep1, r2, d2, mod;
+
+	mod = sqrt(x*x + y*y + z*z);
+	xyz_cel(x,y,z,&r1,&d1);
+	ep1 = 2000. + (jd - J2000)/365.25;
+	precrot(r1,d1,ep1,2000.,&r2,&d2);
+	x = mod * cos(r2/HRS_IN_RADIAN) * cos(d2/DEG_IN_RADIAN);
+	y = mod * sin(r2/HRS_IN_RADIAN) * cos(d2/DEG_IN_RADIAN);
+	z = mod * sin(d2/DEG_IN_RADIAN);
+	printf("%f to 2000 -->  %f %f %f \n",ep1,x,y,z);
+
+}
+
+void earthview(x, y, z, i, ra, dec)
+
+	double *x, *y, *z;
+	int i;
+	double *ra, *dec;
+
+/* given computed planet positions for planets 1-10, computes
+   ra and dec of i-th planet as viewed from earth (3rd) */
+
+{
+	double dx, dy, dz;
+
+	dx = x[i] - x[3];
+	dy = y[i] - y[3];
+	dz = z[i] - z[3];
+
+
+	xyz_cel(dx,dy,dz,ra,dec);
+
+}
+
+void body_posn_set(bp,ra,dec,lat,sid)
+
+	struct body_posn *bp;
+	double ra,dec,lat,sid;
+
+/* fills in hour angle, altitude, azimuth and secant z for a body
+   at ra and dec. */
+
+{
+	bp->ra = ra;
+	bp->dec = dec;
+	bp->ha = adj_time(sid - ra);
+	bp->alt = altit(dec,bp->ha,lat,&bp->az);
+	bp->secz = secant_z(bp->alt);
+}
+
+void calc_pposns_r(ctx,jd,lat,sid,pp)
+
+	struct skycalc_ctx *ctx;
+	double jd,lat,sid;
+	struct planet_posns *pp;
+
+/* computes positions for the sun, moon, and all the planets, as
+   pposns prints them, without printing anything. */
+
+{
+	int i;
+	double x[10], y[10], z[10];
+	double rasun, decsun, distsun, topora,topodec;
+	double georamoon,geodecmoon,geodistmoon,toporamoon,topodecmoon,
+	      topodistmoon;
+	double ra, dec;
+
+	accusun_r(ctx,jd,0.,0.,&rasun,&decsun,&distsun,&topora,&topodec,x+3,y+3,z+3);
+/*      planetxyz(3,jd,x+3,y+3,z+3);   get the earth first (EarthFirst!?)
+	eclrot(jd,x+3,y+3,z+3);  */
+
+	accumoon_r(ctx,jd,lat,sid,0.,&georamoon,&geodecmoon,&geodistmoon,
+			 &toporamoon,&topodecmoon,&topodistmoon);
+
+	body_posn_set(&pp->sun,topora,topodec,lat,sid);
+	body_posn_set(&pp->moon,toporamoon,topodecmoon,lat,sid);
+
+	for(i = 1; i <= 9; i++) {
+		if(i == 3) continue;  /* skip the earth */
+		planetxyz_r(ctx,i,jd,x+i,y+i,z+i);
+		eclrot(jd,x+i,y+i,z+i);
+		earthview(x,y,z,i,&ra,&dec);
+		body_posn_set(&pp->planet[i],ra,dec,lat,sid);
+	}
+}
+
+void calc_pposns(jd,lat,sid,pp)
+	double jd,lat,sid;
+	struct planet_posns *pp;
+{
+	calc_pposns_r(&skycalc_default_ctx,jd,lat,sid,pp);
+}
+
+void print_posn_r(ctx,bp)
+
+	struct skycalc_ctx *ctx;
+	struct body_posn *bp;
+
+/* one line of the pposns table, less the name and newline. */
+
+{
+	put_coords_r(ctx,bp->ra,1);
+	oprntf_r(ctx,"  ");
+	put_coords_r(ctx,bp->dec,0);
+	oprntf_r(ctx,"  ");
+	put_coords_r(ctx,bp->ha,0);
+	if(fabs(bp->secz) < 100.) oprntf_r(ctx,"   %8.2f  ",bp->secz);
+	else oprntf_r(ctx,"  (near horiz)");
+	oprntf_r(ctx," %5.1f  %5.1f",bp->alt,bp->az);
+}
+
+void pposns_r(ctx,jd,lat,sid,print_option,planra,plandec)
+
+	struct skycalc_ctx *ctx;
+	double jd,lat,sid;
+	short print_option;
+	double *planra, *plandec;
+
+/* computes and optionally prints positions for all the planets. */
+/*  print_option 1 = print positions, 0 = silent */
+
+{
+	int i;
+	struct planet_posns pp;
+
+	calc_pposns_r(ctx,jd,lat,sid,&pp);
+	for(i = 1; i <= 9; i++) {
+		if(i == 3) continue;
+		planra[i] = pp.planet[i].ra;
+		plandec[i] = pp.planet[i].dec;
+	}
+	if(print_option != 1) return;
+
+	/* set up table header */
+	oprntf_r(ctx,"\n\nPlanetary positions (epoch of date), accuracy about 0.1 deg:\n");
+	oprntf_r(ctx,"\n             RA       dec       HA");
+	oprntf_r(ctx,"       sec.z     alt   az\n\n");
+
+	/* Throw in the sun and moon here ... */
+	oprntf_r(ctx,"Sun    : ");
+	print_posn_r(ctx,&pp.sun);
+	oprntf_r(ctx,"\n");
+	oprntf_r(ctx,"Moon   : ");
+	print_posn_r(ctx,&pp.moon);
+	oprntf_r(ctx,"\n\n");
+	for(i = 1; i <= 9; i++) {
+		if(i == 3) continue;  /* skip the earth */
+		oprntf_r(ctx,"%s: ",ctx->el[i].name);
+		print_posn_r(ctx,&pp.planet[i]);
+		if(i == 9) oprntf_r(ctx," <-(least accurate)\n");
+		else oprntf_r(ctx,"\n");
+	}
+}
+
+void pposns(jd,lat,sid,print_option,planra,plandec)
+	double jd,lat,sid;
+	short print_option;
+	double *planra, *plandec;
+{
+	pposns_r(&skycalc_default_ctx,jd,lat,sid,print_option,planra,plandec);
+}
+
+void barycor_r(ctx,jd,x,y,z,xdot,ydot,zdot)
+
+	struct skycalc_ctx *ctx;
+	double jd,*x,*y,*z;
+	double *xdot,*ydot,*zdot;
+
+/* This routine takes the position
+   x,y,z and velocity xdot,ydot,zdot, assumed heliocentric,
+   and corrects them to the solar system barycenter taking into
+   account the nine major planets.  Routine evolved by inserting
+   planetary data (given above) into an earlier, very crude
+   barycentric correction.  */
+
+{
+
+	int p;
+	double xp, yp, zp, xvp, yvp, zvp, pos[3], vel[3];
+	double xo, yo, zo;  /* for diagn */
+
+	double xc=0.,yc=0.,zc=0.,xvc=0.,yvc=0.,zvc=0.;
+
+	comp_el_r(ctx,jd);
+
+	for(p=1;p<=9;p++) { /* sum contributions of the planets */
+		planet_state_r(ctx,p,jd,pos,vel);  /* both at once */
+		xp = pos[0];
+		yp = pos[1];
+		zp = pos[2];
+		xvp = vel[0];
+		yvp = vel[1];
+		zvp = vel[2];
+		xc = xc + ctx->el[p].mass * xp;  /* mass is fraction of solar mass */
+		yc = yc + ctx->el[p].mass * yp;
+		zc = zc + ctx->el[p].mass * zp;
+		xvc = xvc + ctx->el[p].mass * xvp;
+		yvc = yvc + ctx->el[p].mass * yvp;
+		zvc = zvc + ctx->el[p].mass * zvp;
+	/* diagnostic commented out ..... nice place to check planets if needed
+		printf("%d :",p);
+		xo = xp;
+		yo = yp;
+		zo = zp;
+		eclrot(jd,&xo,&yo,&zo);
+		xyz2000(jd,xo,yo,zo);
+		printf("    ");
+		xo = xvp;
+		yo = yvp;
+		zo = zvp;
+		eclrot(jd,&xo,&yo,&zo);
+		xyz2000(jd,xo,yo,zo);    */
+	}
+	/* normalize properly and rotate corrections to equatorial coords */
+	xc = xc / SS_MASS;
+	yc = yc / SS_MASS;
+	zc = zc / SS_MASS;     /* might as well do it right ... */
+
+	eclrot(jd, &xc, &yc, &zc);
+
+/*      printf("posn corrn:");   diagnostic commented out
+	xyz2000(jd,xc,yc,zc);
+	printf(" vel corrn:");
+	xyz2000(jd,(1.0e9 * xvc),(1.0e9 * yvc),(1.0e9 * zvc));  */
+
+	xvc = xvc * KMS_AUDAY / SS_MASS;
+	yvc = yvc * KMS_AUDAY / SS_MASS;
+	zvc = zvc * KMS_AUDAY / SS_MASS;
+	eclrot(jd, &xvc, &yvc, &zvc);
+
+	/* add them in */
+	*x = *x - xc;  /* these are in AU -- */
+	*y = *y - yc;
+	*z = *z - zc;
+/*      xyz2000(jd,*x,*y,*z);   */
+	*xdot = *xdot - xvc;
+	*ydot = *ydot - yvc;
+	*zdot = *zdot - zvc;
+
+/* diagnostic -- trash variables
+	-- scale for direct comparison with almanac
+	xp = 1.0e9 * *xdot / KMS_AUDAY;
+	yp = 1.0e9 * *ydot / KMS_AUDAY;
+	zp = 1.0e9 * *zdot / KMS_AUDAY;
+	xyz2000(jd,xp,yp,zp);
+					*/
+}
+
+void barycor(jd,x,y,z,xdot,ydot,zdot)
+	double jd,*x,*y,*z;
+	double *xdot,*ydot,*zdot;
+{
+	barycor_r(&skycalc_default_ctx,jd,x,y,z,xdot,ydot,zdot);
+}
+
+void helcor_earth_r(ctx,jd,s)
+
+	struct skycalc_ctx *ctx;
+	double jd, *s;
+
+/* the earth's barycentric position (AU) and velocity (km/s) at jd,
+   in s[0..2] and s[3..5] -- helcor's part that doesn't depend on the
+   object or the site. */
+
+{
+	double x, y, z, xdot, ydot, zdot;
+	double ras, decs, dists, jd1, jd2, x1, x2, y1, y2, z1, z2;
+	double topora, topodec;
+
+/* diagnostic -- temporarily trash jd1
+	jd1 = jd1 + etcorr(jd1) / SEC_IN_DAY;
+	printf("TDT: %20f\n",jd1);  */
+
+	jd1 = jd - EARTH_DIFF;
+	jd2 = jd + EARTH_DIFF;
+
+	accusun_r(ctx,jd1,0.,0.,&ras,&decs,&dists,&topora,&topodec,&x1,&y1,&z1);
+	accusun_r(ctx,jd2,0.,0.,&ras,&decs,&dists,&topora,&topodec,&x2,&y2,&z2);
+	accusun_r(ctx,jd,0.,0.,&ras,&decs,&dists,&topora,&topodec,&x,&y,&z);
+
+/*      printf("ra dec distance:");  diagnostic -- commented out
+	put_coords(ras,3);
+	printf(" ");
+	put_coords(decs,2);
+	printf(" %f\n",dists);   */
+
+	xdot = KMS_AUDAY*(x2 - x1)/(2.*EARTH_DIFF);  /* numerical differentiation */
+	ydot = KMS_AUDAY*(y2 - y1)/(2.*EARTH_DIFF);  /* crude but accurate */
+	zdot = KMS_AUDAY*(z2 - z1)/(2.*EARTH_DIFF);
+
+/*      printf("Helio earth:");  diagnostic -- commmented out
+	xyz2000(jd,x,y,z);
+	xyz2000(jd,xdot,ydot,zdot);   */
+
+	barycor_r(ctx,jd,&x,&y,&z,&xdot,&ydot,&zdot);
+	s[0] = x;
+	s[1] = y;
+	s[2] = z;
+	s[3] = xdot;
+	s[4] = ydot;
+	s[5] = zdot;
+}
+
+void helcor_r(ctx,jd,ra,dec,ha,lat,elevsea,tcor,vcor)
+
+	struct skycalc_ctx *ctx;
+	double jd,ra,dec,ha;
+  	double lat,elevsea,*tcor,*vcor;
+
+/* finds heliocentric correction for given jd, ra, dec, ha, and lat.
+   tcor is time correction in seconds, vcor velocity in km/s, to
+   be added to the observed values.
+   Input ra and dec assumed to be at current epoch */
+
+{
+	double s[6];
+	double xobj,yobj,zobj;
+	double x_geo, y_geo, z_geo;  /* geocentric coords of observatory */
+	double a=499.0047837;  /* light travel time for 1 AU, sec  */
+
+	dec=dec/DEG_IN_RADIAN; /* pass by value! */
+	ra = ra/HRS_IN_RADIAN;
+	ha = ha/HRS_IN_RADIAN;
+
+	xobj = cos(ra) * cos(dec);
+	yobj = sin(ra) * cos(dec);
+	zobj = sin(dec);
+
+	helcor_earth_r(ctx,jd,s);
+	*tcor = a * (s[0]*xobj + s[1]*yobj + s[2]*zobj);
+	*vcor = s[3] * xobj + s[4] * yobj + s[5] * zobj;
+/* correct diurnal rotation for elliptical earth including obs. elevation */
+	geocent(0., lat, elevsea, &x_geo, &y_geo, &z_geo);
+/* longitude set to zero arbitrarily so that x_geo = perp. distance to axis */
+	*vcor = *vcor - 0.4651011 * x_geo * sin(ha) * cos(dec);
+/* 0.4651011 = 6378.137 km radius * 2 pi / (86164.1 sec per sidereal day) */
+/* could add time-of-flight across earth's radius here -- but rest of
+   theory is not good to 0.02 seconds anyway. */
+}
+
+void helcor(jd,ra,dec,ha,lat,elevsea,tcor,vcor)
+	double jd,ra,dec,ha;
+	double lat,elevsea,*tcor,*vcor;
+{
+	helcor_r(&skycalc_default_ctx,jd,ra,dec,ha,lat,elevsea,tcor,vcor);
+}
+
+/* A couple of eclipse predictors.... */
+
+float overlap(r1, r2, sepn)
+
+	double r1, r2, sepn;
+{
+
+
+/* for two circles of radii r1 and r2,
+   computes the overlap area in terms of the area of r1
+   if their centers are separated by
+   sepn. */
+
+	float result, a, rlarge, rsmall;
+
+	if(sepn > r1+r2) return(0.); /* They don't overlap */
+	if((r2 < 0.) || (r1 < 0.)) return(-1.);  /* oops -- r's > 0.*/
+	if(r2 > r1) {
+		rlarge = r2;
+		rsmall = r1;
+	}
+	else {
+		rlarge = r1;
+		rsmall = r2;
+	}
+	if(sepn < (rlarge - rsmall)) { /* small circle completely contained */
+		if(r2 > r1) return(1.);  /* r1 is completely covered */
+		else return((r2*r2) / (r1*r1)); /* ratio of areas */
+	}
+	a = (rlarge*rlarge + sepn*sepn - rsmall*rsmall) / (2.*sepn);
+	   /* a is the distance along axis of centers to where circles cross */
+	result = PI * rlarge * rlarge / 4.
+	     - a * sqrt(rlarge * rlarge - a*a) / 2.
+	     - rlarge * rlarge * asin(a/rlarge) / 2;
+	a = sepn - a;
+	result = result + PI * rsmall * rsmall / 4.
+	     - a * sqrt(rsmall * rsmall - a*a) / 2.
+	     - rsmall * rsmall * asin(a/rsmall) / 2.;
+	result = result * 2.;
+	return(result / (PI*r1*r1)); /* normalize to circle 1's area. */
+}
+
+short solecl_calc(sun_moon,distmoon,distsun,magnitude)
+
+	double sun_moon,distmoon,distsun;
+	float *magnitude; /* fraction of sun covered */
+
+/* classifies a solar eclipse, given the sun-moon separation in
+   degrees and the distances: returns 0 for none, 1 partial,
+   2 annular, 3 total.  magnitude is set for partial and annular. */
+
+{
+	double ang_sun, ang_moon; /* angular sizes */
+
+	ang_moon = DEG_IN_RADIAN * asin(RMOON / (distmoon * EQUAT_RAD));
+	ang_sun = DEG_IN_RADIAN * asin(RSUN / (distsun * ASTRO_UNIT));
+
+	if(sun_moon >= (ang_sun + ang_moon)) return(0);
+
+	else if(ang_sun >= ang_moon) {                   /* annular */
+		*magnitude = overlap(ang_sun,ang_moon,sun_moon);
+		if(sun_moon > (ang_sun - ang_moon)) return(1);
+		else return(2);
+	}
+	else {
+		*magnitude = overlap(ang_sun,ang_moon,sun_moon);
+		if(sun_moon > (ang_moon - ang_sun)) return(1);
+		else return(3);
+	}
+}
+
+void print_solecl(code,magnitude)
+
+	short code;
+	float magnitude;
+
+{
+	if(code == 1)
+		oprntf("PARTIAL ECLIPSE OF THE SUN, %4.2f covered.\n",
+			magnitude);
+	else if(code == 2)
+		oprntf("ANNULAR ECLIPSE OF THE SUN, %4.2f covered.\n",
+			magnitude);
+	else if(code == 3) oprntf("TOTAL ECLIPSE OF THE SUN!\n");
+}
+
+void solecl(sun_moon,distmoon,distsun)
+
+	double sun_moon,distmoon,distsun;
+
+
+{
+	short code;
+	float magnitude; /* fraction of sun covered */
+
+	code = solecl_calc(sun_moon,distmoon,distsun,&magnitude);
+	print_solecl(code,magnitude);
+}
+
+short lunecl_calc(georamoon,geodecmoon,geodistmoon,rasun,decsun,distsun,
+	magnitude)
+
+	double georamoon,geodecmoon,geodistmoon,rasun,decsun,distsun;
+	float *magnitude;  /* portion covered */
+
+
+{
+	/* quickie lunar eclipse predictor -- makes a number of
+	   minor assumptions, e. g. small angle approximations, plus
+	   projects phenomena onto a plane at distance = geocentric
+	   distance of moon .  Returns 0 for none, 1 partial penumbral,
+	   2 penumbral, 3 partial umbral (magnitude set), 4 total. */
+
+	double ang_sun, ang_moon; /* angular sizes */
+	double radius_um, radius_penum;
+	double ra_shadow, dec_shadow;
+	double lun_to_shadow;  /* angular separation of centerline of shadow
+		  from center of moon ... */
+
+	ang_sun = asin(RSUN / (distsun * ASTRO_UNIT));  /* radians */
+
+	ra_shadow = rasun + 12.;
+	if(ra_shadow > 24.) ra_shadow = ra_shadow - 24.; /* not strictly
+	   necessary, perhaps, but wise */
+	dec_shadow = -1. * decsun;
+	radius_um = (1./geodistmoon - ang_sun) * DEG_IN_RADIAN;
+	radius_penum = (1./geodistmoon + ang_sun) * DEG_IN_RADIAN;
+
+
+	ang_moon = DEG_IN_RADIAN * asin(RMOON / (geodistmoon * EQUAT_RAD));
+	lun_to_shadow = DEG_IN_RADIAN *
+		subtend(georamoon,geodecmoon,ra_shadow,dec_shadow);
+	if(lun_to_shadow > (radius_penum + ang_moon)) return (0);
+	else if(lun_to_shadow >= (radius_um + ang_moon))  {
+		if(lun_to_shadow >= (radius_penum - ang_moon)) return (1);
+		else return (2);
+	}
+	else if (lun_to_shadow >= (radius_um - ang_moon)) {
+		*magnitude = overlap(ang_moon,radius_um,lun_to_shadow);
+		return(3);
+	}
+	else return(4);
+}
+
+void print_lunecl(code,magnitude)
+
+	short code;
+	float magnitude;
+
+{
+	if(code == 1)
+		oprntf("PARTIAL PENUMBRAL (BRIGHT) ECLIPSE OF THE MOON.\n");
+	else if(code == 2)
+		oprntf("PENUMBRAL (BRIGHT) ECLIPSE OF THE MOON.\n");
+	else if(code == 3)
+		oprntf("PARTIAL UMBRAL (DARK) ECLIPSE OF THE MOON, %4.2f covered.\n",
+		   magnitude);
+	else if(code == 4) oprntf("TOTAL ECLIPSE OF THE MOON!\n");
+}
+
+short lunecl(georamoon,geodecmoon,geodistmoon,rasun,decsun,distsun)
+
+	double georamoon,geodecmoon,geodistmoon,rasun,decsun,distsun;
+
+
+{
+	short code;
+	float magnitude;
+
+	code = lunecl_calc(georamoon,geodecmoon,geodistmoon,rasun,decsun,
+		distsun,&magnitude);
+	print_lunecl(code,magnitude);
+	return(code);
+}
+
+void planet_seps_r(ctx,jd,ra,dec,sep)
+
+	struct skycalc_ctx *ctx;
+	double jd,ra,dec;
+	double *sep;
+
+/* given a jd, ra, and dec, computes rough positions for all the
+   planets and returns their angular distances (degrees) from
+   ra and dec in sep[1] through sep[9].  sep[0] and sep[3] (the
+   earth) are set to 180. */
+
+{
+	double pra[10],pdec[10];
+	int i;
+
+	comp_el_r(ctx,jd);
+	pposns_r(ctx,jd,0.,0.,0,pra,pdec);
+	sep[0] = sep[3] = 180.;
+	for(i = 1; i<=9 ; i++) {
+		if(i == 3) continue;
+		sep[i] = subtend(pra[i],pdec[i],ra,dec) * DEG_IN_RADIAN;
+	}
+}
+
+void print_planet_alert_r(ctx,sep,tolerance)
+
+	struct skycalc_ctx *ctx;
+	double *sep, tolerance;
+
+/* prints the warnings for planets in sep (from planet_seps_r)
+   closer than tolerance. */
+
+{
+	int i;
+
+	for(i = 1; i<=9 ; i++) {
+		if(i == 3) continue;
+		if(sep[i] < tolerance) {
+			oprntf_r(ctx,"-- CAUTION -- proximity to %s -- low-precision calculation shows\n ",
+				ctx->el[i].name);
+			oprntf_r(ctx,"this direction as %5.2f deg away from %s ---\n",
+				sep[i],ctx->el[i].name);
+		}
+	}
+}
+
+void planet_alert_r(ctx,jd,ra,dec,tolerance)
+
+	struct skycalc_ctx *ctx;
+	double jd,ra,dec,tolerance;
+
+/* given a jd, ra, and dec, this computes rough positions
+   for all the planets, and alerts the user if any of them
+   are within less than a settable tolerance of the ra and dec. */
+
+{
+	double sep[10];
+
+	planet_seps_r(ctx,jd,ra,dec,sep);
+	print_planet_alert_r(ctx,sep,tolerance);
+}
+
+void planet_alert(jd,ra,dec,tolerance)
+	double jd,ra,dec,tolerance;
+{
+	planet_alert_r(&skycalc_default_ctx,jd,ra,dec,tolerance);
+}
+
+short setup_time_place(date,longit,lat,stdz,use_dst,zone_name,
+        zabr,site_name,enter_ut,night_date,jdut,jdlocal,jdb,jde,sid,
+	curepoch)
+
+struct date_time date;
+double lat, longit, stdz, *jdut, *jdlocal, *jdb, *jde, *sid, *curepoch;
+short use_dst, enter_ut, night_date;
+char zabr;
+char *site_name;
+char *zone_name;
+
+/* This takes the date (which contains the time), and the site parameters,
+   and prints out a banner giving the various dates and times; also
+   computes and returns various jd's, the sidereal time, and the epoch.
+   Returns negative number to signal error if date is out of range of
+   validity of algorithms, or if you specify a bad time during daylight-time
+   change; returns zero if successful.  */
+
+{
+
+	double jd, jdloc, jdtest;
+	if((date.y <= 1900) | (date.y >= 2100)) {
+		oprntf("Date out of range - 1901 -> 2099\n");
+		return(-1);
+	}
+	find_dst_bounds(date.y,stdz,use_dst,jdb,jde);
+	oprntf("\nW Long (hms):");
+	put_coords(longit,3);
+	oprntf(", lat (dms):");
+	put_coords(lat,2);
+	oprntf(", std time zone %3.0f hr W\n",stdz);
+	oprntf("\n");
+
+        /* Establish the correct time from the input values ...
+             This is done more compactly in the true_jd function, but
+             the present code prints more warnings, etc, so leave it.*/
+
+	if(enter_ut==0) {
+		/* "night date" convention -- adjust date up by one if local
+		      time is in morning. */
+		if((night_date == 1) && (date.h < 12))
+		      date.d = date.d + 1;  /* pass-by-value, I hope */
+		jdloc = date_to_jd(date); /* local */
+		jdtest = jdloc + stdz/24.; /* almost */
+		if(use_dst != 0) {
+		   if((fabs(jdtest-*jdb)<0.5) | (fabs(jdtest-*jde)<0.5)) {
+		   oprntf("** be careful -- near standard and daylight change. ** \n");
+		   }
+		}
+		if(use_dst > 0) {  /* handle exceptions during dst -- std change */
+			if((jdtest - *jdb > 0.)
+				&& (jdtest - *jdb < 0.041666667)) {
+				/* this time doesn't really exist */
+			  oprntf("Nonexistent input time during change to DST!\n");
+			  oprntf("Please respecify time as 1 hour later.\n");
+			  return(-1);  /* return error flag. */
+			}
+			else if((jdtest - *jde >= 0.0) &&
+				(jdtest - *jde < 0.04166667)) {
+			  oprntf("\nCAUTION - DST --> STD -- ambiguous input time defaults to STD!\n");
+			  oprntf("Use 'g' option to specify UT unambiguously.\n");
+			  jd = jdloc + stdz / 24.;
+			}
+			else jd = jdloc +
+				zone(use_dst,stdz,jdtest,*jdb,*jde) / 24.;
+		}
+		else if(use_dst < 0) {  /* south -- reverse jdb & jde */
+			if((jdtest - *jde > 0.)
+				&& (jdtest - *jde < 0.041666667)) {
+				/* this time doesn't really exist */
+			  oprntf("Nonexistent input time during change to DST!\n");
+			  oprntf("Please respecify time as 1 hour later.\n");
+			  return(-1);  /* return error flag. */
+			}
+			else if((jdtest - *jdb >= 0.0) &&
+				(jdtest - *jdb < 0.04166667)) {
+			  oprntf("\nCAUTION - DST --> STD -- ambiguous input time defaults to STD!\n");
+			  oprntf("Use 'g' option to specify UT unambiguously.\n");
+			  jd = jdloc + stdz / 24.;
+			}
+			else jd = jdloc +
+				zone(use_dst,stdz,jdtest,*jdb,*jde) / 24.;
+		}
+		else jd = jdtest;  /* not using dst ... no problem. */
+		oprntf("Local Date and time: ");
+		print_all(jdloc);
+		oprntf(" ");
+		print_tz(jd,use_dst,*jdb,*jde,zabr);
+/*              if(fabs(frac_part(jdloc) - 0.5) < MIDN_TOL)
+		   oprntf("\n(Watch for possible day error near midnight.)");
+ .... this really shouldn't happen now. */
+		if(use_dst != 0) {
+		}
+
+		oprntf("\n   UT Date and time: ");
+		print_all(jd);
+		if(fabs(frac_part(jd) - 0.5) < 0.00001)
+		   oprntf("\n(Watch for possible day error near midnight.)");
+	}
+	else {  /* times entered are ut already */
+
+		jd = date_to_jd(date);
+		oprntf("   UT Date and time: ");
+		print_all(jd);
+		if(fabs(frac_part(jd) - 0.5) < 0.00001)
+		   oprntf("\n(Watch for possible day error near midnight.)");
+		jdloc = jd - zone(use_dst,stdz,jd,*jdb,*jde)/24.;
+		if(use_dst != 0) {
+		   if((fabs(jd-*jdb)<0.05) | (fabs(jd-*jde)<0.05))
+			oprntf("\nCAUTION..dst/std time changing!");
+		}
+		oprntf("\nlocal Date and time: ");
+		print_all(jdloc);
+		oprntf(" ");
+		print_tz(jd,use_dst,*jdb,*jde,zabr);
+		if(fabs(frac_part(jdloc) - 0.5) < 0.00001)
+		   oprntf("\n(Watch for possible day error near midnight.)");
+
+	}
+	if(use_dst != 0) {
+		if(stdz==zone(use_dst,stdz,jd,*jdb,*jde))
+			oprntf("\nDST assumed not in effect\n");
+		else oprntf("\nDST assumed in effect.\n");
+	}
+	oprntf("\nJulian date: %lf",jd);
+	*sid=lst(jd,longit);
+	oprntf("   LMST: ");
+	put_coords(*sid,3);
+	*jdut = jd;
+	*jdlocal = jdloc;
+	*curepoch = 2000.+(jd-J2000)/365.25;
+	return(0);
+}
+
+void calc_tonight_r(ctx,date,lat,longit,elevsea,horiz,stdz,use_dst,tn)
+
+	struct skycalc_ctx *ctx;
+	struct date_time date;
+	double lat, longit, elevsea, horiz, stdz;
+	short use_dst;
+	struct tonight *tn;
+
+/* Given site and time information, computes everything print_tonight
+   reports for a single night, and prints nothing.  The states in tn
+   record which of print_tonight's many special cases apply. */
+
+{
+	double jd, geora, geodec, geodist;  /* geocent for moon, not used */
+	double min_alt, max_alt, hasunset, hatwilight, hamoonset;
+
+	find_dst_bounds_r(ctx,date.y,stdz,use_dst,&tn->jdb,&tn->jde);
+	tn->locjdb = tn->jdb-stdz/24.;
+	tn->locjde = tn->jde-(stdz-1)/24.;
+	date.h = 18;  /* local afternoon */
+	date.mn = 0;
+	date.s = 0;  /* afternoon */
+	jd = date_to_jd(date); /* not really jd; local equivalent */
+	tn->jd = jd;
+	tn->timechange = (use_dst != 0) &&
+		((fabs(jd - tn->locjdb) < 0.45) || (fabs(jd - tn->locjde) < 0.45));
+	jd = jd + .5;  /* local morning */
+	jd = jd - 0.25;  /* local midnight */
+	tn->jdmid = jd + zone(use_dst,stdz,jd,tn->jdb,tn->jde) / 24.;
+					/* corresponding ut */
+	tn->stmid = lst_r(ctx,tn->jdmid,longit);
+
+	accumoon_r(ctx,tn->jdmid,lat,tn->stmid,elevsea,
+	   &geora,&geodec,&geodist,&tn->ramoon,&tn->decmoon,&tn->distmoon);
+	lpsun(tn->jdmid,&tn->rasun,&tn->decsun);
+
+	tn->jdsunset = tn->jdsunrise = tn->jdcent = -1.;
+	tn->jdetw = tn->jdmtw = tn->jdetw12 = tn->jdmtw12 = -1.;
+	tn->sidetw = tn->sidmtw = 0.;
+	tn->set_to_rise = tn->twi_to_twi = 0.;
+	tn->twi18state = tn->twi12state = 2;
+
+	hasunset = ha_alt(tn->decsun,lat,-(0.83+horiz));
+	if(hasunset > 900.) tn->sunstate = 1;  /* never sets; twilight
+				certainly irrelevant */
+	else {
+		if(hasunset < -900.) {
+			tn->sunstate = -1;
+			tn->set_to_rise = 24.;
+		}
+		else {
+			tn->sunstate = 0;
+			tn->jdsunset = tn->jdmid +
+				adj_time(tn->rasun+hasunset-tn->stmid)/24.;
+				/* initial guess */
+			tn->jdsunset = jd_body_alt_r(ctx,EVENT_SUN,-(0.83+horiz),
+				tn->jdsunset,lat,longit,0.,EVENT_TOL);
+			tn->jdsunrise = tn->jdmid +
+				adj_time(tn->rasun-hasunset-tn->stmid)/24.;
+			tn->jdsunrise = jd_body_alt_r(ctx,EVENT_SUN,-(0.83+horiz),
+				tn->jdsunrise,lat,longit,0.,EVENT_TOL);
+			if((tn->jdsunrise > 0.) && (tn->jdsunset > 0.)) {
+				tn->set_to_rise = (tn->jdsunrise - tn->jdsunset) * 24.;
+				tn->jdcent = (tn->jdsunrise + tn->jdsunset) / 2.;
+			}
+		}
+
+		/* 18-degree twilight, even if the sun is down all day */
+		hatwilight = ha_alt(tn->decsun,lat,-18.);
+		if(hatwilight < -900.) {
+			tn->twi18state = -1;
+			tn->twi_to_twi = 24.;
+		}
+		else {
+			if(hatwilight > 900.) tn->twi18state = 1;
+			else {
+				tn->twi18state = 0;
+				tn->jdetw = tn->jdmid +
+				  adj_time(tn->rasun+hatwilight-tn->stmid)/24.;  /* rough */
+				tn->jdetw = jd_body_alt_r(ctx,EVENT_SUN,-18.,tn->jdetw,
+					lat,longit,0.,EVENT_TOL);  /* accurate */
+				if(tn->jdetw > 0.) tn->sidetw = lst_r(ctx,tn->jdetw,longit);
+				tn->jdmtw = tn->jdmid +
+				  adj_time(tn->rasun-hatwilight-tn->stmid)/24.;
+				tn->jdmtw = jd_body_alt_r(ctx,EVENT_SUN,-18.,tn->jdmtw,
+					lat,longit,0.,EVENT_TOL);
+				if(tn->jdmtw > 0.) tn->sidmtw = lst_r(ctx,tn->jdmtw,longit);
+				if((tn->jdetw > 0.) && (tn->jdmtw > 0.))
+					tn->twi_to_twi = 24. * (tn->jdmtw - tn->jdetw);
+			}
+
+			/* maybe 12-degree twilight occurs ... */
+			hatwilight = ha_alt(tn->decsun,lat,-12.);
+			if(hatwilight < -900.) tn->twi12state = -1;
+			else if(hatwilight > 900.) tn->twi12state = 1;
+			else {
+				tn->twi12state = 0;
+				tn->jdetw12 = tn->jdmid +
+				  adj_time(tn->rasun+hatwilight-tn->stmid)/24.;
+				tn->jdetw12 = jd_body_alt_r(ctx,EVENT_SUN,-12.,tn->jdetw12,
+					lat,longit,0.,EVENT_TOL);
+				tn->jdmtw12 = tn->jdmid +
+				  adj_time(tn->rasun-hatwilight-tn->stmid)/24.;
+				tn->jdmtw12 = jd_body_alt_r(ctx,EVENT_SUN,-12.,tn->jdmtw12,
+					lat,longit,0.,EVENT_TOL);
+			}
+		}
+	}
+
+	min_max_alt(lat,tn->decmoon,&min_alt,&max_alt);  /* rough check -- occurs? */
+	if(max_alt < -(0.83+horiz)) {
+		tn->moonstate = -1;
+		tn->jdmoonrise = tn->jdmoonset = -1.;
+	}
+	else if(min_alt > -(0.83+horiz)) {
+		tn->moonstate = 1;
+		tn->jdmoonrise = tn->jdmoonset = 1.;
+	}
+	else {
+		/* compute moonrise and set if they're likely to occur */
+		tn->moonstate = 0;
+		hamoonset = ha_alt(tn->decmoon,lat,-(0.83+horiz)); /* rough approx. */
+		tn->tmoonrise = adj_time(tn->ramoon-hamoonset-tn->stmid);
+		tn->tmoonset = adj_time(tn->ramoon+hamoonset-tn->stmid);
+		tn->jdmoonrise = tn->jdmid + tn->tmoonrise / 24.;
+		tn->jdmoonrise = jd_moon_alt_r(ctx,-(0.83+horiz),tn->jdmoonrise,
+			lat,longit,elevsea);
+		tn->jdmoonset = tn->jdmid + tn->tmoonset / 24.;
+		tn->jdmoonset = jd_moon_alt_r(ctx,-(0.83+horiz),tn->jdmoonset,
+			lat,longit,elevsea);
+		if(fabs(tn->set_to_rise) > 10.) tn->moon_print = 0.65*tn->set_to_rise;
+			 else tn->moon_print = 6.5;
+	}
+	tn->ill_frac=0.5*(1.-cos(subtend(tn->ramoon,tn->decmoon,
+		tn->rasun,tn->decsun)));
+}
+
+void calc_tonight(date,lat,longit,elevsea,horiz,stdz,use_dst,tn)
+
+	struct date_time date;
+	double lat, longit, elevsea, horiz, stdz;
+	short use_dst;
+	struct tonight *tn;
+{
+	calc_tonight_r(&skycalc_default_ctx,date,lat,longit,elevsea,horiz,
+		stdz,use_dst,tn);
+}
+
+void print_tonight_time(jd,use_dst,stdz,jdb,jde,zabr)
+
+	double jd, stdz, jdb, jde;
+	short use_dst;
+	char zabr;
+
+/* local time and zone of jd, as print_tonight gives them. */
+
+{
+	print_time((jd-zone(use_dst,stdz,jd,jdb,jde)/24.),0);
+	print_tz(jd,use_dst,jdb,jde,zabr);
+}
+
+void print_tonight(date,lat,longit,elevsea,elev,horiz,site_name,stdz,
+	zone_name,zabr,use_dst,jdb,jde,short_long)
+
+struct date_time date;
+double lat, longit, elevsea, elev, horiz, stdz, *jdb, *jde;
+char *site_name, *zone_name, zabr;
+short use_dst, short_long;     /* short_long is a fossil argument which
+                    allows a slightly shorter version to be printed. */
+
+/* Given site and time information, prints a summary of
+   the important phenomena for a single night.  The phenomena
+   themselves come from calc_tonight; this just formats them. */
+
+{
+	struct tonight tn;
+	double jd;
+	short dow; /* day of week */
+	short k;
+
+	calc_tonight(date,lat,longit,elevsea,horiz,stdz,use_dst,&tn);
+	*jdb = tn.jdb;
+	*jde = tn.jde;
+
+	oprntf("\nAlmanac for %s:\nlong. ",site_name);
 	put_coords(longit,2);
 	oprntf(" (h.m.s) W, lat. ");
 	put_coords(lat,1);
-	oprntf(" (d.m), elev. %5.0f m\n",elevsea);
-	jd = date_to_jd(date); /* not really jd; local equivalent */
-	if(use_dst > 0) {
-		oprntf("%s Daylight Savings Time assumed from 2 AM on\n",zone_name);
-		print_calendar(locjdb,&dow);
-		oprntf(" to 2 AM on ");
-		print_calendar(locjde,&dow);
-		oprntf("; standard zone = %3.0f hrs W",stdz);
-		if((fabs(jd - locjdb) < 0.45) || (fabs(jd - locjde) < 0.45))
-			oprntf("\n   ** TIME CHANGE IS TONIGHT! **");
+	oprntf(" (d.m), elev. %5.0f m\n",elevsea);
+	if(use_dst > 0) {
+		oprntf("%s Daylight Savings Time assumed from 2 AM on\n",zone_name);
+		print_calendar(tn.locjdb,&dow);
+		oprntf(" to 2 AM on ");
+		print_calendar(tn.locjde,&dow);
+		oprntf("; standard zone = %3.0f hrs W",stdz);
+		if(tn.timechange)
+			oprntf("\n   ** TIME CHANGE IS TONIGHT! **");
+	}
+	else if (use_dst < 0) {
+		oprntf("%s Daylight Savings Time used before 2 AM \n",zone_name);
+		print_calendar(tn.locjdb,&dow);
+		oprntf(" and after 2 AM ");
+		print_calendar(tn.locjde,&dow);
+		oprntf("; standard zone = %3.0f hrs W",stdz);
+		if(tn.timechange)
+			oprntf("\n   ** TIME CHANGE IS TONIGHT! **");
+	}
+	else oprntf("%s Standard Time (%3.0f hrs W) in use all year.",zone_name,stdz);
+
+	oprntf("\n\n");
+
+	jd = tn.jd;
+	oprntf("For the night of: ");
+	print_day(day_of_week(jd));
+	oprntf(", ");
+	print_calendar(jd,&dow); /* translate back e.g. 11/31-12/1 */
+	jd = jd + .5;  /* local morning */
+	oprntf(" ---> ");
+	print_day(day_of_week(jd));
+	oprntf(", ");
+	print_calendar(jd,&dow);
+	oprntf("\n");
+	oprntf("Local midnight = ");
+	print_calendar(tn.jdmid,&dow);
+	oprntf(", ");
+	print_time(tn.jdmid,-1); /* just the hours! */
+	oprntf(" UT, or JD %11.3f\n",tn.jdmid);
+	oprntf("Local Mean Sidereal Time at midnight = ");
+	put_coords(tn.stmid,3);
+	oprntf("\n\n");
+
+	if(tn.sunstate == 1) oprntf("Sun up all night!\n");
+	else if(tn.sunstate == -1) oprntf("Sun down all day!\n");
+	else {
+		if(tn.jdsunset > 0.) {
+			oprntf("Sunset (%5.0f m horizon): ",elev);
+			print_tonight_time(tn.jdsunset,use_dst,stdz,*jdb,*jde,zabr);
+		}
+		else oprntf("Sunset not correctly computed; ");
+		if(tn.jdsunrise > 0.) {
+			oprntf("; Sunrise: ");
+			print_tonight_time(tn.jdsunrise,use_dst,stdz,*jdb,*jde,zabr);
+		}
+		if((tn.jdsunrise <= 0.) || (tn.jdsunset <= 0.))
+			oprntf(" Sunrise not correctly computed.");
+	}
+
+	/* 18-degree twilight */
+	if(tn.twi18state == -1)
+		oprntf("\nFull darkness all day (sun below -18 deg).\n");
+	else if(tn.twi18state == 1)
+		oprntf("\nSun higher than 18-degree twilight all night.\n");
+	else if(tn.twi18state == 0) {
+		if(tn.jdetw > 0.) {
+			oprntf("\nEvening twilight: ");
+			print_tonight_time(tn.jdetw,use_dst,stdz,*jdb,*jde,zabr);
+			oprntf(";  LMST at evening twilight: ");
+			put_coords(tn.sidetw,0);
+			oprntf("\n");
+		}
+		else oprntf("Evening twilight incorrectly computed.\n");
+		if(tn.jdmtw > 0.) {
+			oprntf("Morning twilight: ");
+			print_tonight_time(tn.jdmtw,use_dst,stdz,*jdb,*jde,zabr);
+			oprntf(";  LMST at morning twilight: ");
+			put_coords(tn.sidmtw,0);
+		}
+		else oprntf("Morning twilight incorrectly computed.");
+	}
+
+	/* 12-degree twilight */
+	if(tn.twi12state == -1)
+		oprntf("\nSun always below 12-degree twilight...\n");
+	else if(tn.twi12state == 1)
+		oprntf("\nSun always above 12-degree twilight...\n");
+	else if(tn.twi12state == 0) {
+		if(tn.jdetw12 > 0.) {
+			oprntf("\n12-degr twilight:");
+			print_tonight_time(tn.jdetw12,use_dst,stdz,*jdb,*jde,zabr);
+		}
+		else oprntf("Evening 12-degree twilight incorrectly computed.\n");
+		if(tn.jdmtw12 > 0.) {
+			oprntf(" -->");
+			print_tonight_time(tn.jdmtw12,use_dst,stdz,*jdb,*jde,zabr);
+			oprntf("; ");
+		}
+		else oprntf("Morning 12-degree twilight incorrectly computed.");
+	}
+
+        if(tn.jdcent > 0.) {
+		oprntf("night center: ");
+		print_tonight_time(tn.jdcent,use_dst,stdz,*jdb,*jde,zabr);
+	}
+	oprntf("\n\n");
+	if(tn.moonstate == -1)
+		oprntf("Moon's midnight position does not rise.\n");
+	else if(tn.moonstate == 1)
+		oprntf("Moon's midnight position does not set.\n");
+	else {
+	  /* it's nice to see the event which happens first printed first,
+	     so k = 0 is the earlier of the two. */
+	  for(k = 0; k < 2; k++) {
+	    if((k == 0) == (tn.jdmoonset >= tn.jdmoonrise)) {
+		if((tn.jdmoonrise > 0.) && (fabs(tn.tmoonrise) < tn.moon_print)) {
+		  /* print it if computed correctly and more-or-less at night */
+			oprntf("Moonrise: ");
+			print_tonight_time(tn.jdmoonrise,use_dst,stdz,*jdb,*jde,zabr);
+			oprntf("   ");
+		}
+		else if (tn.jdmoonrise < 0.) oprntf("Moonrise incorrectly computed. ");
+	    }
+	    else {
+		if((tn.jdmoonset > 0.) && (fabs(tn.tmoonset) < tn.moon_print)) {
+			oprntf("Moonset : ");
+			print_tonight_time(tn.jdmoonset,use_dst,stdz,*jdb,*jde,zabr);
+			oprntf("   ");
+		}
+		else if (tn.jdmoonset < 0.) oprntf("Moonset incorrectly computed. ");
+	    }
+	  }
+	}
+
+	oprntf("\nMoon at civil midnight: ");
+	oprntf("illuminated fraction %5.3f\n",tn.ill_frac);
+	print_phase(tn.jdmid);
+	oprntf(", RA and dec: ");
+	put_coords(tn.ramoon,2);
+	oprntf(", ");
+	put_coords(tn.decmoon,1);
+	oprntf("\n\n");
+
+     /* print more information if desired */
+     if(short_long == 2) {  /* wacky indenting here ... */
+	oprntf("The sun is down for %4.1f hr; %4.1f hr from eve->morn 18 deg twilight.\n",
+		tn.set_to_rise,tn.twi_to_twi);
+	if((tn.jdmoonrise > 100.) && (tn.jdmoonset > 100.) &&
+	   (tn.twi_to_twi > 0.) && (tn.twi_to_twi < 24.)) {
+	  /* that is, non-pathological */
+		if((tn.jdmoonrise > tn.jdetw) && (tn.jdmoonrise < tn.jdmtw)) /* rises at night */
+			oprntf("%4.1f dark hours after end of twilight and before moonrise.\n",
+			  (24.*(tn.jdmoonrise - tn.jdetw)));
+		if((tn.jdmoonset > tn.jdetw) && (tn.jdmoonset < tn.jdmtw)) /* sets at night */
+			oprntf("%4.1f dark hours after moonset and before beginning of twilight.\n",
+			  (24.*(tn.jdmtw - tn.jdmoonset)));
+		if((tn.jdmoonrise < tn.jdetw) && (tn.jdmoonset > tn.jdmtw))
+			oprntf("Bright all night (moon up from evening to morning twilight).\n");
+		if((tn.jdmoonrise > tn.jdmtw) && (tn.jdmoonset < tn.jdetw))
+			oprntf("Dark all night (moon down from evening to morning twilight).\n");
+	}
+     }  /* closes the wacky indent. */
+}
+
+void calc_circumstances_r(ctx,objra,objdec,objepoch,jd,curep,
+	mura_sec,mudec,sid,lat,elevsea,c)
+
+	struct skycalc_ctx *ctx;
+	double objra,objdec,objepoch,curep,mura_sec,mudec,lat;
+	double jd,sid,elevsea;
+	struct circumstances *c;
+
+/* Given object, site, and time information, computes the
+   circumstances of an observation -- everything print_circumstances
+   reports -- without printing anything. */
+
+{
+	double x, y, z, ang_moon, ep;
+
+	c->pm = (mura_sec != 0.) || (mudec != 0.);
+	c->objra_adj = objra + (curep-objepoch)* mura_sec/3600.;
+	c->objdec_adj = objdec + (curep-objepoch)*mudec/3600.;
+	c->mura_arcs = mura_sec * 15. *
+	     cos(objdec / DEG_IN_RADIAN);
+	precrot_r(ctx,c->objra_adj,c->objdec_adj,objepoch,curep,
+		&c->curra,&c->curdec);
+	c->ha = adj_time(sid - c->curra);
+	c->alt=altit(c->curdec,c->ha,lat,&c->az);
+	c->secz = secant_z(c->alt);
+	c->par = parang(c->ha,c->curdec,lat);
+
+	accumoon_r(ctx,jd,lat,sid,elevsea,&c->georamoon,&c->geodecmoon,
+		&c->geodistmoon,&c->ramoon,&c->decmoon,&c->distmoon);
+	accusun_r(ctx,jd,sid,lat,&c->rasun,&c->decsun,&c->distsun,
+		&c->toporasun,&c->topodecsun,&x,&y,&z);
+	c->sun_alt=altit(c->topodecsun,(sid-c->toporasun),lat,&c->sun_az);
+	c->sun_moon = subtend(c->ramoon,c->decmoon,c->toporasun,c->topodecsun);
+	c->ill_frac= 0.5*(1.-cos(c->sun_moon)); /* ever so slightly inaccurate ...
+	   basis of ancient Greek limit on moon/sun distance ratio! */
+	c->sun_moon = c->sun_moon * DEG_IN_RADIAN;
+	c->sol_ecl = 0;
+	if((c->sun_alt >= -18.) && (c->sun_moon < 1.5))
+		c->sol_ecl = solecl_calc(c->sun_moon,c->distmoon,c->distsun,
+			&c->sol_ecl_mag);
+		/* check for solar eclipse if it's close */
+
+	c->moon_alt=altit(c->decmoon,(sid-c->ramoon),lat,&c->moon_az);
+	c->lun_ecl = 0;
+	c->have_vmoon = 0;
+	if(c->moon_alt > -2.) {
+		c->obj_moon = DEG_IN_RADIAN *
+			subtend(c->ramoon,c->decmoon,c->curra,c->curdec);
+		if(fabs(c->obj_moon) <= 10.) {
+			ang_moon = DEG_IN_RADIAN *
+				asin(RMOON / (c->distmoon * EQUAT_RAD));
+			c->obj_lunlimb = c->obj_moon - ang_moon;
+		}
+		if(c->sun_moon > 176.)
+			c->lun_ecl = lunecl_calc(c->georamoon,c->geodecmoon,
+				c->geodistmoon,c->rasun,c->decsun,c->distsun,
+				&c->lun_ecl_mag);
+		if((c->moon_alt > 0.) && (c->alt > 0.5) && (c->sun_alt < -9.)) {
+		  /*if it makes sense to estimate a lunar sky brightness */
+			c->have_vmoon = 1;
+			c->Vmoon = lunskybright(c->sun_moon,c->obj_moon,KZEN,
+				c->moon_alt,c->alt,c->distmoon);
+		}
+	}
+	ep = curep;
+	eclipt(objra,objdec,objepoch,jd,&ep,&c->eclong,&c->eclat);
+	planet_seps_r(ctx,jd,c->curra,c->curdec,c->planet_sep);
+	helcor_r(ctx,jd,c->curra,c->curdec,c->ha,lat,elevsea,&c->tcor,&c->vcor);
+	c->bjd = jd + c->tcor/SEC_IN_DAY;
+}
+
+void calc_circumstances(objra,objdec,objepoch,jd,curep,
+	mura_sec,mudec,sid,lat,elevsea,c)
+
+	double objra,objdec,objepoch,curep,mura_sec,mudec,lat;
+	double jd,sid,elevsea;
+	struct circumstances *c;
+{
+	calc_circumstances_r(&skycalc_default_ctx,objra,objdec,objepoch,jd,
+		curep,mura_sec,mudec,sid,lat,elevsea,c);
+}
+
+void print_circumstances(objra,objdec,objepoch,jd,curep,
+	mura_arcs,mura_sec,mudec,sid,lat,elevsea,horiz)
+
+double objra,objdec,objepoch,curep,mura_arcs,mura_sec,mudec,lat,horiz;
+double jd,sid,elevsea;
+
+/* Given object, site, and time information, prints the circumstances
+   of an observation.  The heart of the "calculator" mode.  The
+   numbers come from calc_circumstances. */
+
+{
+	struct circumstances c;
+
+	calc_circumstances(objra,objdec,objepoch,jd,curep,mura_sec,mudec,
+		sid,lat,elevsea,&c);
+
+	oprntf("\n\nStd epoch--> RA:");
+	put_coords(objra,3);
+	oprntf(", dec:");
+	put_coords(objdec,2);
+	oprntf(", ep %7.2f\n",objepoch);
+	if((mura_sec != 0.) | (mura_arcs != 0.) |(mudec != 0.)) {
+		oprntf("Adj for p.m: RA:");
+		put_coords(c.objra_adj,3);
+		oprntf(", dec:");
+		put_coords(c.objdec_adj,2);
+		oprntf(", epoch %7.2f, equinox %7.2f\n", curep,objepoch);
+		oprntf("(Annual proper motions:");
+      		oprntf(" RA: %8.4f sec //%7.3f arcsec, ",mura_sec,c.mura_arcs);
+		oprntf("dec: %7.3f)\n",mudec);
+	}
+	oprntf("Current  --> RA:");
+	put_coords(c.curra,3);
+	oprntf(", dec:");
+	put_coords(c.curdec,2);
+	oprntf(", ep %7.2f\n",curep);
+	oprntf("HA: ");
+	put_coords(c.ha,2);
+	/* test size of sec z to avoid overflowing space provided */
+ 	if(fabs(c.secz) < 100.) oprntf("; sec.z = %8.3f",c.secz);
+	else oprntf(" Obj very near horizon.");
+	if(c.secz > 3.) oprntf(" -- Large airmass!\n");
+	else if(c.secz < 0.) oprntf(" -- BELOW HORIZON.\n");
+	else oprntf("\n");
+	oprntf("altitude %6.2f, azimuth %6.2f, ",c.alt,c.az);
+	oprntf("parallactic angle %4.1f",c.par);
+	/* also give +- 180 ..... */
+	if((c.par <= 180.) && (c.par > 0.)) oprntf("  [%4.1f]\n\n",c.par - 180.);
+	 else oprntf("  [%4.1f]\n\n",c.par + 180.);
+	if(c.sun_alt < -18.) oprntf("The sun is down; there is no twilight.\n");
+	else {
+		if (c.sun_alt < -(0.83+horiz))
+			oprntf("In twilight, sun alt %4.1f, az %5.1f ",c.sun_alt,c.sun_az);
+		else oprntf("The sun is up, alt %4.1f, az %4.1f",c.sun_alt,c.sun_az);
+		oprntf("; Sun at ");
+		put_coords(c.toporasun,3);
+		oprntf(", ");
+		put_coords(c.topodecsun,2);
+		oprntf("\n");
+		print_solecl(c.sol_ecl,c.sol_ecl_mag);
+		if (c.sun_alt < -(0.83+horiz))
+		  oprntf("Clear zenith twilight (blue) approx %4.1f  mag over dark night sky.\n",
+				ztwilight(c.sun_alt));
+	}
+	if(c.moon_alt > -2.) {
+		oprntf("Moon :");
+		put_coords(c.ramoon,2);
+		oprntf(",");
+		put_coords(c.decmoon,1);
+		oprntf(", alt %5.1f, az %5.1f;",c.moon_alt,c.moon_az);
+		oprntf("%6.3f illum.\n",c.ill_frac);
+		print_phase(jd);
+		if(fabs(c.obj_moon) > 10.) {
+		  oprntf(".  Object is %5.1f degr. from moon.\n",c.obj_moon);
+		}
+		else  {
+			if(c.obj_lunlimb > 0.)
+			  oprntf(" ** NOTE ** Object %4.1f degr. from lunar limb!\n",c.obj_lunlimb);
+			else oprntf(" ** NOTE ** You're looking AT the moon!\n");
+		}
+		print_lunecl(c.lun_ecl,c.lun_ecl_mag);
+		if(c.have_vmoon) {
+		     oprntf("Lunar part of sky bright. = %5.1f V mag/sq.arcsec (estimated).\n",c.Vmoon);
+		     if(c.lun_ecl != 0)
+			oprntf(" NOT including effect of LUNAR ECLIPSE ...!\n");
+		}
+	}
+	else {
+		print_phase(jd);
+		oprntf(".  The moon is down.\n");
+	}
+	if(fabs(c.eclat)<10.) {
+		oprntf("Ecliptic latitude %4.1f; ",c.eclat);
+		oprntf("watch for low-flying minor planets.\n");
+	}
+	print_planet_alert_r(&skycalc_default_ctx,c.planet_sep,PLANET_TOL);
+	/* tolerance set to 3 degrees earlier. */
+	oprntf("Barycentric corrections: add %6.1f sec, %5.2f",c.tcor,c.vcor);
+	oprntf(" km/sec to observed values.\n");
+	oprntf("Barycentric Julian date = %14.6f\n",c.bjd);
+}
+
+int calc_hourly_airmass_r(ctx,date,stdz,lat,longit,use_dst,objra,objdec,
+  objepoch,am)
+
+	struct skycalc_ctx *ctx;
+	struct date_time date;
+	double stdz,lat,longit,objra,objdec,objepoch;
+	short use_dst;
+	struct airmass_table *am;
+
+/* Computes the table hourly_airmass prints -- hour by hour through
+   the night of date, while the sun is down -- without printing.
+   Returns -1 if the date is out of range (1901 -> 2099), else 0.
+   The table runs at most AIRMASS_MAXHRS hours either side of the
+   center of the night. */
+
+{
+	double jd, sid, az, rasun, decsun, ramoon, decmoon, distmoon;
+	double hasset, jdsset, jdsrise, jdcent, span;
+	long int jdclong;
+	short i, hr_span;
+	struct airmass_row *row;
+
+	if((date.y <= 1900) | (date.y >= 2100)) return(-1);
+
+	find_dst_bounds_r(ctx,date.y,stdz,use_dst,&am->jdb,&am->jde);
+	date.h = 24; /* local midn */
+	date.mn = 0;
+	date.s = 0;
+	am->jdmid = date_to_jd(date) + stdz/24.;
+	/* first approx.-imperfect near time change */
+	am->jdmid = date_to_jd(date) +
+		zone(use_dst,stdz,am->jdmid,am->jdb,am->jde)/24.;
+	am->curep = 2000.+(am->jdmid - J2000)/365.25;
+	am->timechange = (use_dst != 0) &&
+		((fabs(am->jdmid - am->jdb) < 0.5) || (fabs(am->jdmid - am->jde) < 0.5));
+	precrot_r(ctx,objra,objdec,objepoch,am->curep,&am->curra,&am->curdec);
+	lpsun(am->jdmid,&rasun,&decsun);
+	sid=lst_r(ctx,am->jdmid,longit);
+	lpmoon(am->jdmid,lat,sid,&ramoon,&decmoon,&distmoon); /* close enuf */
+	am->ill_frac=0.5*(1.-cos(subtend(ramoon,decmoon,rasun,decsun)));
+	am->sepn = DEG_IN_RADIAN * subtend(ramoon,decmoon,am->curra,am->curdec);
+	planet_seps_r(ctx,am->jdmid,am->curra,am->curdec,am->planet_sep);
+
+        /* figure out how much to tabulate ... */
+
+        hasset = ha_alt(decsun,lat,-0.83);
+        jdsset = jd_body_alt_r(ctx,EVENT_SUN,-0.83,(am->jdmid - (12. - hasset) / 24.),
+		lat,longit,0.,EVENT_TOL);
+        jdsrise = jd_body_alt_r(ctx,EVENT_SUN,-0.83,(am->jdmid + (12. - hasset) / 24.),
+		lat,longit,0.,EVENT_TOL);
+        jdcent = (jdsset + jdsrise) / 2.;   /* center of night .. not local mid */
+        span = 12. * (jdsrise - jdsset) + 0.5;
+	if((jdsset < 0.) || (jdsrise < 0.)) {
+		/* no sunset or sunrise -- near the pole.  Tabulate the
+		   whole day around midnight; the rows are dropped anyway
+		   if the sun is up. */
+		jdcent = am->jdmid;
+		span = 12.;
+	}
+	if(span > AIRMASS_MAXHRS) span = AIRMASS_MAXHRS;
+        hr_span = (short) span;
+        jdclong = (long) ((24. * jdcent) + 0.5);  /* round to nearest hour */
+        jdcent = jdclong / 24. + 0.00001;  /* add a hair to prevent "24 00"
+              rounding ugliness in time table. */
+	am->nrows = 0;
+	for(i=(-1 * hr_span);i<=hr_span;i++) {
+		jd = jdcent + i/24.;
+		sid=lst_r(ctx,jd,longit);
+		lpsun(jd,&rasun,&decsun);
+		row = am->row + am->nrows;
+		row->sunalt = altit(decsun,(sid-rasun),lat,&az);
+		if(row->sunalt > 0.) continue;
+		row->jd = jd;
+		row->jdlocal = jd-zone(use_dst,stdz,jd,am->jdb,am->jde)/24.;
+		row->sid = sid;
+		row->ha = adj_time(sid - am->curra);
+		row->alt=altit(am->curdec,row->ha,lat,&az);
+		row->secz=secant_z(row->alt);
+		row->par = parang(row->ha,am->curdec,lat);
+		lpmoon(jd,lat,sid,&ramoon,&decmoon,&distmoon); /* close enuf */
+		row->moonalt=altit(decmoon,(sid-ramoon),lat,&az);
+		am->nrows++;
+	}
+	return(0);
+}
+
+int calc_hourly_airmass(date,stdz,lat,longit,use_dst,objra,objdec,
+  objepoch,am)
+
+	struct date_time date;
+	double stdz,lat,longit,objra,objdec,objepoch;
+	short use_dst;
+	struct airmass_table *am;
+{
+	return(calc_hourly_airmass_r(&skycalc_default_ctx,date,stdz,lat,
+		longit,use_dst,objra,objdec,objepoch,am));
+}
+
+void hourly_airmass(date,stdz,lat,longit,horiz,use_dst,objra,objdec,
+  objepoch, mura_sec,mura_arcs,mudec)
+
+/* Given a slew of information, prints a table of hourly airmass, etc.
+   for use in scheduling observations.  Also prints sun and moon
+   altitude when these are relevant.  Precesses coordinates as well.
+   The table itself comes from calc_hourly_airmass. */
+
+struct date_time date;
+double stdz,lat,longit,horiz,objra,objdec,objepoch,mura_sec,mura_arcs,mudec;
+short use_dst;
+
+{
+	struct airmass_table am;
+	struct airmass_row *row;
+	int nch, i;
+	short dow;
+	char obj_name[40];
+
+	if((date.y <= 1900) | (date.y >= 2100)) {
+		oprntf("Date out of range - 1901 -> 2099\n");
+		return;
+	}
+	oprntf("Name of object:");
+	nch = get_line(obj_name);
+
+	calc_hourly_airmass(date,stdz,lat,longit,use_dst,objra,objdec,
+		objepoch,&am);
+	oprntf("\n\n*** Hourly airmass for %s ***\n\n",obj_name);
+	if(am.timechange)
+		oprntf("*** NOTE STD/DAYLIGHT TIME CHANGE TONIGHT ***\n");
+	oprntf("Epoch %7.2f: RA ",objepoch);
+	put_coords(objra,3);
+	oprntf(", dec ");
+	put_coords(objdec,2);
+	oprntf("\n");
+	oprntf("Epoch %7.2f: RA ",am.curep);
+	put_coords(am.curra,3);
+	oprntf(", dec ");
+	put_coords(am.curdec,2);
+	if((mura_sec != 0.) | (mura_arcs != 0.) | (mudec != 0))
+	   oprntf("\n Caution .. proper motion ignored\n\n");
+	else oprntf("\n\n");
+	oprntf("At midnight: UT date ");
+	print_calendar(am.jdmid,&dow);
+	oprntf(", Moon %4.2f illum, %3.0f degr from obj\n",am.ill_frac,am.sepn);
+	print_planet_alert_r(&skycalc_default_ctx,am.planet_sep,PLANET_TOL);
+		/* better know about it .... */
+	oprntf("\n  Local      UT      LMST");
+	oprntf("      HA     secz   par.angl. SunAlt MoonAlt\n\n");
+
+	for(i = 0; i < am.nrows; i++) {
+		row = am.row + i;
+		print_time(row->jdlocal,0);
+		oprntf("  ");
+		print_time(row->jd,0);
+		oprntf("  ");
+		put_coords(row->sid,0);
+		oprntf("  ");
+		put_coords(row->ha,0);
+		oprntf("  ");
+	        if(row->alt < -(horiz)) oprntf(" (down)");
+		else if(row->alt < 1.0) oprntf("(v.low)");
+		else oprntf(" %6.3f",row->secz);
+		oprntf("  %6.1f ",row->par);
+		if(row->sunalt < -18.) oprntf("    ... ");
+		   else oprntf("   %5.1f",row->sunalt);
+		if(row->moonalt < -2.)  oprntf("    ... \n");
+		   else oprntf("   %5.1f\n",row->moonalt);
+	}
+}
+
+void print_params(date,enter_ut,night_date,stdz,lat,longit,site_name,
+    elevsea,elev,use_dst,objra,objdec,objepoch,mura_sec,mura_arcs,
+    mudec)
+
+    struct date_time date;
+    short enter_ut;
+    short night_date;
+    double stdz;
+    double lat;
+    double longit;
+    char *site_name;
+    double elevsea;
+    double elev;
+    short use_dst;
+    double objra;
+    double objdec;
+    double objepoch;
+    double mura_sec;
+    double mura_arcs;
+    double mudec;
+
+/* This simply prints a nicely formatted list of the *input* parameters
+   without doing any computations.  Helpful for the perplexed user, and
+   for checking things. */
+{
+	short dow;
+	double jd;
+
+	jd = date_to_jd(date);
+	oprntf("\nCurrent INPUT parameter values:\n\n");
+	oprntf("      DATE: ");
+	print_calendar(jd,&dow);
+	oprntf("\n      TIME:");
+	print_time(jd,3);
+	if(night_date == 1)
+		oprntf("\nNIGHT_DATE:  ON    -- date applies all evening & next morning.\n");
+	else oprntf("\nNIGHT_DATE:  OFF   -- date is taken literally.\n");
+	if(enter_ut == 1)
+		oprntf("  UT_INPUT:  ON    -- input times taken to be UT.\n");
+	else oprntf("  UT_INPUT:  OFF   -- input times taken to be local.\n");
+	if(use_dst == 0)
+		oprntf("   USE_DST:   0    -- Standard time in use all year.\n");
+	else oprntf("   USE_DST: %3d    -- Daylight savings used part of year.\n",
+			use_dst);
+	oprntf("\n");
+	oprntf("            RA: ");
+	put_coords(objra,4);
+	oprntf("\n           DEC: ");
+	put_coords(objdec,3);
+	oprntf("\n   INPUT EPOCH:   %8.2f\n",objepoch);
+	if((mura_sec == 0.) && (mura_arcs == 0.) && (mudec == 0.))
+		oprntf("PROPER MOTIONS:  OFF\n");
+	else    {
+          mura_arcs = mura_sec * 15. * cos(objdec / DEG_IN_RADIAN);
+	  oprntf("PROPER MOTIONS: RA(sec)=%6.3f, RA(arc)=%6.2f, DEC=%6.2f\n",
+		mura_sec,mura_arcs,mudec);
+        }
+	oprntf("\nSITE: %s\n",site_name);
+	oprntf("      E.longit. = ");
+	put_coords(-15. * longit,1);
+	oprntf(", latit. = ");
+	put_coords(lat,1);
+	oprntf(" (degrees)\n");
+	oprntf("      Standard zone = %3.0f hrs ",fabs(stdz));
+	if(stdz >= 0.) oprntf(" West\n");
+	  else oprntf(" East\n");
+	oprntf("      Elevation above horizon = %4.0f m, True elevation = %4.0f m\n",
+		elev,elevsea);
+}
+
+void print_menu()
+	{
+	if(skycalc_default_ctx.sclogfl != NULL) fprintf(skycalc_default_ctx.sclogfl,"\n\n *** Menu Choices *** \n");
+	oprntf("Circumstance calculator, type '=' for output.\n");
+	oprntf("Commands are SINGLE (lower-case!) CHARACTERS as follows:\n");
+	oprntf(" ? .. prints this menu; other information options are:\n");
+	oprntf("i,f . 'i' prints brief Instructions and examples, 'f' fast tour\n");
+	oprntf(" w .. prints info on internal Workings, accuracy & LEGALITIES\n");
+	oprntf("TO SET PARAMETERS & OPTIONS, use these (follow the formats!):\n");
+	oprntf(" r .. enter object RA, in hr min sec,  example: r 3 12 12.43\n");
+	oprntf(" d .. enter object Dec in deg min sec, example: d -0 18 0\n");
+	oprntf(" y .. enter date, starting with Year   example: y 1994 10 12\n");
+#if SYS_CLOCK_OK == 1
+     	oprntf("t,T: t = enter time, e.g.: t 22 18 02 [see 'g' and 'n']; T = right now+\n");
+#else
+     	oprntf(" t .. enter time, example: t 22 18 02 ; see 'g' and 'n' below\n");
+#endif
+     	oprntf(" n .. *toggles* whether date is used as 'evening' (default) or literal\n");
+	oprntf(" g .. *toggles* whether time is used as Greenwich or local\n");
+	oprntf(" e .. enter Epoch used to interpret input coords (default = 1950)\n");
+	oprntf(" p .. enter object Proper motions (complicated, follow prompts).\n");
+	oprntf(" s .. change Site (again, follow prompts).\n");
+	oprntf(" l .. Look at current parameter values (no computation).\n");
+	oprntf("TO CALCULATE AND SEE RESULTS, use these commands: \n");
+	oprntf(" = .. type out circumstances for specified instant of time, ra, dec, etc.\n");
+	oprntf(" a .. type out night's Almanac for specified (evening) date\n");
+	oprntf(" h .. type out Hourly airmass table for specified date, ra, dec\n");
+        oprntf(" o .. tabulate Observability at 2-week intervals (at full&new moon)\n");
+	oprntf(" m .. Major planets -- print 0.1 deg positions for specified instant\n");
+        oprntf(" x .. eXtra goodies: log file, object files, other calculators; try x? \n");
+	oprntf(" Q .. QUIT .. STOPS PROGRAM. ---> ");
+}
+
+void print_tutorial()
+{
+	if(skycalc_default_ctx.sclogfl != NULL) fprintf(skycalc_default_ctx.sclogfl,"\n  *** Fast Guided Tour listing ***\n\n");
+	oprntf("FAST GUIDED TOUR: (type 'f' to see this again).\n\n");
+	oprntf("To explore this program quickly, try the following (in order):\n\n");
+	oprntf("--> Specify an evening date (e.g., 1995 March 22) and then display\n");
+	oprntf("    the almanac for that night by typing \n");
+	oprntf("        y 1995 3 22   a \n");
+	oprntf("--> Specify an ra and dec and then make an hourly airmass table\n");
+	oprntf("    by typing, for instance \n");
+	oprntf("        r 15 28 27  d 12 13 14  h \n");
+	oprntf("    (Notice how the date you specified earlier is still in effect.)\n");
+	oprntf("--> Specify a time (e.g., 4 50 00 AM local time) and display the\n");
+	oprntf("    circumstances at that instant by typing\n");
+	oprntf("        t 4 50 0  =\n");
+	oprntf("--> Type 'o' and follow the prompts to show observability\n");
+	oprntf("    through a season (tabulated at new & full moon).\n");
+	oprntf("--> Type 'l' to list the current input parameters and options.\n");
+	oprntf("--> Type 'm' to list planetary positions.\n");
+#if SYS_CLOCK_OK == 1
+ 	oprntf("--> Type 'T' to set time & date to right now (+ settable offset).\n");
+        oprntf("--> Type 'x?' for eXtra goodies menu; log file, object lists etc..\n");
+	oprntf("--> Read the help texts; '?' prints a short menu, 'i' gives\n");
+#else
+	oprntf("--> Read the help texts; '?' prints a short menu, 'i' gives\n");
+#endif
+	oprntf("    more complete information, 'w' tells you about inner workings.\n");
+	oprntf("    An upper-case 'Q' exits the program.\n");
+	oprntf(" Give a command: ");
+}
+
+void print_examples() {
+
+	char cdum;
+
+	if(skycalc_default_ctx.sclogfl != NULL) fprintf(skycalc_default_ctx.sclogfl,"\n\n *** On-Line Documentation listing ***");
+	oprntf("\n\nMost parameters are entered as a single character followed\n");
+	oprntf("by a value; you then type an EQUALS SIGN to compute circumstances\n");
+	oprntf("for current site, time, and celestial position. FOR EXAMPLE:\n");
+	oprntf("You observe an object at RA 19 02 23.3, dec -5 18 17\n");
+	oprntf("epoch 2000., on 1993 June 18, at 21 32 18 local time, from\n");
+	oprntf("the site you've selected.  To calculate circumstances, type\n\n");
+	oprntf("r 19 02 23.3 d -5 18 17 e 2000 y 1993 6 18 t 21 32 18 =\n\n");
+	oprntf("Note: coords, dates and times are entered as TRIPLETS OF NUMBERS\n");
+	oprntf("separated by blanks (not colons), and date format is y m d.\n");
+	oprntf("Commands are CASE SENSITIVE (R is not r)!  Carriage returns\n");
+	oprntf("can go almost anywhere. Parameters remain in effect until you\n");
+	oprntf("change them, so in this example typing\n");
+	oprntf("t 23 32 18 =  \n");
+	oprntf("would give circumstances for the same object two hours later.\n\n");
+
+	oprntf("Typing 'a' prints an almanac for the currently specified date -- be\n");
+	oprntf("careful you have the correct night if you've used 'n' or 'g'. (below).\n\n");
+
+	oprntf("(Hit return to continue listing...)");
+	scanf("%c",&cdum);
+	scanf("%c",&cdum);  /* first one eats fossil input.. */
+
+	oprntf("\n\nTwo commands invoke options for the interpretation of times and dates.\n");
+        oprntf("[N. B. -- This issue is a little confusing, but important .... ]\n");
+	oprntf("By default, the program interprets dates as 'evening', so late PM and\n");
+	oprntf("early AM times refer to the same night.  Typing 'n' (for 'night date')\n");
+	oprntf("TOGGLES bewteen this and literal dates.  Also by default, input\n");
+	oprntf("times are in local (zone) time, but input times can be interpreted as UT;\n");
+	oprntf("typing 'g' TOGGLES between these.  Invoking UT mode disables night dates.\n");
+	oprntf("Note that 'g', 'n' (and the epoch option 'e') do not cause calculation, but\n");
+	oprntf("only affect interpretation of the relevant parameters at compute time.\n\n");
+
+	oprntf("Typing 'l' (look) causes all the input parameters to be typed out without\n");
+        oprntf("any computation, which is especially helpful if you're lost by 'g' or 'n'.\n\n");
+
+	oprntf("Typing 'h' creates a table of airmass, etc. at hourly intervals through\n");
+	oprntf("the night.  You may wish to redirect output (using system) to print.\n\n");
+
+	oprntf("Typing 'o' computes observability of an object for each dark\n");
+	oprntf("and bright run through a range of dates.\n\n");
+
+	oprntf("(Hit return to continue listing...)");
+	scanf("%c",&cdum);
+
+	oprntf("\nTyping 'm' displays rough (see 'w' option) positions of major planets.\n\n");
+
+	oprntf("To change observing sites, type 's' and answer the prompts.\n\n");
+
+#if SYS_CLOCK_OK == 1
+	oprntf("Typing 'T' sets BOTH the TIME and DATE to 'now' using the system clock.\n");
+	oprntf("You can also specify a number of minutes into the future to set.  The status\n");
+	oprntf("of the 'n' and 'g' options are properly taken into account.\n\n");
+#endif
+	oprntf("To enable an approximate proper motion correction, type 'p' and\n");
+	oprntf("answer the prompts *carefully*.  Re-enter as zero to turn off.\n\n");
+	oprntf("Typing 'x' invokes many useful commands -- log file, object files, etc!\n\n");
+	oprntf("Type command, Q (upper case) to stop, or ? for a menu:");
+}
+
+void print_accuracy()
+
+{
+
+	char cdum;
+
+        if(skycalc_default_ctx.sclogfl != NULL) fprintf(skycalc_default_ctx.sclogfl,"\n\n");
+	oprntf("ACCURACY INFO:\n\n");
+	oprntf("The distinctions between UTC, UT1, TDT (etc.) are ignored\n");
+	oprntf("except that a rough correction to TDT is used for the moon.\n");
+	oprntf("The solar ephemeris used is good to a few arcsec.  Moon positions\n");
+	oprntf("positions are topocentric and +- about 30 arcsec, hence solar\n");
+	oprntf("eclipse paths are +- 50 km and +- 1 min. All rise/set times are\n");
+	oprntf("computed to about +-1 min; non-level horizon, site elevation,\n");
+	oprntf("and refraction uncertainties are often larger than this.\n\n");
+	oprntf("The lunar sky brightness model assumes ideal atmospheric conditions;\n");
+	oprntf("true lunar contributions to sky will vary widely.  To compare\n");
+	oprntf("a dark site has about V=21.5 mag/sq.arcsec (variable)! Twilight\n");
+	oprntf("brightness prediction is for blue, and only very approximate.\n\n");
+	oprntf("The planetary calculations are truncated, but the error should\n");
+	oprntf("seldom exceed 0.1 degree; MV are best(1'), MJSU ok, Pluto worst.\n");
+	oprntf("\nNote that the local sidereal time given is Mean, not true,\n");
+	oprntf("and that it assumes the input is true UT, not UTC (< 1 second)\n");
+	oprntf("(Hit return to continue listing...)");
+	scanf("%c",&cdum);
+	scanf("%c",&cdum);  /* first one usually eats fossil input.. */
+	oprntf("\nDaylight savings time, if selected, is established using a\n");
+	oprntf("site-specific convention (e.g., USA).  Beware of ambiguities\n");
+	oprntf("and nonexistent times when the clock is reset.  If necessary,\n");
+	oprntf("use the 'g' option and enter times and dates as Greenwich (UT),\n");
+	oprntf("or disable DST in site params (see discussion under 'i').\n\n");
+	oprntf("The *precession* routine used is a 'rigorous'");
+	oprntf(" rotation matrix routine,\ntaken from L. Taff's Computational");
+	oprntf(" Spherical Astronomy.\nIt uses IAU1976 constants, is good to < 1 arcsec in 50 years,\n");
+	oprntf("and has no troubles near the pole.  Proper motion corrections\n");
+	oprntf("are done crudely as x = x0 + mu * dt; this is inaccurate near\n");
+	oprntf("the poles.  Use another routine if sub-arcsec accuracy is critical.\n");
+	oprntf("Apparent place (with nutation, aberration) is NOT computed.\n");
+	oprntf("(Hit return to continue listing...)");
+	scanf("%c",&cdum);
+	oprntf("\n\nThe parallactic angle follows Filippenko (1982, PASP 94, 715).\n");
+	oprntf("\nThe barycentric ('heliocentric') corrections are computed using\n");
+	oprntf("an elliptical earth orbit with a few periodic perturbations\n");
+	oprntf("including lunar recoil.  The helio-to-barycentric transformation\n");
+	oprntf("uses the same algorithms as the planetary postions.  Overall max error:\n");
+	oprntf("< 0.2 sec and < 0.005 km/s.  Velocity corrn. includes earth rotation.\n");
+	oprntf("\nThe galactic coordinate routine is rigorously accurate, and\n");
+	oprntf("precesses to 1950 before transforming.  The ecliptic coord.\n");
+	oprntf("routine is for coordinates of date and is good to < 1 arcsec.\n\n");
+	oprntf("These routines are **not necessarily correct** at times very far from\n");
+	oprntf("the present (1990s).  The program rejects input outside 1900-2100.\n");
+	oprntf("\nWhen porting to a new machine, run tests to ensure\n");
+	oprntf("correctness and accuracy.  Experience shows that compiler\npeculiarities arise ");
+	oprntf("surprisingly often.\n");
+	oprntf("(Hit return to continue listing...)");
+	scanf("%c",&cdum);
+	oprntf("CAUTIONS, LEGALITIES:\n");
+	oprntf("Many routines take a time argument which is a double-precision\n");
+	oprntf("floating-point julian date; on most workstations, this gives\n");
+	oprntf("time resolution of < 0.1 second.  When porting\n");
+	oprntf("to another machine or compiler, test that the accuracy is\n");
+	oprntf("sufficient.  \n\n");
+	oprntf("I cannot guarantee that this program is bug-free, and caution\n");
+   /* although at this time I really don't know of any bugs ... ! */
+	oprntf("that not all routines are thoroughly precise and rigorous.\n");
+	oprntf("The user of this program is responsible for interpreting \n");
+	oprntf("results correctly.  I disavow any legal liability for damages\n");
+	oprntf("caused by use of this program.\n\n");
+	oprntf("Program copyright 1993, John Thorstensen, Dartmouth College\n");
+	oprntf("Permission hereby granted for scientific/educational use.\n");
+	oprntf("Commercial users must license.  Please communicate problems or\n");
+	oprntf("suggestions to the author, John Thorstensen, Dept. Physics\n");
+	oprntf("and Astronomy, Dartmouth College, Hanover NH 03755\n");
+	oprntf("John.Thorstensen@Dartmouth.edu\n");
+	oprntf("\nType command, or ? to see menu again.:");
+}
+
+void print_legalities()
+
+{
+	printf("\nThis has been superseded -- this shouldn't print out.\n");
+}
+
+
+void ephemgen(ra, dec, ep, lat, longit)
+	double ra, dec, ep, lat, longit;
+
+{
+
+/* Prompts for elements of an ephemeris, then
+   generates a printout of the *geocentric*
+   ephemeris of an object.  Uses current values of ra and dec;
+   ignores observatory parameters, which are much more important
+   for velocity than for time.  Not *strictly* correct in that
+   earth's position in helio-to-geo conversion is computed (strictly
+   speaking) for heliocentric jd, while ephemeris is for (presumably)
+   geocentric jd.  This makes a difference of at most 30 km/s  over c,
+   or about 1 in 10**4, for the heliocentric correction.  Pretty trivial.
+
+   Observatory paramaters are used in determining observability of
+   phenomenon.
+*/
+
+  double t0=0., per; /* ephemeris -- t0 + per * cycle count */
+  int ibeg, iend, cycles;
+  double curra, curdec, curep;
+  double max_secz, min_alt, max_alt, min_ok_alt, sun_alt, max_ok_sun, secz;
+  double sid, ha, altitude, az, rasun, decsun, hasun;
+  double jd, jdstart, jdend, tcor, vcor;
+  struct date_time tempdate;
+  int valid_date = 0;
+  short dow;
+
+  printf("Prints geocentric times of repeating phenom, e.g. stellar eclipses.\n");
+  printf("Not suitable for very short periods (seconds) -- too many events.\n");
+  printf("You may optionally specify that only events observable from your site\n");
+  printf("be printed.\n\n");
+  printf("Give heliocentric period, days; negative exits:");
+  scanf("%lf",&per);
+  if(per < 0.) return;
+  printf("Give heliocentric jd of time zero, *all* the digits!:");
+  scanf("%lf",&t0);
+  if(t0 < 2000000.) {
+	printf("Exiting -- JD *has* to be greater than 2 million!\n");
+	return;
+  }
+  printf("Give starting UT date for listing, yyyy mm dd, neg year exits:");
+  if((valid_date = get_date(&tempdate)) < 0) return;
+/*  printf("Give starting ut, h m s:");
+  get_time(&tempdate);   Too much of pain to enter .. force to ut = 0 */
+  tempdate.h = 0.;
+  tempdate.mn = 0.;
+  tempdate.s = 0.;
+  jdstart = date_to_jd(tempdate);
+  printf("Give ending date for listing:");
+  get_date(&tempdate);
+/*  printf("Give ending time:");
+  get_time(&tempdate);  */
+  jdend = date_to_jd(tempdate);
+  printf("Give maximum airmass for listing, negative to print all:");
+  scanf("%lf",&max_secz);
+  if(max_secz > 0.) min_ok_alt = 90. - DEG_IN_RADIAN * acos(1/max_secz);
+  else min_ok_alt = -100.;
+  curep = 2000. + (jdstart - J2000)/365.25;    /* precess to check observ. */
+  precrot(ra,dec,ep,curep,&curra,&curdec);
+  min_max_alt(lat,curdec,&min_alt,&max_alt);
+  if(max_alt < min_ok_alt) {
+  oprntf("Object never rises this high -- max alt %5.1f deg -- returning!\n",
+           max_alt);
+	return;
+  }
+
+  printf("Give maximum allowable sun altitude to print, 90 to print all:");
+  scanf("%lf",&max_ok_sun);
+
+  oprntf("\nObject RA = ");
+  put_coords(ra,3);
+  oprntf(", dec = ");
+  put_coords(dec,2);
+  oprntf(" epoch %6.1f\n",ep);
+  oprntf("Site long = ");
+  put_coords(longit,3);
+  oprntf("W (hr.mn.sec), lat = ");
+  put_coords(lat,2);
+  oprntf("N \n");
+  oprntf("\nEphemeris: %lf + %14.8f E (Heliocentric)\n\n",t0, per);
+  oprntf("Listing of events in interval from ");
+  print_calendar(jdstart,&dow);
+  oprntf(" UT to ");
+  print_calendar(jdend,&dow);
+  oprntf(" UT.\n");
+  if(min_ok_alt > 0.) oprntf("Only events at sec(z) < %5.2f are shown.\n",
+        max_secz);
+  if(max_ok_sun < 89.)
+	oprntf("Only events with sun altit. < %6.1f degrees are shown.\n\n",
+	max_ok_sun);
+  oprntf("First columns show cycle number, GEOCENTRIC jd, date and time (UT);\n");
+  oprntf("Last show HA, sec(z), 'ngt' if night, sun alt if twilit, 'day' if day.\n\n");
+  ibeg = (jdstart - t0) / per;  /* truncate */
+  iend = (jdend - t0) / per;    /* truncate again */
+
+  for(cycles = ibeg; cycles <= iend; cycles++) {
+ 	jd = t0 + (double) cycles * per;
+	curep = 2000. + (jd - J2000)/365.25;    /* precess to current */
+        precrot(ra,dec,ep,curep,&curra,&curdec);
+	helcor(jd, curra, curdec, 0., 0., 0., &tcor, &vcor);
+/*      oprntf("Raw = %12.4f, Correction: %f\n",jd,tcor);   diagnostic */
+        jd = jd - tcor / SEC_IN_DAY;  /* subtract to convert to geo .*/
+        sid = lst(jd,longit);
+        ha = adj_time(sid - curra);
+        altitude = altit(curdec,ha,lat,&az);
+	secz = secant_z(altitude);
+        if(altitude >= min_ok_alt) {
+           lpsun(jd,&rasun,&decsun);  /* lpsun plenty good enough */
+	   hasun = sid - rasun;
+	   sun_alt = altit(decsun,hasun,lat,&az);
+           if(sun_alt < max_ok_sun) {
+              oprntf("# %d  JD(geo) %12.4f = ",cycles,jd);
+	      print_calendar(jd,&dow);
+	      oprntf(", ");
+              print_time(jd,3);
+	      oprntf(" UT");
+	      put_coords(ha,0);
+	      if((secz < 10.) && (secz > 0.)) oprntf(" %5.2f",secz);
+              else if (secz > 0.) oprntf(" v.low");
+	      else oprntf(" down!");
+	      if(sun_alt <= -18.) oprntf(" ngt");
+	      else if(sun_alt <= -0.53) oprntf(" %3.0f",sun_alt);
+	      else oprntf(" day");
+	      oprntf("\n");
+	   }
+       }
+  }
+  oprntf("Listing done.  Type ? if you need a menu.\n");
+}
+
+#define ALT_3  19.47  /* 19.47 degrees altitude => sec z = 3 */
+#define ALT_2  30.
+#define ALT_15 41.81
+#define SID_RATE 1.0027379093  /* sidereal / solar rate */
+
+double hrs_up(jdup, jddown, jdeve, jdmorn)
+
+	double jdup, jddown, jdeve, jdmorn;
+{
+
+   /* If an object comes up past a given point at jdup,
+      and goes down at jddown, and evening and morning
+      are at jdeve and jdmorn, computes how long
+      object is up *and* it's dark.  ... Written as
+      function 'cause it's done three times below. */
+
+   double jdup2, jddown0;  /* for the next ... or previous ...
+                            time around */
+
+   if(jdup < jdeve) {
+     if(jddown >= jdmorn)   /* up all night */
+	return ((jdmorn - jdeve) * 24.);
+     else if(jddown >= jdeve)  {
+	/* careful here ... circumpolar objects can come back *up*
+	   a second time before morning.  jdup and jddown are
+	   the ones immediately preceding and following the upper
+	   culmination nearest the center of the night, so "jdup"
+	   can be on the previous night rather than the one we want. */
+       jdup2 = jdup + 1.0/SID_RATE;
+       if(jdup2 > jdmorn)  /* the usual case ... doesn't rise again */
+	   return ((jddown - jdeve) * 24.);
+       else return(((jddown - jdeve) + (jdmorn - jdup2)) * 24.);
+     }
+     else return(0.);
+   }
+   else if(jddown > jdmorn) {
+     if(jdup >= jdmorn) return(0.);
+     else {
+	/* again, a circumpolar object can be up at evening twilight
+	    and come 'round again in the morning ... */
+        jddown0 = jddown - 1.0/SID_RATE;
+	if(jddown0 < jdeve) return((jdmorn - jdup) * 24.);
+        else return(((jddown0 - jdeve) + (jdmorn - jdup)) * 24.);
+     }
+   }
+   else return((jddown - jdup)*24.);  /* up & down the same night ...
+      might happen a second time in pathological cases, but this will
+      be extremely rare except at very high latitudes.  */
+}
+
+void print_air_r(ctx,secz,prec)
+	struct skycalc_ctx *ctx;
+    	double secz;
+	short prec;
+{
+   if((secz > 0.) && (secz < 100.)) {
+	if(prec == 0) oprntf_r(ctx," %5.1f ",secz);
+	         else oprntf_r(ctx," %5.2f ",secz);
+   }
+   else if(secz > 0.) oprntf_r(ctx," v.low ");
+   else if(secz < 0.) oprntf_r(ctx,"  down ");
+}
+
+void print_air(secz,prec)
+	double secz;
+	short prec;
+{
+	print_air_r(&skycalc_default_ctx,secz,prec);
+}
+
+void print_ha_air_r(ctx,ha,secz,prec1,prec2)
+	struct skycalc_ctx *ctx;
+	double ha, secz;
+	short prec1, prec2;
+{
+ 	put_coords_r(ctx,ha,prec1);
+	oprntf_r(ctx," ");
+	print_air_r(ctx,secz,prec2);
+}
+
+void print_ha_air(ha,secz,prec1,prec2)
+	double ha, secz;
+	short prec1, prec2;
+{
+	print_ha_air_r(&skycalc_default_ctx,ha,secz,prec1,prec2);
+}
+
+int skycalc_nthreads(nthreads)
+
+	int nthreads;
+
+/* how many threads skycalc_parallel will really use when asked
+   for nthreads; zero or less means one per online processor. */
+
+{
+#if THREADS_OK == 1
+	long ncpu;
+
+	if(nthreads <= 0) {
+		ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = (ncpu > 0) ? (int) ncpu : 1;
+	}
+	if(nthreads > MAX_THREADS) nthreads = MAX_THREADS;
+	return(nthreads);
+#else
+	return(1);
+#endif
+}
+
+#if THREADS_OK == 1
+
+void *par_worker(arg)
+
+	void *arg;
+
+/* one of skycalc_parallel's threads -- takes chunks off the
+   shared counter until there are none left. */
+
+{
+	struct par_job *job;
+	int i0, i1;
+
+	job = (struct par_job *) arg;
+	while(1) {
+		pthread_mutex_lock(&job->lock);
+		i0 = job->next;
+		job->next += job->chunk;
+		pthread_mutex_unlock(&job->lock);
+		if(i0 >= job->n) break;
+		i1 = i0 + job->chunk;
+		if(i1 > job->n) i1 = job->n;
+		(*job->func)(job->arg,i0,i1);
+	}
+	return(NULL);
+}
+
+#endif
+
+int skycalc_parallel(nthreads,n,chunk,func,arg)
+
+	int nthreads, n, chunk;
+	void (*func)(void *arg, int i0, int i1);
+	void *arg;
+
+/* calls func(arg,i0,i1) over items 0 through n-1, chunk items at a
+   time, spread over nthreads threads (see skycalc_nthreads).  func
+   has to be safe to run in several threads at once -- in practice,
+   it mustn't touch a skycalc_ctx, since contexts aren't locked.
+   If threads aren't available, or don't start, the chunks are all
+   done in the calling thread.  Returns the number of threads used. */
+
+{
+	int i, nt;
+#if THREADS_OK == 1
+	struct par_job job;
+	pthread_t tid[MAX_THREADS];
+#endif
+
+	if(n <= 0) return(0);
+	if(chunk < 1) chunk = 1;
+	nt = skycalc_nthreads(nthreads);
+	if(nt > (n + chunk - 1) / chunk) nt = (n + chunk - 1) / chunk;
+#if THREADS_OK == 1
+	if(nt > 1) {
+		job.func = func;
+		job.arg = arg;
+		job.n = n;
+		job.chunk = chunk;
+		job.next = 0;
+		pthread_mutex_init(&job.lock,NULL);
+		/* this thread works too, so start nt - 1 more */
+		for(i = 1; i < nt; i++)
+			if(pthread_create(&tid[i],NULL,par_worker,&job) != 0) break;
+		nt = i;
+		par_worker(&job);
+		for(i = 1; i < nt; i++) pthread_join(tid[i],NULL);
+		pthread_mutex_destroy(&job.lock);
+		return(nt);
+	}
+#endif
+	for(i = 0; i < n; i += chunk)
+		(*func)(arg,i,(i + chunk < n) ? i + chunk : n);
+	return(1);
+}
+
+int season_nights_r(ctx,jdstart,jdend,sun_twi,lat,longit,night)
+
+	struct skycalc_ctx *ctx;
+	double jdstart, jdend, sun_twi, lat, longit;
+	struct season_night **night;
+
+/* the sun's side of obs_season: for each new and full moon from the
+   one before jdstart through the first after jdend, the night nearest
+   the phase -- its natural center (the sun's lower culmination),
+   evening and morning twilight (sun at sun_twi), and the local
+   sidereal times of all three.  These are the same for every object,
+   so season_obs_calc can be run over many objects without redoing
+   them.  *night is malloc'ed; free it.  Returns the number of
+   nights, or -1 if out of memory. */
+
+{
+	struct season_night *nt;
+	int nlun, nph, n, nmax;
+	double jd, jdtrunc, jdmid, midnfrac, hatwi, hasun, rasun, decsun;
+
+	jd = jdstart - lun_age(jdstart,&nlun);
+	nph = 0;  /* jd is adjusted to last previous new moon */
+
+	/* two phases a lunation, and one over at each end */
+	nmax = (int) ((jdend - jd) / 14.5) + 4;
+	if(nmax < 4) nmax = 4;
+	nt = (struct season_night *) malloc(nmax * sizeof(struct season_night));
+	if(nt == NULL) return(-1);
+
+	n = 0;
+	while(jd <= jdend && n < nmax) {
+		if(nph == 0) nph = 2;
+		else if(nph == 2) {
+			nlun++;
+			nph = 0;
+		}
+		flmoon(nlun,nph,&jd);
+		nt[n].nph = nph;
+		nt[n].jdphase = jd;
+
+		/* Take care to compute for the date nearest full or new ...
+		   people may use this as a lunar calendar, which it sort of
+		   isn't. */
+		midnfrac = 0.5 + longit/24.;  /* rough fractional part of jd
+				  for local midnight ... */
+		jdtrunc = (double)((long) jd);
+		jdmid = jdtrunc + midnfrac;
+		if((jd - jdmid) > 0.5) jdmid = jdmid + 1.;
+		else if((jd - jdmid) < -0.5) jdmid = jdmid - 1.;
+
+		lpsun(jdmid,&rasun,&decsun);
+		hasun = adj_time(lst_r(ctx,jdmid,longit) - rasun); /* at rough midn. */
+		if(hasun > 0.) nt[n].jdcent = jdmid + (12. - hasun) / 24.;
+		else nt[n].jdcent = jdmid - (hasun + 12.) / 24.;
+		/* jdcent is very close to sun's lower culmination
+		   -- natural center of night */
+
+		hatwi = ha_alt(decsun,lat,sun_twi);
+		if(hatwi > 100.) {
+			nt[n].jdeve = -1.;    /* signal -- no twilight */
+			nt[n].jdmorn = -1.;
+		}
+		else if(hatwi < -100.) {  /* always night */
+			nt[n].jdeve = nt[n].jdcent - 0.5; /* sensible, anyway  */
+			nt[n].jdmorn = nt[n].jdcent + 0.5;
+		}
+		else {
+			nt[n].jdmorn = jd_body_alt_r(ctx,EVENT_SUN,sun_twi,
+				nt[n].jdcent + (12. - hatwi) / 24.,lat,longit,
+				0.,EVENT_TOL);
+			nt[n].jdeve = jd_body_alt_r(ctx,EVENT_SUN,sun_twi,
+				nt[n].jdcent - (12. - hatwi) / 24.,lat,longit,
+				0.,EVENT_TOL);
+		}
+		nt[n].stcent = lst_r(ctx,nt[n].jdcent,longit);
+		if(nt[n].jdeve > 0.) {
+			nt[n].steve = lst_r(ctx,nt[n].jdeve,longit);
+			nt[n].stmorn = lst_r(ctx,nt[n].jdmorn,longit);
+		}
+		else nt[n].steve = nt[n].stmorn = 0.;
+		/* the correct *evening* date, for labelling */
+		nt[n].jdevedate = nt[n].jdcent - longit/24. - 0.25;
+		n++;
+	}
+	*night = nt;
+	return(n);
+}
+
+int season_nights(jdstart,jdend,sun_twi,lat,longit,night)
+
+	double jdstart, jdend, sun_twi, lat, longit;
+	struct season_night **night;
+{
+	return(season_nights_r(&skycalc_default_ctx,jdstart,jdend,sun_twi,
+		lat,longit,night));
+}
+
+void season_obs_calc(ra,dec,lat,night,nnight,obs)
+
+	double ra, dec, lat;
+	struct season_night *night;
+	int nnight;
+	struct season_obs *obs;
+
+/* the object's side of obs_season, for nights from season_nights.
+   ra and dec must already be precessed to about the middle of the
+   season.  Fills obs[0] through obs[nnight-1] with HA and sec z at
+   evening twilight, center of night and morning twilight, and the
+   dark hours spent at sec z < 3, 2 and 1.5.  Uses no context, so
+   it's safe to run in many threads at once. */
+
+{
+	struct season_night *nt;
+	struct season_obs *ob;
+	double min_alt, max_alt, altitude, az, dt, jdtrans;
+	double jdup[3], jddown[3], hrs[3];
+	static double alts[3] = {ALT_3, ALT_2, ALT_15};
+	int k, j;
+
+	min_max_alt(lat,dec,&min_alt,&max_alt);
+
+	for(k = 0; k < nnight; k++) {
+		nt = night + k;
+		ob = obs + k;
+		if(nt->jdeve > 0.) {
+			ob->haeve = adj_time(nt->steve - ra);
+			altitude = altit(dec,ob->haeve,lat,&az);
+			ob->seczeve = secant_z(altitude);
+			ob->hamorn = adj_time(nt->stmorn - ra);
+			altitude = altit(dec,ob->hamorn,lat,&az);
+			ob->seczmorn = secant_z(altitude);
+		}
+		else {
+			ob->haeve = ob->hamorn = 0.;
+			ob->seczeve = ob->seczmorn = 0.;
+		}
+		ob->hacent = adj_time(nt->stcent - ra);
+		altitude = altit(dec,ob->hacent,lat,&az);
+		ob->seczcent = secant_z(altitude);
+
+		jdtrans = nt->jdcent - ob->hacent / (SID_RATE * 24.);
+		   /* this will be the transit nearest midnight */
+		for(j = 0; j < 3; j++) {
+			/* if it makes sense to compute the times when
+			   this object passes the airmass ... */
+			if((min_alt < alts[j]) && (max_alt > alts[j])) {
+				dt = ha_alt(dec,lat,alts[j]) / (SID_RATE * 24.);
+				jdup[j] = jdtrans - dt;
+				jddown[j] = jdtrans + dt;
+			}
+			else jdup[j] = jddown[j] = 0.;
+
+		/* Now based on times of twilight and times at which object
+		   passes the airmass points, figure out how long the object
+		   is up at night ... */
+			if(nt->jdeve <= 0.) hrs[j] = 0.;  /* twilight all night */
+			else if(jdup[j] != 0.)
+				hrs[j] = hrs_up(jdup[j],jddown[j],nt->jdeve,
+					nt->jdmorn);
+			else if(min_alt > alts[j])
+				hrs[j] = 24. * (nt->jdmorn - nt->jdeve); /* always up */
+			else hrs[j] = 0.;                /* never up ... */
+		}
+		ob->hrs_3 = hrs[0];
+		ob->hrs_2 = hrs[1];
+		ob->hrs_15 = hrs[2];
+	}
+}
+
+void season_worker(arg,i0,i1)
+
+	void *arg;
+	int i0, i1;
+
+/* obs_season_cat_r's share of work for one thread -- arg is
+   the season_table, with ra and dec in its scratch arrays. */
+
+{
+	struct season_table *tab;
+	int i;
+
+	tab = (struct season_table *) arg;
+	for(i = i0; i < i1; i++)
+		season_obs_calc(tab->ra[i],tab->dec[i],tab->lat,tab->night,
+			tab->nnight,tab->obs + (size_t) i * tab->nnight);
+}
+
+void season_table_free(tab)
+
+	struct season_table *tab;
+{
+	free(tab->night);
+	free(tab->obs);
+	free(tab->ra);
+	free(tab->dec);
+	tab->night = NULL;
+	tab->obs = NULL;
+	tab->ra = tab->dec = NULL;
+	tab->nnight = tab->nobj = 0;
+}
+
+int obs_season_cat_r(ctx,cat,jdstart,jdend,sun_twi,lat,longit,nthreads,tab)
+
+	struct skycalc_ctx *ctx;
+	struct catalog *cat;
+	double jdstart, jdend, sun_twi, lat, longit;
+	int nthreads;
+	struct season_table *tab;
+
+/* obs_season for every object in cat at once, without the dialog.
+   The nights (season_nights_r) are worked out once; each object is
+   precessed to the middle of the season, a run of one epoch at a
+   time, and then the objects are shared out over nthreads threads
+   (zero for one per processor; see skycalc_parallel) for
+   season_obs_calc.  Afterward tab->obs[i * tab->nnight + k] is object
+   i+1 on night tab->night[k].  Free with season_table_free.  Returns
+   the number of threads used, or -1 if out of memory. */
+
+{
+	struct objct *ob;
+	double jdcent;
+	int i, j, m, nt;
+
+	tab->nobj = cat->n;
+	tab->sun_twi = sun_twi;
+	tab->lat = lat;
+	tab->longit = longit;
+	tab->night = NULL;
+	tab->obs = NULL;
+	tab->ra = tab->dec = NULL;
+
+	tab->nnight = season_nights_r(ctx,jdstart,jdend,sun_twi,lat,longit,
+		&tab->night);
+	if(tab->nnight < 0) return(-1);
+	jdcent = (jdstart - lun_age(jdstart,&i) + jdend) / 2.;
+	tab->curep = 2000. + (jdcent - J2000) / 365.25;
+
+	if(cat->n == 0) return(1);
+	tab->obs = (struct season_obs *) malloc((size_t) cat->n *
+		tab->nnight * sizeof(struct season_obs));
+	tab->ra = (double *) malloc(cat->n * sizeof(double));
+	tab->dec = (double *) malloc(cat->n * sizeof(double));
+	if(tab->obs == NULL || tab->ra == NULL || tab->dec == NULL) {
+		season_table_free(tab);
+		return(-1);
+	}
+
+	for(i = 0; i < cat->n; i += m) {
+		ob = cat->objs + i + 1;
+		for(m = 1; m < BATCH_BLOCK && i + m < cat->n && ob[m].ep == ob[0].ep; m++) ;
+		for(j = 0; j < m; j++) {
+			tab->ra[i+j] = ob[j].ra;
+			tab->dec[i+j] = ob[j].dec;
+		}
+		precrot_batch(prec_cache_r(ctx,ob[0].ep,tab->curep),tab->ra + i,
+			tab->dec + i,NULL,NULL,(size_t) m,tab->ra + i,tab->dec + i);
+	}
+
+	nt = skycalc_parallel(nthreads,cat->n,SEASON_CHUNK,season_worker,
+		(void *) tab);
+	free(tab->ra);
+	free(tab->dec);
+	tab->ra = tab->dec = NULL;
+	return(nt);
+}
+
+int obs_season_cat(cat,jdstart,jdend,sun_twi,lat,longit,nthreads,tab)
+
+	struct catalog *cat;
+	double jdstart, jdend, sun_twi, lat, longit;
+	int nthreads;
+	struct season_table *tab;
+{
+	return(obs_season_cat_r(&skycalc_default_ctx,cat,jdstart,jdend,
+		sun_twi,lat,longit,nthreads,tab));
+}
+
+void obs_season(ra, dec, epoch, lat, longit)
+
+   double ra, dec, epoch, lat, longit;
+
+/* prints a table of observability through an observing
+   season.  The idea is to help the observer come up
+   with an accurately computed "range of acceptable
+   dates", to quote NOAO proposal forms ...  The numbers
+   come from season_nights and season_obs_calc; see
+   obs_season_cat for many objects at once. */
+
+{
+   int valid_date, nlun, nch, nnight, k;
+   char obj_name[40];
+   short dow;
+   double sun_twi;
+   double jdstart, jdend, jdcent;
+   double min_alt, max_alt;
+   double curep, curra, curdec;
+   struct date_time tempdate;
+   struct season_night *night, *nt;
+   struct season_obs *obs, *ob;
+
+   printf("This types out a summary of the observability of your object\n");
+   printf("through the observing season.  Observability is summarized\n");
+   printf("at new & full moon through a range of dates you specify.\n");
+   printf("(a 24-line display holds about a 6-month range.)\n\n");
+   if(fabs(lat) > 70.) {
+	oprntf("NOTE: The site's geographical latitude is so high that there's\n");
+	oprntf("a possibility that 'darkness' will last all day (depending\n");
+        oprntf("on how you define the end of twilight below.)  In this case\n");
+	oprntf("the HA and sec z at 'twilight' will be for +-12 hours from\n");
+	oprntf("sun's lower culmination.\n\n");
+   }
+
+   printf("Give approx. starting date, yyyy mm dd, neg year exits:");
+
+  if((valid_date = get_date(&tempdate)) < 0) return;
+  tempdate.h =  0.;
+  tempdate.mn = 0.;
+  tempdate.s = 0.;
+  jdstart = date_to_jd(tempdate);
+  printf("Give ending date for listing:");
+  if((valid_date = get_date(&tempdate)) < 0) return;
+  jdend = date_to_jd(tempdate);
+  printf("You must now specify the altitude of the sun which defines twilight.\n");
+  printf("Type -18. , or give a non-standard choice:");
+  scanf("%lf",&sun_twi);
+
+  printf("Name of object:");     /* for labeling redirected output */
+  nch = get_line(obj_name);
+
+  jdcent = (jdstart - lun_age(jdstart,&nlun) + jdend) / 2.;
+  curep = 2000. + (jdcent - J2000)/365.25;    /* precess to check observ. */
+  precrot(ra,dec,epoch,curep,&curra,&curdec);
+  min_max_alt(lat,curdec,&min_alt,&max_alt);
+
+  nnight = season_nights(jdstart,jdend,sun_twi,lat,longit,&night);
+  if(nnight < 0) {
+	printf("Out of memory!\n");
+	return;
+  }
+  obs = (struct season_obs *) malloc((nnight + 1) * sizeof(struct season_obs));
+  if(obs == NULL) {
+	printf("Out of memory!\n");
+	free(night);
+	return;
+  }
+  season_obs_calc(curra,curdec,lat,night,nnight,obs);
+
+  oprntf("\n          *** Seasonal Observability of %s ***\n",obj_name);
+  oprntf("\n     RA & dec: ");
+  put_coords(ra,3);
+  oprntf(", ");
+  put_coords(dec,2);
+  oprntf(", epoch %6.1f\n", epoch);
+
+  oprntf("Site long&lat: ");
+  put_coords(longit,3);
+  oprntf(" (h.m.s) West, ");
+  put_coords(lat,2);
+  oprntf(" North.\n\n");
+
+
+  if(max_alt < ALT_15)
+    oprntf("NOTE -- This object is always at sec.z > %5.2f\n",
+	1./cos((90. - max_alt) / DEG_IN_RADIAN));
+  if(min_alt > ALT_3)
+    oprntf("NOTE -- This object is always at sec.z < %5.2f\n",
+	1./cos((90. - min_alt) / DEG_IN_RADIAN));
+
+  oprntf("Shown: local eve. date, moon phase, hr ang and sec.z at (1) eve. twilight,\n");
+  oprntf("(2) natural center of night, and (3) morning twilight; then comes number of\n");
+  oprntf("nighttime hours during which object is at sec.z less than 3, 2, and 1.5.\n");
+  oprntf("Night (and twilight) is defined by sun altitude < %4.1f degrees.\n\n",sun_twi);
+
+  oprntf(" Date (eve) moon      eve            cent           morn");
+  oprntf("     night hrs@sec.z:\n");
+  oprntf("                   HA  sec.z      HA  sec.z      HA  sec.z");
+  oprntf("     <3   <2   <1.5\n");
+
+  for(k = 0; k < nnight; k++) {
+       nt = night + k;
+       ob = obs + k;
+
+       planet_alert(nt->jdcent,curra,curdec,PLANET_TOL);
+         /* better know about it ... */
+
+       print_calendar(nt->jdevedate,&dow);
+
+       /* space table correctly -- what a pain ! */
+       caldat(nt->jdevedate,&tempdate,&dow);
+       if(tempdate.d < 10) oprntf(" ");
+
+       if(nt->nph == 0) oprntf("   N");
+       else oprntf("   F");
+       if(nt->jdeve > 0.) print_ha_air(ob->haeve,ob->seczeve,0,0);
+       else oprntf(" twi.all.nght! ");
+       print_ha_air(ob->hacent,ob->seczcent,0,0);
+       if(nt->jdmorn > 0.) print_ha_air(ob->hamorn,ob->seczmorn,0,0);
+       else oprntf(" twi.all.nght! ");
+
+       oprntf(" %4.1f  %4.1f  %4.1f \n",ob->hrs_3,ob->hrs_2,ob->hrs_15);
+
+  }
+  free(night);
+  free(obs);
+  printf("Listing done.  'f' gives tutorial, '?' prints a menu.\n");
+}
+
+#if SYS_CLOCK_OK == 1
+#include <time.h>
+#endif
+
+#if SYS_CLOCK_OK == 1
+
+void helser_node_worker(arg,i0,i1)
+
+	void *arg;
+	int i0, i1;
+
+/* helcor_series' first pass for one thread -- the earth's state at
+   nodes i0 through i1-1, in a context of the thread's own. */
+
+{
+	struct helser *hs;
+	struct skycalc_ctx wctx;
+	int i;
+
+	hs = (struct helser *) arg;
+	skycalc_ctx_init(&wctx);
+	wctx.eph = hs->ctx->eph;
+	for(i = i0; i < i1; i++)
+		helcor_earth_r(&wctx,hs->jd0 + i * HELSER_STEP,hs->node + 6 * i);
+}
+
+void helser_worker(arg,i0,i1)
+
+	void *arg;
+	int i0, i1;
+
+/* helcor_series' second pass -- epochs i0 through i1-1, with the
+   earth's state interpolated between the four nearest nodes. */
+
+{
+	struct helser *hs;
+	struct sid_cache sc;
+	double u, t, w[4], s[6], *nd, ha;
+	double a=499.0047837;  /* light travel time for 1 AU, sec, as helcor */
+	int i, j, k;
+
+	hs = (struct helser *) arg;
+	sc.valid = 0;
+	for(i = i0; i < i1; i++) {
+		u = (hs->jd[i] - hs->jd0) / HELSER_STEP;
+		k = (int) u;
+		t = u - k;
+		/* cubic through nodes k-1 .. k+2 */
+		w[0] = -t * (t - 1.) * (t - 2.) / 6.;
+		w[1] = (t + 1.) * (t - 1.) * (t - 2.) / 2.;
+		w[2] = -(t + 1.) * t * (t - 2.) / 2.;
+		w[3] = (t + 1.) * t * (t - 1.) / 6.;
+		nd = hs->node + 6 * (k - 1);
+		for(j = 0; j < 6; j++)
+			s[j] = w[0] * nd[j] + w[1] * nd[j+6] + w[2] * nd[j+12] +
+				w[3] * nd[j+18];
+		ha = (lst_cached(&sc,hs->jd[i],hs->longit) - hs->ra) / HRS_IN_RADIAN;
+		hs->tcor[i] = a * (s[0]*hs->xobj + s[1]*hs->yobj + s[2]*hs->zobj);
+		hs->vcor[i] = s[3]*hs->xobj + s[4]*hs->yobj + s[5]*hs->zobj -
+			hs->rot * sin(ha);
+	}
+}
+
+int helcor_series_r(ctx,jd,n,ra,dec,longit,lat,elevsea,nthreads,tcor,vcor)
+
+	struct skycalc_ctx *ctx;
+	double *jd;
+	int n;
+	double ra, dec, longit, lat, elevsea;
+	int nthreads;
+	double *tcor, *vcor;
+
+/* helcor for each of the n times jd[] (in any order) of one target
+   at ra and dec (of date), seen from the site at longit, lat and
+   elevsea -- tcor[] and vcor[] are filled in as helcor would, with
+   the hour angle from the site's sidereal time.  The earth's state is
+   found only at nodes HELSER_STEP apart over the span of the times
+   and interpolated (cubic) between them; this agrees with helcor to
+   better than 1.0e-5 s and 1.0e-5 km/s, well inside helcor's own
+   accuracy.  If the times are sparser than the nodes, each is done
+   directly.  Both passes are shared out over nthreads threads (zero
+   for one per processor; see skycalc_parallel).  Returns the number
+   of threads used, or -1 if out of memory. */
+
+{
+	struct helser hs;
+	double jdmin, jdmax, x_geo, y_geo, z_geo, decr, rar;
+	int i, nt, ntnode;
+
+	if(n <= 0) return(0);
+	jdmin = jdmax = jd[0];
+	for(i = 1; i < n; i++) {
+		if(jd[i] < jdmin) jdmin = jd[i];
+		if(jd[i] > jdmax) jdmax = jd[i];
+	}
+	if((jdmax - jdmin) / HELSER_STEP + 4. > n) {
+		for(i = 0; i < n; i++)
+			helcor_r(ctx,jd[i],ra,dec,lst_r(ctx,jd[i],longit) - ra,lat,
+				elevsea,tcor + i,vcor + i);
+		return(1);
+	}
+
+	hs.jd = jd;
+	hs.n = n;
+	hs.jd0 = floor(jdmin) - HELSER_STEP;
+	hs.nnode = (int) ((jdmax - hs.jd0) / HELSER_STEP) + 3;
+	hs.node = (double *) malloc((size_t) hs.nnode * 6 * sizeof(double));
+	if(hs.node == NULL) return(-1);
+	decr = dec / DEG_IN_RADIAN;
+	rar = ra / HRS_IN_RADIAN;
+	hs.xobj = cos(rar) * cos(decr);
+	hs.yobj = sin(rar) * cos(decr);
+	hs.zobj = sin(decr);
+	hs.ra = ra;
+	hs.longit = longit;
+	geocent(0., lat, elevsea, &x_geo, &y_geo, &z_geo);
+	hs.rot = 0.4651011 * x_geo * cos(decr);   /* see helcor */
+	hs.tcor = tcor;
+	hs.vcor = vcor;
+	hs.ctx = ctx;
+
+	ntnode = skycalc_parallel(nthreads,hs.nnode,1,helser_node_worker,
+		(void *) &hs);
+	nt = skycalc_parallel(nthreads,n,HELSER_CHUNK,helser_worker,(void *) &hs);
+	free(hs.node);
+	return((nt > ntnode) ? nt : ntnode);
+}
+
+int helcor_series(jd,n,ra,dec,longit,lat,elevsea,nthreads,tcor,vcor)
+
+	double *jd;
+	int n;
+	double ra, dec, longit, lat, elevsea;
+	int nthreads;
+	double *tcor, *vcor;
+{
+	return(helcor_series_r(&skycalc_default_ctx,jd,n,ra,dec,longit,lat,
+		elevsea,nthreads,tcor,vcor));
+}
+
+double lun_node_sin(n,nph)
+
+	int n, nph;
+
+/* |sin F| at phase nph of lunation n, F being the moon's argument
+   of latitude as in flmoon.  There's no eclipse at a new or full
+   moon with this over 0.36 (Meeus). */
+
+{
+	double lun, T, F;
+
+	lun = (double) n + (double) nph / 4.;
+	T = lun / 1236.85;
+	F = 21.2964 + 390.67050646 * lun - 0.0016528 * T * T - 0.00000239 * T * T * T;
+	return(fabs(sin(F / DEG_IN_RADIAN)));
+}
+
+double ecl_geom(ea,jd,thr,dist)
+
+	struct ecl_arg *ea;
+	double jd, *thr, *dist;
+
+/* the separation (degrees) that matters for an event of kind
+   ea->kind at jd, and the separations at which its contacts happen,
+   in thr[0] (outer) through thr[2] (inner):
+
+   ECL_LUNAR -- the geocentric moon from the center of the earth's
+	shadow; the penumbral, umbral and total contacts, as lunecl_calc.
+   ECL_SOLAR -- the topocentric moon from the sun; the partial
+	contacts and (thr[1]) the total or annular ones, as solecl_calc.
+   ECL_OCCULT -- the topocentric moon from the object (ea->xyz, at
+	J2000); disappearance and reappearance at the limb.
+
+   dist[0] and dist[1] get the moon's and sun's distances, for
+   lunecl_calc and solecl_calc. */
+
+{
+	struct skycalc_ctx *ctx;
+	double sid, gra, gdec, gdist, tra, tdec, tdist;
+	double ras, decs, dists, toras, todecs, x, y, z;
+	double ang_sun, ang_moon, ra2, dec2, c, sep;
+
+	ctx = ea->ctx;
+	sid = lst_r(ctx,jd,ea->longit);
+	accumoon_r(ctx,jd,ea->lat,sid,ea->elevsea,&gra,&gdec,&gdist,&tra,&tdec,
+		&tdist);
+	if(ea->kind == ECL_OCCULT) {
+		precrot_r(ctx,tra,tdec,2000. + (jd - J2000) / 365.25,2000.,&ra2,&dec2);
+		ra2 = ra2 / HRS_IN_RADIAN;
+		dec2 = dec2 / DEG_IN_RADIAN;
+		c = cos(ra2) * cos(dec2) * ea->xyz[0] + sin(ra2) * cos(dec2) * ea->xyz[1]
+			+ sin(dec2) * ea->xyz[2];
+		if(c > 1.) c = 1.;
+		sep = acos(c) * DEG_IN_RADIAN;
+		thr[0] = DEG_IN_RADIAN * asin(RMOON / (tdist * EQUAT_RAD));
+		thr[1] = thr[2] = -1.;
+		dist[0] = tdist;
+		return(sep);
 	}
-	else if (use_dst < 0) {
-		oprntf("%s Daylight Savings Time used before 2 AM \n",zone_name);
-		print_calendar(*jdb-stdz/24.,&dow);
-		oprntf(" and after 2 AM ");
-		print_calendar(*jde-(stdz-1)/24.,&dow);
-		oprntf("; standard zone = %3.0f hrs W",stdz);
-		if((fabs(jd - locjdb) < 0.45) || (fabs(jd - locjde) < 0.45))
-			oprntf("\n   ** TIME CHANGE IS TONIGHT! **");
+	accusun_r(ctx,jd,sid,ea->lat,&ras,&decs,&dists,&toras,&todecs,&x,&y,&z);
+	ang_sun = asin(RSUN / (dists * ASTRO_UNIT));  /* radians */
+	dist[1] = dists;
+	if(ea->kind == ECL_LUNAR) {
+		ang_moon = DEG_IN_RADIAN * asin(RMOON / (gdist * EQUAT_RAD));
+		thr[0] = (1./gdist + ang_sun) * DEG_IN_RADIAN + ang_moon;
+		thr[1] = (1./gdist - ang_sun) * DEG_IN_RADIAN + ang_moon;
+		thr[2] = thr[1] - 2. * ang_moon;
+		dist[0] = gdist;
+		return(DEG_IN_RADIAN * subtend(gra,gdec,adj_time(ras + 12.),-decs));
 	}
-	else oprntf("%s Standard Time (%3.0f hrs W) in use all year.",zone_name,stdz);
+	ang_moon = DEG_IN_RADIAN * asin(RMOON / (tdist * EQUAT_RAD));
+	ang_sun = ang_sun * DEG_IN_RADIAN;
+	thr[0] = ang_sun + ang_moon;
+	thr[1] = fabs(ang_sun - ang_moon);
+	thr[2] = -1.;
+	dist[0] = tdist;
+	return(DEG_IN_RADIAN * subtend(tra,tdec,toras,todecs));
+}
 
-	oprntf("\n\n");
+double ecl_func(ea,jd)
 
-	oprntf("For the night of: ");
-	print_day(day_of_week(jd));
-	oprntf(", ");
-	print_calendar(jd,&dow); /* translate back e.g. 11/31-12/1 */
-	jd = jd + .5;  /* local morning */
-	oprntf(" ---> ");
-	print_day(day_of_week(jd));
-	oprntf(", ");
-	print_calendar(jd,&dow);
-	oprntf("\n");
-	jd = jd - 0.25;  /* local midnight */
-	jdmid = jd + zone(use_dst,stdz,jd,*jdb,*jde) / 24.;
-					/* corresponding ut */
-	oprntf("Local midnight = ");
-	print_calendar(jdmid,&dow);
-	oprntf(", ");
-	print_time(jdmid,-1); /* just the hours! */
-	oprntf(" UT, or JD %11.3f\n",jdmid);
-	oprntf("Local Mean Sidereal Time at midnight = ");
-	stmid = lst(jdmid,longit);
-	put_coords(stmid,3);
-	oprntf("\n\n");
+	struct ecl_arg *ea;
+	double jd;
+
+/* the separation less the contact separation of level ea->level (or
+   just the separation, for level -1) -- negative inside. */
+
+{
+	double thr[3], dist[2], sep;
+
+	sep = ecl_geom(ea,jd,thr,dist);
+	return((ea->level < 0) ? sep : sep - thr[ea->level]);
+}
+
+double ecl_min(ea,jda,jdb,tol)
+
+	struct ecl_arg *ea;
+	double jda, jdb, tol;
+
+/* the time of the least ecl_func between jda and jdb (to within tol
+   days), by golden section -- for the time of greatest eclipse or
+   closest approach. */
+
+{
+	double r = 0.38196601125, x1, x2, f1, f2;
+
+	x1 = jda + r * (jdb - jda);
+	x2 = jdb - r * (jdb - jda);
+	f1 = ecl_func(ea,x1);
+	f2 = ecl_func(ea,x2);
+	while(jdb - jda > tol) {
+		if(f1 < f2) {
+			jdb = x2;
+			x2 = x1;
+			f2 = f1;
+			x1 = jda + r * (jdb - jda);
+			f1 = ecl_func(ea,x1);
+		}
+		else {
+			jda = x1;
+			x1 = x2;
+			f1 = f2;
+			x2 = jdb - r * (jdb - jda);
+			f2 = ecl_func(ea,x2);
+		}
+	}
+	return(0.5 * (jda + jdb));
+}
+
+double ecl_root(ea,jda,jdb,fa,fb,tol)
+
+	struct ecl_arg *ea;
+	double jda,jdb,fa,fb,tol;
+
+/* refines a contact bracketed by jda and jdb, at which ecl_func is
+   fa and fb (of opposite sign), to within tol days -- Brent's
+   method, as alt_event_root_r. */
+
+{
+	double a = jda, b = jdb, c, fc, d, e, tol1, xm;
+	double p, q, r, s2, min1, min2;
+	short i;
+
+	c = b;
+	fc = fb;
+	d = e = b - a;
+	for(i = 0; i < 60; i++) {
+		if((fb > 0. && fc > 0.) || (fb < 0. && fc < 0.)) {
+			c = a;   /* keep the root between b and c */
+			fc = fa;
+			d = e = b - a;
+		}
+		if(fabs(fc) < fabs(fb)) {  /* b the best guess so far */
+			a = b;
+			b = c;
+			c = a;
+			fa = fb;
+			fb = fc;
+			fc = fa;
+		}
+		tol1 = 2.0e-16 * fabs(b) + 0.5 * tol;
+		xm = 0.5 * (c - b);
+		if(fabs(xm) <= tol1 || fb == 0.) return(b);
+		if(fabs(e) >= tol1 && fabs(fa) > fabs(fb)) {
+			s2 = fb / fa;
+			if(a == c) {   /* secant */
+				p = 2. * xm * s2;
+				q = 1. - s2;
+			}
+			else {   /* inverse quadratic */
+				q = fa / fc;
+				r = fb / fc;
+				p = s2 * (2. * xm * q * (q - r) - (b - a) * (r - 1.));
+				q = (q - 1.) * (r - 1.) * (s2 - 1.);
+			}
+			if(p > 0.) q = -q;
+			p = fabs(p);
+			min1 = 3. * xm * q - fabs(tol1 * q);
+			min2 = fabs(e * q);
+			if(2. * p < (min1 < min2 ? min1 : min2)) {
+				e = d;
+				d = p / q;
+			}
+			else {  /* interpolation no good -- bisect */
+				d = xm;
+				e = d;
+			}
+		}
+		else {
+			d = xm;
+			e = d;
+		}
+		a = b;
+		fa = fb;
+		if(fabs(d) > tol1) b = b + d;
+		else b = b + (xm > 0. ? tol1 : -tol1);
+		fb = ecl_func(ea,b);
+	}
+	return(b);
+}
+
+void ecl_list_free(el)
+
+	struct ecl_list *el;
+{
+	free(el->ev);
+	el->ev = NULL;
+	el->n = el->cap = 0;
+}
+
+int ecl_list_add(el,ev)
+
+	struct ecl_list *el;
+	struct ecl_event *ev;
+
+/* appends a copy of *ev to el.  Returns 0, or -1 if memory runs
+   out. */
+
+{
+	struct ecl_event *nev;
+	int ncap;
+
+	if(el->n == el->cap) {
+		ncap = (el->cap > 0) ? 2 * el->cap : 16;
+		nev = (struct ecl_event *) realloc(el->ev,
+			ncap * sizeof(struct ecl_event));
+		if(nev == NULL) return(-1);
+		el->ev = nev;
+		el->cap = ncap;
+	}
+	el->ev[el->n++] = *ev;
+	return(0);
+}
+
+int ecl_event_find(ea,jda,jdb,jdmax,ev)
+
+	struct ecl_arg *ea;
+	double jda, jdb, jdmax;
+	struct ecl_event *ev;
 
-	accumoon(jdmid,lat,stmid,elevsea,
-	   &geora,&geodec,&geodist,&ramoon,&decmoon,&distmoon);
-	lpsun(jdmid,&rasun,&decsun);
-	hasunset = ha_alt(decsun,lat,-(0.83+horiz));
-	if(hasunset > 900.) {  /* flag for never sets */
-		oprntf("Sun up all night!\n");
-		set_to_rise = 0.;
-		twi_to_twi = 0.;
-		jdcent = -1.;
-		goto DO_MOON_ETC;  /* aargh! Ugly flow of control!! But
-                   twilight certainly irrelevant if sun up all night, so
-		   skip it. */
-	}
-	if(hasunset < -900.) {
-		oprntf("Sun down all day!\n");
-		set_to_rise = 24.;
-		jdcent = -1.;
-		goto CHECK_TWI18;  /* More ugly flow  -
-			checks for twilight even if sun down. */
-	}
-	jdsunset = jdmid + adj_time(rasun+hasunset-stmid)/24.;
-		/* initial guess */
-	jdsunset = jd_sun_alt(-(0.83+horiz),jdsunset,lat,longit);
-	if(jdsunset > 0.) {
-		oprntf("Sunset (%5.0f m horizon): ",elev);
-		print_time((jdsunset-zone(use_dst,stdz,jdsunset,*jdb,*jde)/24.),0);
-		print_tz(jdsunset,use_dst,*jdb,*jde,zabr);
-	}
-	else oprntf("Sunset not correctly computed; ");
-	jdsunrise = jdmid + adj_time(rasun-hasunset-stmid)/24.;
-	jdsunrise = jd_sun_alt(-(0.83+horiz),jdsunrise,lat,longit);
-	if(jdsunrise > 0.) {
-		oprntf("; Sunrise: ");
-		print_time((jdsunrise-zone(use_dst,stdz,jdsunrise,*jdb,*jde)/24.),0);
-		print_tz(jdsunrise,use_dst,*jdb,*jde,zabr);
-	}
-	if((jdsunrise > 0.) && (jdsunset > 0.)) {
-		set_to_rise = (jdsunrise - jdsunset) * 24.;
-		jdcent = (jdsunrise + jdsunset) / 2.;
+/* the event of kind ea->kind with closest approach at jdmax (see
+   ecl_min), if there is one -- fills in *ev with the separation
+   then, the type and magnitude (see struct ecl_event), the altitude of the body seen from
+   the site, and the contacts (to ECL_TOL), outer first, -1 for any
+   that don't happen, and returns 1; otherwise returns 0.  jda and
+   jdb, before and after jdmax, must be outside the event's outer
+   contacts for those to be found. */
+
+{
+	double thr[3], dist[2], f, fa, fb, sid, ra, dec, dd, x, y, z;
+	double gra, gdec, gdist, tra, tdec, tdist, ras, decs, dists, toras, todecs;
+	int lev, nlev, i;
+
+	ev->sepmax = ecl_geom(ea,jdmax,thr,dist);
+	if(ev->sepmax >= thr[0]) return(0);
+
+	ev->kind = ea->kind;
+	ev->obj = 0;
+	ev->jdmax = jdmax;
+	ev->magnitude = 0.;
+	for(i = 0; i < 6; i++) ev->contact[i] = -1.;
+	nlev = (ea->kind == ECL_LUNAR) ? 3 : (ea->kind == ECL_SOLAR) ? 2 : 1;
+	for(lev = 0; lev < nlev; lev++) {
+		if(ev->sepmax >= thr[lev]) break;
+		ea->level = lev;
+		f = ev->sepmax - thr[lev];
+		fa = ecl_func(ea,jda);
+		fb = ecl_func(ea,jdb);
+		if(fa > 0.)   /* contacts go outside in, as P1 U1 U2 U3 U4 P4 */
+			ev->contact[lev] = ecl_root(ea,jda,jdmax,fa,f,ECL_TOL);
+		if(fb > 0.)
+			ev->contact[2 * nlev - 1 - lev] = ecl_root(ea,jdmax,jdb,f,fb,
+				ECL_TOL);
 	}
+	ea->level = -1;
+
+	sid = lst_r(ea->ctx,jdmax,ea->longit);
+	accumoon_r(ea->ctx,jdmax,ea->lat,sid,ea->elevsea,&gra,&gdec,&gdist,
+		&tra,&tdec,&tdist);
+	ra = tra;
+	dec = tdec;
+	if(ea->kind == ECL_OCCULT) ev->type = 1;
 	else {
-		oprntf(" Sunrise not correctly computed.");
-		jdcent = -1.;
+		accusun_r(ea->ctx,jdmax,sid,ea->lat,&ras,&decs,&dists,&toras,
+			&todecs,&x,&y,&z);
+		if(ea->kind == ECL_LUNAR) {
+			ev->type = lunecl_calc(gra,gdec,gdist,ras,decs,dists,
+				&ev->magnitude);
+			/* lunecl_calc sets a magnitude only for partial
+			   umbral eclipses; give every one the usual umbral
+			   (types 3 and 4) or penumbral magnitude -- the
+			   depth of the moon's leading limb in the shadow,
+			   in moon diameters.  thr[1] - thr[2] is the
+			   moon's diameter. */
+			ev->magnitude = (ev->type >= 3) ?
+				(thr[1] - ev->sepmax) / (thr[1] - thr[2]) :
+				(thr[0] - ev->sepmax) / (thr[1] - thr[2]);
+		}
+		else {
+			ev->type = solecl_calc(ev->sepmax,tdist,dists,&ev->magnitude);
+			ra = toras;
+			dec = todecs;
+		}
 	}
+	ev->alt = altit(dec,adj_time(sid - ra),ea->lat,&dd);
+	return(1);
+}
 
-	/* This block checks for and prints out 18-degree twilight
-           as appropriate. */
+int eclipse_search_r(ctx,jdstart,jdend,lat,longit,elevsea,el)
 
-	CHECK_TWI18: hatwilight = ha_alt(decsun,lat,-18.);
-	if(hatwilight < -900.) {
-		oprntf("\nFull darkness all day (sun below -18 deg).\n");
-		twi_to_twi = 24.;
-		goto DO_MOON_ETC;  /* certainly no 12-degree twilight */
+	struct skycalc_ctx *ctx;
+	double jdstart, jdend, lat, longit, elevsea;
+	struct ecl_list *el;
+
+/* every lunar eclipse, and every solar eclipse seen (above the
+   horizon or not -- see ev->alt) from the site at lat, longit and
+   elevsea, with greatest eclipse between jdstart and jdend.  Only
+   the new and full moons from flmoon near a node of the moon's orbit
+   (lun_node_sin) are looked at.  Each is sampled every ECL_STEP over
+   ECL_WINDOW days either side; the closest approach is refined near
+   the least sample, and the contacts within the window, by
+   ecl_event_find.  The events are appended to el (start from a
+   zeroed one) in time order.  Returns the number added, or -1 if
+   memory runs out. */
+
+{
+	struct ecl_arg ea;
+	struct ecl_event ev;
+	double jd, t, f, fmin, tmin;
+	int nlun, nph, n0;
+
+	ea.ctx = ctx;
+	ea.lat = lat;
+	ea.longit = longit;
+	ea.elevsea = elevsea;
+	n0 = el->n;
+
+	lun_age(jdstart,&nlun);   /* the new moon before jdstart */
+	for(nph = 0; ; ) {
+		flmoon(nlun,nph,&jd);
+		if(jd - ECL_WINDOW > jdend) break;
+		if(jd + ECL_WINDOW >= jdstart && lun_node_sin(nlun,nph) <= 0.36) {
+			ea.kind = (nph == 0) ? ECL_SOLAR : ECL_LUNAR;
+			ea.level = -1;
+			tmin = jd;
+			fmin = 1000.;
+			for(t = jd - ECL_WINDOW; t <= jd + ECL_WINDOW; t += ECL_STEP) {
+				f = ecl_func(&ea,t);
+				if(f < fmin) {
+					fmin = f;
+					tmin = t;
+				}
+			}
+			tmin = ecl_min(&ea,tmin - ECL_STEP,tmin + ECL_STEP,ECL_TOL);
+			if(tmin >= jdstart && tmin <= jdend &&
+			   ecl_event_find(&ea,jd - ECL_WINDOW,jd + ECL_WINDOW,tmin,&ev) &&
+			   ecl_list_add(el,&ev) != 0) return(-1);
+		}
+		if(nph == 2) nlun++;
+		nph = 2 - nph;
 	}
-	if(hatwilight > 900.) {
-		oprntf("\nSun higher than 18-degree twilight all night.\n");
-		twi_to_twi = 0.;
-		goto CHECK_TWI12;  /* but maybe 12-degree twilight occurs ...*/
-	}
-
-	/* compute & print evening twilight and LST at eve. twilight */
-	jdtwilight = jdmid + adj_time(rasun+hatwilight-stmid)/24.;  /* rough */
-	jdtwilight = jd_sun_alt(-18.,jdtwilight,lat,longit);  /* accurate */
-	jdetw = jdtwilight;
-	if(jdtwilight > 0.) {
-		oprntf("\nEvening twilight: ");
-		print_time((jdtwilight-zone(use_dst,stdz,jdtwilight,*jdb,*jde)/24.),0);
-		sid = lst(jdtwilight,longit);
-		print_tz(jdtwilight,use_dst,*jdb,*jde,zabr);
-		oprntf(";  LMST at evening twilight: ");
-		put_coords(sid,0);
-		oprntf("\n");
+	return(el->n - n0);
+}
+
+int eclipse_search(jdstart,jdend,lat,longit,elevsea,el)
+
+	double jdstart, jdend, lat, longit, elevsea;
+	struct ecl_list *el;
+{
+	return(eclipse_search_r(&skycalc_default_ctx,jdstart,jdend,lat,longit,
+		elevsea,el));
+}
+
+void occ_node_worker(arg,i0,i1)
+
+	void *arg;
+	int i0, i1;
+
+/* occult_search_r's first pass for one thread -- the topocentric
+   moon at grid nodes i0 through i1-1. */
+
+{
+	struct occ_job *oj;
+	struct skycalc_ctx wctx;
+	double jd, gra, gdec, gdist, tra, tdec, tdist, ra2, dec2, *nd;
+	int i;
+
+	oj = (struct occ_job *) arg;
+	skycalc_ctx_init(&wctx);
+	wctx.moon_cheb = oj->ctx->moon_cheb;
+	wctx.eph = oj->ctx->eph;
+	for(i = i0; i < i1; i++) {
+		jd = oj->jd0 + i * OCC_STEP;
+		accumoon_r(&wctx,jd,oj->lat,lst_r(&wctx,jd,oj->longit),oj->elevsea,
+			&gra,&gdec,&gdist,&tra,&tdec,&tdist);
+		precrot_r(&wctx,tra,tdec,2000. + (jd - J2000) / 365.25,2000.,
+			&ra2,&dec2);
+		ra2 = ra2 / HRS_IN_RADIAN;
+		dec2 = dec2 / DEG_IN_RADIAN;
+		nd = oj->node + 4 * i;
+		nd[0] = cos(ra2) * cos(dec2);
+		nd[1] = sin(ra2) * cos(dec2);
+		nd[2] = sin(dec2);
+		/* cosine of the widest separation worth a closer look */
+		nd[3] = cos((DEG_IN_RADIAN * asin(RMOON / (tdist * EQUAT_RAD)) +
+			OCC_MARGIN) / DEG_IN_RADIAN);
 	}
-	else oprntf("Evening twilight incorrectly computed.\n");
-
-        /* Now do morning twilight */
-	jdtwilight = jdmid + adj_time(rasun-hatwilight-stmid)/24.;
-	jdtwilight = jd_sun_alt(-18.,jdtwilight,lat,longit);
-	jdmtw = jdtwilight;
-	if(jdtwilight > 0.) {
-		oprntf("Morning twilight: ");
-		print_time((jdtwilight-zone(use_dst,stdz,jdtwilight,*jdb,*jde)/24.),0);
-		sid = lst(jdtwilight,longit);
-		print_tz(jdtwilight,use_dst,*jdb,*jde,zabr);
-		oprntf(";  LMST at morning twilight: ");
-		put_coords(sid,0);
-	}
-	else oprntf("Morning twilight incorrectly computed.");
-	if((jdetw > 0.) && (jdmtw > 0.)) twi_to_twi = 24. * (jdmtw - jdetw);
-
-        /* Now do same for 12-degree twilight */
-	CHECK_TWI12: hatwilight = ha_alt(decsun,lat,-12.);
-	if(hatwilight < -900.) {
-		oprntf("\nSun always below 12-degree twilight...\n");
-		goto DO_MOON_ETC;
+}
+
+void occ_worker(arg,i0,i1)
+
+	void *arg;
+	int i0, i1;
+
+/* occult_search_r's second pass -- objects i0 through i1-1 against
+   the moon's grid, with each run of close nodes refined by ecl_min
+   and ecl_event_find into oj->found[i]. */
+
+{
+	struct occ_job *oj;
+	struct skycalc_ctx wctx;
+	struct ecl_arg ea;
+	struct ecl_event ev;
+	double *nd, *xyz, jda, jdb;
+	int i, k, k0;
+
+	oj = (struct occ_job *) arg;
+	skycalc_ctx_init(&wctx);
+	wctx.moon_cheb = oj->ctx->moon_cheb;
+	wctx.eph = oj->ctx->eph;
+	ea.ctx = &wctx;
+	ea.kind = ECL_OCCULT;
+	ea.level = -1;
+	ea.lat = oj->lat;
+	ea.longit = oj->longit;
+	ea.elevsea = oj->elevsea;
+	for(i = i0; i < i1; i++) {
+		xyz = oj->xyz + 3 * i;
+		ea.xyz[0] = xyz[0];
+		ea.xyz[1] = xyz[1];
+		ea.xyz[2] = xyz[2];
+		for(k = 0; k < oj->nnode; k++) {
+			nd = oj->node + 4 * k;
+			if(nd[0] * xyz[0] + nd[1] * xyz[1] + nd[2] * xyz[2] <= nd[3])
+				continue;
+			k0 = k;
+			while(k + 1 < oj->nnode) {
+				nd = oj->node + 4 * (k + 1);
+				if(nd[0] * xyz[0] + nd[1] * xyz[1] + nd[2] * xyz[2] <= nd[3])
+					break;
+				k++;
+			}
+			jda = oj->jd0 + (k0 > 0 ? k0 - 1 : 0) * OCC_STEP;
+			jdb = oj->jd0 + (k + 1 < oj->nnode ? k + 1 : k) * OCC_STEP;
+			if(ecl_event_find(&ea,jda,jdb,ecl_min(&ea,jda,jdb,ECL_TOL),&ev)) {
+				ev.obj = oj->obj[i];
+				if(ecl_list_add(oj->found + i,&ev) != 0) {
+					oj->found[i].n = -1;   /* out of memory */
+					break;
+				}
+			}
+		}
 	}
-	if(hatwilight > 900.) {
-		oprntf("\nSun always above 12-degree twilight...\n");
-		goto DO_MOON_ETC;
+}
+
+int occult_search_r(ctx,cat,jdstart,jdend,lat,longit,elevsea,nthreads,el)
+
+	struct skycalc_ctx *ctx;
+	struct catalog *cat;
+	double jdstart, jdend, lat, longit, elevsea;
+	int nthreads;
+	struct ecl_list *el;
+
+/* every occultation by the moon, seen from the site at lat, longit
+   and elevsea (above the horizon or not -- see ev->alt), of an object
+   in cat between jdstart and jdend.  The
+   topocentric moon is found every OCC_STEP; each object (skipping
+   those too far from the ecliptic for the moon ever to reach) is
+   checked against that, and the runs of steps where the moon's limb
+   comes within OCC_MARGIN are refined with ecl_event_find --
+   contact[0] is the disappearance and contact[1] the reappearance.
+   Both passes are shared out over nthreads threads (zero for one per
+   processor; see skycalc_parallel).  The events are appended to el
+   (start from a zeroed one), object by object and in time order for
+   each.  Returns the number of threads used, or -1 if out of
+   memory. */
+
+{
+	struct occ_job oj;
+	double ra, dec, beta, sineps, coseps;
+	int i, k, n, nt, ntnode, ret = 0;
+
+	if(cat->n == 0 || jdend < jdstart) return(0);
+	oj.ctx = ctx;
+	oj.lat = lat;
+	oj.longit = longit;
+	oj.elevsea = elevsea;
+	oj.jd0 = jdstart;
+	oj.nnode = (int) ((jdend - jdstart) / OCC_STEP) + 2;
+	oj.node = (double *) malloc((size_t) oj.nnode * 4 * sizeof(double));
+	oj.xyz = (double *) malloc((size_t) cat->n * 3 * sizeof(double));
+	oj.obj = (int *) malloc(cat->n * sizeof(int));
+	oj.found = (struct ecl_list *) calloc(cat->n,sizeof(struct ecl_list));
+	if(oj.node == NULL || oj.xyz == NULL || oj.obj == NULL ||
+	   oj.found == NULL) {
+		free(oj.node);
+		free(oj.xyz);
+		free(oj.obj);
+		free(oj.found);
+		return(-1);
 	}
-	jdtwilight = jdmid + adj_time(rasun+hatwilight-stmid)/24.;
-	jdtwilight = jd_sun_alt(-12.,jdtwilight,lat,longit);
-	if(jdtwilight > 0.) {
-		oprntf("\n12-degr twilight:");
-		print_time((jdtwilight-zone(use_dst,stdz,jdtwilight,*jdb,*jde)/24.),0);
-		print_tz(jdtwilight,use_dst,*jdb,*jde,zabr);
+
+	/* the objects at J2000, less those more than 6.6 degrees from
+	   the ecliptic (5.3 for the moon's orbit, 1 for parallax, and
+	   the moon's radius) */
+	sineps = sin(23.4393 / DEG_IN_RADIAN);
+	coseps = cos(23.4393 / DEG_IN_RADIAN);
+	n = 0;
+	for(i = 1; i <= cat->n; i++) {
+		precrot_r(ctx,cat->objs[i].ra,cat->objs[i].dec,cat->objs[i].ep,2000.,
+			&ra,&dec);
+		ra = ra / HRS_IN_RADIAN;
+		dec = dec / DEG_IN_RADIAN;
+		oj.xyz[3*n] = cos(ra) * cos(dec);
+		oj.xyz[3*n+1] = sin(ra) * cos(dec);
+		oj.xyz[3*n+2] = sin(dec);
+		beta = asin(oj.xyz[3*n+2] * coseps - oj.xyz[3*n+1] * sineps);
+		if(fabs(beta) * DEG_IN_RADIAN > 6.6) continue;
+		oj.obj[n] = i;
+		n++;
+	}
+	oj.nobj = n;
+
+	ntnode = skycalc_parallel(nthreads,oj.nnode,OCC_CHUNK,occ_node_worker,
+		(void *) &oj);
+	nt = skycalc_parallel(nthreads,n,1,occ_worker,(void *) &oj);
+	for(i = 0; i < n; i++) {
+		if(oj.found[i].n < 0) ret = -1;
+		for(k = 0; ret == 0 && k < oj.found[i].n; k++)
+			if(oj.found[i].ev[k].jdmax >= jdstart &&
+			   oj.found[i].ev[k].jdmax <= jdend &&
+			   ecl_list_add(el,oj.found[i].ev + k) != 0) ret = -1;
+		free(oj.found[i].ev);
 	}
-	else oprntf("Evening 12-degree twilight incorrectly computed.\n");
+	free(oj.node);
+	free(oj.xyz);
+	free(oj.obj);
+	free(oj.found);
+	if(ret < 0) return(-1);
+	return((nt > ntnode) ? nt : ntnode);
+}
+
+int occult_search(cat,jdstart,jdend,lat,longit,elevsea,nthreads,el)
+
+	struct catalog *cat;
+	double jdstart, jdend, lat, longit, elevsea;
+	int nthreads;
+	struct ecl_list *el;
+{
+	return(occult_search_r(&skycalc_default_ctx,cat,jdstart,jdend,lat,
+		longit,elevsea,nthreads,el));
+}
+
+void calendar_worker(arg,i0,i1)
 
-	jdtwilight = jdmid + adj_time(rasun-hatwilight-stmid)/24.;
-	jdtwilight = jd_sun_alt(-12.,jdtwilight,lat,longit);
-	if(jdtwilight > 0.) {
-		oprntf(" -->");
-		print_time((jdtwilight-zone(use_dst,stdz,jdtwilight,*jdb,*jde)/24.),0);
-		print_tz(jdtwilight,use_dst,*jdb,*jde,zabr);
-		oprntf("; ");
+	void *arg;
+	int i0, i1;
+
+/* calendar_gen_r's share of work for one thread -- nights i0 through
+   i1 - 1, counting through each site in turn.  Each piece gets a
+   context of its own, sharing the caller's ephemerides, which are
+   only read. */
+
+{
+	struct calendar *cal;
+	struct skycalc_ctx wctx;
+	struct cal_site *st;
+	struct date_time date;
+	short dow;
+	int i, k;
+
+	cal = (struct calendar *) arg;
+	skycalc_ctx_init(&wctx);
+	wctx.moon_cheb = cal->ctx->moon_cheb;
+	wctx.eph = cal->ctx->eph;
+	wctx.dst = cal->ctx->dst;
+	for(i = i0; i < i1; i++) {
+		st = cal->site + i / cal->nnight;
+		k = i % cal->nnight;
+		caldat(cal->jdstart + k,&date,&dow);
+		calc_tonight_r(&wctx,date,st->lat,st->longit,st->elevsea,
+			st->horiz,st->stdz,st->use_dst,cal->night + i);
 	}
-	else oprntf("Morning 12-degree twilight incorrectly computed.");
+}
 
-        DO_MOON_ETC:
-        if(jdcent > 0.) {
-		oprntf("night center: ");
-		print_time((jdcent-zone(use_dst,stdz,jdcent,*jdb,*jde)/24.),0);
-		print_tz(jdcent,use_dst,*jdb,*jde,zabr);
+void calendar_free(cal)
+
+	struct calendar *cal;
+{
+	free(cal->night);
+	cal->night = NULL;
+	cal->nnight = 0;
+}
+
+int calendar_gen_r(ctx,site,nsite,year,nyears,nthreads,cal)
+
+	struct skycalc_ctx *ctx;
+	struct cal_site *site;
+	int nsite;
+	short year, nyears;
+	int nthreads;
+	struct calendar *cal;
+
+/* the nights of skycalendar, for nyears years from the start of year
+   at each of nsite sites, without printing anything.  Each night is
+   computed by calc_tonight_r; the (site, night) pairs are shared out
+   over nthreads threads (zero for one per processor; see
+   skycalc_parallel), and each lands in its own place in cal->night,
+   so the result doesn't depend on how the work was divided.  ctx's
+   moon_cheb table and ephemeris file, if any, are used.  cal keeps a
+   pointer to site.  Print with calendar_print_r; free with
+   calendar_free.  Returns the number of threads used, or -1 if out
+   of memory. */
+
+{
+	struct date_time date;
+	int nt;
+
+	cal->site = site;
+	cal->nsite = nsite;
+	cal->year = year;
+	cal->nyears = nyears;
+	cal->night = NULL;
+	cal->nnight = 0;
+
+	date.y = year;
+	date.mo = 1;
+	date.d = 1;
+	date.h = 18;  /* local afternoon */
+	date.mn = 0;
+	date.s = 0;
+	cal->jdstart = date_to_jd(date);
+	if(nsite <= 0 || nyears <= 0) return(0);
+	date.y = year + nyears - 1;
+	date.mo = 12;
+	date.d = 31;
+	cal->nnight = (int) (date_to_jd(date) - cal->jdstart + 0.5) + 1;
+
+	cal->night = (struct tonight *) malloc((size_t) nsite *
+		cal->nnight * sizeof(struct tonight));
+	if(cal->night == NULL) {
+		cal->nnight = 0;
+		return(-1);
 	}
-	oprntf("\n\n");
-	min_max_alt(lat,decmoon,&min_alt,&max_alt);  /* rough check -- occurs? */
-	if(max_alt < -(0.83+horiz)) {
-		oprntf("Moon's midnight position does not rise.\n");
-		jdmoonrise = -1.;
-		goto MORE_MOON;
+	cal->ctx = ctx;
+	nt = skycalc_parallel(nthreads,nsite * cal->nnight,CALENDAR_CHUNK,
+		calendar_worker,(void *) cal);
+	cal->ctx = NULL;
+	return(nt);
+}
+
+int calendar_gen(site,nsite,year,nyears,nthreads,cal)
+
+	struct cal_site *site;
+	int nsite;
+	short year, nyears;
+	int nthreads;
+	struct calendar *cal;
+{
+	return(calendar_gen_r(&skycalc_default_ctx,site,nsite,year,nyears,
+		nthreads,cal));
+}
+
+void calendar_setup_tex_r(ctx,option)
+
+	struct skycalc_ctx *ctx;
+	short option;   /* CAL_TEX1 = 1 month per page, CAL_TEX2 = 2 */
+
+/* the head of a TeX calendar, as skycalendar's setupTeX -- it
+   leaves a verbatim block open. */
+
+{
+  oprntf_r(ctx,"%% see the TeXBook, D. Knuth, Addison-Wesley, ISBN 0-201-13448-9, p.382\n");
+  oprntf_r(ctx,"%% The following sizing parameters may need to be tweaked for your setup:\n");
+  oprntf_r(ctx,"\\magnification=835\n");
+  oprntf_r(ctx,"\\hsize 7.6truein\n");
+  oprntf_r(ctx,"\\hoffset -0.7truein \n");
+  oprntf_r(ctx,"\\baselineskip=9.8pt \n");
+  if(option == CAL_TEX2) {
+     oprntf_r(ctx,"\\voffset -0.55truein\n");
+     oprntf_r(ctx,"\\vsize 10.0truein\n");
+  }
+  oprntf_r(ctx,"%% The rest of this should be essentially system-independent:\n");
+  oprntf_r(ctx,"\\nopagenumbers\n");
+  oprntf_r(ctx,"\\def\\uncatcodespecials{\\def\\do##1{\\catcode`##1=12 }\\dospecials} \n");
+  oprntf_r(ctx,"\\def\\doverbatim#1{\\def\\next##1#1{##1\\endgroup}\\next} \n");
+  oprntf_r(ctx,"\\def\\setupverbatim{\\tt \n");
+  oprntf_r(ctx,"  \\def\\par{\\leavevmode\\endgraf} \\catcode`\\`=\\active \n");
+  oprntf_r(ctx,"  \\obeylines \\uncatcodespecials \\obeyspaces} \n");
+  oprntf_r(ctx,"  {\\obeyspaces\\global\\let =\\ }\n");
+  oprntf_r(ctx,"\\def\\listing#1{\\par\\begingroup\\setupverbatim\\input#1 \\endgroup} \n");
+  oprntf_r(ctx,"\\def\\verbatim{\\begingroup\\setupverbatim\\doverbatim} \n");
+  oprntf_r(ctx,"\\verbatim$\n");
+}
+
+void calendar_new_page_r(ctx,format)
+
+	struct skycalc_ctx *ctx;
+	short format;
+
+/* a page break in a text or TeX calendar. */
+
+{
+	if(format == CAL_TEXT) oprntf_r(ctx,"%c",12);  /* form feed */
+	else {
+		oprntf_r(ctx,"$\n");
+		oprntf_r(ctx,"\\par\\vfill\\eject\n");
+		oprntf_r(ctx,"\\verbatim$\n");
 	}
-	if(min_alt > -(0.83+horiz)) {
-		oprntf("Moon's midnight position does not set.\n");
-		jdmoonrise = 1.;
-		goto MORE_MOON;
-	}
-
-	/* compute moonrise and set if they're likely to occur */
-
-	hamoonset = ha_alt(decmoon,lat,-(0.83+horiz)); /* rough approx. */
-	tmoonrise = adj_time(ramoon-hamoonset-stmid);
-	tmoonset = adj_time(ramoon+hamoonset-stmid);
-	jdmoonrise = jdmid + tmoonrise / 24.;
-	jdmoonrise = jd_moon_alt(-(0.83+horiz),jdmoonrise,lat,longit,elevsea);
-	jdmoonset = jdmid + tmoonset / 24.;
-	jdmoonset = jd_moon_alt(-(0.83+horiz),jdmoonset,lat,longit,elevsea);
-	if(fabs(set_to_rise) > 10.) moon_print = 0.65*set_to_rise;
-		 else moon_print = 6.5;
-
-	/* more lousy flow of control, but it's nice to see the event which happens
-	   first printed first .... */
-
-	if(jdmoonset < jdmoonrise) goto PRINT_MOONSET;  /* OUCH!! */
-	PRINT_MOONRISE: if((jdmoonrise > 0.) && (fabs(tmoonrise) < moon_print)) {
-	  /* print it if computed correctly and more-or-less at night */
-		oprntf("Moonrise: ");
-		print_time((jdmoonrise-zone(use_dst,stdz,jdmoonrise,*jdb,*jde)/24.),0);
-		print_tz(jdmoonrise,use_dst,*jdb,*jde,zabr);
-		oprntf("   ");
-	}
-	else if (jdmoonrise < 0.) oprntf("Moonrise incorrectly computed. ");
-	if(jdmoonset < jdmoonrise) goto MORE_MOON;
-	PRINT_MOONSET: if((jdmoonset > 0.) && (fabs(tmoonset) < moon_print)) {
-		oprntf("Moonset : ");
-		print_time((jdmoonset-zone(use_dst,stdz,jdmoonset,*jdb,*jde)/24.),0);
-		print_tz(jdmoonset,use_dst,*jdb,*jde,zabr);
-		oprntf("   ");
-	}
-	else if (jdmoonset < 0.) oprntf("Moonset incorrectly computed. ");
-	if(jdmoonset < jdmoonrise) goto PRINT_MOONRISE;
-
-     MORE_MOON: ill_frac=0.5*(1.-cos(subtend(ramoon,decmoon,rasun,decsun)));
-	oprntf("\nMoon at civil midnight: ");
-	oprntf("illuminated fraction %5.3f\n",ill_frac);
-	print_phase(jdmid);
-	oprntf(", RA and dec: ");
-	put_coords(ramoon,2);
-	oprntf(", ");
-	put_coords(decmoon,1);
-	oprntf("\n\n");
+}
 
-     /* print more information if desired */
-     if(short_long == 2) {  /* wacky indenting here ... */
-	oprntf("The sun is down for %4.1f hr; %4.1f hr from eve->morn 18 deg twilight.\n",
-		set_to_rise,twi_to_twi);
-	if((jdmoonrise > 100.) && (jdmoonset > 100.) &&
-	   (twi_to_twi > 0.) && (twi_to_twi < 24.)) {
-	  /* that is, non-pathological */
-		if((jdmoonrise > jdetw) && (jdmoonrise < jdmtw)) /* rises at night */
-			oprntf("%4.1f dark hours after end of twilight and before moonrise.\n",
-			  (24.*(jdmoonrise - jdetw)));
-		if((jdmoonset > jdetw) && (jdmoonset < jdmtw)) /* sets at night */
-			oprntf("%4.1f dark hours after moonset and before beginning of twilight.\n",
-			  (24.*(jdmtw - jdmoonset)));
-		if((jdmoonrise < jdetw) && (jdmoonset > jdmtw))
-			oprntf("Bright all night (moon up from evening to morning twilight).\n");
-		if((jdmoonrise > jdmtw) && (jdmoonset < jdetw))
-			oprntf("Dark all night (moon down from evening to morning twilight).\n");
+void calendar_page_top_r(ctx,st)
+
+	struct skycalc_ctx *ctx;
+	struct cal_site *st;
+
+{
+	oprntf_r(ctx,"Calendar for %s, west longitude (h.m.s) = ",st->name);
+	put_coords_r(ctx,st->longit,2);
+	oprntf_r(ctx,", latitude (d.m) = ");
+	put_coords_r(ctx,st->lat,1);
+	oprntf_r(ctx,"\n");
+	oprntf_r(ctx,"Note that each line lists events of one night,");
+	oprntf_r(ctx," spanning two calendar dates.  Rise/set times are given\n");
+	oprntf_r(ctx,"in %s time (%3.0f hr W),",st->zone_name,st->stdz);
+	if(st->elev == 0.) oprntf_r(ctx," uncorrected for elevation, ");
+	else oprntf_r(ctx," for %4.0f m above surroundings, ",st->elev);
+	if(st->use_dst == 0) oprntf_r(ctx,"in standard time all year.\n");
+	else oprntf_r(ctx,"DAYLIGHT time used, `*` shows night clocks are reset.\n");
+	oprntf_r(ctx,"Moon coords. and illum. are for local midnight,");
+	oprntf_r(ctx," even if moon is down.\n");
+}
+
+void calendar_date_r(ctx,jd)
+
+	struct skycalc_ctx *ctx;
+	double jd;
+
+/* month and day of jd, as "Jan 01". */
+
+{
+	struct date_time date;
+	char *months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+	short dow;
+
+	caldat(jd,&date,&dow);
+	oprntf_r(ctx,"%.3s %02d",months + 3*(date.mo - 1),(int) date.d);
+}
+
+void calendar_phases_r(ctx,st,year)
+
+	struct skycalc_ctx *ctx;
+	struct cal_site *st;
+	short year;
+
+/* the page of new, first-quarter, full and last-quarter moons (local
+   time) that heads each year of a calendar. */
+
+{
+	struct date_time date;
+	double jd, jdb, jde, jdjan0, jddec32, jdloc;
+	int lunation, mphase;
+
+	find_dst_bounds_r(ctx,year,st->stdz,st->use_dst,&jdb,&jde);
+	oprntf_r(ctx,"      MOON PHASES FOR %d, at %s\n\n",year,st->name);
+	oprntf_r(ctx,"Times and dates are given in local time, zone = %3.0f hr West.\n",
+			st->stdz);
+	oprntf_r(ctx,"They are generally better than +- 2 minutes.\n");
+	if(st->use_dst != 0) oprntf_r(ctx,"Daylight savings time used.\n");
+	oprntf_r(ctx,"\n   The end of the previous year and the beginning of the next\n");
+	oprntf_r(ctx,"are included for continuity.\n\n");
+
+	date.y = year;
+	date.mo = 1;
+	date.d = 0;
+	date.h = 0;
+	date.mn = 0;
+	date.s = 0;
+	jdjan0 = date_to_jd(date);
+	date.mo = 12;
+	date.d = 32;
+	jddec32 = date_to_jd(date);
+
+	lunation = (year - 1900) * 12.3;  /* puts it before beginning */
+	jd = 0.;
+	/* find first lunation of yr */
+	while((jd < jdjan0) && (lunation < 2000)) {
+		flmoon(lunation,0,&jd);
+		lunation++;
+	}
+	if(lunation >= 1995) { /* skip it if results make no sense */
+		oprntf_r(ctx,"Some error in lunations ... no lunar calendar printed.\n");
+		return;
+	}
+	lunation = lunation - 2; /* back up */
+	oprntf_r(ctx,"    NEW             1ST             FULL            LAST\n\n");
+	while(jd < jddec32) {
+		for(mphase = 0; mphase <= 3; mphase++) {
+			flmoon(lunation,mphase,&jd);
+			jdloc = jd - zone(st->use_dst,st->stdz,jd,jdb,jde)/24.;
+			calendar_date_r(ctx,jdloc);
+			oprntf_r(ctx," ");
+			print_time_r(ctx,jdloc,0);
+			oprntf_r(ctx,"   ");
+		}
+		oprntf_r(ctx,"\n\n");
+		lunation++;
+	}
+}
+
+void calendar_time_r(ctx,st,tn,jd)
+
+	struct skycalc_ctx *ctx;
+	struct cal_site *st;
+	struct tonight *tn;
+	double jd;
+
+/* the local time of jd, to the minute, or dots if it's not a time. */
+
+{
+	if(jd > 0.)
+		print_time_r(ctx,jd - zone(st->use_dst,st->stdz,jd,tn->jdb,
+			tn->jde)/24.,0);
+	else oprntf_r(ctx," .....");
+}
+
+void calendar_line_r(ctx,st,tn,jdroot)
+
+	struct skycalc_ctx *ctx;
+	struct cal_site *st;
+	struct tonight *tn;
+	long jdroot;
+
+/* one night's line of a text or TeX calendar, laid out as
+   skycalendar's.  Moonrise and moonset are shown only if they're
+   within 1.5 hours plus half the night of local midnight (6.5 hours
+   at least, 10 where the sun doesn't set and rise). */
+
+{
+	double moon_pr;
+
+	print_day_r(ctx,day_of_week(tn->jd));
+	oprntf_r(ctx," ");
+	calendar_date_r(ctx,tn->jd); /* translate back e.g. 11/31-12/1 */
+	oprntf_r(ctx,"/");
+	print_day_r(ctx,day_of_week(tn->jd + 0.5));  /* local morning */
+	oprntf_r(ctx," ");
+	calendar_date_r(ctx,tn->jd + 0.5);
+	if((st->use_dst != 0) && ((fabs(tn->jdmid - tn->jdb) < 0.49) ||
+			(fabs(tn->jdmid - tn->jde) < 0.49)))
+		oprntf_r(ctx,"*");  /* a star if changing times */
+	else oprntf_r(ctx," ");
+	oprntf_r(ctx,"%7.1f  ",tn->jdmid - jdroot);
+	put_coords_r(ctx,tn->stmid,2);
+	oprntf_r(ctx,"  ");
+
+	moon_pr = 10.;
+	if(tn->sunstate == 1)    /* sun doesn't set; no twilight */
+		oprntf_r(ctx," .....  .....   ....  ....   .....  .....");
+	else {
+		if(tn->sunstate == -1) oprntf_r(ctx," .....");
+		else calendar_time_r(ctx,st,tn,tn->jdsunset);
+		if(tn->twi18state != 0) oprntf_r(ctx,"  .....   ....");
+		else {
+			oprntf_r(ctx," ");
+			calendar_time_r(ctx,st,tn,tn->jdetw);
+			oprntf_r(ctx," ");
+			calendar_time_r(ctx,st,tn,tn->jdmtw);
+		}
+		if(tn->sunstate == -1) oprntf_r(ctx," .....");
+		else calendar_time_r(ctx,st,tn,tn->jdsunrise);
+		if((tn->jdsunrise > 0.) && (tn->jdsunset > 0.)) {
+			moon_pr = 1.5 + 0.5 * (tn->jdsunrise - tn->jdsunset) * 24.;
+			if(moon_pr < 6.5) moon_pr = 6.5;
+		}
+		oprntf_r(ctx,"  ");
+		if((tn->jdetw > 0.) && (tn->jdmtw > 0.)) {
+			put_coords_r(ctx,tn->sidetw,0);
+			oprntf_r(ctx," ");
+			put_coords_r(ctx,tn->sidmtw,0);
+		}
+		else oprntf_r(ctx," .....  .....");
+	}
+	oprntf_r(ctx,"  ");
+
+	if(tn->moonstate == 0) {
+		if(fabs((tn->jdmoonrise - tn->jdmid) * 24.) < moon_pr) {
+			calendar_time_r(ctx,st,tn,tn->jdmoonrise);
+			oprntf_r(ctx," ");
+		}
+		else oprntf_r(ctx," ..... ");
+		if(fabs((tn->jdmoonset - tn->jdmid) * 24.) < moon_pr) {
+			calendar_time_r(ctx,st,tn,tn->jdmoonset);
+			oprntf_r(ctx,"  ");
+		}
+		else oprntf_r(ctx," .....  ");
+	}
+	else oprntf_r(ctx," .....  .....  "); /* no rise or set */
+	oprntf_r(ctx,"%4.0f ",100. * tn->ill_frac);
+	put_coords_r(ctx,tn->ramoon,1);
+	oprntf_r(ctx," ");
+	put_coords_r(ctx,tn->decmoon,0);
+	oprntf_r(ctx,"\n");
+}
+
+void calendar_data_jd_r(ctx,jd)
+
+	struct skycalc_ctx *ctx;
+	double jd;
+
+/* a tab and a UT jd for calendar_data_r, or a dash for none. */
+
+{
+	if(jd > 0.) oprntf_r(ctx,"\t%.5f",jd);
+	else oprntf_r(ctx,"\t-");
+}
+
+void calendar_data_r(ctx,cal,s)
+
+	struct skycalc_ctx *ctx;
+	struct calendar *cal;
+	int s;
+
+/* site s of cal as one tab-separated line per night, after a header
+   line starting with '#'.  Times are UT julian dates (a dash where
+   there's no event), sidereal times and RA are decimal hours, and
+   Dec is decimal degrees. */
+
+{
+	struct cal_site *st;
+	struct tonight *tn;
+	struct date_time date;
+	short dow;
+	int k;
+
+	st = cal->site + s;
+	oprntf_r(ctx,"# site\tdate\tjdmid\tlstmid\tsunset\tevetwi\tmorntwi\tsunrise");
+	oprntf_r(ctx,"\tlsteve\tlstmorn\tmoonrise\tmoonset\tillum\tramoon\tdecmoon\n");
+	for(k = 0; k < cal->nnight; k++) {
+		tn = cal->night + (size_t) s * cal->nnight + k;
+		caldat(tn->jd,&date,&dow);
+		oprntf_r(ctx,"%s\t%04d-%02d-%02d\t%.5f\t%.5f",st->name,(int) date.y,
+			(int) date.mo,(int) date.d,tn->jdmid,tn->stmid);
+		calendar_data_jd_r(ctx,tn->sunstate == 0 ? tn->jdsunset : -1.);
+		calendar_data_jd_r(ctx,tn->twi18state == 0 ? tn->jdetw : -1.);
+		calendar_data_jd_r(ctx,tn->twi18state == 0 ? tn->jdmtw : -1.);
+		calendar_data_jd_r(ctx,tn->sunstate == 0 ? tn->jdsunrise : -1.);
+		if(tn->jdetw > 0. && tn->jdmtw > 0.)
+			oprntf_r(ctx,"\t%.5f\t%.5f",tn->sidetw,tn->sidmtw);
+		else oprntf_r(ctx,"\t-\t-");
+		calendar_data_jd_r(ctx,tn->moonstate == 0 ? tn->jdmoonrise : -1.);
+		calendar_data_jd_r(ctx,tn->moonstate == 0 ? tn->jdmoonset : -1.);
+		oprntf_r(ctx,"\t%.3f\t%.5f\t%.4f\n",tn->ill_frac,tn->ramoon,
+			tn->decmoon);
 	}
-     }  /* closes the wacky indent. */
 }
 
-void print_circumstances(objra,objdec,objepoch,jd,curep,
-	mura_arcs,mura_sec,mudec,sid,lat,elevsea,horiz)
+void calendar_print_r(ctx,cal,s,format)
 
-double objra,objdec,objepoch,curep,mura_arcs,mura_sec,mudec,lat,horiz;
-double jd,sid,elevsea;
+	struct skycalc_ctx *ctx;
+	struct calendar *cal;
+	int s;
+	short format;
 
-/* Given object, site, and time information, prints the circumstances
-   of an observation.  The heart of the "calculator" mode. */
+/* prints site s of cal (from calendar_gen_r) to ctx's output, in
+   format CAL_TEXT, CAL_TEX1, CAL_TEX2 or CAL_DATA.  The text and TeX
+   forms are skycalendar's -- for each year, a page of moon phases and
+   then a page per month (two a page for CAL_TEX2) -- without its
+   introductory page; the TeX form is a whole document. */
 
 {
-	double objra_adj,objdec_adj,curra,curdec,ha,alt,az,secz,par;
-	float ill_frac;
-	double ramoon,decmoon,distmoon,ang_moon,
-		georamoon, geodecmoon, geodistmoon,
-		rasun,decsun,distsun,x,y,z,
-		toporasun,topodecsun,
-		moon_alt,sun_alt,obj_moon,obj_lunlimb,sun_moon,Vmoon,
-		obj_alt,eclong,eclat,tcor,vcor;
-	short luneclcode = 0;
+	static char *monames[] = {"JANUARY","FEBRUARY","MARCH","APRIL",
+		"MAY","JUNE","JULY","AUGUST","SEPTEMBER","OCTOBER",
+		"NOVEMBER","DECEMBER"};
+	struct cal_site *st;
+	struct tonight *tn;
+	struct date_time date;
+	double jd;
+	long jdroot;
+	short y, mo, dow;
+	int k;
 
-	oprntf("\n\nStd epoch--> RA:");
-	put_coords(objra,3);
-	oprntf(", dec:");
-	put_coords(objdec,2);
-	oprntf(", ep %7.2f\n",objepoch);
-	if((mura_sec != 0.) | (mura_arcs != 0.) |(mudec != 0.)) {
-		objra_adj = objra + (curep-objepoch)* mura_sec/3600.;
-		objdec_adj = objdec + (curep-objepoch)*mudec/3600.;
-		oprntf("Adj for p.m: RA:");
-		put_coords(objra_adj,3);
-		oprntf(", dec:");
-		put_coords(objdec_adj,2);
-		oprntf(", epoch %7.2f, equinox %7.2f\n", curep,objepoch);
-		oprntf("(Annual proper motions:");
-		mura_arcs = mura_sec * 15. *
-		     cos(objdec / DEG_IN_RADIAN);
-      		oprntf(" RA: %8.4f sec //%7.3f arcsec, ",mura_sec,mura_arcs);
-		oprntf("dec: %7.3f)\n",mudec);
-		precrot(objra_adj,objdec_adj,objepoch,curep,&curra,&curdec);
-	}
-	else precrot(objra,objdec,objepoch,curep,&curra,&curdec);
-	oprntf("Current  --> RA:");
-	put_coords(curra,3);
-	oprntf(", dec:");
-	put_coords(curdec,2);
-	oprntf(", ep %7.2f\n",curep);
-	ha = adj_time(sid - curra);
-	oprntf("HA: ");
-	put_coords(ha,2);
-	alt=altit(curdec,ha,lat,&az);
-	obj_alt = alt;
-	/* test size of sec z to avoid overflowing space provided */
-	secz = secant_z(alt);
- 	if(fabs(secz) < 100.) oprntf("; sec.z = %8.3f",secz);
-	else oprntf(" Obj very near horizon.");
-	if(secz > 3.) oprntf(" -- Large airmass!\n");
-	else if(secz < 0.) oprntf(" -- BELOW HORIZON.\n");
-	else oprntf("\n");
-	oprntf("altitude %6.2f, azimuth %6.2f, ",alt,az);
-	par = parang(ha,curdec,lat);
-	oprntf("parallactic angle %4.1f",par);
-	/* also give +- 180 ..... */
-	if((par <= 180.) && (par > 0.)) oprntf("  [%4.1f]\n\n",par - 180.);
-	 else oprntf("  [%4.1f]\n\n",par + 180.);
-	accumoon(jd,lat,sid,elevsea,&georamoon,&geodecmoon,&geodistmoon,
-			&ramoon,&decmoon,&distmoon);
-	accusun(jd,sid,lat,&rasun,&decsun,&distsun,
-		&toporasun,&topodecsun,&x,&y,&z);
-	alt=altit(topodecsun,(sid-toporasun),lat,&az);
-	sun_moon = subtend(ramoon,decmoon,toporasun,topodecsun);
-	ill_frac= 0.5*(1.-cos(sun_moon)); /* ever so slightly inaccurate ...
-	   basis of ancient Greek limit on moon/sun distance ratio! */
-	sun_moon = sun_moon * DEG_IN_RADIAN;
-/*      printf("geocentric moon: ");
-	put_coords(georamoon,4);
-	printf("  ");
-	put_coords(geodecmoon,3);
-	printf(" %f \n",geodistmoon);  */
-	sun_alt = alt;
-	if(alt < -18.) oprntf("The sun is down; there is no twilight.\n");
-	else {
-		if (alt < -(0.83+horiz))
-			oprntf("In twilight, sun alt %4.1f, az %5.1f ",alt,az);
-		else oprntf("The sun is up, alt %4.1f, az %4.1f",alt,az);
-		oprntf("; Sun at ");
-		put_coords(toporasun,3);
-		oprntf(", ");
-		put_coords(topodecsun,2);
-		oprntf("\n");
-		if(sun_moon < 1.5) solecl(sun_moon,distmoon,distsun);
-			/* check for solar eclipse if it's close */
-		if (alt < -(0.83+horiz))
-		  oprntf("Clear zenith twilight (blue) approx %4.1f  mag over dark night sky.\n",
-				ztwilight(alt));
+	if(format == CAL_DATA) {
+		calendar_data_r(ctx,cal,s);
+		return;
 	}
-	moon_alt=altit(decmoon,(sid-ramoon),lat,&az);
-	if(moon_alt > -2.) {
-		oprntf("Moon :");
-		put_coords(ramoon,2);
-		oprntf(",");
-		put_coords(decmoon,1);
-		oprntf(", alt %5.1f, az %5.1f;",moon_alt,az);
-		oprntf("%6.3f illum.\n",ill_frac);
-		print_phase(jd);
-		obj_moon = DEG_IN_RADIAN * subtend(ramoon,decmoon,curra,curdec);
-		if(fabs(obj_moon) > 10.) {
-		  oprntf(".  Object is %5.1f degr. from moon.\n",obj_moon);
-		}
-		else  {
-			ang_moon = DEG_IN_RADIAN * asin(RMOON / (distmoon * EQUAT_RAD));
-			if((obj_lunlimb = obj_moon - ang_moon) > 0.)
-			  oprntf(" ** NOTE ** Object %4.1f degr. from lunar limb!\n",obj_lunlimb);
-			else oprntf(" ** NOTE ** You're looking AT the moon!\n");
-		}
-		if(sun_moon > 176.)
-			luneclcode = lunecl(georamoon,geodecmoon,geodistmoon,
-			rasun,decsun,distsun);
-		if((moon_alt > 0.) && (obj_alt > 0.5) && (sun_alt < -9.)) {
-		  /*if it makes sense to estimate a lunar sky brightness */
-		  Vmoon =
-		     lunskybright(sun_moon,obj_moon,KZEN,moon_alt,
-				obj_alt,distmoon);
-
-		     oprntf("Lunar part of sky bright. = %5.1f V mag/sq.arcsec (estimated).\n",Vmoon);
-		     if(luneclcode != 0)
-			oprntf(" NOT including effect of LUNAR ECLIPSE ...!\n");
+	st = cal->site + s;
+	if(format != CAL_TEXT) calendar_setup_tex_r(ctx,format);
+
+	for(y = cal->year; y < cal->year + cal->nyears; y++) {
+		if(format == CAL_TEXT || y > cal->year)
+			calendar_new_page_r(ctx,format);
+		calendar_phases_r(ctx,st,y);
+
+		for(mo = 1; mo <= 12; mo++) {
+			if(format == CAL_TEX2) {
+				if(mo % 2 == 1) {
+					calendar_new_page_r(ctx,format);
+					calendar_page_top_r(ctx,st);
+				}
+			}
+			else calendar_new_page_r(ctx,format);
+			oprntf_r(ctx,"\n");
+			oprntf_r(ctx,"                                           ***** %4d %s *****\n",
+				(int) y,monames[mo - 1]);
+			if(format != CAL_TEX2) {
+				oprntf_r(ctx,"\n");
+				calendar_page_top_r(ctx,st);
+			}
+			oprntf_r(ctx,"\n");
+
+			date.y = y;
+			date.mo = mo;
+			date.d = 1;
+			date.h = 18;  /* evening of first night of month */
+			date.mn = 0;
+			date.s = 0;
+			jd = date_to_jd(date); /* not really jd; local equivalent */
+			jdroot = ((long) (jd / 10000.)) * 10000;
+			oprntf_r(ctx,"  Date (eve/morn)      JDmid    LMSTmidn   ---------- Sun: --------- ");
+			oprntf_r(ctx,"  LST twilight:  ------------- Moon: --------------\n");
+			oprntf_r(ctx,"  (%4d at start)    (-%7ld)       ",(int) y,jdroot);
+			oprntf_r(ctx,"     set  twi.end twi.beg rise");
+			oprntf_r(ctx,"    eve    morn    rise   set  %%illum   RA      Dec\n\n");
+
+			k = (int) (jd - cal->jdstart + 0.5);
+			for( ; k < cal->nnight; k++) {
+				tn = cal->night + (size_t) s * cal->nnight + k;
+				caldat(tn->jd,&date,&dow);
+				if(date.mo != mo) break;
+				if(dow == 6) oprntf_r(ctx,"\n"); /* blank line at Sunday */
+				calendar_line_r(ctx,st,tn,jdroot);
+			}
 		}
 	}
-	else {
-		print_phase(jd);
-		oprntf(".  The moon is down.\n");
-	}
-	eclipt(objra,objdec,objepoch,jd,&curep,&eclong,&eclat);
-	if(fabs(eclat)<10.) {
-		oprntf("Ecliptic latitude %4.1f; ",eclat);
-		oprntf("watch for low-flying minor planets.\n");
+	if(format != CAL_TEXT) {
+		oprntf_r(ctx,"$\n");
+		oprntf_r(ctx,"\\par\\vfill\\supereject\\end\n");
 	}
-	planet_alert(jd,curra,curdec,PLANET_TOL);
-	/* tolerance set to 3 degrees earlier. */
-	helcor(jd,curra,curdec,ha,lat,elevsea,&tcor,&vcor);
-	oprntf("Barycentric corrections: add %6.1f sec, %5.2f",tcor,vcor);
-	oprntf(" km/sec to observed values.\n");
-	oprntf("Barycentric Julian date = %14.6f\n",(jd+tcor/SEC_IN_DAY));
-	printf("\nType command, 'f' for fast tour, '?' for a menu:");
 }
 
-void hourly_airmass(date,stdz,lat,longit,horiz,use_dst,objra,objdec,
-  objepoch, mura_sec,mura_arcs,mudec)
+void calendar_print(cal,s,format)
 
-/* Given a slew of information, prints a table of hourly airmass, etc.
-   for use in scheduling observations.  Also prints sun and moon
-   altitude when these are relevant.  Precesses coordinates as well. */
+	struct calendar *cal;
+	int s;
+	short format;
+{
+	calendar_print_r(&skycalc_default_ctx,cal,s,format);
+}
 
-struct date_time date;
-double stdz,lat,longit,horiz,objra,objdec,objepoch,mura_sec,mura_arcs,mudec;
-short use_dst;
+int get_sys_date(date, use_dst, enter_ut, night_date, stdz, toffset)
 
+	struct date_time *date;
+	short use_dst, enter_ut, night_date;
+        double stdz, toffset;
 {
+	/* Reads the system clock; loads up the date structure
+           to conform to the prevailing conventions for the interpretation
+           of times.  Optionally adds "toffset" minutes to the system
+           clock, as in x minutes in the future. */
 
-	double jd, jdb, jde, jdmid, curra, curdec, curep;
-	double sid, ha, alt, az, secz, par, rasun, decsun, ramoon,
-		decmoon,distmoon;
- 	double ill_frac,sepn;
-        long int jdclong;
-	int nch;
-	short i, hr_span, dow;
-	char obj_name[40], errprompt[80];
-        double hasset, jdsset, jdsrise, jdcent;
+	time_t t, *tp;
+	struct tm *stm;
+        double jd, jdb, jde;
+        short dow;
 
-	if((date.y <= 1900) | (date.y >= 2100)) {
-		printf("Date out of range - 1901 -> 2099\n");
-		return;
-	}
-	printf("Name of object:");
-	nch = get_line(obj_name);
+	tp = &t;  /* have to initialize pointer variable for it to
+                     serve as an argument. */
 
-	find_dst_bounds(date.y,stdz,use_dst,&jdb,&jde);
-	date.h = 24; /* local midn */
-	date.mn = 0;
-	date.s = 0;
-	jdmid = date_to_jd(date) + stdz/24.;
-	/* first approx.-imperfect near time change */
-	jdmid = date_to_jd(date) +
-		zone(use_dst,stdz,jdmid,jdb,jde)/24.;
-	curep = 2000.+(jdmid - J2000)/365.25;
-	oprntf("\n\n*** Hourly airmass for %s ***\n\n",obj_name);
-	if((use_dst != 0) &&
-		((fabs(jdmid - jdb) < 0.5) || (fabs(jdmid - jde) < 0.5)))
-		oprntf("*** NOTE STD/DAYLIGHT TIME CHANGE TONIGHT ***\n");
-	oprntf("Epoch %7.2f: RA ",objepoch);
-	put_coords(objra,3);
-	oprntf(", dec ");
-	put_coords(objdec,2);
-	oprntf("\n");
-	oprntf("Epoch %7.2f: RA ",curep);
-	precrot(objra,objdec,objepoch,curep,&curra,&curdec);
-	put_coords(curra,3);
-	oprntf(", dec ");
-	put_coords(curdec,2);
-	if((mura_sec != 0.) | (mura_arcs != 0.) | (mudec != 0))
-	   oprntf("\n Caution .. proper motion ignored\n\n");
-	else oprntf("\n\n");
-	oprntf("At midnight: UT date ");
-	print_calendar(jdmid,&dow);
-	lpsun(jdmid,&rasun,&decsun);
-	sid=lst(jdmid,longit);
-	lpmoon(jdmid,lat,sid,&ramoon,&decmoon,&distmoon); /* close enuf */
-	ill_frac=0.5*(1.-cos(subtend(ramoon,decmoon,rasun,decsun)));
-	sepn = DEG_IN_RADIAN * subtend(ramoon,decmoon,curra,curdec);
-	oprntf(", Moon %4.2f illum, %3.0f degr from obj\n",ill_frac,sepn);
-	planet_alert(jdmid,curra,curdec,PLANET_TOL);   /* better know about it .... */
-	oprntf("\n  Local      UT      LMST");
-	oprntf("      HA     secz   par.angl. SunAlt MoonAlt\n\n");
+	t = time(tp);
+	if(t == -1) {
+		oprntf("SYSTEM TIME UNAVAILABLE!  Date & time left alone.\n");
+		return(-1);
+        }
+	stm = localtime(&t);
+	date->y = (short) (stm->tm_year + 1900);
+	date->mo = (short) (stm->tm_mon + 1);
+	date->d = (short) (stm->tm_mday);
+	date->h = (short) (stm->tm_hour);
+	date->mn = (short) (stm->tm_min);
+	date->s = (float) (stm->tm_sec);
 
-        /* figure out how much to print ... */
+	if(toffset != 0.) {
+	   jd = date_to_jd(*date);
+	   jd = jd + toffset / 1440.;
+	   caldat(jd,date,&dow);
+        }
 
-        hasset = ha_alt(decsun,lat,-0.83);
-        jdsset = jd_sun_alt(-0.83,(jdmid - (12. - hasset) / 24.),lat,longit);
-        jdsrise = jd_sun_alt(-0.83,(jdmid + (12. - hasset) / 24.),lat,longit);
-        jdcent = (jdsset + jdsrise) / 2.;   /* center of night .. not local mid */
-        hr_span = (short) (12. * (jdsrise - jdsset) + 0.5);
- /*       printf("jdsset %f jdsrise %f jdcent %f hr_span %d\n",
-                jdsset,jdsrise,jdcent,hr_span);   ... diagnostic */
-        jdclong = (long) ((24. * jdcent) + 0.5);  /* round to nearest hour */
-        jdcent = jdclong / 24. + 0.00001;  /* add a hair to prevent "24 00"
-              rounding ugliness in time table. */
- /*       printf("jdcent .... %f\n",jdcent);  ... diagnostic */
-	for(i=(-1 * hr_span);i<=hr_span;i++) {
-		jd = jdcent + i/24.;
-		sid=lst(jd,longit);
-		lpsun(jd,&rasun,&decsun);
-		if(altit(decsun,(sid-rasun),lat,&az) > 0.) goto SKIP;
-		print_time((jd-zone(use_dst,stdz,jd,jdb,jde)/24.),0);
-		oprntf("  ");
-		print_time(jd,0);
-		oprntf("  ");
-	     /*	sid=lst(jd,longit); */
-		put_coords(sid,0);
-		oprntf("  ");
-		ha = adj_time(sid - curra);
-		put_coords(ha,0);
-		oprntf("  ");
-		alt=altit(curdec,ha,lat,&az);
-	        if(alt < -(horiz)) oprntf(" (down)");
-		else if(alt < 1.0) oprntf("(v.low)");
-		else {
-		     secz=secant_z(alt);
-      		     oprntf(" %6.3f",secz);
-		}
-		par = parang(ha,curdec,lat);
-		oprntf("  %6.1f ",par);
-		/* lpsun(jd,&rasun,&decsun); */
-		alt=altit(decsun,(sid-rasun),lat,&az);
-		if(alt < -18.) oprntf("    ... ");
-		   else oprntf("   %5.1f",alt);
-		lpmoon(jd,lat,sid,&ramoon,&decmoon,&distmoon); /* close enuf */
-		alt=altit(decmoon,(sid-ramoon),lat,&az);
-		if(alt < -2.)  oprntf("    ... \n");
-		   else oprntf("   %5.1f\n",alt);
-                SKIP: ;
+        if(enter_ut == 1)  { /* adjust if needed */
+           find_dst_bounds(date->y,stdz,use_dst,&jdb,&jde);
+	   jd = date_to_jd(*date);
+	   jd = jd + zone(use_dst,stdz,jd,jdb,jde)/24.;
+           caldat(jd,date,&dow);
+        }
+	oprntf("\nDATE AND TIME SET AUTOMATICALLY USING SYSTEM CLOCK ... to\n");
+	print_all(date_to_jd(*date));
+	if(enter_ut == 0) oprntf(" local time\n");
+        else oprntf(" Universal time\n");
+      	if((night_date == 1) && (date->h < 12)) {
+		date->d = date->d - 1;
+		oprntf("(night-date is on, so internal value of date set to last evening)\n");
 	}
+	oprntf("(NOTE: time does NOT automatically update; 'T' reads clock again.)\n");
+        return(0); /* success */
 }
 
-void print_params(date,enter_ut,night_date,stdz,lat,longit,site_name,
-    elevsea,elev,use_dst,objra,objdec,objepoch,mura_sec,mura_arcs,
-    mudec)
+#endif     /* previous routine depends on sys clock */
 
-    struct date_time date;
-    short enter_ut;
-    short night_date;
-    double stdz;
-    double lat;
-    double longit;
-    char *site_name;
-    double elevsea;
-    double elev;
-    short use_dst;
-    double objra;
-    double objdec;
-    double objepoch;
-    double mura_sec;
-    double mura_arcs;
-    double mudec;
+void indexx(n,arrin,indx)
 
-/* This simply prints a nicely formatted list of the *input* parameters
-   without doing any computations.  Helpful for the perplexed user, and
-   for checking things. */
+/* Sort routine from Press et al., "Numerical Recipes in C",
+  1st edition, Cambridge University Press. */
+
+int n,indx[];
+float arrin[];
 {
-	short dow;
-	double jd;
+	int l,j,ir,indxt,i;
+	float q;
 
-	jd = date_to_jd(date);
-	oprntf("\nCurrent INPUT parameter values:\n\n");
-	oprntf("      DATE: ");
-	print_calendar(jd,&dow);
-	oprntf("\n      TIME:");
-	print_time(jd,3);
-	if(night_date == 1)
-		oprntf("\nNIGHT_DATE:  ON    -- date applies all evening & next morning.\n");
-	else oprntf("\nNIGHT_DATE:  OFF   -- date is taken literally.\n");
-	if(enter_ut == 1)
-		oprntf("  UT_INPUT:  ON    -- input times taken to be UT.\n");
-	else oprntf("  UT_INPUT:  OFF   -- input times taken to be local.\n");
-	if(use_dst == 0)
-		oprntf("   USE_DST:   0    -- Standard time in use all year.\n");
-	else oprntf("   USE_DST: %3d    -- Daylight savings used part of year.\n",
-			use_dst);
-	oprntf("\n");
-	oprntf("            RA: ");
-	put_coords(objra,4);
-	oprntf("\n           DEC: ");
-	put_coords(objdec,3);
-	oprntf("\n   INPUT EPOCH:   %8.2f\n",objepoch);
-	if((mura_sec == 0.) && (mura_arcs == 0.) && (mudec == 0.))
-		oprntf("PROPER MOTIONS:  OFF\n");
-	else    {
-          mura_arcs = mura_sec * 15. * cos(objdec / DEG_IN_RADIAN);
-	  oprntf("PROPER MOTIONS: RA(sec)=%6.3f, RA(arc)=%6.2f, DEC=%6.2f\n",
-		mura_sec,mura_arcs,mudec);
-        }
-	oprntf("\nSITE: %s\n",site_name);
-	oprntf("      E.longit. = ");
-	put_coords(-15. * longit,1);
-	oprntf(", latit. = ");
-	put_coords(lat,1);
-	oprntf(" (degrees)\n");
-	oprntf("      Standard zone = %3.0f hrs ",fabs(stdz));
-	if(stdz >= 0.) oprntf(" West\n");
-	  else oprntf(" East\n");
-	oprntf("      Elevation above horizon = %4.0f m, True elevation = %4.0f m\n",
-		elev,elevsea);
+	for (j=1;j<=n;j++) indx[j]=j;
+	l=(n >> 1) + 1;
+	ir=n;
+	for (;;) {
+		if (l > 1)
+			q=arrin[(indxt=indx[--l])];
+		else {
+			q=arrin[(indxt=indx[ir])];
+			indx[ir]=indx[1];
+			if (--ir == 1) {
+				indx[1]=indxt;
+				return;
+			}
+		}
+		i=l;
+		j=l << 1;
+		while (j <= ir) {
+			if (j < ir && arrin[indx[j]] < arrin[indx[j+1]]) j++;
+			if (q < arrin[indx[j]]) {
+				indx[i]=indx[j];
+				j += (i=j);
+			}
+			else j=ir+1;
+		}
+		indx[i]=indxt;
+	}
 }
 
-void print_menu()
-	{
-	if(sclogfl != NULL) fprintf(sclogfl,"\n\n *** Menu Choices *** \n");
-	oprntf("Circumstance calculator, type '=' for output.\n");
-	oprntf("Commands are SINGLE (lower-case!) CHARACTERS as follows:\n");
-	oprntf(" ? .. prints this menu; other information options are:\n");
-	oprntf("i,f . 'i' prints brief Instructions and examples, 'f' fast tour\n");
-	oprntf(" w .. prints info on internal Workings, accuracy & LEGALITIES\n");
-	oprntf("TO SET PARAMETERS & OPTIONS, use these (follow the formats!):\n");
-	oprntf(" r .. enter object RA, in hr min sec,  example: r 3 12 12.43\n");
-	oprntf(" d .. enter object Dec in deg min sec, example: d -0 18 0\n");
-	oprntf(" y .. enter date, starting with Year   example: y 1994 10 12\n");
-#if SYS_CLOCK_OK == 1
-     	oprntf("t,T: t = enter time, e.g.: t 22 18 02 [see 'g' and 'n']; T = right now+\n");
-#else
-     	oprntf(" t .. enter time, example: t 22 18 02 ; see 'g' and 'n' below\n");
-#endif
-     	oprntf(" n .. *toggles* whether date is used as 'evening' (default) or literal\n");
-	oprntf(" g .. *toggles* whether time is used as Greenwich or local\n");
-	oprntf(" e .. enter Epoch used to interpret input coords (default = 1950)\n");
-	oprntf(" p .. enter object Proper motions (complicated, follow prompts).\n");
-	oprntf(" s .. change Site (again, follow prompts).\n");
-	oprntf(" l .. Look at current parameter values (no computation).\n");
-	oprntf("TO CALCULATE AND SEE RESULTS, use these commands: \n");
-	oprntf(" = .. type out circumstances for specified instant of time, ra, dec, etc.\n");
-	oprntf(" a .. type out night's Almanac for specified (evening) date\n");
-	oprntf(" h .. type out Hourly airmass table for specified date, ra, dec\n");
-        oprntf(" o .. tabulate Observability at 2-week intervals (at full&new moon)\n");
-	oprntf(" m .. Major planets -- print 0.1 deg positions for specified instant\n");
-        oprntf(" x .. eXtra goodies: log file, object files, other calculators; try x? \n");
-	oprntf(" Q .. QUIT .. STOPS PROGRAM. ---> ");
-}
+/* the last generation number handed out by catalog_touch; one
+   counter for the whole process, so that no two catalogs (or states
+   of one catalog) ever share a number. */
+
+static unsigned long catalog_gen_last = 0;
+static pthread_mutex_t catalog_gen_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void catalog_touch(cat)
+
+	struct catalog *cat;
+
+/* gives cat a new generation number, marking any index built from
+   it earlier as stale (see catindex_current).  The catalog_ calls do
+   this themselves; code that changes cat->objs or cat->n directly
+   should call it after. */
 
-void print_tutorial()
 {
-	if(sclogfl != NULL) fprintf(sclogfl,"\n  *** Fast Guided Tour listing ***\n\n");
-	oprntf("FAST GUIDED TOUR: (type 'f' to see this again).\n\n");
-	oprntf("To explore this program quickly, try the following (in order):\n\n");
-	oprntf("--> Specify an evening date (e.g., 1995 March 22) and then display\n");
-	oprntf("    the almanac for that night by typing \n");
-	oprntf("        y 1995 3 22   a \n");
-	oprntf("--> Specify an ra and dec and then make an hourly airmass table\n");
-	oprntf("    by typing, for instance \n");
-	oprntf("        r 15 28 27  d 12 13 14  h \n");
-	oprntf("    (Notice how the date you specified earlier is still in effect.)\n");
-	oprntf("--> Specify a time (e.g., 4 50 00 AM local time) and display the\n");
-	oprntf("    circumstances at that instant by typing\n");
-	oprntf("        t 4 50 0  =\n");
-	oprntf("--> Type 'o' and follow the prompts to show observability\n");
-	oprntf("    through a season (tabulated at new & full moon).\n");
-	oprntf("--> Type 'l' to list the current input parameters and options.\n");
-	oprntf("--> Type 'm' to list planetary positions.\n");
-#if SYS_CLOCK_OK == 1
- 	oprntf("--> Type 'T' to set time & date to right now (+ settable offset).\n");
-        oprntf("--> Type 'x?' for eXtra goodies menu; log file, object lists etc..\n");
-	oprntf("--> Read the help texts; '?' prints a short menu, 'i' gives\n");
-#else
-	oprntf("--> Read the help texts; '?' prints a short menu, 'i' gives\n");
-#endif
-	oprntf("    more complete information, 'w' tells you about inner workings.\n");
-	oprntf("    An upper-case 'Q' exits the program.\n");
-	oprntf(" Give a command: ");
+	pthread_mutex_lock(&catalog_gen_lock);
+	cat->gen = ++catalog_gen_last;
+	pthread_mutex_unlock(&catalog_gen_lock);
 }
 
-void print_examples() {
+void catalog_init(cat)
 
-	char cdum;
+	struct catalog *cat;
 
-	if(sclogfl != NULL) fprintf(sclogfl,"\n\n *** On-Line Documentation listing ***");
-	oprntf("\n\nMost parameters are entered as a single character followed\n");
-	oprntf("by a value; you then type an EQUALS SIGN to compute circumstances\n");
-	oprntf("for current site, time, and celestial position. FOR EXAMPLE:\n");
-	oprntf("You observe an object at RA 19 02 23.3, dec -5 18 17\n");
-	oprntf("epoch 2000., on 1993 June 18, at 21 32 18 local time, from\n");
-	oprntf("the site you've selected.  To calculate circumstances, type\n\n");
-	oprntf("r 19 02 23.3 d -5 18 17 e 2000 y 1993 6 18 t 21 32 18 =\n\n");
-	oprntf("Note: coords, dates and times are entered as TRIPLETS OF NUMBERS\n");
-	oprntf("separated by blanks (not colons), and date format is y m d.\n");
-	oprntf("Commands are CASE SENSITIVE (R is not r)!  Carriage returns\n");
-	oprntf("can go almost anywhere. Parameters remain in effect until you\n");
-	oprntf("change them, so in this example typing\n");
-	oprntf("t 23 32 18 =  \n");
-	oprntf("would give circumstances for the same object two hours later.\n\n");
+/* sets up an empty catalog. */
 
-	oprntf("Typing 'a' prints an almanac for the currently specified date -- be\n");
-	oprntf("careful you have the correct night if you've used 'n' or 'g'. (below).\n\n");
+{
+	cat->objs = NULL;
+	cat->n = 0;
+	cat->cap = 0;
+	cat->gen = 0;
+}
 
-	oprntf("(Hit return to continue listing...)");
-	scanf("%c",&cdum);
-	scanf("%c",&cdum);  /* first one eats fossil input.. */
+void catalog_free(cat)
 
-	oprntf("\n\nTwo commands invoke options for the interpretation of times and dates.\n");
-        oprntf("[N. B. -- This issue is a little confusing, but important .... ]\n");
-	oprntf("By default, the program interprets dates as 'evening', so late PM and\n");
-	oprntf("early AM times refer to the same night.  Typing 'n' (for 'night date')\n");
-	oprntf("TOGGLES bewteen this and literal dates.  Also by default, input\n");
-	oprntf("times are in local (zone) time, but input times can be interpreted as UT;\n");
-	oprntf("typing 'g' TOGGLES between these.  Invoking UT mode disables night dates.\n");
-	oprntf("Note that 'g', 'n' (and the epoch option 'e') do not cause calculation, but\n");
-	oprntf("only affect interpretation of the relevant parameters at compute time.\n\n");
+	struct catalog *cat;
 
-	oprntf("Typing 'l' (look) causes all the input parameters to be typed out without\n");
-        oprntf("any computation, which is especially helpful if you're lost by 'g' or 'n'.\n\n");
+{
+	free(cat->objs);
+	catalog_init(cat);
+	catalog_touch(cat);
+}
 
-	oprntf("Typing 'h' creates a table of airmass, etc. at hourly intervals through\n");
-	oprntf("the night.  You may wish to redirect output (using system) to print.\n\n");
+int catalog_reserve(cat,n)
 
-	oprntf("Typing 'o' computes observability of an object for each dark\n");
-	oprntf("and bright run through a range of dates.\n\n");
+	struct catalog *cat;
+	int n;
 
-	oprntf("(Hit return to continue listing...)");
-	scanf("%c",&cdum);
+/* makes room for at least n objects, growing the catalog
+   geometrically from CATALOG_CHUNK.  Returns 0, or -1 if out
+   of memory (in which case the catalog is unchanged). */
 
-	oprntf("\nTyping 'm' displays rough (see 'w' option) positions of major planets.\n\n");
+{
+	struct objct *objs;
+	int cap;
+
+	if(n <= cat->cap) return(0);
+	cap = cat->cap > 0 ? cat->cap : CATALOG_CHUNK;
+	while(cap < n) cap *= 2;
+	objs = (struct objct *) realloc(cat->objs,
+		(size_t) (cap + 1) * sizeof(struct objct));  /* + objs[0] */
+	if(objs == NULL) return(-1);
+	cat->objs = objs;
+	cat->cap = cap;
+	return(0);
+}
 
-	oprntf("To change observing sites, type 's' and answer the prompts.\n\n");
+int catalog_add(cat,name,ra,dec,ep,xtra)
 
-#if SYS_CLOCK_OK == 1
-	oprntf("Typing 'T' sets BOTH the TIME and DATE to 'now' using the system clock.\n");
-	oprntf("You can also specify a number of minutes into the future to set.  The status\n");
-	oprntf("of the 'n' and 'g' options are properly taken into account.\n\n");
-#endif
-	oprntf("To enable an approximate proper motion correction, type 'p' and\n");
-	oprntf("answer the prompts *carefully*.  Re-enter as zero to turn off.\n\n");
-	oprntf("Typing 'x' invokes many useful commands -- log file, object files, etc!\n\n");
-	oprntf("Type command, Q (upper case) to stop, or ? for a menu:");
+	struct catalog *cat;
+	char *name;
+	double ra, dec, ep, xtra;
+
+/* appends an object; returns its index, or -1 if out of memory.
+   Names are cut to fit. */
+
+{
+	struct objct *ob;
+
+	if(catalog_reserve(cat,cat->n + 1) < 0) return(-1);
+	ob = cat->objs + ++cat->n;
+	strncpy(ob->name,name,sizeof(ob->name) - 1);
+	ob->name[sizeof(ob->name) - 1] = '\0';
+	ob->ra = ra;
+	ob->dec = dec;
+	ob->ep = ep;
+	ob->xtra = xtra;
+	catalog_touch(cat);
+	return(cat->n);
 }
 
-void print_accuracy()
+int catalog_blank(c)
+
+	int c;
+
+/* white space within a line, as scanf sees it. */
 
 {
+	return(c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v');
+}
 
-	char cdum;
+char *catalog_num(p,end,x)
 
-        if(sclogfl != NULL) fprintf(sclogfl,"\n\n");
-	oprntf("ACCURACY INFO:\n\n");
-	oprntf("The distinctions between UTC, UT1, TDT (etc.) are ignored\n");
-	oprntf("except that a rough correction to TDT is used for the moon.\n");
-	oprntf("The solar ephemeris used is good to a few arcsec.  Moon positions\n");
-	oprntf("positions are topocentric and +- about 30 arcsec, hence solar\n");
-	oprntf("eclipse paths are +- 50 km and +- 1 min. All rise/set times are\n");
-	oprntf("computed to about +-1 min; non-level horizon, site elevation,\n");
-	oprntf("and refraction uncertainties are often larger than this.\n\n");
-	oprntf("The lunar sky brightness model assumes ideal atmospheric conditions;\n");
-	oprntf("true lunar contributions to sky will vary widely.  To compare\n");
-	oprntf("a dark site has about V=21.5 mag/sq.arcsec (variable)! Twilight\n");
-	oprntf("brightness prediction is for blue, and only very approximate.\n\n");
-	oprntf("The planetary calculations are truncated, but the error should\n");
-	oprntf("seldom exceed 0.1 degree; MV are best(1'), MJSU ok, Pluto worst.\n");
-	oprntf("\nNote that the local sidereal time given is Mean, not true,\n");
-	oprntf("and that it assumes the input is true UT, not UTC (< 1 second)\n");
-	oprntf("(Hit return to continue listing...)");
-	scanf("%c",&cdum);
-	scanf("%c",&cdum);  /* first one usually eats fossil input.. */
-	oprntf("\nDaylight savings time, if selected, is established using a\n");
-	oprntf("site-specific convention (e.g., USA).  Beware of ambiguities\n");
-	oprntf("and nonexistent times when the clock is reset.  If necessary,\n");
-	oprntf("use the 'g' option and enter times and dates as Greenwich (UT),\n");
-	oprntf("or disable DST in site params (see discussion under 'i').\n\n");
-	oprntf("The *precession* routine used is a 'rigorous'");
-	oprntf(" rotation matrix routine,\ntaken from L. Taff's Computational");
-	oprntf(" Spherical Astronomy.\nIt uses IAU1976 constants, is good to < 1 arcsec in 50 years,\n");
-	oprntf("and has no troubles near the pole.  Proper motion corrections\n");
-	oprntf("are done crudely as x = x0 + mu * dt; this is inaccurate near\n");
-	oprntf("the poles.  Use another routine if sub-arcsec accuracy is critical.\n");
-	oprntf("Apparent place (with nutation, aberration) is NOT computed.\n");
-	oprntf("(Hit return to continue listing...)");
-	scanf("%c",&cdum);
-	oprntf("\n\nThe parallactic angle follows Filippenko (1982, PASP 94, 715).\n");
-	oprntf("\nThe barycentric ('heliocentric') corrections are computed using\n");
-	oprntf("an elliptical earth orbit with a few periodic perturbations\n");
-	oprntf("including lunar recoil.  The helio-to-barycentric transformation\n");
-	oprntf("uses the same algorithms as the planetary postions.  Overall max error:\n");
-	oprntf("< 0.2 sec and < 0.005 km/s.  Velocity corrn. includes earth rotation.\n");
-	oprntf("\nThe galactic coordinate routine is rigorously accurate, and\n");
-	oprntf("precesses to 1950 before transforming.  The ecliptic coord.\n");
-	oprntf("routine is for coordinates of date and is good to < 1 arcsec.\n\n");
-	oprntf("These routines are **not necessarily correct** at times very far from\n");
-	oprntf("the present (1990s).  The program rejects input outside 1900-2100.\n");
-	oprntf("\nWhen porting to a new machine, run tests to ensure\n");
-	oprntf("correctness and accuracy.  Experience shows that compiler\npeculiarities arise ");
-	oprntf("surprisingly often.\n");
-	oprntf("(Hit return to continue listing...)");
-	scanf("%c",&cdum);
-	oprntf("CAUTIONS, LEGALITIES:\n");
-	oprntf("Many routines take a time argument which is a double-precision\n");
-	oprntf("floating-point julian date; on most workstations, this gives\n");
-	oprntf("time resolution of < 0.1 second.  When porting\n");
-	oprntf("to another machine or compiler, test that the accuracy is\n");
-	oprntf("sufficient.  \n\n");
-	oprntf("I cannot guarantee that this program is bug-free, and caution\n");
-   /* although at this time I really don't know of any bugs ... ! */
-	oprntf("that not all routines are thoroughly precise and rigorous.\n");
-	oprntf("The user of this program is responsible for interpreting \n");
-	oprntf("results correctly.  I disavow any legal liability for damages\n");
-	oprntf("caused by use of this program.\n\n");
-	oprntf("Program copyright 1993, John Thorstensen, Dartmouth College\n");
-	oprntf("Permission hereby granted for scientific/educational use.\n");
-	oprntf("Commercial users must license.  Please communicate problems or\n");
-	oprntf("suggestions to the author, John Thorstensen, Dept. Physics\n");
-	oprntf("and Astronomy, Dartmouth College, Hanover NH 03755\n");
-	oprntf("John.Thorstensen@Dartmouth.edu\n");
-	oprntf("\nType command, or ? to see menu again.:");
+	char *p, *end;
+	double *x;
+
+/* reads the number in the field starting at p; returns a pointer
+   just past the field, or NULL if the field isn't a number.  Plain
+   decimals of up to 15 digits are converted by dividing the integer
+   of the digits by an exact power of ten, which rounds correctly
+   and so gives exactly what scanf does; anything else is handed to
+   strtod. */
+
+{
+	static double pow10[] = {1.,1.e1,1.e2,1.e3,1.e4,1.e5,1.e6,1.e7,
+		1.e8,1.e9,1.e10,1.e11,1.e12,1.e13,1.e14,1.e15};
+	char *q, *stop, tok[64];
+	double mant = 0.;
+	int neg = 0, ndig = 0, nfrac = 0, frac = 0;
+
+	q = p;
+	if(q < end && (*q == '-' || *q == '+')) neg = (*q++ == '-');
+	for( ; q < end; q++) {
+		if(*q >= '0' && *q <= '9') {
+			if(ndig == 15) goto SLOW;
+			mant = 10. * mant + (*q - '0');
+			ndig++;
+			nfrac += frac;
+		}
+		else if(*q == '.' && frac == 0) frac = 1;
+		else break;
+	}
+	if(ndig == 0 || (q < end && !catalog_blank(*q) && *q != '\n'))
+		goto SLOW;
+	*x = mant / pow10[nfrac];
+	if(neg) *x = -*x;
+	return(q);
+
+   SLOW:
+	for(q = p; q < end && !catalog_blank(*q) && *q != '\n'; q++) ;
+	if(q - p >= (long) sizeof(tok)) return(NULL);
+	memcpy(tok,p,q - p);
+	tok[q - p] = '\0';
+	*x = strtod(tok,&stop);
+	if(stop == tok || *stop != '\0') return(NULL);
+	return(q);
 }
 
-void print_legalities()
+char *catalog_line(p,end,ob)
+
+	char *p, *end;
+	struct objct *ob;
+
+/* parses the object list line starting at p -- see read_obj_list_r
+   for the format -- into ob.  Returns a pointer to the start of the
+   next line, with ob->name[0] set to '\0' if the line was bad.
+   A missing or unreadable optional number gives xtra = 99.9. */
 
 {
-	printf("\nThis has been superseded -- this shouldn't print out.\n");
+	char *q, *stop, tok[64];
+	double f[7];
+	int i, decneg = 0;
+
+	ob->name[0] = '\0';
+	while(p < end && catalog_blank(*p)) p++;
+	for(q = p; q < end && !catalog_blank(*q) && *q != '\n'; q++) ;
+	if(q == p) goto NEXT;     /* blank line */
+	i = (q - p < (long) sizeof(ob->name)) ? (int) (q - p) :
+		(int) sizeof(ob->name) - 1;
+	memcpy(ob->name,p,i);
+	ob->name[i] = '\0';
+	p = q;
+
+	for(i = 0; i < 7; i++) {   /* hr mn sec  deg mn sec  epoch */
+		while(p < end && catalog_blank(*p)) p++;
+		if(p == end || *p == '\n') break;
+		if(i == 3) decneg = (*p == '-');   /* careful with "-0" */
+		if((q = catalog_num(p,end,f+i)) == NULL) break;
+		p = q;
+	}
+	if(i < 7) {
+		ob->name[0] = '\0';
+		goto NEXT;
+	}
+	ob->ra = f[0] + f[1]/60. + f[2]/3600.;
+	if(decneg) {
+		if(f[3] <= 0.) f[3] = f[3] * -1.;
+		ob->dec = -1.* (f[3] + f[4]/60. + f[5]/3600.);
+	}
+	else ob->dec = f[3] + f[4]/60. + f[5]/3600.;
+	ob->ep = f[6];
+
+	/* the optional user number -- read as a float, as scanf would */
+	ob->xtra = 99.9;
+	while(p < end && catalog_blank(*p)) p++;
+	for(q = p; q < end && !catalog_blank(*q) && *q != '\n'; q++) ;
+	if(q > p && q - p < (long) sizeof(tok)) {
+		memcpy(tok,p,q - p);
+		tok[q - p] = '\0';
+		ob->xtra = strtof(tok,&stop);
+		if(stop == tok) ob->xtra = 99.9;
+	}
+	p = q;
+
+   NEXT:
+	while(p < end && *p != '\n') p++;
+	return(p < end ? p + 1 : end);
 }
 
+int catalog_parse(cat,text,len,verbose,nbad)
 
-void ephemgen(ra, dec, ep, lat, longit)
-	double ra, dec, ep, lat, longit;
+	struct catalog *cat;
+	char *text;
+	size_t len;
+	int verbose;
+	int *nbad;
+
+/* adds the objects in len characters of text -- lines in the
+   read_obj_list_r format -- to cat.  Bad lines are counted in
+   *nbad (if nbad isn't NULL) and, if verbose, printed.  Returns
+   the number of objects added, or -1 if memory ran out. */
 
 {
+	char *p, *next, *end;
+	int n0 = cat->n;
 
-/* Prompts for elements of an ephemeris, then
-   generates a printout of the *geocentric*
-   ephemeris of an object.  Uses current values of ra and dec;
-   ignores observatory parameters, which are much more important
-   for velocity than for time.  Not *strictly* correct in that
-   earth's position in helio-to-geo conversion is computed (strictly
-   speaking) for heliocentric jd, while ephemeris is for (presumably)
-   geocentric jd.  This makes a difference of at most 30 km/s  over c,
-   or about 1 in 10**4, for the heliocentric correction.  Pretty trivial.
+	p = text;
+	end = text + len;
+	while(p < end) {
+		if(cat->n >= cat->cap && catalog_reserve(cat,cat->n + 1) < 0)
+			return(-1);
+		next = catalog_line(p,end,cat->objs + cat->n + 1);
+		if(cat->objs[cat->n + 1].name[0] != '\0') cat->n++;
+		else {
+			if(nbad != NULL) (*nbad)++;
+			if(verbose) printf("Ignoring bad line: %.*s",
+				(int) (next - p),p);
+		}
+		p = next;
+	}
+	if(cat->n != n0) catalog_touch(cat);
+	return(cat->n - n0);
+}
 
-   Observatory paramaters are used in determining observability of
-   phenomenon.
-*/
+int catalog_load_fp(cat,fp,verbose,nbad)
 
-  double t0=0., per; /* ephemeris -- t0 + per * cycle count */
-  int ibeg, iend, cycles;
-  double curra, curdec, curep;
-  double max_secz, min_alt, max_alt, min_ok_alt, sun_alt, max_ok_sun, secz;
-  double sid, ha, altitude, az, rasun, decsun, hasun;
-  double jd, jdstart, jdend, tcor, vcor;
-  struct date_time tempdate;
-  int valid_date = 0;
-  short dow;
+	struct catalog *cat;
+	FILE *fp;
+	int verbose;
+	int *nbad;
+
+/* adds the objects from an open file to cat, starting at the file's
+   current position.  A regular file is mapped into memory and parsed
+   in place; anything else (a pipe, say) is read through a buffer.
+   Returns the number added, or -1 on a read error or if memory ran
+   out -- the objects read until then are kept.  See catalog_parse. */
+
+{
+	struct stat st;
+	char *map, *buf, *nbuf, *p;
+	size_t size = CATALOG_READBUF, have = 0, got;
+	long off;
+	int n, ntot = 0, fd;
+
+	fd = fileno(fp);
+	off = ftell(fp);
+	if(off >= 0 && fstat(fd,&st) == 0 && S_ISREG(st.st_mode)) {
+		if(st.st_size <= off) return(0);
+		map = (char *) mmap(NULL,(size_t) st.st_size,PROT_READ,
+			MAP_PRIVATE,fd,0);
+		if(map != (char *) MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+			madvise(map,(size_t) st.st_size,MADV_SEQUENTIAL);
+#endif
+			n = catalog_parse(cat,map + off,
+				(size_t) (st.st_size - off),verbose,nbad);
+			munmap(map,(size_t) st.st_size);
+			fseek(fp,0L,SEEK_END);
+			return(n);
+		}
+	}
+
+	/* can't map it -- read it a buffer at a time, parsing the
+	   complete lines and carrying the partial one over. */
+	if((buf = (char *) malloc(size)) == NULL) return(-1);
+	for(;;) {
+		if(have == size) {   /* a line longer than the buffer */
+			if((nbuf = (char *) realloc(buf,2 * size)) == NULL) {
+				ntot = -1;
+				break;
+			}
+			buf = nbuf;
+			size *= 2;
+		}
+		got = fread(buf + have,1,size - have,fp);
+		if(got == 0) {   /* end of file -- the last line, if any */
+			if(ferror(fp)) ntot = -1;
+			else if(have > 0) {
+				n = catalog_parse(cat,buf,have,verbose,nbad);
+				ntot = n < 0 ? -1 : ntot + n;
+			}
+			break;
+		}
+		have += got;
+		for(p = buf + have; p > buf && p[-1] != '\n'; p--) ;
+		if(p == buf) continue;   /* no complete line yet */
+		if((n = catalog_parse(cat,buf,p - buf,verbose,nbad)) < 0) {
+			ntot = -1;
+			break;
+		}
+		ntot += n;
+		have -= p - buf;
+		memmove(buf,p,have);
+	}
+	free(buf);
+	return(ntot);
+}
 
-  printf("Prints geocentric times of repeating phenom, e.g. stellar eclipses.\n");
-  printf("Not suitable for very short periods (seconds) -- too many events.\n");
-  printf("You may optionally specify that only events observable from your site\n");
-  printf("be printed.\n\n");
-  printf("Give heliocentric period, days; negative exits:");
-  scanf("%lf",&per);
-  if(per < 0.) return;
-  printf("Give heliocentric jd of time zero, *all* the digits!:");
-  scanf("%lf",&t0);
-  if(t0 < 2000000.) {
-	printf("Exiting -- JD *has* to be greater than 2 million!\n");
-	return;
-  }
-  printf("Give starting UT date for listing, yyyy mm dd, neg year exits:");
-  if((valid_date = get_date(&tempdate)) < 0) return;
-/*  printf("Give starting ut, h m s:");
-  get_time(&tempdate);   Too much of pain to enter .. force to ut = 0 */
-  tempdate.h = 0.;
-  tempdate.mn = 0.;
-  tempdate.s = 0.;
-  jdstart = date_to_jd(tempdate);
-  printf("Give ending date for listing:");
-  get_date(&tempdate);
-/*  printf("Give ending time:");
-  get_time(&tempdate);  */
-  jdend = date_to_jd(tempdate);
-  printf("Give maximum airmass for listing, negative to print all:");
-  scanf("%lf",&max_secz);
-  if(max_secz > 0.) min_ok_alt = 90. - DEG_IN_RADIAN * acos(1/max_secz);
-  else min_ok_alt = -100.;
-  curep = 2000. + (jdstart - J2000)/365.25;    /* precess to check observ. */
-  precrot(ra,dec,ep,curep,&curra,&curdec);
-  min_max_alt(lat,curdec,&min_alt,&max_alt);
-  if(max_alt < min_ok_alt) {
-  oprntf("Object never rises this high -- max alt %5.1f deg -- returning!\n",
-           max_alt);
-	return;
-  }
+int catalog_load(cat,fname,verbose,nbad)
 
-  printf("Give maximum allowable sun altitude to print, 90 to print all:");
-  scanf("%lf",&max_ok_sun);
+	struct catalog *cat;
+	char *fname;
+	int verbose;
+	int *nbad;
 
-  oprntf("\nObject RA = ");
-  put_coords(ra,3);
-  oprntf(", dec = ");
-  put_coords(dec,2);
-  oprntf(" epoch %6.1f\n",ep);
-  oprntf("Site long = ");
-  put_coords(longit,3);
-  oprntf("W (hr.mn.sec), lat = ");
-  put_coords(lat,2);
-  oprntf("N \n");
-  oprntf("\nEphemeris: %lf + %14.8f E (Heliocentric)\n\n",t0, per);
-  oprntf("Listing of events in interval from ");
-  print_calendar(jdstart,&dow);
-  oprntf(" UT to ");
-  print_calendar(jdend,&dow);
-  oprntf(" UT.\n");
-  if(min_ok_alt > 0.) oprntf("Only events at sec(z) < %5.2f are shown.\n",
-        max_secz);
-  if(max_ok_sun < 89.)
-	oprntf("Only events with sun altit. < %6.1f degrees are shown.\n\n",
-	max_ok_sun);
-  oprntf("First columns show cycle number, GEOCENTRIC jd, date and time (UT);\n");
-  oprntf("Last show HA, sec(z), 'ngt' if night, sun alt if twilit, 'day' if day.\n\n");
-  ibeg = (jdstart - t0) / per;  /* truncate */
-  iend = (jdend - t0) / per;    /* truncate again */
+/* adds the objects in file fname to cat; returns the number added,
+   or -1 if the file won't open (or as for catalog_load_fp). */
 
-  for(cycles = ibeg; cycles <= iend; cycles++) {
- 	jd = t0 + (double) cycles * per;
-	curep = 2000. + (jd - J2000)/365.25;    /* precess to current */
-        precrot(ra,dec,ep,curep,&curra,&curdec);
-	helcor(jd, curra, curdec, 0., 0., 0., &tcor, &vcor);
-/*      oprntf("Raw = %12.4f, Correction: %f\n",jd,tcor);   diagnostic */
-        jd = jd - tcor / SEC_IN_DAY;  /* subtract to convert to geo .*/
-        sid = lst(jd,longit);
-        ha = adj_time(sid - curra);
-        altitude = altit(curdec,ha,lat,&az);
-	secz = secant_z(altitude);
-        if(altitude >= min_ok_alt) {
-           lpsun(jd,&rasun,&decsun);  /* lpsun plenty good enough */
-	   hasun = lst(jd,longit) - rasun;
-	   sun_alt = altit(decsun,hasun,lat,&az);
-           if(sun_alt < max_ok_sun) {
-              oprntf("# %d  JD(geo) %12.4f = ",cycles,jd);
-	      print_calendar(jd,&dow);
-	      oprntf(", ");
-              print_time(jd,3);
-	      oprntf(" UT");
-	      put_coords(ha,0);
-	      if((secz < 10.) && (secz > 0.)) oprntf(" %5.2f",secz);
-              else if (secz > 0.) oprntf(" v.low");
-	      else oprntf(" down!");
-	      if(sun_alt <= -18.) oprntf(" ngt");
-	      else if(sun_alt <= -0.53) oprntf(" %3.0f",sun_alt);
-	      else oprntf(" day");
-	      oprntf("\n");
-	   }
-       }
-  }
-  oprntf("Listing done.  Type ? if you need a menu.\n");
+{
+	FILE *fp;
+	int n;
+
+	if((fp = fopen(fname,"r")) == NULL) return(-1);
+	n = catalog_load_fp(cat,fp,verbose,nbad);
+	fclose(fp);
+	return(n);
 }
 
-#define ALT_3  19.47  /* 19.47 degrees altitude => sec z = 3 */
-#define ALT_2  30.
-#define ALT_15 41.81
-#define SID_RATE 1.0027379093  /* sidereal / solar rate */
+void catindex_swap(ix,i,j)
 
-double hrs_up(jdup, jddown, jdeve, jdmorn)
+	struct catindex *ix;
+	int i, j;
 
-	double jdup, jddown, jdeve, jdmorn;
 {
+	double t;
+	int k, tid;
 
-   /* If an object comes up past a given point at jdup,
-      and goes down at jddown, and evening and morning
-      are at jdeve and jdmorn, computes how long
-      object is up *and* it's dark.  ... Written as
-      function 'cause it's done three times below. */
+	for(k = 0; k < 3; k++) {
+		t = ix->xyz[3*i+k];
+		ix->xyz[3*i+k] = ix->xyz[3*j+k];
+		ix->xyz[3*j+k] = t;
+	}
+	tid = ix->id[i];
+	ix->id[i] = ix->id[j];
+	ix->id[j] = tid;
+}
 
-   double jdup2, jddown0;  /* for the next ... or previous ...
-                            time around */
+void catindex_select(ix,lo,hi,k,axis)
 
-   if(jdup < jdeve) {
-     if(jddown >= jdmorn)   /* up all night */
-	return ((jdmorn - jdeve) * 24.);
-     else if(jddown >= jdeve)  {
-	/* careful here ... circumpolar objects can come back *up*
-	   a second time before morning.  jdup and jddown are
-	   the ones immediately preceding and following the upper
-	   culmination nearest the center of the night, so "jdup"
-	   can be on the previous night rather than the one we want. */
-       jdup2 = jdup + 1.0/SID_RATE;
-       if(jdup2 > jdmorn)  /* the usual case ... doesn't rise again */
-	   return ((jddown - jdeve) * 24.);
-       else return(((jddown - jdeve) + (jdmorn - jdup2)) * 24.);
-     }
-     else return(0.);
-   }
-   else if(jddown > jdmorn) {
-     if(jdup >= jdmorn) return(0.);
-     else {
-	/* again, a circumpolar object can be up at evening twilight
-	    and come 'round again in the morning ... */
-        jddown0 = jddown - 1.0/SID_RATE;
-	if(jddown0 < jdeve) return((jdmorn - jdup) * 24.);
-        else return(((jddown0 - jdeve) + (jdmorn - jdup)) * 24.);
-     }
-   }
-   else return((jddown - jdup)*24.);  /* up & down the same night ...
-      might happen a second time in pathological cases, but this will
-      be extremely rare except at very high latitudes.  */
+	struct catindex *ix;
+	int lo, hi, k, axis;
+
+/* rearranges entries lo through hi-1 so that entry k is the one
+   that would be there if they were sorted on axis, with none larger
+   before it and none smaller after (Hoare's selection). */
+
+{
+	double pivot;
+	int i, j;
+
+	while(hi - lo > 1) {
+		pivot = ix->xyz[3*((lo + hi) / 2) + axis];
+		i = lo;
+		j = hi - 1;
+		while(i <= j) {
+			while(ix->xyz[3*i+axis] < pivot) i++;
+			while(ix->xyz[3*j+axis] > pivot) j--;
+			if(i <= j) catindex_swap(ix,i++,j--);
+		}
+		if(k <= j) hi = j + 1;
+		else if(k >= i) lo = i;
+		else return;
+	}
 }
 
-void print_air(secz,prec)
-    	double secz;
-	short prec;
+void catindex_split(ix,lo,hi,depth)
+
+	struct catindex *ix;
+	int lo, hi, depth;
+
+/* builds the tree over entries lo through hi-1. */
+
 {
-   if((secz > 0.) && (secz < 100.)) {
-	if(prec == 0) oprntf(" %5.1f ",secz);
-	         else oprntf(" %5.2f ",secz);
-   }
-   else if(secz > 0.) oprntf(" v.low ");
-   else if(secz < 0.) oprntf("  down ");
+	int mid;
+
+	if(hi - lo <= 1) return;
+	mid = (lo + hi) / 2;
+	catindex_select(ix,lo,hi,mid,depth % 3);
+	catindex_split(ix,lo,mid,depth + 1);
+	catindex_split(ix,mid + 1,hi,depth + 1);
 }
 
-void print_ha_air(ha,secz,prec1,prec2)
-	double ha, secz;
-	short prec1, prec2;
+void catindex_free(ix)
+
+	struct catindex *ix;
+
 {
- 	put_coords(ha,prec1);
-	oprntf(" ");
-	print_air(secz,prec2);
+	free(ix->xyz);
+	free(ix->id);
+	ix->xyz = NULL;
+	ix->id = NULL;
+	ix->n = 0;
 }
 
-void obs_season(ra, dec, epoch, lat, longit)
+int catindex_build_r(ctx,cat,epoch,ix)
 
-   double ra, dec, epoch, lat, longit;
+	struct skycalc_ctx *ctx;
+	struct catalog *cat;
+	double epoch;
+	struct catindex *ix;
 
-/* prints a table of observability through an observing
-   season.  The idea is to help the observer come up
-   with an accurately computed "range of acceptable
-   dates", to quote NOAO proposal forms ... */
+/* indexes the objects in cat, precessed to epoch.  Returns 0, or
+   -1 if out of memory (leaving ix empty).  The index doesn't follow
+   later changes to the catalog; catindex_current tells whether it
+   needs rebuilding. */
 
 {
-   int valid_date, nlun, nph, nch;
-   char obj_name[40];
-   short dow;
-   double sun_twi;
-   double jdstart, jdend, jd, jdtrunc, jdevedate;
-   double jdmid, jdcent, jdeve, jdmorn, midnfrac;
-   double steve,stmid,stcent,stmorn;
-   double hatwi, hasun, hacent, haeve, hamorn;
-   double seczcent, seczeve, seczmorn;
-   double dt15,dt2,dt3;
-   double jdtrans, jd3_1, jd3_2, jd2_1, jd2_2,
-	  jd15_1, jd15_2, rasun, decsun;
-   double hrs_3, hrs_2, hrs_15;
-   double min_alt, max_alt, altitude, az;
-   double curep, curra, curdec;
-   struct date_time tempdate;
+	struct objct *ob;
+	double ra, dec;
+	int i;
 
-   printf("This types out a summary of the observability of your object\n");
-   printf("through the observing season.  Observability is summarized\n");
-   printf("at new & full moon through a range of dates you specify.\n");
-   printf("(a 24-line display holds about a 6-month range.)\n\n");
-   if(fabs(lat) > 70.) {
-	oprntf("NOTE: The site's geographical latitude is so high that there's\n");
-	oprntf("a possibility that 'darkness' will last all day (depending\n");
-        oprntf("on how you define the end of twilight below.)  In this case\n");
-	oprntf("the HA and sec z at 'twilight' will be for +-12 hours from\n");
-	oprntf("sun's lower culmination.\n\n");
-   }
+	ix->epoch = epoch;
+	ix->n = 0;
+	ix->gen = cat->gen;
+	ix->xyz = (double *) malloc((size_t) (cat->n > 0 ? cat->n : 1) *
+		3 * sizeof(double));
+	ix->id = (int *) malloc((size_t) (cat->n > 0 ? cat->n : 1) * sizeof(int));
+	if(ix->xyz == NULL || ix->id == NULL) {
+		catindex_free(ix);
+		return(-1);
+	}
+	for(i = 0; i < cat->n; i++) {
+		ob = cat->objs + i + 1;
+		if(ob->ep != epoch)
+			precrot_r(ctx,ob->ra,ob->dec,ob->ep,epoch,&ra,&dec);
+		else {
+			ra = ob->ra;
+			dec = ob->dec;
+		}
+		cel_unit(ra,dec,ix->xyz + 3*i);
+		ix->id[i] = i + 1;
+	}
+	ix->n = cat->n;
+	catindex_split(ix,0,ix->n,0);
+	return(0);
+}
 
-   printf("Give approx. starting date, yyyy mm dd, neg year exits:");
+int catindex_build(cat,epoch,ix)
 
-  if((valid_date = get_date(&tempdate)) < 0) return;
-  tempdate.h =  0.;
-  tempdate.mn = 0.;
-  tempdate.s = 0.;
-  jdstart = date_to_jd(tempdate);
-  printf("Give ending date for listing:");
-  if((valid_date = get_date(&tempdate)) < 0) return;
-  jdend = date_to_jd(tempdate);
-  printf("You must now specify the altitude of the sun which defines twilight.\n");
-  printf("Type -18. , or give a non-standard choice:");
-  scanf("%lf",&sun_twi);
+	struct catalog *cat;
+	double epoch;
+	struct catindex *ix;
+{
+	return(catindex_build_r(&skycalc_default_ctx,cat,epoch,ix));
+}
 
-  printf("Name of object:");     /* for labeling redirected output */
-  nch = get_line(obj_name);
+int catindex_current(ix,cat)
 
-  jd = jdstart - lun_age(jdstart,&nlun);
-  nph = 0;  /* jd is adjusted to last previous new moon */
+	struct catindex *ix;
+	struct catalog *cat;
 
-  jdcent = (jd + jdend) / 2.;  /* temporary use of var */
-  curep = 2000. + (jdcent - J2000)/365.25;    /* precess to check observ. */
-  precrot(ra,dec,epoch,curep,&curra,&curdec);
-  min_max_alt(lat,curdec,&min_alt,&max_alt);
+/* 1 if ix was built from cat as it stands now, 0 if cat has changed
+   since, ix was built from some other catalog, or ix is NULL.  (All
+   newly set up catalogs have generation 0, but they are empty, as is
+   any index of one, so the index can't mislead.) */
 
-  oprntf("\n          *** Seasonal Observability of %s ***\n",obj_name);
-  oprntf("\n     RA & dec: ");
-  put_coords(ra,3);
-  oprntf(", ");
-  put_coords(dec,2);
-  oprntf(", epoch %6.1f\n", epoch);
-  /*  printf("\nObject RA&dec: ");
-  put_coords(curra,3);
-  oprntf(", ");
-  put_coords(curdec,2);
-  oprntf(", epoch %6.1f\n", curep);  */
+{
+	return(ix != NULL && ix->gen == cat->gen && ix->n == cat->n);
+}
 
-  oprntf("Site long&lat: ");
-  put_coords(longit,3);
-  oprntf(" (h.m.s) West, ");
-  put_coords(lat,2);
-  oprntf(" North.\n\n");
+void catindex_query_r(ctx,ix,ra,dec,epoch,q)
 
+	struct skycalc_ctx *ctx;
+	struct catindex *ix;
+	double ra, dec, epoch, *q;
 
-  if(max_alt < ALT_15)
-    oprntf("NOTE -- This object is always at sec.z > %5.2f\n",
-	1./cos((90. - max_alt) / DEG_IN_RADIAN));
-  if(min_alt > ALT_3)
-    oprntf("NOTE -- This object is always at sec.z < %5.2f\n",
-	1./cos((90. - min_alt) / DEG_IN_RADIAN));
+/* the unit vector of ra and dec (at epoch) at the index's epoch. */
 
-  oprntf("Shown: local eve. date, moon phase, hr ang and sec.z at (1) eve. twilight,\n");
-  oprntf("(2) natural center of night, and (3) morning twilight; then comes number of\n");
-  oprntf("nighttime hours during which object is at sec.z less than 3, 2, and 1.5.\n");
-  oprntf("Night (and twilight) is defined by sun altitude < %4.1f degrees.\n\n",sun_twi);
+{
+	if(epoch != ix->epoch)
+		precrot_r(ctx,ra,dec,epoch,ix->epoch,&ra,&dec);
+	cel_unit(ra,dec,q);
+}
 
-  oprntf(" Date (eve) moon      eve            cent           morn");
-  oprntf("     night hrs@sec.z:\n");
-  oprntf("                   HA  sec.z      HA  sec.z      HA  sec.z");
-  oprntf("     <3   <2   <1.5\n");
+void catindex_knn(ix,lo,hi,depth,q,k,hd,hid,nh)
+
+	struct catindex *ix;
+	int lo, hi, depth;
+	double *q;
+	int k;
+	double *hd;
+	int *hid, *nh;
+
+/* the k-nearest search over entries lo through hi-1.  hd and hid
+   hold the best *nh so far as a heap, farthest first; distances
+   are squared chords. */
+
+{
+	double *p, d2, diff, t;
+	int mid, axis, i, c, ti;
+
+	while(lo < hi) {
+		mid = (lo + hi) / 2;
+		p = ix->xyz + 3*mid;
+		d2 = (q[0]-p[0])*(q[0]-p[0]) + (q[1]-p[1])*(q[1]-p[1]) +
+			(q[2]-p[2])*(q[2]-p[2]);
+		if(*nh < k) {   /* not full -- sift the new one up */
+			i = (*nh)++;
+			hd[i] = d2;
+			hid[i] = ix->id[mid];
+			while(i > 0 && hd[(i-1)/2] < hd[i]) {
+				c = (i-1)/2;
+				t = hd[c]; hd[c] = hd[i]; hd[i] = t;
+				ti = hid[c]; hid[c] = hid[i]; hid[i] = ti;
+				i = c;
+			}
+		}
+		else if(d2 < hd[0]) {   /* replace the farthest, sift down */
+			hd[0] = d2;
+			hid[0] = ix->id[mid];
+			i = 0;
+			while((c = 2*i + 1) < k) {
+				if(c + 1 < k && hd[c+1] > hd[c]) c++;
+				if(hd[c] <= hd[i]) break;
+				t = hd[c]; hd[c] = hd[i]; hd[i] = t;
+				ti = hid[c]; hid[c] = hid[i]; hid[i] = ti;
+				i = c;
+			}
+		}
+		axis = depth % 3;
+		diff = q[axis] - p[axis];
+		depth++;
+		/* search the near side, then loop on the far one if
+		   it can still hold something closer. */
+		if(diff < 0.) {
+			catindex_knn(ix,lo,mid,depth,q,k,hd,hid,nh);
+			if(*nh == k && diff*diff >= hd[0]) return;
+			lo = mid + 1;
+		}
+		else {
+			catindex_knn(ix,mid + 1,hi,depth,q,k,hd,hid,nh);
+			if(*nh == k && diff*diff >= hd[0]) return;
+			hi = mid;
+		}
+	}
+}
+
+int catindex_nearest_r(ctx,ix,ra,dec,epoch,k,id,dist)
 
+	struct skycalc_ctx *ctx;
+	struct catindex *ix;
+	double ra, dec, epoch;
+	int k;
+	int *id;
+	double *dist;
 
-  while(jd <= jdend) {
-       if(nph == 0) nph = 2;
-       else if(nph == 2) {
-	  nlun++;
-	  nph = 0;
-       }
-       flmoon(nlun,nph,&jd);
-
-       /* Take care to compute for the date nearest full or new ...
-	  people may use this as a lunar calendar, which it sort of
-	  isn't. */
-
-       midnfrac = 0.5 + longit/24.;  /* rough fractional part of jd
-		       for local midnight ... */
-       jdtrunc = (double)((long) jd);
-       jdmid = jdtrunc + midnfrac;
-       if((jd - jdmid) > 0.5) jdmid = jdmid + 1.;
-       else if((jd - jdmid) < -0.5) jdmid = jdmid - 1.;
-
-       lpsun(jdmid,&rasun,&decsun);
-       hasun = adj_time(lst(jdmid,longit) - rasun); /* at rough midn. */
-       if(hasun > 0.) jdcent = jdmid + (12. - hasun) / 24.;
-       else jdcent = jdmid - (hasun + 12.) / 24.;
-	  /* jdcent is very close to sun's lower culmination
-	      -- natural center of night */
-
-       hatwi = ha_alt(decsun,lat,sun_twi);
-       if(hatwi > 100.) {
-	      jdeve = -1.;    /* signal -- no twilight */
-              jdmorn = -1.;
-       }
+/* finds the k objects nearest ra and dec (at epoch).  Their catalog
+   indices go in id[0] through id[k-1], nearest first, and their
+   distances (radians, as from subtend) in dist.  Returns the number
+   found -- k, unless the index holds fewer. */
 
-       else {
-	  if(hatwi < -100.) {  /* always night */
-	        jdeve = jdcent - 0.5; /* sensible, anyway  */
-	        jdmorn = jdcent + 0.5;
-          }
-          else {
-		jdmorn = jd_sun_alt(sun_twi,(jdcent +(12.-hatwi)/24.),
-	           lat,longit);
-          	jdeve = jd_sun_alt(sun_twi,(jdcent - (12.-hatwi)/24.),
-	           lat,longit);
-          }
-          haeve = adj_time(lst(jdeve,longit) - curra);
-          altitude = altit(curdec,haeve,lat,&az);
-	  seczeve = secant_z(altitude);
-
-          hamorn = adj_time(lst(jdmorn,longit) - curra);
-          altitude = altit(curdec,hamorn,lat,&az);
-	  seczmorn = secant_z(altitude);
-       }
+{
+	double q[3], t;
+	int nh = 0, ti, i, c, m;
+
+	if(k > ix->n) k = ix->n;
+	if(k <= 0) return(0);
+	catindex_query_r(ctx,ix,ra,dec,epoch,q);
+	catindex_knn(ix,0,ix->n,0,q,k,dist,id,&nh);
+
+	/* the heap to nearest-first order, farthest popped to the end */
+	for(m = nh - 1; m > 0; m--) {
+		t = dist[0]; dist[0] = dist[m]; dist[m] = t;
+		ti = id[0]; id[0] = id[m]; id[m] = ti;
+		i = 0;
+		while((c = 2*i + 1) < m) {
+			if(c + 1 < m && dist[c+1] > dist[c]) c++;
+			if(dist[c] <= dist[i]) break;
+			t = dist[c]; dist[c] = dist[i]; dist[i] = t;
+			ti = id[c]; id[c] = id[i]; id[i] = ti;
+			i = c;
+		}
+	}
+	for(i = 0; i < nh; i++) dist[i] = 2. * asin(0.5 * sqrt(dist[i]));
+	return(nh);
+}
 
-       hacent = adj_time(lst(jdcent,longit) - curra);
-       altitude = altit(curdec,hacent,lat,&az);
-       seczcent = secant_z(altitude);
-
-       jdtrans = jdcent - hacent / (SID_RATE * 24.);
-	  /* this will be the transit nearest midnight */
-       if((min_alt < ALT_3) && (max_alt > ALT_3)) {
-	 /* if it makes sense to compute the times when
-	    this object passes three airmasses ... */
-	  dt3 = ha_alt(curdec,lat,ALT_3) / (SID_RATE * 24.);
-	  jd3_1 = jdtrans - dt3;
-	  jd3_2 = jdtrans + dt3;
-       }
-       else {
-	  jd3_1 = 0.;  jd3_2 = 0.;
-       }
-        if((min_alt < ALT_2) && (max_alt > ALT_2)) {
-	 /* if it makes sense to compute the times when
-	    this object passes two airmasses ... */
-	  dt2 = ha_alt(curdec,lat,ALT_2) / (SID_RATE * 24.);
-	  jd2_1 = jdtrans - dt2;
-	  jd2_2 = jdtrans + dt2;
-       }
-       else {
-	  jd2_1 = 0.;  jd2_2 = 0.;
-       }
-       if((min_alt < ALT_15) && (max_alt > ALT_15)) {
-	 /* if it makes sense to compute the times when
-	    this object passes 1.5 airmasses ... */
-	  dt15 = ha_alt(curdec,lat,ALT_15) / (SID_RATE * 24.);
-	  jd15_1 = jdtrans - dt15;
-	  jd15_2 = jdtrans + dt15;
-       }
-       else {
-	  jd15_1 = 0.;  jd15_2 = 0.;
-       }
+int catindex_nearest(ix,ra,dec,epoch,k,id,dist)
 
-   /* Now based on times of twilight and times at which object
-      passes the airmass points, figure out how long the object
-      is up at night ... */
-
-      if(jdeve > 0.) {  /* if twilight occurs ... */
-         if(jd2_1 != 0.)
-	   hrs_2 = hrs_up(jd2_1, jd2_2,jdeve,jdmorn);
-         else if(min_alt > ALT_2)
-	   hrs_2 = 24. * (jdmorn - jdeve);  /* always up ... */
-         else hrs_2 = 0.;                   /* never up ... */
-
-         if(jd3_1 != 0.)
-	   hrs_3 = hrs_up(jd3_1, jd3_2,jdeve,jdmorn);
-         else if(min_alt > ALT_3)
-	   hrs_3 = 24. * (jdmorn - jdeve);
-         else hrs_3 = 0.;
-
-         if(jd15_1 != 0.)
-           hrs_15 = hrs_up(jd15_1, jd15_2,jdeve,jdmorn);
-         else if(min_alt > ALT_15)
-	   hrs_15 = 24. * (jdmorn - jdeve);
-         else hrs_15 = 0.;
-      }
-      else if(jdeve > -500.) {  /* twilight all night */
-	  hrs_2 = 0.;
-	  hrs_3 = 0.;
-	  hrs_15 = 0.;
-      }
+	struct catindex *ix;
+	double ra, dec, epoch;
+	int k;
+	int *id;
+	double *dist;
+{
+	return(catindex_nearest_r(&skycalc_default_ctx,ix,ra,dec,epoch,k,id,dist));
+}
 
+void catindex_walk(ix,lo,hi,depth,q,c2,maxn,id,dist,nfound)
 
-       /* now print the table itself.  Take pains to
-	  get the correct *evening* date .... */
+	struct catindex *ix;
+	int lo, hi, depth;
+	double *q, c2;
+	int maxn;
+	int *id;
+	double *dist;
+	int *nfound;
 
-       jdevedate = jdcent - longit/24. - 0.25;
-       planet_alert(jdcent,curra,curdec,PLANET_TOL);
-         /* better know about it ... */
+/* the cone search over entries lo through hi-1; c2 is the squared
+   chord of the radius. */
 
-       print_calendar(jdevedate,&dow);
+{
+	double *p, d2, diff;
+	int mid, axis;
+
+	while(lo < hi) {
+		mid = (lo + hi) / 2;
+		p = ix->xyz + 3*mid;
+		d2 = (q[0]-p[0])*(q[0]-p[0]) + (q[1]-p[1])*(q[1]-p[1]) +
+			(q[2]-p[2])*(q[2]-p[2]);
+		if(d2 <= c2) {
+			if(*nfound < maxn) {
+				id[*nfound] = ix->id[mid];
+				dist[*nfound] = 2. * asin(0.5 * sqrt(d2));
+			}
+			(*nfound)++;
+		}
+		axis = depth % 3;
+		diff = q[axis] - p[axis];
+		depth++;
+		if(diff < 0.) {
+			catindex_walk(ix,lo,mid,depth,q,c2,maxn,id,dist,nfound);
+			if(diff*diff > c2) return;
+			lo = mid + 1;
+		}
+		else {
+			catindex_walk(ix,mid + 1,hi,depth,q,c2,maxn,id,dist,nfound);
+			if(diff*diff > c2) return;
+			hi = mid;
+		}
+	}
+}
 
-       /* space table correctly -- what a pain ! */
-       caldat(jdevedate,&tempdate,&dow);
-       if(tempdate.d < 10) oprntf(" ");
+int catindex_cone_r(ctx,ix,ra,dec,epoch,radius,maxn,id,dist)
 
-       if(nph == 0) oprntf("   N");
-       else oprntf("   F");
-       if(jdeve > 0.) print_ha_air(haeve,seczeve,0,0);
-       else oprntf(" twi.all.nght! ");
-       print_ha_air(hacent,seczcent,0,0);
-       if(jdmorn > 0.) print_ha_air(hamorn,seczmorn,0,0);
-       else oprntf(" twi.all.nght! ");
+	struct skycalc_ctx *ctx;
+	struct catindex *ix;
+	double ra, dec, epoch, radius;
+	int maxn;
+	int *id;
+	double *dist;
 
-       oprntf(" %4.1f  %4.1f  %4.1f \n",hrs_3,hrs_2,hrs_15);
+/* finds the objects within radius (radians) of ra and dec (at
+   epoch).  Up to maxn of them go in id and dist (as for
+   catindex_nearest_r), in no particular order.  Returns how many
+   there are in all, which may be more than maxn. */
 
-   }
-   printf("Listing done.  'f' gives tutorial, '?' prints a menu.\n");
+{
+	double q[3], c;
+	int nfound = 0;
+
+	if(radius >= PI) c = 2.;
+	else c = 2. * sin(0.5 * radius);
+	catindex_query_r(ctx,ix,ra,dec,epoch,q);
+	catindex_walk(ix,0,ix->n,0,q,c*c,maxn,id,dist,&nfound);
+	return(nfound);
 }
 
-#if SYS_CLOCK_OK == 1
-#include <time.h>
-#endif
+int catindex_cone(ix,ra,dec,epoch,radius,maxn,id,dist)
 
-#if SYS_CLOCK_OK == 1
+	struct catindex *ix;
+	double ra, dec, epoch, radius;
+	int maxn;
+	int *id;
+	double *dist;
+{
+	return(catindex_cone_r(&skycalc_default_ctx,ix,ra,dec,epoch,radius,
+		maxn,id,dist));
+}
 
-int get_sys_date(date, use_dst, enter_ut, night_date, stdz, toffset)
+void prox_list_free(pl)
 
-	struct date_time *date;
-	short use_dst, enter_ut, night_date;
-        double stdz, toffset;
+	struct prox_list *pl;
 {
-	/* Reads the system clock; loads up the date structure
-           to conform to the prevailing conventions for the interpretation
-           of times.  Optionally adds "toffset" minutes to the system
-           clock, as in x minutes in the future. */
-
-	time_t t, *tp;
-	struct tm *stm;
-        double jd, jdb, jde;
-        short dow;
+	free(pl->hit);
+	pl->hit = NULL;
+	pl->n = pl->cap = 0;
+}
 
-	tp = &t;  /* have to initialize pointer variable for it to
-                     serve as an argument. */
+int prox_list_add(pl,obj,body,jd,sep)
 
-	t = time(tp);
-	if(t == -1) {
-		oprntf("SYSTEM TIME UNAVAILABLE!  Date & time left alone.\n");
-		return(-1);
-        }
-	stm = localtime(&t);
-	date->y = (short) (stm->tm_year + 1900);
-	date->mo = (short) (stm->tm_mon + 1);
-	date->d = (short) (stm->tm_mday);
-	date->h = (short) (stm->tm_hour);
-	date->mn = (short) (stm->tm_min);
-	date->s = (float) (stm->tm_sec);
+	struct prox_list *pl;
+	int obj, body;
+	double jd, sep;
 
-	if(toffset != 0.) {
-	   jd = date_to_jd(*date);
-	   jd = jd + toffset / 1440.;
-	   caldat(jd,date,&dow);
-        }
+/* appends one hit to pl, growing it as needed.  Returns 0, or -1 if
+   memory runs out. */
 
-        if(enter_ut == 1)  { /* adjust if needed */
-           find_dst_bounds(date->y,stdz,use_dst,&jdb,&jde);
-	   jd = date_to_jd(*date);
-	   jd = jd + zone(use_dst,stdz,jd,jdb,jde)/24.;
-           caldat(jd,date,&dow);
-        }
-	oprntf("\nDATE AND TIME SET AUTOMATICALLY USING SYSTEM CLOCK ... to\n");
-	print_all(date_to_jd(*date));
-	if(enter_ut == 0) oprntf(" local time\n");
-        else oprntf(" Universal time\n");
-      	if((night_date == 1) && (date->h < 12)) {
-		date->d = date->d - 1;
-		oprntf("(night-date is on, so internal value of date set to last evening)\n");
+{
+	struct prox_hit *nhit;
+	int ncap;
+
+	if(pl->n == pl->cap) {
+		ncap = (pl->cap > 0) ? 2 * pl->cap : 64;
+		nhit = (struct prox_hit *) realloc(pl->hit,
+			ncap * sizeof(struct prox_hit));
+		if(nhit == NULL) return(-1);
+		pl->hit = nhit;
+		pl->cap = ncap;
 	}
-	oprntf("(NOTE: time does NOT automatically update; 'T' reads clock again.)\n");
-        return(0); /* success */
+	pl->hit[pl->n].obj = obj;
+	pl->hit[pl->n].body = (short) body;
+	pl->hit[pl->n].jd = jd;
+	pl->hit[pl->n].sep = sep;
+	pl->n++;
+	return(0);
 }
 
-#endif     /* previous routine depends on sys clock */
+int planet_screen_r(ctx,cat,ix,jdstart,jdend,step,tolerance,lat,longit,pl)
 
-void indexx(n,arrin,indx)
+	struct skycalc_ctx *ctx;
+	struct catalog *cat;
+	struct catindex *ix;
+	double jdstart, jdend, step, tolerance, lat, longit;
+	struct prox_list *pl;
 
-/* Sort routine from Press et al., "Numerical Recipes in C",
-  1st edition, Cambridge University Press. */
+/* planet_alert for a whole catalog over a night or a semester.  At
+   each time jdstart, jdstart + step, ... through jdend, the sun, the
+   moon (topocentric, from lat and longit) and the planets are found
+   once, as calc_pposns does, and every object within tolerance
+   (degrees) of any of them is appended to pl (start from a zeroed
+   one) -- time by time, and for each time body by body.  The objects
+   are found from ix, a catalog index of cat (see catindex_build); if
+   ix is NULL or out of date a temporary one is built.  Returns the
+   number of hits added, or -1 if memory runs out. */
 
-int n,indx[];
-float arrin[];
 {
-	int l,j,ir,indxt,i;
-	float q;
-
-	for (j=1;j<=n;j++) indx[j]=j;
-	l=(n >> 1) + 1;
-	ir=n;
-	for (;;) {
-		if (l > 1)
-			q=arrin[(indxt=indx[--l])];
-		else {
-			q=arrin[(indxt=indx[ir])];
-			indx[ir]=indx[1];
-			if (--ir == 1) {
-				indx[1]=indxt;
-				return;
-			}
-		}
-		i=l;
-		j=l << 1;
-		while (j <= ir) {
-			if (j < ir && arrin[indx[j]] < arrin[indx[j+1]]) j++;
-			if (q < arrin[indx[j]]) {
-				indx[i]=indx[j];
-				j += (i=j);
-			}
-			else j=ir+1;
+	struct catindex tmpix;
+	struct planet_posns pp;
+	struct body_posn *bp;
+	int *id, b, k, nf, nstep, n0, ret = 0;
+	double *dist, jd, ep, radius;
+
+	n0 = pl->n;
+	if(cat->n == 0 || step <= 0. || jdend < jdstart) return(0);
+	if(!catindex_current(ix,cat)) {
+		ep = 2000. + (0.5 * (jdstart + jdend) - J2000) / 365.25;
+		if(catindex_build_r(ctx,cat,ep,&tmpix) != 0) return(-1);
+		ix = &tmpix;
+	}
+	id = (int *) malloc(cat->n * sizeof(int));
+	dist = (double *) malloc(cat->n * sizeof(double));
+	if(id == NULL || dist == NULL) ret = -1;
+
+	radius = tolerance / DEG_IN_RADIAN;
+	nstep = (int) ((jdend - jdstart) / step + 1.0e-9) + 1;
+	for(k = 0; k < nstep && ret == 0; k++) {
+		jd = jdstart + k * step;
+		ep = 2000. + (jd - J2000) / 365.25;   /* positions are of date */
+		comp_el_r(ctx,jd);
+		calc_pposns_r(ctx,jd,lat,lst_r(ctx,jd,longit),&pp);
+		for(b = 0; b < SKYEPH_NBODY && ret == 0; b++) {
+			if(b == 3) continue;    /* the earth */
+			if(b == SKYEPH_SUN) bp = &pp.sun;
+			else if(b == SKYEPH_MOON) bp = &pp.moon;
+			else bp = pp.planet + b;
+			nf = catindex_cone_r(ctx,ix,bp->ra,bp->dec,ep,radius,cat->n,
+				id,dist);
+			while(nf-- > 0)
+				if(prox_list_add(pl,id[nf],b,jd,
+				   dist[nf] * DEG_IN_RADIAN) != 0) ret = -1;
 		}
-		indx[i]=indxt;
 	}
+	free(id);
+	free(dist);
+	if(ix == &tmpix) catindex_free(&tmpix);
+	if(ret < 0) return(-1);
+	return(pl->n - n0);
 }
 
-struct objct {
-	char name[20];
-	double ra;
-	double dec;
-	float ep;
-	float xtra;  /* mag, whatever */
-};
+int planet_screen(cat,ix,jdstart,jdend,step,tolerance,lat,longit,pl)
+
+	struct catalog *cat;
+	struct catindex *ix;
+	double jdstart, jdend, step, tolerance, lat, longit;
+	struct prox_list *pl;
+{
+	return(planet_screen_r(&skycalc_default_ctx,cat,ix,jdstart,jdend,step,
+		tolerance,lat,longit,pl));
+}
 
-struct objct objs[MAX_OBJECTS];
-int nobjects;
+int read_obj_list_r(ctx)
 
-int read_obj_list()
+	struct skycalc_ctx *ctx;
 
 /* Reads a list of objects from a file.  Here's the rules:
      -- each line of file  must be formatted as follows:
@@ -5577,23 +11323,19 @@ name   rahr ramn rasec   decdeg decmin decsec   epoch   [optional number]
 
     I chose this format because it's the standard format for
     pointing files at my home institution.  If you'd like to code
-    another format, please be my guest!  */
+    another format, please be my guest!  The parsing itself is done
+    by catalog_load_fp.  */
 
 {
         FILE *inf;
 	char fname[60], resp[10];
-	char buf[200];
-	char decstr[10];
-	double rah, ram, ras, ded, dem, des, ept;
-        int i, nitems;
-	float xtr;
+	int nbad = 0;
 
 	printf("\nThis reads from a file of objects.  Format is as follows,\n\n");
 	printf("name_no_blanks<20char   hr mn sec  deg mn sec  epoch  [opt._user_float]\n\n");
 	printf("with exactly 1 object per line, blanks between fields, otherwise free-form.\n");
         printf("Anything after the optional user-defined floating pt number is ignored.\n");
-	printf("Error checking is unsophisticated; maximum of %d objects.\n\n",
-		(MAX_OBJECTS-1));
+	printf("Error checking is unsophisticated.\n\n");
 	printf("Give name of file of objects (or QUIT):");
 	scanf("%s",fname);
 
@@ -5610,48 +11352,35 @@ name   rahr ramn rasec   decdeg decmin decsec   epoch   [optional number]
 	}
 	else printf("\nopened ... \n");
 
-	if(nobjects != 0) {
-		printf("\nYou have %d objects already!\n",nobjects);
+	if(ctx->cat.n != 0) {
+		printf("\nYou have %d objects already!\n",ctx->cat.n);
 	        printf("Type a to append, or r to replace:");
 		scanf("%s",resp);
-		if(resp[0] == 'r') nobjects = 0;
-	}
-        /*  on first pass be sure xtra's have a value, just in case. */
-        else for(i = 1; i < MAX_OBJECTS; i++) objs[i].xtra = 0.0;
-
-	while((fgets(buf,200,inf) != NULL) && (nobjects < MAX_OBJECTS - 1)) {
-		nobjects++;   /* this will be 1-indexed */
-		nitems = sscanf(buf,"%s %lf %lf %lf  %s %lf %lf  %lf %f",
-			objs[nobjects].name,&rah,&ram,&ras,decstr,&dem,&des,
-				&ept,&xtr);
-		if(nitems >= 8) {  /* a little error checking here ... */
-	             objs[nobjects].ra = rah + ram/60. + ras/3600.;
-		     sscanf(decstr,"%lf",&ded);   /* careful with "-0" */
-		     if(decstr[0] == '-') {
-			if(ded <= 0.)
-				ded = ded * -1.;
-			objs[nobjects].dec =
-					-1.* (ded + dem/60. + des/3600.);
-		     }
-	             else objs[nobjects].dec = ded + dem/60. + des/3600.;
-                     objs[nobjects].ep = ept;
-		     if(nitems == 9) objs[nobjects].xtra = xtr;
-		     else if(nitems == 8) objs[nobjects].xtra = 99.9;
-                }
-	        else {
-		     printf("Ignoring bad line: %s",buf);
-		     nobjects--;
-	        }
-        }
-	printf("\n .... %d objects read from file.\n",nobjects);
-	if(nobjects == MAX_OBJECTS - 1)
-	  printf("** WARNING ** AT MAX NUMBER OF OBJECTS. You may have missed some.\n");
+		if(resp[0] == 'r') {
+			ctx->cat.n = 0;
+			catalog_touch(&ctx->cat);
+		}
+	}
+
+	if(catalog_load_fp(&ctx->cat,inf,1,&nbad) < 0)
+	  printf("** WARNING ** couldn't read the whole file. You may have missed some.\n");
+	if(ctx->catindex != NULL) {   /* keep the index up to date */
+		catindex_free(ctx->catindex);
+		catindex_build_r(ctx,&ctx->cat,ctx->catindex->epoch,ctx->catindex);
+	}
+	printf("\n .... %d objects read from file.\n",ctx->cat.n);
 	fclose(inf);
 	return(0);  /* success */
 }
 
-int find_by_name(ra, dec, epoch, date, use_dst, enter_ut, night_date, stdz,
-		lat, longit)
+int read_obj_list()
+{
+	return(read_obj_list_r(&skycalc_default_ctx));
+}
+
+int find_by_name_r(ctx, ra, dec, epoch, date, use_dst, enter_ut, night_date,
+		stdz, lat, longit)
+	struct skycalc_ctx *ctx;
 	double *ra, *dec, epoch, stdz, lat, longit;
 	struct date_time date;
 	short use_dst, enter_ut, night_date;
@@ -5666,7 +11395,7 @@ int find_by_name(ra, dec, epoch, date, use_dst, enter_ut, night_date, stdz,
 	int i, found = 1;
 	double jd, curep, curra, curdec, sid, ha, alt, az, secz, precra, precdec;
 
-	if(nobjects == 0) {
+	if(ctx->cat.n == 0) {
 		printf("No objects!\n");
 		return(-1);
 	}
@@ -5686,33 +11415,33 @@ int find_by_name(ra, dec, epoch, date, use_dst, enter_ut, night_date, stdz,
 	scanf("%s",objname);
 
 	i = 1;
-	while((i <= nobjects) &&
-		((found = strcmp(objs[i].name,objname)) != 0)) i++;
+	while((i <= ctx->cat.n) &&
+		((found = strcmp(ctx->cat.objs[i].name,objname)) != 0)) i++;
         if(found == 0) {
-		if(objs[i].ep != epoch) {
-		        precrot(objs[i].ra,objs[i].dec,objs[i].ep,
+		if(ctx->cat.objs[i].ep != epoch) {
+		        precrot_r(ctx,ctx->cat.objs[i].ra,ctx->cat.objs[i].dec,ctx->cat.objs[i].ep,
                                 epoch,&precra,&precdec);
 		}
 		else {
-			precra = objs[i].ra;
-			precdec = objs[i].dec;
+			precra = ctx->cat.objs[i].ra;
+			precdec = ctx->cat.objs[i].dec;
 		}
 		*ra = precra;
 		*dec = precdec;
 		printf("\nObject found -- name, coords, epoch, user#, HA, airmass --- \n\n");
-		printf("%s  ",objs[i].name);
-		put_coords(objs[i].ra,3);
+		printf("%s  ",ctx->cat.objs[i].name);
+		put_coords_r(ctx,ctx->cat.objs[i].ra,3);
 		printf("  ");
-		put_coords(objs[i].dec,2);
-		printf("  %6.1f  %5.2f ",objs[i].ep,objs[i].xtra);
-               	precrot(objs[i].ra,objs[i].dec,
-				objs[i].ep,curep,&curra,&curdec);
+		put_coords_r(ctx,ctx->cat.objs[i].dec,2);
+		printf("  %6.1f  %5.2f ",ctx->cat.objs[i].ep,ctx->cat.objs[i].xtra);
+               	precrot_r(ctx,ctx->cat.objs[i].ra,ctx->cat.objs[i].dec,
+				ctx->cat.objs[i].ep,curep,&curra,&curdec);
     		ha = adj_time(sid - curra);
  		alt=altit(curdec,ha,lat,&az);
 		secz = secant_z(alt);
-		print_ha_air(ha,secz,0,1);
+		print_ha_air_r(ctx,ha,secz,0,1);
 		printf("\n\n COORDINATES ARE NOW SET TO THIS OBJECT.\n");
-		if(objs[i].ep != epoch)
+		if(ctx->cat.objs[i].ep != epoch)
 		printf("(RA & dec have been precessed to %6.1f, your standard input epoch.)\n",
 			epoch);
 		return(0);
@@ -5724,20 +11453,32 @@ int find_by_name(ra, dec, epoch, date, use_dst, enter_ut, night_date, stdz,
         return(-1);
 }
 
-void type_list(date, use_dst, enter_ut, night_date, stdz,
+int find_by_name(ra, dec, epoch, date, use_dst, enter_ut, night_date, stdz,
+		lat, longit)
+	double *ra, *dec, epoch, stdz, lat, longit;
+	struct date_time date;
+	short use_dst, enter_ut, night_date;
+{
+	return(find_by_name_r(&skycalc_default_ctx,ra,dec,epoch,date,
+		use_dst,enter_ut,night_date,stdz,lat,longit));
+}
+
+void type_list_r(ctx, date, use_dst, enter_ut, night_date, stdz,
 		lat, longit)
+	struct skycalc_ctx *ctx;
      	double stdz, lat, longit;
 	struct date_time date;
 	short use_dst, enter_ut, night_date;
 
 
 {
-	int i;
+	int i, nstart = 1, nend;
 	double jd, curep, curra, curdec, sid, ha, alt, az, secz;
-	short nstart = 1, nend, ok;
+	double dstart, dend;   /* getshort won't do for a long list */
+	short ok;
 	char errprompt[40];
 
-	if(nobjects == 0) {
+	if(ctx->cat.n == 0) {
 		printf("No objects!\n");
 		return;
 	}
@@ -5755,41 +11496,292 @@ void type_list(date, use_dst, enter_ut, night_date, stdz,
 	printf("(Listing will show name, coords, epoch, user#, HA and airmass.)\n");
 
 	strcpy(errprompt,"ERROR IN INPUT ... ");
-	oprntf("%d objects in list.\n",nobjects);
-/*	while((nobjects > 0) && (nstart > 0)) { used to loop -- too tricky. */
+	oprntf_r(ctx,"%d objects in list.\n",ctx->cat.n);
+/*	while((ctx->cat.n > 0) && (nstart > 0)) { used to loop -- too tricky. */
 	   /* get out the heavy input checking artillery to avoid
                 running away here ... */
 	  /*      printf("First and last (numbers) to list, -1 exits:"); */
 	        printf("First and last (numbers) to list:");
-		ok = getshort(&nstart,-1,(short)nobjects,errprompt);
+		ok = getdouble_r(ctx,&dstart,-1.,(double)ctx->cat.n,errprompt);
+		nstart = (int) dstart;
 		/* if(nstart < 0) break; */
-		ok = getshort(&nend,nstart,(short)nobjects,errprompt);
-		if(nend > nobjects) nend = nobjects;
+		ok = getdouble_r(ctx,&dend,(double)nstart,(double)ctx->cat.n,errprompt);
+		nend = (int) dend;
+		if(nend > ctx->cat.n) nend = ctx->cat.n;
 		if(nstart > nend) nstart = nend;
-		oprntf("\n\n");
-		print_current(date,night_date,enter_ut);
-		oprntf("\n");
+		oprntf_r(ctx,"\n\n");
+		print_current_r(ctx,date,night_date,enter_ut);
+		oprntf_r(ctx,"\n");
                 for(i = nstart; i <= nend; i++) {
- 			oprntf("%20s ",objs[i].name);
-			put_coords(objs[i].ra,3);
-			oprntf("  ");
-			put_coords(objs[i].dec,2);
-			oprntf("   %6.1f  %5.3f ",objs[i].ep,objs[i].xtra);
-               		precrot(objs[i].ra,objs[i].dec,
-				objs[i].ep,curep,&curra,&curdec);
+ 			oprntf_r(ctx,"%20s ",ctx->cat.objs[i].name);
+			put_coords_r(ctx,ctx->cat.objs[i].ra,3);
+			oprntf_r(ctx,"  ");
+			put_coords_r(ctx,ctx->cat.objs[i].dec,2);
+			oprntf_r(ctx,"   %6.1f  %5.3f ",ctx->cat.objs[i].ep,ctx->cat.objs[i].xtra);
+               		precrot_r(ctx,ctx->cat.objs[i].ra,ctx->cat.objs[i].dec,
+				ctx->cat.objs[i].ep,curep,&curra,&curdec);
     			ha = adj_time(sid - curra);
 			alt=altit(curdec,ha,lat,&az);
 			secz = secant_z(alt);
-			print_ha_air(ha,secz,0,1);
-			oprntf("\n");
+			print_ha_air_r(ctx,ha,secz,0,1);
+			oprntf_r(ctx,"\n");
 		}
-		oprntf("\n");
+		oprntf_r(ctx,"\n");
 /*	}*/
 }
 
-int find_nearest(ra, dec, epoch, date, use_dst, enter_ut, night_date, stdz,
+void type_list(date, use_dst, enter_ut, night_date, stdz,
 		lat, longit)
+	double stdz, lat, longit;
+	struct date_time date;
+	short use_dst, enter_ut, night_date;
+{
+	type_list_r(&skycalc_default_ctx,date,use_dst,enter_ut,night_date,
+		stdz,lat,longit);
+}
+
+int catalog_keys_r(ctx,cat,rs,keys)
+
+	struct skycalc_ctx *ctx;
+	struct catalog *cat;
+	struct rank_spec *rs;
+	double *keys;
+
+/* computes the sort key rs->key for every object in cat, as
+   find_nearest_r ranks them; keys[i] is for cat->objs[i+1].
+     RANK_ARC      arc from rs->ra, rs->dec (radians)
+     RANK_HA       absolute hour angle (hours)
+     RANK_AIRMASS  difference in secz from rs->ra, rs->dec
+     RANK_SETTING  hours until secz reaches rs->aircrit in the west;
+                   100. if never, or already past
+     RANK_XTRA     the user-supplied number.
+   Objects are precessed a run at a time (runs of one epoch) with
+   precrot_batch, and secz comes from altaz_batch.  Returns 0, or
+   -1 for an unknown key or an aircrit less than 1. */
+
+{
+	struct objct *ob;
+	double a[BATCH_BLOCK], d[BATCH_BLOCK], alt[BATCH_BLOCK],
+		az[BATCH_BLOCK], secz[BATCH_BLOCK];
+	double curep, sid, curra, curdec, ha, seczob = 0., altcrit = 0.,
+		hacrit, ep;
+	int i, j, m;
+
+	if(rs->key < RANK_ARC || rs->key > RANK_XTRA) return(-1);
+	sid = lst_r(ctx,rs->jd,rs->longit);
+	curep = 2000. + (rs->jd - J2000) / 365.25;
+	if(rs->key == RANK_AIRMASS) {
+		precrot_r(ctx,rs->ra,rs->dec,rs->epoch,curep,&curra,&curdec);
+		ha = adj_time(sid - curra);
+		seczob = secant_z(altit(curdec,ha,rs->lat,az));
+	}
+	if(rs->key == RANK_SETTING) {
+		if(rs->aircrit < 1.) return(-1);
+		altcrit = DEG_IN_RADIAN * asin(1.0 / rs->aircrit);
+	}
+
+	for(i = 0; i < cat->n; i += m) {
+		ob = cat->objs + i + 1;
+		if(rs->key == RANK_XTRA) {
+			m = cat->n;
+			for(j = 0; j < m; j++) keys[j] = ob[j].xtra;
+			continue;
+		}
+		/* a run of objects with one epoch */
+		ep = ob[0].ep;
+		for(m = 1; m < BATCH_BLOCK && i + m < cat->n && ob[m].ep == ob[0].ep; m++) ;
+		for(j = 0; j < m; j++) {
+			a[j] = ob[j].ra;
+			d[j] = ob[j].dec;
+		}
+		if(rs->key == RANK_ARC) {
+			if(ep != rs->epoch)
+				precrot_batch(prec_cache_r(ctx,ep,rs->epoch),a,d,
+					NULL,NULL,(size_t) m,a,d);
+			for(j = 0; j < m; j++)
+				keys[i+j] = subtend(rs->ra,rs->dec,a[j],d[j]);
+			continue;
+		}
+		precrot_batch(prec_cache_r(ctx,ep,curep),a,d,NULL,NULL,
+			(size_t) m,a,d);
+		if(rs->key == RANK_HA)
+			for(j = 0; j < m; j++) keys[i+j] = fabs(adj_time(sid - a[j]));
+		else if(rs->key == RANK_AIRMASS) {
+			altaz_batch(a,d,(size_t) m,rs->jd,rs->lat,rs->longit,
+				alt,az,secz);
+			for(j = 0; j < m; j++) keys[i+j] = fabs(secz[j] - seczob);
+		}
+		else for(j = 0; j < m; j++) {   /* RANK_SETTING */
+			hacrit = ha_alt(d[j],rs->lat,altcrit);
+			if(fabs(hacrit) > 24.) keys[i+j] = 100.;
+			else {
+				keys[i+j] = hacrit - adj_time(sid - a[j]);
+				if(keys[i+j] < 0.) keys[i+j] = 100.;
+			}
+		}
+	}
+	return(0);
+}
+
+int catalog_keys(cat,rs,keys)
+
+	struct catalog *cat;
+	struct rank_spec *rs;
+	double *keys;
+{
+	return(catalog_keys_r(&skycalc_default_ctx,cat,rs,keys));
+}
+
+int rank_less(keys,a,b)
+
+	double *keys;
+	int a, b;
+
+/* ranking order -- by key, ties by position. */
 
+{
+	return(keys[a] < keys[b] || (keys[a] == keys[b] && a < b));
+}
+
+int rank_topk(keys,n,k,idx,work)
+
+	double *keys;
+	int n, k;
+	int *idx, *work;
+
+/* finds the k smallest of keys[0] through keys[n-1], leaving their
+   positions in idx[0] through idx[k-1], smallest first (equal keys
+   in order of position).  idx needs room for only k; the selection
+   is done in work, which must have room for n, or is allocated here
+   if work is NULL.  Partial selection (Hoare) and then a heap sort
+   of just the k, so it's O(n + k log k) where a full sort is
+   O(n log n).  Returns the number ranked -- k, or n if that's
+   smaller -- or -1 if work can't be allocated. */
+
+{
+	int lo, hi, i, j, c, p, t, m, *w;
+
+	if(k > n) k = n;
+	if(k <= 0) return(0);
+	w = work;
+	if(w == NULL && (w = (int *) malloc(n * sizeof(int))) == NULL)
+		return(-1);
+	for(i = 0; i < n; i++) w[i] = i;
+
+	/* select, so that the k smallest come first */
+	lo = 0;
+	hi = n - 1;
+	while(lo < hi) {
+		p = w[(lo + hi) / 2];
+		i = lo;
+		j = hi;
+		while(i <= j) {
+			while(rank_less(keys,w[i],p)) i++;
+			while(rank_less(keys,p,w[j])) j--;
+			if(i <= j) {
+				t = w[i]; w[i] = w[j]; w[j] = t;
+				i++;
+				j--;
+			}
+		}
+		if(k - 1 <= j) hi = j;
+		else if(k - 1 >= i) lo = i;
+		else break;
+	}
+
+	for(i = 0; i < k; i++) idx[i] = w[i];
+	if(work == NULL) free(w);
+
+	/* heap sort of idx[0..k-1], largest to the end */
+	for(m = k / 2 - 1; m >= 0; m--) {   /* heapify */
+		for(i = m; (c = 2*i + 1) < k; i = c) {
+			if(c + 1 < k && rank_less(keys,idx[c],idx[c+1])) c++;
+			if(!rank_less(keys,idx[i],idx[c])) break;
+			t = idx[i]; idx[i] = idx[c]; idx[c] = t;
+		}
+	}
+	for(m = k - 1; m > 0; m--) {
+		t = idx[0]; idx[0] = idx[m]; idx[m] = t;
+		for(i = 0; (c = 2*i + 1) < m; i = c) {
+			if(c + 1 < m && rank_less(keys,idx[c],idx[c+1])) c++;
+			if(!rank_less(keys,idx[i],idx[c])) break;
+			t = idx[i]; idx[i] = idx[c]; idx[c] = t;
+		}
+	}
+	return(k);
+}
+
+int catalog_rank_r(ctx,cat,rs,k,idx,keys)
+
+	struct skycalc_ctx *ctx;
+	struct catalog *cat;
+	struct rank_spec *rs;
+	int k;
+	int *idx;
+	double *keys;
+
+/* ranks cat by rs (see catalog_keys_r) and returns the k objects
+   with the smallest keys: idx[0] through idx[k-1] are their
+   0-based positions -- object idx[j] is cat->objs[idx[j] + 1] --
+   and its key is keys[idx[j]].  idx must have room for k, and keys
+   for cat->n.  Returns the number ranked, or -1 as for
+   catalog_keys_r or if rank_topk can't allocate its work space. */
+
+{
+	if(catalog_keys_r(ctx,cat,rs,keys) < 0) return(-1);
+	return(rank_topk(keys,cat->n,k,idx,(int *) NULL));
+}
+
+int catalog_rank(cat,rs,k,idx,keys)
+
+	struct catalog *cat;
+	struct rank_spec *rs;
+	int k;
+	int *idx;
+	double *keys;
+{
+	return(catalog_rank_r(&skycalc_default_ctx,cat,rs,k,idx,keys));
+}
+
+int find_nearest_rank_r(ctx,useix,ra,dec,epoch,want,ind,keys,iwork,dwork)
+
+	struct skycalc_ctx *ctx;
+	int useix;
+	double ra, dec, epoch;
+	int want, *ind;
+	double *keys;
+	int *iwork;
+	double *dwork;
+
+/* puts the want top-ranked objects in ind[1..want], as indices into
+   the catalog.  If useix, they're the nearest to ra and dec, from
+   the context's catalog index, and their keys[] are filled in;
+   otherwise keys[1..n] must all be set already.  iwork must have
+   room for n, and dwork (used only with the index) for want.
+   Returns the number ranked. */
+
+{
+	int j, k;
+
+	if(useix) {
+		k = catindex_nearest_r(ctx,ctx->catindex,ra,dec,epoch,want,
+			iwork,dwork);
+		for(j = 0; j < k; j++) {
+			keys[iwork[j]] = dwork[j];
+			ind[j+1] = iwork[j];
+		}
+	}
+	else {
+		k = rank_topk(keys + 1,ctx->cat.n,want,ind + 1,iwork);
+		for(j = 0; j < k; j++) ind[j+1] = ind[j+1] + 1;
+	}
+	return(k);
+}
+
+int find_nearest_r(ctx, ra, dec, epoch, date, use_dst, enter_ut, night_date,
+		stdz, lat, longit)
+
+	struct skycalc_ctx *ctx;
 	double *ra, *dec, epoch, stdz, lat, longit;
 	struct date_time date;
 	short use_dst, enter_ut, night_date;
@@ -5799,15 +11791,17 @@ int find_nearest(ra, dec, epoch, date, use_dst, enter_ut, night_date, stdz,
    whether to accept.  */
 
 {
- 	int i, ind[MAX_OBJECTS];
+ 	int i, *ind, *iwork;
 	double precra, precdec, jd, sid, ha, alt, az,
-		secz, seczob, curra, curdec, curep, hacrit, altcrit, aircrit;
-	float arcs[MAX_OBJECTS];
+		secz, seczob, curra, curdec, curep, aircrit = 0.;
+	double *keys, *dwork = NULL;
+	struct rank_spec rs;
 	char resp[10];
 	int found = 0;
+	int useix, nranked;     /* objects ranked so far */
         short sortopt,nprnt;
 
-	if(nobjects == 0) {
+	if(ctx->cat.n == 0) {
 		printf("No objects!\n");
 		return(-1);
 	}
@@ -5832,165 +11826,172 @@ int find_nearest(ra, dec, epoch, date, use_dst, enter_ut, night_date, stdz,
 		printf("Give critical airmass in west:");
 	        scanf("%lf",&aircrit);
 		if(aircrit < 1.) {
-			oprntf("Airmass must be > 1. ... exiting!\n");
+			oprntf_r(ctx,"Airmass must be > 1. ... exiting!\n");
 			return(-1);
 		}
-		altcrit = DEG_IN_RADIAN * asin(1.0 / aircrit);
 	}
-	sid = lst(jd, longit);
+	sid = lst_r(ctx,jd,longit);
 	curep = 2000. + (jd - J2000) / 365.25;
 
-	 /* compute present airmass for option 3 */
-        if(sortopt == 3) {
-	    precrot(*ra,*dec,epoch,
-                         curep,&curra,&curdec);
-	    ha = adj_time(sid - curra);
-	    alt=altit(curdec,ha,lat,&az);
-	    seczob = secant_z(alt);
-        }
-
-	for(i = 1; i <= nobjects; i++) {
-		if(sortopt == 1) {   /* sort by arc distance */
-		   if(objs[i].ep != epoch)
- 	  		precrot(objs[i].ra,objs[i].dec,objs[i].ep,
-                                epoch,&precra,&precdec);
- 		   else {
-			precra = objs[i].ra;
-			precdec = objs[i].dec;
-		   }
-	           arcs[i] = subtend(*ra,*dec,precra,precdec);
-		}
-		else if (sortopt == 2) {  /* sort by hour angle */
-		   precrot(objs[i].ra,objs[i].dec,objs[i].ep,
-				curep,&curra,&curdec);
-	           arcs[i] = fabs(sid - curra);
-		}
-		else if (sortopt == 3) {  /* sort by difference of airmass */
-		   precrot(objs[i].ra,objs[i].dec,objs[i].ep,
-				curep,&curra,&curdec);
-    		   ha = adj_time(sid - curra);
-		   alt=altit(curdec,ha,lat,&az);
-	    	   arcs[i] = fabs(secant_z(alt) - seczob);
-		}
-                else if (sortopt == 4) {  /* sort by proximity to critical airmass */
-		   precrot(objs[i].ra,objs[i].dec,objs[i].ep,
-				curep,&curra,&curdec);
-		   hacrit = ha_alt(curdec,lat,altcrit);
-                   if(fabs(hacrit) > 24.) arcs[i] = 100.;
-    		   else {
-	         	ha = adj_time(sid - curra);
-                        arcs[i] = hacrit - ha;
-		        if(arcs[i] < 0.) arcs[i] = 100.;
-		   }
-               }
-               else   /* sort by user-supplied extra number */
-		   arcs[i] = (double) objs[i].xtra;
+	rs.key = (sortopt >= RANK_ARC && sortopt <= RANK_SETTING) ?
+		sortopt : RANK_XTRA;
+	rs.ra = *ra;
+	rs.dec = *dec;
+	rs.epoch = epoch;
+	rs.jd = jd;
+	rs.lat = lat;
+	rs.longit = longit;
+	rs.aircrit = aircrit;
+
+	/* by arc distance, an up-to-date catalog index (see
+	   catindex_build) finds the nearest few directly.  Otherwise
+	   every object's key is computed, but only the first few are
+	   ranked (rank_topk).  More are ranked as they're asked for. */
+	useix = (rs.key == RANK_ARC) &&
+		catindex_current(ctx->catindex,&ctx->cat);
+
+	ind = (int *) malloc((ctx->cat.n + 1) * sizeof(int));
+	iwork = (int *) malloc((ctx->cat.n + 1) * sizeof(int));
+	keys = (double *) malloc((ctx->cat.n + 1) * sizeof(double));
+	if(useix) dwork = (double *) malloc((ctx->cat.n + 1) * sizeof(double));
+	if(ind == NULL || iwork == NULL || keys == NULL ||
+	   (useix && dwork == NULL)) {
+		printf("Out of memory sorting the object list!\n");
+		free(ind);
+		free(iwork);
+		free(keys);
+		free(dwork);
+		return(-1);
 	}
-
-	indexx(nobjects,arcs,ind);
+	if(!useix) catalog_keys_r(ctx,&ctx->cat,&rs,keys + 1);
+	nranked = find_nearest_rank_r(ctx,useix,*ra,*dec,epoch,20,ind,keys,
+		iwork,dwork);
 
 	printf("If you now select an object, RA & dec will be set to its coords.\n\n");
-	if(sclogfl != NULL) fprintf(sclogfl,"\n\n *** Sorted object listing *** \n");
-	oprntf("Listed for each: Name, ra, dec, epoch, user-defined #,\n");
-	if(sortopt == 1) oprntf("arclength to coords (deg), ");
-        if(sortopt == 4) oprntf("minutes til crit secz, ");
-	oprntf("HA, secz, computed for the following date & time:\n\n");
-	print_current(date,night_date,enter_ut);
-	oprntf("\n\n");
+	if(ctx->sclogfl != NULL) fprintf(ctx->sclogfl,"\n\n *** Sorted object listing *** \n");
+	oprntf_r(ctx,"Listed for each: Name, ra, dec, epoch, user-defined #,\n");
+	if(sortopt == 1) oprntf_r(ctx,"arclength to coords (deg), ");
+        if(sortopt == 4) oprntf_r(ctx,"minutes til crit secz, ");
+	oprntf_r(ctx,"HA, secz, computed for the following date & time:\n\n");
+	print_current_r(ctx,date,night_date,enter_ut);
+	oprntf_r(ctx,"\n\n");
 	if((sortopt != 2) && (sortopt != 4)) { /* print relevant info */
-	    oprntf("Current coords: ");
-	    put_coords(*ra,3);
-	    oprntf("  ");
-            put_coords(*dec,2);
-	    oprntf("  %6.1f ",epoch);
-	    precrot(*ra,*dec,epoch,
+	    oprntf_r(ctx,"Current coords: ");
+	    put_coords_r(ctx,*ra,3);
+	    oprntf_r(ctx,"  ");
+            put_coords_r(ctx,*dec,2);
+	    oprntf_r(ctx,"  %6.1f ",epoch);
+	    precrot_r(ctx,*ra,*dec,epoch,
                                 curep,&curra,&curdec);
 	    ha = adj_time(sid - curra);
 	    alt=altit(curdec,ha,lat,&az);
 	    seczob = secant_z(alt);
-	    print_ha_air(ha,seczob,0,1);
-	    oprntf("\n\n");
+	    print_ha_air_r(ctx,ha,seczob,0,1);
+	    oprntf_r(ctx,"\n\n");
 	}
 
 	i = 1;
 	while(found == 0) {
 	    for(nprnt=1;nprnt<=10;nprnt++) {
-		precrot(objs[ind[i]].ra,objs[ind[i]].dec,
-				objs[ind[i]].ep,
+		if(i > nranked) nranked = find_nearest_rank_r(ctx,useix,
+			*ra,*dec,epoch,4 * nranked,ind,keys,iwork,dwork);
+		precrot_r(ctx,ctx->cat.objs[ind[i]].ra,ctx->cat.objs[ind[i]].dec,
+				ctx->cat.objs[ind[i]].ep,
                                    curep,&curra,&curdec);
     		ha = adj_time(sid - curra);
 		alt=altit(curdec,ha,lat,&az);
 
- 		oprntf("%2d %13s",i,objs[ind[i]].name);
-		put_coords(objs[ind[i]].ra,3);
-		oprntf(" ");
-		put_coords(objs[ind[i]].dec,2);
-		oprntf(" %6.1f %6.2f ",objs[ind[i]].ep, objs[ind[i]].xtra);
-		if(sortopt == 1) oprntf(" %6.3f",arcs[ind[i]] * DEG_IN_RADIAN);
-                if(sortopt == 4) oprntf(" %5.0f",arcs[ind[i]] * 60.);
+ 		oprntf_r(ctx,"%2d %13s",i,ctx->cat.objs[ind[i]].name);
+		put_coords_r(ctx,ctx->cat.objs[ind[i]].ra,3);
+		oprntf_r(ctx," ");
+		put_coords_r(ctx,ctx->cat.objs[ind[i]].dec,2);
+		oprntf_r(ctx," %6.1f %6.2f ",ctx->cat.objs[ind[i]].ep, ctx->cat.objs[ind[i]].xtra);
+		if(sortopt == 1) oprntf_r(ctx," %6.3f",keys[ind[i]] * DEG_IN_RADIAN);
+                if(sortopt == 4) oprntf_r(ctx," %5.0f",keys[ind[i]] * 60.);
 		secz = secant_z(alt);
-		print_ha_air(ha,secz,0,1);
-                oprntf("\n");
-                if(nprnt == 5) oprntf("\n");
+		print_ha_air_r(ctx,ha,secz,0,1);
+                oprntf_r(ctx,"\n");
+                if(nprnt == 5) oprntf_r(ctx,"\n");
 		i++;
-	        if(i > nobjects) break;
+	        if(i > ctx->cat.n) break;
             }
 	    printf("Type number to select an object, m to see more, q to quit:");
 
  	    scanf("%s",resp);
  	    if(resp[0] == 'q') {
-			oprntf("Abandoning search.\n");
-			return(found = -1);
+			oprntf_r(ctx,"Abandoning search.\n");
+			found = -1;
+			goto DONE;
 	    }
 	    else if((resp[0] == 'm') || (resp[0] == 'M')) {
-		if(i > nobjects) {
-			oprntf("Sorry -- that's all you have!\n");
-			oprntf("Search abandoned.\n");
-	        	return(found = -1);
+		if(i > ctx->cat.n) {
+			oprntf_r(ctx,"Sorry -- that's all you have!\n");
+			oprntf_r(ctx,"Search abandoned.\n");
+	        	found = -1;
+			goto DONE;
                 }
 	    }
 	    else if(isdigit(resp[0]) != 0) {
 		sscanf(resp,"%d",&i);
-		if((i < 0) || (i > nobjects)) {
-		     	oprntf("BAD OBJECT INDEX -- %d -- start over!\n",i);
-			return(-1);
+		if((i < 0) || (i > ctx->cat.n)) {
+		     	oprntf_r(ctx,"BAD OBJECT INDEX -- %d -- start over!\n",i);
+			found = -1;
+			goto DONE;
 		}
- 		if(objs[ind[i]].ep != epoch)
-			     precrot(objs[ind[i]].ra,objs[ind[i]].dec,
-				objs[ind[i]].ep,
+		if(i > nranked) nranked = find_nearest_rank_r(ctx,useix,
+			*ra,*dec,epoch,i,ind,keys,iwork,dwork);
+ 		if(ctx->cat.objs[ind[i]].ep != epoch)
+			     precrot_r(ctx,ctx->cat.objs[ind[i]].ra,ctx->cat.objs[ind[i]].dec,
+				ctx->cat.objs[ind[i]].ep,
                                    epoch,&precra,&precdec);
 		else {
-			precra = objs[ind[i]].ra;
-			precdec = objs[ind[i]].dec;
+			precra = ctx->cat.objs[ind[i]].ra;
+			precdec = ctx->cat.objs[ind[i]].dec;
 		}
                 *ra = precra;
 		*dec = precdec;
-		oprntf("\n%s  ",objs[ind[i]].name);
-		put_coords(objs[ind[i]].ra,3);
-		oprntf("  ");
-		put_coords(objs[ind[i]].dec,2);
-		oprntf("  %6.1f  %5.2f ",objs[ind[i]].ep,objs[ind[i]].xtra);
-               	precrot(objs[ind[i]].ra,objs[ind[i]].dec,
-				objs[ind[i]].ep,curep,&curra,&curdec);
+		oprntf_r(ctx,"\n%s  ",ctx->cat.objs[ind[i]].name);
+		put_coords_r(ctx,ctx->cat.objs[ind[i]].ra,3);
+		oprntf_r(ctx,"  ");
+		put_coords_r(ctx,ctx->cat.objs[ind[i]].dec,2);
+		oprntf_r(ctx,"  %6.1f  %5.2f ",ctx->cat.objs[ind[i]].ep,ctx->cat.objs[ind[i]].xtra);
+               	precrot_r(ctx,ctx->cat.objs[ind[i]].ra,ctx->cat.objs[ind[i]].dec,
+				ctx->cat.objs[ind[i]].ep,curep,&curra,&curdec);
     		ha = adj_time(sid - curra);
  		alt=altit(curdec,ha,lat,&az);
 		secz = secant_z(alt);
-		print_ha_air(ha,secz,0,1);
-		oprntf("\n\n COORDINATES ARE NOW SET TO THIS OBJECT.\n");
-		if(objs[ind[i]].ep != epoch)
-   		oprntf("(RA & dec have been precessed to %6.1f, your current standard epoch.)\n",
+		print_ha_air_r(ctx,ha,secz,0,1);
+		oprntf_r(ctx,"\n\n COORDINATES ARE NOW SET TO THIS OBJECT.\n");
+		if(ctx->cat.objs[ind[i]].ep != epoch)
+   		oprntf_r(ctx,"(RA & dec have been precessed to %6.1f, your current standard epoch.)\n",
 				epoch);
-		return(found = 1);
+		found = 1;
 	    }
 	    else {
 		printf("Unrecognized response ... continuing ..\n");
-		if(i > nobjects) {
+		if(i > ctx->cat.n) {
 			printf("That's all the objects .. abandoning search.\n");
-			return(found = -1);
+			found = -1;
+			goto DONE;
 		}
             }
         }
-        return(found = -1);
+   DONE:
+	free(ind);
+	free(iwork);
+	free(keys);
+	free(dwork);
+	return(found);
+}
+
+int find_nearest(ra, dec, epoch, date, use_dst, enter_ut, night_date, stdz,
+		lat, longit)
+	double *ra, *dec, epoch, stdz, lat, longit;
+	struct date_time date;
+	short use_dst, enter_ut, night_date;
+{
+	return(find_nearest_r(&skycalc_default_ctx,ra,dec,epoch,date,
+		use_dst,enter_ut,night_date,stdz,lat,longit));
 }
 
 void set_zenith(date, use_dst, enter_ut, night_date, stdz, lat,
@@ -6347,7 +12348,7 @@ oprntf("The date in effect will now be interpreted as the evening date.\n");
 			nreturns=0;
 			break;
 		case 'a':
-			if(sclogfl != NULL) fprintf(sclogfl,"\n\n"); /* space it */
+			if(skycalc_default_ctx.sclogfl != NULL) fprintf(skycalc_default_ctx.sclogfl,"\n\n"); /* space it */
 			oprntf("*** Almanac for the currently specified date ***");
 			if(night_date != 1) {
 oprntf(", but CAUTION!!\nThe 'night date' option is off, so be especially careful\n");
@@ -6376,7 +12377,7 @@ oprntf("this is the correct night.  See 'g' and 'n'...");
 			nreturns=0;
 			break;
 		case '=':  /* PRINT CIRCUMSTANCES for current params */
-			if(sclogfl != NULL) fprintf(sclogfl,"\n\n*** Instantaneous Circumstances ***\n");
+			if(skycalc_default_ctx.sclogfl != NULL) fprintf(skycalc_default_ctx.sclogfl,"\n\n*** Instantaneous Circumstances ***\n");
 			if(setup_time_place(date,longit,lat,stdz,
 			    use_dst,zone_name,zabr, site_name,enter_ut,
 			    night_date,&jd,&jdloc,&jdb,&jde,&sid,
@@ -6384,6 +12385,7 @@ oprntf("this is the correct night.  See 'g' and 'n'...");
 			print_circumstances(objra,objdec,objepoch,jd,
 			    curep,mura_arcs,mura_sec,mudec,
 				   sid,lat,elevsea,horiz);
+			printf("\nType command, 'f' for fast tour, '?' for a menu:");
 			nreturns=0;
 			break;
 		case 'm':  /* print positions of major planets */
@@ -6393,6 +12395,7 @@ oprntf("this is the correct night.  See 'g' and 'n'...");
 				   break;
 			comp_el(jd);
 			pposns(jd,lat,sid,1,pra,pdec);
+			printf("Type command, or ? for menu:");
 			nreturns=0;
 			break;
 		case 'h':  /* print an hourly airmass table */
@@ -6402,7 +12405,7 @@ oprntf("this is the correct night.  See 'g' and 'n'...");
 			nreturns=0;
 			break;
 		case 'o':
-			if(sclogfl != NULL) fprintf(sclogfl,"\n");
+			if(skycalc_default_ctx.sclogfl != NULL) fprintf(skycalc_default_ctx.sclogfl,"\n");
 		        obs_season(objra,objdec,objepoch,
 			     lat,longit);
 			nreturns=0;
@@ -6468,8 +12471,8 @@ oprntf("this is the correct night.  See 'g' and 'n'...");
 			oprntf("  xx ... null command, returns to main level.\n");
 			   break;
                            case 'v':
-			      if(sclogfl != NULL)
-				fprintf(sclogfl,"\n\n  *** Ephemeris predictions ***\n\n");
+			      if(skycalc_default_ctx.sclogfl != NULL)
+				fprintf(skycalc_default_ctx.sclogfl,"\n\n  *** Ephemeris predictions ***\n\n");
 			      ephemgen(objra,objdec,objepoch,lat,longit);
 			   break;
 			   case 'f':
@@ -6530,24 +12533,24 @@ oprntf("this is the correct night.  See 'g' and 'n'...");
 	                   break;
 #if LOG_FILES_OK == 1
 			   case 'L':
-				if(sclogfl == NULL) {
+				if(skycalc_default_ctx.sclogfl == NULL) {
 				    trying = 1;
-				    while(sclogfl == NULL && trying == 1) {
+				    while(skycalc_default_ctx.sclogfl == NULL && trying == 1) {
 				    	printf("Give filename for log file, type NONE to cancel:");
 				    	scanf("%s",str);
 					if(strcmp(str,"NONE") == 0)
 						trying = 0;
 					else {
-				    		sclogfl = fopen(str,"a");
+				    		skycalc_default_ctx.sclogfl = fopen(str,"a");
 					}
 				    }
-				    if(sclogfl != NULL)
+				    if(skycalc_default_ctx.sclogfl != NULL)
 					printf("log file %s is OPEN in append mode.\n",str);
 				    else printf("LOG FILE NOT OPENED.\n");
 				}
 			        else {
-				    fclose(sclogfl);
-				    sclogfl = NULL;  /* reset it explicitly */
+				    fclose(skycalc_default_ctx.sclogfl);
+				    skycalc_default_ctx.sclogfl = NULL;  /* reset it explicitly */
 				    printf("Log file has been CLOSED.\n");
 				}
 				break;
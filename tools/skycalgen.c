@@ -0,0 +1,151 @@
+/* skycalgen -- nighttime calendars for many sites and years at once.
+
+   usage: skycalgen [-f text|tex1|tex2|data] [-t nthreads] [-o prefix]
+		year nyears sitefile
+
+   Each line of sitefile describes one site, as load_site would:
+
+	longit lat stdz use_dst elevsea elev zabr zone_name site name
+
+   -- west longitude in decimal hours, latitude in decimal degrees,
+   standard zone in hours west, the daylight time convention (0, 1,
+   2, -1, -2), elevation above sea level and above the horizon in
+   meters, the one-character zone abbreviation, the zone's name (one
+   word) and the rest of the line for the site's name.  Blank lines
+   and lines starting with '#' are skipped.
+
+   The nights are computed by calendar_gen over nthreads threads
+   (default one per processor), then printed site by site in the
+   order of the file -- to standard output, or with -o to one file
+   per site, prefix01.txt and so on (.tex or .dat by format).
+
+   Copyright (C) 2000  J.D.Pritchard -- GNU General Public License,
+   version 2 or later; see COPYING. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "libskycalc.h"
+
+#define MAXSITES 256
+
+int read_sites(fname, site)
+
+	char *fname;
+	struct cal_site *site;
+
+/* reads up to MAXSITES sites from fname; returns how many, or -1
+   if the file can't be read or a line doesn't parse. */
+
+{
+	FILE *fp;
+	char line[256], zabr[8], *p;
+	int n, nch, use_dst, lineno;
+	struct cal_site *st;
+
+	if((fp = fopen(fname,"r")) == NULL) return(-1);
+	n = 0;
+	lineno = 0;
+	while(fgets(line,sizeof(line),fp) != NULL) {
+		lineno++;
+		for(p = line; *p == ' ' || *p == '\t'; p++) ;
+		if(*p == '#' || *p == '\n' || *p == '\0') continue;
+		if(n == MAXSITES) break;
+		st = site + n;
+		if(sscanf(p,"%lf %lf %lf %d %lf %lf %7s %24s %n",&st->longit,
+		     &st->lat,&st->stdz,&use_dst,&st->elevsea,&st->elev,
+		     zabr,st->zone_name,&nch) < 8) {
+			fprintf(stderr,"%s, line %d: can't read site.\n",fname,
+				lineno);
+			fclose(fp);
+			return(-1);
+		}
+		p = p + nch;
+		p[strcspn(p,"\r\n")] = '\0';
+		strncpy(st->name,p,sizeof(st->name) - 1);
+		st->name[sizeof(st->name) - 1] = '\0';
+		st->zabr = zabr[0];
+		st->use_dst = use_dst;
+		/* depression of the horizon, as load_site */
+		st->horiz = sqrt(2. * st->elev / 6378140.) * DEG_IN_RADIAN;
+		n++;
+	}
+	fclose(fp);
+	return(n);
+}
+
+int main(argc, argv)
+
+	int argc;
+	char **argv;
+
+{
+	static struct cal_site site[MAXSITES];
+	struct calendar cal;
+	char *prefix, *ext, fname[512];
+	short format;
+	int i, nsite, nthreads, year, nyears, nt;
+	FILE *fp;
+
+	format = CAL_TEXT;
+	ext = "txt";
+	nthreads = 0;
+	prefix = NULL;
+	for(i = 1; i < argc - 1 && argv[i][0] == '-'; i += 2) {
+		if(strcmp(argv[i],"-f") == 0) {
+			if(strcmp(argv[i+1],"text") == 0) format = CAL_TEXT;
+			else if(strcmp(argv[i+1],"tex1") == 0) format = CAL_TEX1;
+			else if(strcmp(argv[i+1],"tex2") == 0) format = CAL_TEX2;
+			else if(strcmp(argv[i+1],"data") == 0) format = CAL_DATA;
+			else break;
+			ext = (format == CAL_TEXT) ? "txt" :
+				(format == CAL_DATA) ? "dat" : "tex";
+		}
+		else if(strcmp(argv[i],"-t") == 0) nthreads = atoi(argv[i+1]);
+		else if(strcmp(argv[i],"-o") == 0) prefix = argv[i+1];
+		else break;
+	}
+	if(argc - i != 3) {
+		fprintf(stderr,"usage: %s [-f text|tex1|tex2|data] [-t nthreads] [-o prefix] year nyears sitefile\n",
+			argv[0]);
+		return(1);
+	}
+	year = atoi(argv[i]);
+	nyears = atoi(argv[i+1]);
+	if(year < 1901 || nyears < 1 || year + nyears - 1 > 2099) {
+		fprintf(stderr,"%s: years must be within 1901 to 2099.\n",argv[0]);
+		return(1);
+	}
+	if((nsite = read_sites(argv[i+2],site)) <= 0) {
+		fprintf(stderr,"%s: no sites read from %s.\n",argv[0],argv[i+2]);
+		return(1);
+	}
+
+	nt = calendar_gen(site,nsite,(short) year,(short) nyears,nthreads,&cal);
+	if(nt < 0) {
+		fprintf(stderr,"%s: out of memory.\n",argv[0]);
+		return(1);
+	}
+	fprintf(stderr,"%s: %d sites, %d nights each, %d threads.\n",argv[0],
+		nsite,cal.nnight,nt);
+
+	for(i = 0; i < nsite; i++) {
+		if(prefix != NULL) {
+			sprintf(fname,"%.480s%02d.%s",prefix,i + 1,ext);
+			if((fp = fopen(fname,"w")) == NULL) {
+				fprintf(stderr,"%s: can't write %s.\n",argv[0],fname);
+				calendar_free(&cal);
+				return(1);
+			}
+			osink_file(&skycalc_default_ctx,fp);
+		}
+		calendar_print(&cal,i,format);
+		if(prefix != NULL) {
+			osink_stdout(&skycalc_default_ctx);
+			fclose(fp);
+		}
+	}
+	calendar_free(&cal);
+	return(0);
+}
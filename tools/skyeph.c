@@ -0,0 +1,51 @@
+/* skyeph -- writes a precomputed ephemeris file for libskycalc.
+
+   usage: skyeph jdstart jdend file
+
+   The file holds Chebyshev fits to the sun, moon, and planets over
+   jdstart to jdend; see skyeph_write.  Programs hand it to the
+   library with skyeph_open and by setting ctx->eph, after which
+   pposns_r, barycor_r, helcor_r, accusun_r and accumoon_r take their
+   positions from it.  Being mapped read-only, one copy in the page
+   cache serves every process using it.
+
+   Copyright (C) 2000  J.D.Pritchard -- GNU General Public License,
+   version 2 or later; see COPYING. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "libskycalc.h"
+
+int main(argc, argv)
+
+	int argc;
+	char **argv;
+
+{
+	double jdstart, jdend;
+	struct skyeph eph;
+
+	if(argc != 4) {
+		fprintf(stderr,"usage: %s jdstart jdend file\n",argv[0]);
+		return(1);
+	}
+	jdstart = atof(argv[1]);
+	jdend = atof(argv[2]);
+	if(jdend <= jdstart) {
+		fprintf(stderr,"%s: jdend must be later than jdstart.\n",argv[0]);
+		return(1);
+	}
+
+	if(skyeph_write(argv[3],jdstart,jdend) != 0) {
+		fprintf(stderr,"%s: couldn't write %s.\n",argv[0],argv[3]);
+		return(1);
+	}
+	if(skyeph_open(&eph,argv[3]) != 0) {   /* check it reads back */
+		fprintf(stderr,"%s: %s doesn't read back.\n",argv[0],argv[3]);
+		return(1);
+	}
+	printf("%s: JD %.1f to %.1f, %ld bytes.\n",argv[3],jdstart,jdend,
+		(long) eph.maplen);
+	skyeph_close(&eph);
+	return(0);
+}